@@ -49,6 +49,23 @@ namespace CCLib
 											CCVector3& dimMax,
 											double enlargeFactor = 0.01);
 
+		//! Computes the bounding-box of a transformed 3D cube
+		/** The transformed cube is enclosed in a box centered on the transformed
+			center, with half extents equal to |R|.h (R being the rotation part of
+			the transformation). The box is slightly enlarged so as to be robust to
+			rounding errors (if the points inside the cube are transformed one by one).
+			\param center the cube center (already transformed)
+			\param halfSize the cube half size
+			\param transMat the transformation (OpenGL style 4x4 matrix, i.e. column-major) or 0 if none
+			\param[out] boxMin the box min corner
+			\param[out] boxMax the box max corner
+		**/
+		static void ComputeTransformedCubeBox(	const CCVector3& center,
+												PointCoordinateType halfSize,
+												const float* transMat,
+												CCVector3& boxMin,
+												CCVector3& boxMax);
+
 		//! Computes base vectors for a given 3D plane
 		/** Determines at least two orthogonal vectors perpendicular to a third one
 			\param[in] N a non null vector
@@ -212,6 +212,39 @@ public:
 		//! Returns cloud capacity (i.e. reserved size)
 		inline virtual unsigned capacity() const { return m_points->capacity(); }
 
+		/*** bulk access ***/
+
+		//! Returns the number of chunks of the points database
+		/** Points are stored in chunks of contiguous (x,y,z) triplets. Processing
+			a cloud chunk by chunk (see ChunkedPointCloud::getChunkSize and
+			ChunkedPointCloud::getChunkPoints) is much faster than calling
+			ChunkedPointCloud::getPoint for each point.
+		**/
+		inline unsigned getChunksCount() const { return m_points->chunksCount(); }
+
+		//! Returns the number of points stored in a given chunk
+		/** Warning: may be smaller than the chunk capacity (reserved memory
+			is not taken into account).
+			\param chunkIndex chunk index
+			\return number of (valid) points in this chunk
+		**/
+		inline unsigned getChunkSize(unsigned chunkIndex) const
+		{
+			unsigned firstIndex = (chunkIndex << CHUNK_INDEX_BIT_DEC);
+			unsigned count = size();
+			if (firstIndex >= count)
+				return 0;
+			unsigned chunkSize = m_points->chunkSize(chunkIndex);
+			return (count-firstIndex < chunkSize ? count-firstIndex : chunkSize);
+		}
+
+		//! Returns the (contiguous) points stored in a given chunk
+		/** The first point of chunk 'i' has index 'i * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK'.
+			\param chunkIndex chunk index
+			\return pointer on the first point of the chunk
+		**/
+		inline const CCVector3* getChunkPoints(unsigned chunkIndex) const { return reinterpret_cast<const CCVector3*>(m_points->chunkStartPtr(chunkIndex)); }
+
 protected:
 
 		//! Swaps two points (and their associated scalar values!)
@@ -231,6 +264,18 @@ protected:
 		**/
 		inline virtual const CCVector3* point(unsigned index) const { assert(index < size()); return (CCVector3*)m_points->getValue(index); }
 
+		//! Returns non const access to the points stored in a given chunk
+		/** See ChunkedPointCloud::getChunkPoints.
+			\param chunkIndex chunk index
+			\return pointer on the first point of the chunk
+		**/
+		inline CCVector3* chunkPoints(unsigned chunkIndex) { return reinterpret_cast<CCVector3*>(m_points->chunkStartPtr(chunkIndex)); }
+
+		//! Computes the bounding-box of the points (chunk by chunk)
+		/** Equivalent to GenericChunkedArray::computeMinAndMax.
+		**/
+		void computeBoundingBox();
+
 		//! 3D Points database
 		GenericChunkedArray<3,PointCoordinateType>* m_points;
 
@@ -27,6 +27,7 @@
 
 //system
 #include <vector>
+#include <algorithm>
 #include <assert.h>
 #include <string.h>
 
@@ -99,6 +100,9 @@ public:
 	//! Invalid cell code
 	static const OctreeCellCodeType INVALID_CELL_CODE = (~(OctreeCellCodeType)0);
 
+	//! Index of a removed point (see DgmOctree::removePoints)
+	static const unsigned REMOVED_POINT_INDEX = 0xFFFFFFFF;
+
 	//! Octree cell codes container
 	typedef std::vector<OctreeCellCodeType> cellCodesContainer;
 
@@ -180,6 +184,119 @@ public:
 	//! A set of neighbour cells descriptors
 	typedef std::vector<CellDescriptor> NeighbourCellsSet;
 
+	//! Contiguous copy (structure of arrays) of the coordinates of a set of neighbours
+	/** Filled by the nearest neighbour(s) search algorithms the first time a neighbour
+		is met, and then shared by all the query points lying in the same cell, so that
+		the distances can be computed in batch (with SIMD instructions when available).
+		Each entry keeps the index of the point it has been copied from, so that the
+		block can be checked against (and resynchronized with) the neighbours it mirrors.
+	**/
+	struct NeighboursCoordinates
+	{
+		//! X coordinates
+		std::vector<PointCoordinateType> x;
+		//! Y coordinates
+		std::vector<PointCoordinateType> y;
+		//! Z coordinates
+		std::vector<PointCoordinateType> z;
+		//! Indexes of the corresponding points
+		std::vector<unsigned> indexes;
+		//! Square distances (buffer)
+		std::vector<double> squareDists;
+
+		//! Cell whose points are stored in the block
+		struct Cell
+		{
+			//! Cell index (see NearestNeighboursSearchStruct::minimalCellsSetToVisit)
+			unsigned index;
+			//! Level of subdivision of the cell (the same index may correspond to different cells at different levels)
+			uchar level;
+			//! Position of the first point of the cell in the block
+			unsigned offset;
+		};
+
+		//! Cells whose points are stored in the block (keyed by level and index)
+		/** Only used by the "unique nearest point" search algorithm (mirrors
+			NearestNeighboursSearchStruct::minimalCellsSetToVisit).
+		**/
+		std::vector<Cell> cells;
+
+		//! Returns the number of points
+		inline unsigned size() const { return static_cast<unsigned>(indexes.size()); }
+
+		//! Resizes the block (may throw std::bad_alloc)
+		void resize(unsigned count)
+		{
+			x.resize(count);
+			y.resize(count);
+			z.resize(count);
+			indexes.resize(count);
+			squareDists.resize(count);
+		}
+
+		//! Sets a given entry
+		inline void set(unsigned i, const CCVector3& P, unsigned index)
+		{
+			x[i] = P.x;
+			y[i] = P.y;
+			z[i] = P.z;
+			indexes[i] = index;
+		}
+
+		//! Adds an entry (may throw std::bad_alloc)
+		inline void push_back(const CCVector3& P, unsigned index)
+		{
+			x.push_back(P.x);
+			y.push_back(P.y);
+			z.push_back(P.z);
+			indexes.push_back(index);
+		}
+
+		//! Clears the block (without releasing memory)
+		void clear()
+		{
+			resize(0);
+			cells.clear();
+		}
+
+		//! Returns the total capacity (to detect re-allocations)
+		size_t capacity() const
+		{
+			return x.capacity() + indexes.capacity() + squareDists.capacity() + cells.capacity();
+		}
+
+		//! Swaps the content of two blocks
+		void swap(NeighboursCoordinates& other)
+		{
+			x.swap(other.x);
+			y.swap(other.y);
+			z.swap(other.z);
+			indexes.swap(other.indexes);
+			squareDists.swap(other.squareDists);
+			cells.swap(other.cells);
+		}
+	};
+
+	//! Scratch buffers for cell functions
+	/** Owned by the octree visitors (one per thread, see executeFunctionForAllCellsAtLevel
+		for instance) and reused from one cell to the next, so that the neighbour search
+		containers don't have to be re-allocated for each cell (see ScopedScratchBuffers).
+	**/
+	struct CellScratchBuffers
+	{
+		//! Neighbours buffer (see NearestNeighboursSearchStruct::pointsInNeighbourhood)
+		NeighboursSet neighbours;
+		//! Cells buffer (see NearestNeighboursSearchStruct::minimalCellsSetToVisit)
+		cellIndexesContainer cellIndexes;
+		//! Coordinates buffer (see NearestNeighboursSearchStruct::neighboursCoordinates)
+		NeighboursCoordinates coordinates;
+		//! Number of times the buffers had to grow (i.e. be re-allocated)
+		unsigned growthCount;
+
+		//! Default constructor
+		CellScratchBuffers() : growthCount(0) {}
+	};
+
 	//! Container of in/out parameters for nearest neighbour(s) search
 	/** This structure is generic and can be used in multiple cases.
 		It is particularly useful when searching nearest neighbours around points
@@ -249,6 +366,12 @@ public:
 		**/
 		int alreadyVisitedNeighbourhoodSize;
 
+		//! Coordinates of the neighbours (for batch distances computation)
+		/** This field is managed by the search algorithms (it is automatically
+			resynchronized with minimalCellsSetToVisit or pointsInNeighbourhood).
+		**/
+		NeighboursCoordinates neighboursCoordinates;
+
 		/*** Result ***/
 
 		//! The nearest point
@@ -346,6 +469,14 @@ public:
 		{
 		}
 
+		//! Assignment operator
+		IndexAndCode& operator = (const IndexAndCode& ic)
+		{
+			theIndex = ic.theIndex;
+			theCode = ic.theCode;
+			return *this;
+		}
+
 		//! Code-based comparison operator
 		/** \param a first IndexAndCode structure
 			\param b second IndexAndCode structure
@@ -384,6 +515,8 @@ public:
 		unsigned index;
 		//! Set of points lying inside this cell
 		ReferenceCloud* points;
+		//! Scratch buffers of the current thread (may be 0)
+		CellScratchBuffers* scratch;
 
 		//! Default constructor
 		octreeCell(DgmOctree* parentOctree);
@@ -392,6 +525,67 @@ public:
 		virtual ~octreeCell();
 	};
 
+	//! Lends the scratch buffers of a cell to a neighbour search structure
+	/** The search containers are swapped with the scratch buffers (and emptied) at
+		construction, and given back at destruction. Does nothing if 'buffers' is 0.
+		Typical use, in a cell function:
+		\code
+		DgmOctree::NearestNeighboursSearchStruct nNSS;
+		DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
+		\endcode
+	**/
+	class ScopedScratchBuffers
+	{
+	public:
+
+		//! Default constructor
+		ScopedScratchBuffers(NearestNeighboursSearchStruct& nNSS, CellScratchBuffers* buffers)
+			: m_nNSS(nNSS)
+			, m_buffers(buffers)
+			, m_neighboursCapacity(0)
+			, m_cellIndexesCapacity(0)
+			, m_coordinatesCapacity(0)
+		{
+			if (m_buffers)
+			{
+				m_nNSS.pointsInNeighbourhood.swap(m_buffers->neighbours);
+				m_nNSS.minimalCellsSetToVisit.swap(m_buffers->cellIndexes);
+				m_nNSS.neighboursCoordinates.swap(m_buffers->coordinates);
+				m_nNSS.pointsInNeighbourhood.clear();
+				m_nNSS.minimalCellsSetToVisit.clear();
+				m_nNSS.neighboursCoordinates.clear();
+				m_neighboursCapacity = m_nNSS.pointsInNeighbourhood.capacity();
+				m_cellIndexesCapacity = m_nNSS.minimalCellsSetToVisit.capacity();
+				m_coordinatesCapacity = m_nNSS.neighboursCoordinates.capacity();
+			}
+		}
+
+		//! Destructor
+		~ScopedScratchBuffers()
+		{
+			if (m_buffers)
+			{
+				if (	m_nNSS.pointsInNeighbourhood.capacity() != m_neighboursCapacity
+					||	m_nNSS.minimalCellsSetToVisit.capacity() != m_cellIndexesCapacity
+					||	m_nNSS.neighboursCoordinates.capacity() != m_coordinatesCapacity)
+				{
+					++m_buffers->growthCount;
+				}
+				m_nNSS.pointsInNeighbourhood.swap(m_buffers->neighbours);
+				m_nNSS.minimalCellsSetToVisit.swap(m_buffers->cellIndexes);
+				m_nNSS.neighboursCoordinates.swap(m_buffers->coordinates);
+			}
+		}
+
+	protected:
+
+		NearestNeighboursSearchStruct& m_nNSS;
+		CellScratchBuffers* m_buffers;
+		size_t m_neighboursCapacity;
+		size_t m_cellIndexesCapacity;
+		size_t m_coordinatesCapacity;
+	};
+
 	//! Generic form of a function that can be applied automatically to all cells of the octree
 	/** See DgmOctree::executeFunctionForAllCellsAtLevel and DgmOctree::executeFunctionForAllCellsAtStartingLevel.
 		The parameters of such a function are:
@@ -441,6 +635,29 @@ public:
 				const CCVector3* pointsMaxFilter = 0,
 				GenericProgressCallback* progressCb = 0);
 
+	//! Inserts new points in the octree (without rebuilding it)
+	/** Typically used after some points have been appended to the associated
+		cloud. The new cell codes are sorted and merged in the existing structure,
+		and the cells statistics are updated incrementally. The octree bounding-box
+		is not modified: points falling outside are ignored (in which case the
+		octree should rather be rebuilt).
+		\param firstIndex index of the first point to insert
+		\param lastIndex index of the last point to insert (excluded)
+		\return the number of inserted points (or a negative value if an error occurred)
+	**/
+	virtual int insertPoints(unsigned firstIndex, unsigned lastIndex);
+
+	//! Removes points from the octree and re-indexes the remaining ones (without rebuilding it)
+	/** Typically used after some points have been removed from the associated
+		cloud (and the remaining ones have been compacted). The codes order is
+		not modified and the cells statistics are updated incrementally. The
+		bounding-box of the projected points is left untouched (i.e. it may be
+		larger than necessary).
+		\param newIndexes new index of each point (indexed by the former point indexes) or REMOVED_POINT_INDEX for the removed points
+		\return success
+	**/
+	virtual bool removePoints(const std::vector<unsigned>& newIndexes);
+
 	/**** GETTERS ****/
 
 	//! Returns the number of points projected into the octree
@@ -513,6 +730,23 @@ public:
 									int neighbourhoodLength,
 									int* cellDists) const;
 
+	//! Tests whether at least one (non empty) cell lies in the neighbourhood of a given cell
+	/** This is a fast but conservative test: it is performed at a coarser level of subdivision,
+		on the 27 cells around the 'parent' of the query cell (which enclose all the cells at a
+		distance of 'neighbourhoodLength' cells or less from the query cell). Therefore, if the
+		method returns false there's no cell in the neighbourhood, but if it returns true there
+		may be none as well.
+		\param cellPos query cell position
+		\param level level at which octree grid is considered
+		\param neighbourhoodLength cell neighbourhood "radius"
+		\param cellIndexesBuffer temporary container (cleared on return)
+		\return false if there's no cell at all in the neighbourhood
+	**/
+	bool hasCellsInNeighbourhood(const int* cellPos,
+									uchar level,
+									int neighbourhoodLength,
+									cellIndexesContainer& cellIndexesBuffer) const;
+
 	//! Returns the points lying in a specific cell
 	/** Each cell at a given level of subdivision can be recognized by the index
 		in the DgmOctree structure of the first point that lies inside it. By
@@ -965,6 +1199,7 @@ public:
 			- '-1' = no cells (input)
 			- '-2' = not enough memory
 			- '-3' = no CC found
+			- '-4' = process canceled by the user
 	**/
 	int extractCCs(	const cellCodesContainer& cellCodes,
 					uchar level,
@@ -984,6 +1219,7 @@ public:
 			- '-1' = no cells (input)
 			- '-2' = not enough memory
 			- '-3' = no CC found
+			- '-4' = process canceled by the user
 	**/
 	int extractCCs(	uchar level,
 					bool sixConnexity,
@@ -1033,8 +1269,10 @@ public:
 
 #ifdef ENABLE_MT_OCTREE
 	//! Multi-threaded version of executeFunctionForAllCellsAtLevel
-	/** Based on QtConcurrent::map system. Dispatches automatically
-		computation on as much cores on the system.
+	/** Dispatches automatically computation on as much cores on the system
+		(cells are balanced between threads by population, with work stealing).
+		This method is reentrant: several jobs can run concurrently. The progress
+		callback is only updated from the calling thread.
 		\return the number of processed cells (or 0 is something went wrong)
 	**/
 	unsigned executeFunctionForAllCellsAtLevel_MT(uchar level,
@@ -1043,9 +1281,8 @@ public:
 													GenericProgressCallback* progressCb = 0,
 													const char* functionTitle = 0);
 
-	//! Multi-threaded version of executeFunctionForAllCellsAtLevel
-	/** Based on QtConcurrent::map system. Dispatches automatically
-		computation on as much cores on the system.
+	//! Multi-threaded version of executeFunctionForAllCellsAtStartingLevel
+	/** Same scheduling as executeFunctionForAllCellsAtLevel_MT.
 		\return the number of processed cells (or 0 is something went wrong)
 	**/
 	unsigned executeFunctionForAllCellsAtStartingLevel_MT(	uchar level,
@@ -1175,6 +1412,12 @@ protected:
 												int maxNeighbourhoodLength) const;
 #endif
 
+	//! Copies the coordinates of the points lying in the cells to visit (see findTheNearestNeighborStartingFromCell)
+	/** The cells already copied (and still valid) are not processed again.
+		\param nNSS NN search parameters (from which are used: level, minimalCellsSetToVisit and neighboursCoordinates)
+	**/
+	void updateNeighboursCoordinates(NearestNeighboursSearchStruct &nNSS) const;
+
 	//! Returns the index of a given cell represented by its code
 	/** The index is found thanks to a binary search. The index of an existing cell
 		is between 0 and the number of points projected in the octree minus 1. If
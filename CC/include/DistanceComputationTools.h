@@ -59,11 +59,13 @@ public:
 		//! Maximum search distance (true distance won't be computed if greater)
 		/** Set to -1 to deactivate (default).
 			Not compatible with closest point set determination (see CPSet).
+			Cells of the compared octree with no reference point in range are
+			skipped as a whole (their points directly get this value).
 		**/
 		ScalarType maxSearchDist;
 
 		//! Whether to use multi-thread or single thread mode
-		/** If maxSearchDist>=0, single thread mode is forced.
+		/** Compatible with maxSearchDist (results are the same in both modes).
 		**/
 		bool multiThread;
 
@@ -135,6 +137,32 @@ public:
 										DgmOctree* compOctree = 0,
 										DgmOctree* refOctree = 0);
 
+	//! Computes the "nearest neighbour distance" between two (very large) point clouds, tile by tile
+	/** The bounding-box of the compared cloud is split in spatial tiles. For each tile, only
+		the compared points inside the tile and the reference points inside the tile enlarged
+		by the max search distance are gathered (in a temporary cloud) and the standard algorithm
+		is applied (see DistanceComputationTools::computeHausdorffDistance). Points are only
+		counted per tile at first, then the tiles are processed by batches (the clouds are read
+		once per batch to gather the indexes of its points) and no global octree is ever built,
+		so that the peak memory mostly depends on the tile size (and not on the full clouds
+		size - the clouds themselves may be memory mapped, see MemoryMappedChunks).
+		As the max search distance is mandatory, distances are the same as the ones computed
+		by the standard algorithm with the same parameters (without local model).
+		\param comparedCloud the compared cloud (the distances will be computed on these points)
+		\param referenceCloud the reference cloud (the distances will be computed relatively to these points)
+		\param params distance computation parameters (maxSearchDist must be strictly positive and CPSet is not supported)
+		\param maxPointsPerTile (approximate) maximum number of compared points per tile
+		\param outputFilename if not 0, the distances are streamed to this file as binary (unsigned index, ScalarType distance) records instead of being stored in the compared cloud scalar field
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return 0 if ok, a negative value otherwise
+	**/
+	static int computeTiledHausdorffDistance(	GenericIndexedCloudPersist* comparedCloud,
+												GenericIndexedCloudPersist* referenceCloud,
+												Cloud2CloudDistanceComputationParams& params,
+												unsigned maxPointsPerTile,
+												const char* outputFilename = 0,
+												GenericProgressCallback* progressCb = 0);
+
 	//! Computes the distance between a point cloud and a mesh
 	/** The algorithm, inspired from METRO by Cignoni et al., is described
 		in Daniel Girardeau-Montaut's PhD manuscript (Chapter 2, section 2.2).
@@ -124,6 +124,10 @@ public:
 protected:
 
 	//! A generic Fast Marching grid cell
+	/** Cells are plain structures: they are stored contiguously by the
+		derived classes (see FastMarching::instantiateCellsTpl) and the
+		grid only references them.
+	**/
 	class Cell
 	{
 	public:
@@ -141,16 +145,17 @@ protected:
 		Cell()
 			: state(FAR_CELL)
 			, T(T_INF())
+			, trialPos(0)
 		{}
 
-		//! Virtual destructor
-		virtual ~Cell() {}
-
 		//! Cell state
 		STATE state;
 
 		//! Front arrival time
 		float T;
+
+		//! Position in the TRIAL cells heap (only meaningful for TRIAL cells)
+		unsigned trialPos;
 	};
 
 	//! Intializes the grid as a snapshot of an octree structure at a given subdivision level
@@ -207,9 +212,15 @@ protected:
 		if (m_theGrid)
 			return false;
 
-		T** grid = new T*[size];
-		if (!grid)
+		T** grid = 0;
+		try
+		{
+			grid = new T*[size];
+		}
+		catch(.../*const std::bad_alloc&*/) //out of memory
+		{
 			return false;
+		}
 		memset(grid,0,size*sizeof(T*));
 
 		m_theGrid = (Cell**)grid;
@@ -217,11 +228,40 @@ protected:
 		return true;
 	}
 
-	//! Add a cell to the TRIAL cells list
-	/** \param index index of the cell
+	//! Cells instantiation helper
+	/** The cells are stored contiguously in the input container (owned
+		by the derived class) so as to avoid one allocation per cell.
+		The grid should then only reference them (see FastMarching::m_theGrid).
+		\param cells cells container
+		\param count number of (non empty) cells
+		\return success
+	**/
+	template <class T> static bool instantiateCellsTpl(std::vector<T>& cells, size_t count)
+	{
+		try
+		{
+			cells.clear();
+			cells.resize(count);
+		}
+		catch(.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+		return true;
+	}
+
+	//! Add a cell to the TRIAL cells heap
+	/** The cell front arrival time should already be set.
+		\param index index of the cell
 	**/
 	virtual void addTrialCell(unsigned index);
 
+	//! Decreases the front arrival time of a TRIAL cell
+	/** \param index index of the cell
+		\param T new front arrival time (should be smaller than the current one)
+	**/
+	void decreaseTrialCellTime(unsigned index, float T);
+
 	//! Add a cell to the ACTIVE cells list
 	/** \param index index of the cell
 	**/
@@ -233,10 +273,17 @@ protected:
 	virtual void addIgnoredCell(unsigned index);
 
 	//! Returns the TRIAL cell with the smallest front arrival time
-	/** \return the index of the "earliest" TRIAL cell (or 0 in case of error)
+	/** The cell is removed from the TRIAL cells heap.
+		\return the index of the "earliest" TRIAL cell (or 0 in case of error)
 	**/
 	virtual unsigned getNearestTrialCell();
 
+	//! Moves a TRIAL cell up in the heap (after its front arrival time has decreased)
+	void siftUpTrialCell(unsigned pos);
+
+	//! Moves a TRIAL cell down in the heap (after its front arrival time has increased)
+	void siftDownTrialCell(unsigned pos);
+
 	//! Resets the state of cells in a given list
 	/** Warning: the list will be cleared!
 	**/
@@ -244,7 +291,7 @@ protected:
 
 	//! ACTIVE cells list
 	std::vector<unsigned> m_activeCells;
-	//! TRIAL cells list
+	//! TRIAL cells (binary min-heap on the cells front arrival time)
 	std::vector<unsigned> m_trialCells;
 	//! IGNORED cells lits
 	std::vector<unsigned> m_ignoredCells;
@@ -266,6 +313,9 @@ protected:
 	//! Grid size
 	unsigned m_gridSize;
 	//! Grid used to process Fast Marching
+	/** Only references the cells (which are owned by the derived classes).
+		Empty cells are null.
+	**/
 	Cell** m_theGrid;
 
 	//! Associated octree
@@ -31,7 +31,7 @@ class GenericCloud;
 //! Fast Marching algorithm for surface front propagation
 /** Extends the FastMarching class.
 **/
-class FastMarchingForPropagation : public FastMarching
+class CC_CORE_LIB_API FastMarchingForPropagation : public FastMarching
 {
 public:
 
@@ -108,9 +108,6 @@ protected:
 			, cellCode(0)
 		{}
 
-		//! Destructor
-		virtual ~PropagationCell() {}
-
 		//! Local front acceleration
 		float f;
 		//! Equivalent cell code in the octree
@@ -122,6 +119,9 @@ protected:
 	virtual int step();
 	virtual bool instantiateGrid(unsigned size) { return instantiateGridTpl<PropagationCell>(size); }
 
+	//! Grid cells (non empty ones only)
+	std::vector<PropagationCell> m_cells;
+
 	//! Accceleration exageration factor
 	float m_jumpCoef;
 	//! Threshold for propagation stop
@@ -30,6 +30,7 @@ static const unsigned MAX_NUMBER_OF_ELEMENTS_PER_CHUNK = (1<<CHUNK_INDEX_BIT_DEC
 static const unsigned ELEMENT_INDEX_BIT_MASK = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-1;
 
 #include "CCShareable.h"
+#include "MemoryMappedChunks.h"
 
 //system
 #include <stdlib.h>
@@ -81,12 +82,40 @@ public:
 	inline unsigned dim() const {return N;}
 
 	//! Returns memory (in bytes) currently used by this structure
-	inline unsigned memory() const
+	/** Memory-mapped chunks only account for their resident part (see MemoryMappedChunks).
+	**/
+	inline size_t memory() const
+	{
+		size_t mappedBytes = 0;
+		return memory(mappedBytes);
+	}
+
+	//! Returns memory (in bytes) currently used by this structure, and memory-mapped bytes
+	/** \param mappedBytes total size of the memory-mapped chunks (resident or not)
+		\return memory (in bytes) actually used by this structure (i.e. heap + resident mapped bytes)
+	**/
+	size_t memory(size_t& mappedBytes) const
 	{
-		return sizeof(GenericChunkedArray) 
-				+ N*capacity()*sizeof(ElementType)
-				+ (unsigned)m_theChunks.capacity()*sizeof(ElementType*)
-				+ (unsigned)m_perChunkCount.capacity()*sizeof(unsigned);
+		size_t residentBytes = sizeof(GenericChunkedArray)
+				+ m_theChunks.capacity()*sizeof(ElementType*)
+				+ m_perChunkCount.capacity()*sizeof(unsigned);
+		mappedBytes = 0;
+
+		for (size_t i=0; i<m_theChunks.size(); ++i)
+		{
+			size_t chunkMappedBytes = 0, chunkResidentBytes = 0;
+			if (MemoryMappedChunks::GetChunkMemory(m_theChunks[i],chunkMappedBytes,chunkResidentBytes))
+			{
+				mappedBytes += chunkMappedBytes;
+				residentBytes += chunkResidentBytes;
+			}
+			else
+			{
+				residentBytes += m_perChunkCount[i]*N*sizeof(ElementType);
+			}
+		}
+
+		return residentBytes;
 	}
 
 	//! Clears the array
@@ -98,7 +127,7 @@ public:
 		{
 			while (!m_theChunks.empty())
 			{
-				delete[] m_theChunks.back();
+				MemoryMappedChunks::Free(m_theChunks.back());
 				m_theChunks.pop_back();
 			}
 			m_perChunkCount.clear();
@@ -189,7 +218,7 @@ public:
 				newNumberOfElementsForThisChunk = freeSpaceInThisChunk;
 
 			//let's reallocate the chunk
-			void* newTable = realloc(m_theChunks.back(),(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*N*sizeof(ElementType));
+			void* newTable = MemoryMappedChunks::Reallocate(m_theChunks.back(),(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*N*sizeof(ElementType),MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*N*sizeof(ElementType));
 			//not enough memory?!
 			if (!newTable)
 			{
@@ -259,7 +288,7 @@ public:
 				{
 					//simply remove the chunk
 					m_maxCount -= numberOfElementsForThisChunk;
-					delete m_theChunks.back();
+					MemoryMappedChunks::Free(m_theChunks.back());
 					m_theChunks.pop_back();
 					m_perChunkCount.pop_back();
 				}
@@ -269,7 +298,7 @@ public:
 					//we resize the chunk
 					numberOfElementsForThisChunk -= spaceToFree;
 					assert(numberOfElementsForThisChunk>0);
-					void* newTable = realloc(m_theChunks.back(),numberOfElementsForThisChunk*N*sizeof(ElementType));
+					void* newTable = MemoryMappedChunks::Reallocate(m_theChunks.back(),numberOfElementsForThisChunk*N*sizeof(ElementType),MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*N*sizeof(ElementType));
 					//if 'realloc' failed?!
 					if (!newTable)
 						return false;
@@ -336,10 +365,17 @@ public:
 	}
 
 	//! Returns the ith value stored in the array
-	/** \param index the index of the element to return
+	/** Memory-mapped chunks are marked as recently used (see MemoryMappedChunks::Touch).
+		\param index the index of the element to return
 		\return a pointer to the ith element
 	**/
-	inline ElementType* getValue(unsigned index) const {assert(index<m_maxCount); return m_theChunks[index >> CHUNK_INDEX_BIT_DEC]+((index & ELEMENT_INDEX_BIT_MASK)*N);}
+	inline ElementType* getValue(unsigned index) const
+	{
+		assert(index<m_maxCount);
+		ElementType* chunk = m_theChunks[index >> CHUNK_INDEX_BIT_DEC];
+		MemoryMappedChunks::Touch(chunk);
+		return chunk+((index & ELEMENT_INDEX_BIT_MASK)*N);
+	}
 
 	//! Sets the value of the ith element
 	/** \param index the index of the element to update
@@ -440,7 +476,9 @@ public:
 	inline unsigned chunkSize(unsigned index) const { assert(index < m_theChunks.size()); return m_perChunkCount[index]; }
 
 	//! Returns the begining of a given chunk (pointer)
-	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); return m_theChunks[index]; }
+	/** Memory-mapped chunks are marked as recently used (see MemoryMappedChunks::Touch).
+	**/
+	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); MemoryMappedChunks::Touch(m_theChunks[index]); return m_theChunks[index]; }
 
 	//! Copy array data to another one
 	/** \param dest destination array (will be resize if necessary)
@@ -474,7 +512,7 @@ protected:
 	{
 		while (!m_theChunks.empty())
 		{
-			delete[] m_theChunks.back();
+			MemoryMappedChunks::Free(m_theChunks.back());
 			m_theChunks.pop_back();
 		}
 	}
@@ -538,12 +576,40 @@ public:
 	inline unsigned dim() const {return 1;}
 
 	//! Returns memory (in bytes) currently used by this structure
-	inline unsigned memory() const
+	/** Memory-mapped chunks only account for their resident part (see MemoryMappedChunks).
+	**/
+	inline size_t memory() const
 	{
-		return sizeof(GenericChunkedArray) 
-				+ capacity()*sizeof(ElementType)
-				+ (unsigned)m_theChunks.capacity()*sizeof(ElementType*)
-				+ (unsigned)m_perChunkCount.capacity()*sizeof(unsigned);
+		size_t mappedBytes = 0;
+		return memory(mappedBytes);
+	}
+
+	//! Returns memory (in bytes) currently used by this structure, and memory-mapped bytes
+	/** \param mappedBytes total size of the memory-mapped chunks (resident or not)
+		\return memory (in bytes) actually used by this structure (i.e. heap + resident mapped bytes)
+	**/
+	size_t memory(size_t& mappedBytes) const
+	{
+		size_t residentBytes = sizeof(GenericChunkedArray)
+				+ m_theChunks.capacity()*sizeof(ElementType*)
+				+ m_perChunkCount.capacity()*sizeof(unsigned);
+		mappedBytes = 0;
+
+		for (size_t i=0; i<m_theChunks.size(); ++i)
+		{
+			size_t chunkMappedBytes = 0, chunkResidentBytes = 0;
+			if (MemoryMappedChunks::GetChunkMemory(m_theChunks[i],chunkMappedBytes,chunkResidentBytes))
+			{
+				mappedBytes += chunkMappedBytes;
+				residentBytes += chunkResidentBytes;
+			}
+			else
+			{
+				residentBytes += m_perChunkCount[i]*sizeof(ElementType);
+			}
+		}
+
+		return residentBytes;
 	}
 	//! Clears the array
 	/** \param releaseMemory whether memory should be released or not (for quicker "refill")
@@ -554,7 +620,7 @@ public:
 		{
 			while (!m_theChunks.empty())
 			{
-				delete[] m_theChunks.back();
+				MemoryMappedChunks::Free(m_theChunks.back());
 				m_theChunks.pop_back();
 			}
 			m_perChunkCount.clear();
@@ -643,7 +709,7 @@ public:
 				newNumberOfElementsForThisChunk = freeSpaceInThisChunk;
 
 			//let's reallocate the chunk
-			void* newTable = realloc(m_theChunks.back(),(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*sizeof(ElementType));
+			void* newTable = MemoryMappedChunks::Reallocate(m_theChunks.back(),(m_perChunkCount.back()+newNumberOfElementsForThisChunk)*sizeof(ElementType),MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*sizeof(ElementType));
 			//not enough memory?!
 			if (!newTable)
 			{
@@ -713,7 +779,7 @@ public:
 				{
 					//simply remove the chunk
 					m_maxCount -= numberOfElementsForThisChunk;
-					delete m_theChunks.back();
+					MemoryMappedChunks::Free(m_theChunks.back());
 					m_theChunks.pop_back();
 					m_perChunkCount.pop_back();
 				}
@@ -723,7 +789,7 @@ public:
 					//we resize the chunk
 					numberOfElementsForThisChunk -= spaceToFree;
 					assert(numberOfElementsForThisChunk>0);
-					void* newTable = realloc(m_theChunks.back(),numberOfElementsForThisChunk*sizeof(ElementType));
+					void* newTable = MemoryMappedChunks::Reallocate(m_theChunks.back(),numberOfElementsForThisChunk*sizeof(ElementType),MAX_NUMBER_OF_ELEMENTS_PER_CHUNK*sizeof(ElementType));
 					//if 'realloc' failed?!
 					if (!newTable)
 						return false;
@@ -763,7 +829,9 @@ public:
 	inline ElementType& operator[] (unsigned index)
 	{
 		assert(index<m_maxCount);
-		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC][index & ELEMENT_INDEX_BIT_MASK];
+		ElementType* chunk = m_theChunks[index >> CHUNK_INDEX_BIT_DEC];
+		MemoryMappedChunks::Touch(chunk);
+		return chunk[index & ELEMENT_INDEX_BIT_MASK];
 	}
 
 	//***** data access *****//
@@ -802,13 +870,16 @@ public:
 	}
 
 	//! Returns the ith value stored in the array
-	/** \param index the index of the element to return
+	/** Memory-mapped chunks are marked as recently used (see MemoryMappedChunks::Touch).
+		\param index the index of the element to return
 		\return a pointer to the ith element
 	**/
 	inline const ElementType& getValue(unsigned index) const
 	{
 		assert(index<m_maxCount);
-		return m_theChunks[index >> CHUNK_INDEX_BIT_DEC][index & ELEMENT_INDEX_BIT_MASK];
+		const ElementType* chunk = m_theChunks[index >> CHUNK_INDEX_BIT_DEC];
+		MemoryMappedChunks::Touch(chunk);
+		return chunk[index & ELEMENT_INDEX_BIT_MASK];
 	}
 
 	//! Sets the value of the ith element
@@ -898,7 +969,9 @@ public:
 	inline unsigned chunkSize(unsigned index) const { assert(index < m_theChunks.size()); return m_perChunkCount[index]; }
 
 	//! Returns the begining of a given chunk (pointer)
-	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); return m_theChunks[index]; }
+	/** Memory-mapped chunks are marked as recently used (see MemoryMappedChunks::Touch).
+	**/
+	inline ElementType* chunkStartPtr(unsigned index) const { assert(index < m_theChunks.size()); MemoryMappedChunks::Touch(m_theChunks[index]); return m_theChunks[index]; }
 
 	//! Copy array data to another one
 	/** \param dest destination array (will be resized if necessary)
@@ -932,7 +1005,7 @@ protected:
 	{
 		while (!m_theChunks.empty())
 		{
-			delete[] m_theChunks.back();
+			MemoryMappedChunks::Free(m_theChunks.back());
 			m_theChunks.pop_back();
 		}
 	}
@@ -24,6 +24,7 @@
 
 //Qt
 #include <QAtomicInt>
+#include <QThread>
 
 //system
 #include <assert.h>
@@ -201,6 +202,63 @@ protected:
 	GenericProgressCallback* progressCallback;
 };
 
+//! Progress relay for parallel loops
+/** The worker threads only count their steps and read the shared 'canceled'
+	flag. The client callback is only updated (and asked for cancel requests)
+	by the calling thread, which also processes some items of the loop (see
+	QtConcurrent::blockingMap).
+**/
+class ParallelProgressRelay
+{
+public:
+
+	//! Default constructor (to be called by the calling thread)
+	/** \param nprogress client progress notification (optional)
+	**/
+	explicit ParallelProgressRelay(NormalizedProgress* nprogress)
+		: m_nprogress(nprogress)
+		, m_pendingSteps(0)
+		, m_canceled(0)
+		, m_callingThread(QThread::currentThread())
+	{}
+
+	//! Notifies some processed steps (from any thread)
+	/** The client callback is only updated by the calling thread.
+		\return false if the process has been canceled
+	**/
+	bool steps(unsigned n)
+	{
+		m_pendingSteps.fetchAndAddRelaxed(static_cast<int>(n));
+		if (QThread::currentThread() == m_callingThread)
+			flush();
+		return !isCanceled();
+	}
+
+	//! Forwards the pending steps to the client callback (calling thread only)
+	void flush()
+	{
+		int n = m_pendingSteps.fetchAndStoreOrdered(0);
+		if (m_nprogress && n != 0 && !m_nprogress->steps(static_cast<unsigned>(n)))
+			cancel();
+	}
+
+	//! Returns whether the process has been canceled
+	inline bool isCanceled() { return m_canceled.fetchAndAddRelaxed(0) != 0; }
+	//! Cancels the process
+	inline void cancel() { m_canceled.fetchAndStoreOrdered(1); }
+
+protected:
+
+	//! Client progress notification
+	NormalizedProgress* m_nprogress;
+	//! Steps not forwarded yet to the client callback
+	QAtomicInt m_pendingSteps;
+	//! Shared 'process canceled' flag
+	QAtomicInt m_canceled;
+	//! Calling thread
+	QThread* m_callingThread;
+};
+
 }
 
 #endif //GENERIC_PROGRESS_CALLBACK_HEADER
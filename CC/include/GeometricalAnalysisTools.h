@@ -24,6 +24,10 @@
 #include "Neighbourhood.h"
 #include "DgmOctree.h"
 #include "Matrix.h"
+#include "GenericChunkedArray.h"
+
+//system
+#include <vector>
 
 namespace CCLib
 {
@@ -93,6 +97,58 @@ public:
 								GenericProgressCallback* progressCb = 0,
 								DgmOctree* inputOctree = 0);
 
+	//! Geometric features (see computeGeomFeatures)
+	enum GeomFeature {	GF_NORMAL,				/**< Normal (least square plane) **/
+						GF_MEAN_CURVATURE,		/**< Mean curvature (see computeCurvature) **/
+						GF_GAUSSIAN_CURVATURE,	/**< Gaussian curvature (see computeCurvature) **/
+						GF_ROUGHNESS,			/**< Roughness (see computeRoughness) **/
+						GF_DENSITY,				/**< Local density (see computeLocalDensity) **/
+						GF_LINEARITY,			/**< Linearity: (l1-l2)/l1 (with l1 >= l2 >= l3 the covariance matrix eigen values) **/
+						GF_PLANARITY,			/**< Planarity: (l2-l3)/l1 **/
+						GF_SPHERICITY,			/**< Sphericity: l3/l1 **/
+						GF_NEIGHBOR_COUNT		/**< Number of neighbours **/
+	};
+
+	//! Normals container (see computeGeomFeatures)
+	typedef GenericChunkedArray<3,PointCoordinateType> NormalsContainer;
+
+	//! Geometric feature request (see computeGeomFeatures)
+	struct GeomFeatureDesc
+	{
+		//! Feature
+		GeomFeature feature;
+		//! Neighbourhood radius
+		PointCoordinateType radius;
+		//! Output scalar field (all features but GF_NORMAL - same size as the cloud)
+		ScalarField* sf;
+		//! Output normals (GF_NORMAL only - same size as the cloud)
+		NormalsContainer* normals;
+
+		//! Default constructor
+		GeomFeatureDesc(GeomFeature f = GF_NEIGHBOR_COUNT, PointCoordinateType r = 0)
+			: feature(f)
+			, radius(r)
+			, sf(0)
+			, normals(0)
+		{}
+	};
+
+	//! Computes several geometric features at once
+	/** The spherical neighbourhood of each point is extracted only once (for
+		the largest radius) and shared by all the requested features (the
+		neighbourhoods at smaller radii are deduced from it).
+		Invalid values are set to NAN_VALUE (scalar fields) or to (0,0,0) (normals).
+		\param theCloud processed cloud
+		\param features requested features (with their output containers already sized)
+		\param progressCb client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param inputOctree if not set as input, octree will be automatically computed.
+		\return success (0) or error code (<0)
+	**/
+	static int computeGeomFeatures(	GenericIndexedCloudPersist* theCloud,
+									const std::vector<GeomFeatureDesc>& features,
+									GenericProgressCallback* progressCb = 0,
+									DgmOctree* inputOctree = 0);
+
 	//! Computes the gravity center of a point cloud
 	/** \warning this method uses the cloud global iterator
 		\param theCloud cloud
@@ -195,6 +251,15 @@ protected:
 														void** additionalParameters,
 														NormalizedProgress* nProgress = 0);
 
+	//! Computes geometric features inside a cell
+	/**	\param cell structure describing the cell on which processing is applied
+		\param additionalParameters see method description
+		\param nProgress optional (normalized) progress notification (per-point)
+	**/
+	static bool computeGeomFeaturesInACellAtLevel(	const DgmOctree::octreeCell& cell,
+													void** additionalParameters,
+													NormalizedProgress* nProgress = 0);
+
 	//! Flags duplicate points inside a cell
 	/**	\param cell structure describing the cell on which processing is applied
 		\param additionalParameters see method description
@@ -23,6 +23,9 @@
 #include "CCToolbox.h"
 #include "Neighbourhood.h"
 
+//system
+#include <vector>
+
 namespace CCLib
 {
 
@@ -32,6 +35,7 @@ class GenericIndexedMesh;
 class GenericProgressCallback;
 class ReferenceCloud;
 class Polyline;
+class DgmOctree;
 
 //! Manual segmentation algorithms (inside/outside a polyline, etc.)
 class CC_CORE_LIB_API ManualSegmentationTools : public CCToolbox
@@ -46,9 +50,31 @@ public:
 		\param poly the polyline
 		\param keepInside if true (resp. false), the points falling inside (resp. outside) the polyline will be extracted
 		\param viewMat the optional 4x4 visualization matrix (OpenGL style)
+		\param octree the optional octree of the cloud (see flagPointsInsidePoly)
 		\return a cloud structure containing references to the extracted points (references to - no duplication)
 	**/
-	static ReferenceCloud* segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat=0);
+	static ReferenceCloud* segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat=0, const DgmOctree* octree=0);
+
+	//! Flags the points that fall inside a 2D polygon once projected on the screen
+	/** Fast version of the point-by-point inclusion test:
+		- if an octree is provided, the cells whose projected bounding-box doesn't
+		intersect the polygon bounding-box are rejected as a whole
+		- the polygon edges are sorted in a scanline table (horizontal slabs), so that
+		only the edges crossing the point slab are tested (binary search)
+		- the points (or the octree cells) are processed by chunks, in parallel
+		The result is the same as with isPointInsidePoly.
+		\param aCloud the cloud to segment
+		\param polyVertices the polygon vertices (screen coordinates)
+		\param[out] insideFlags for each point: 1 if it falls inside the polygon, 0 otherwise (resized by this method)
+		\param projMat the optional 4x4 projection matrix (OpenGL style - double version). The screen coordinates of a point P are (M.P).x/(M.P).w and (M.P).y/(M.P).w
+		\param octree the optional octree of the cloud (ignored if it doesn't correspond to the cloud)
+		\return success (false if there's not enough memory)
+	**/
+	static bool flagPointsInsidePoly(	GenericIndexedCloudPersist* aCloud,
+										const std::vector<CCVector2>& polyVertices,
+										std::vector<unsigned char>& insideFlags,
+										const double* projMat = 0,
+										const DgmOctree* octree = 0);
 
 	//! Extracts the points which associated scalar value fall inside a specified interval
 	/** All the points with an associated scalar value comprised between minDist and maxDist
@@ -92,6 +118,121 @@ public:
 	**/
 	static GenericIndexedMesh* segmentMesh(GenericIndexedMesh* theMesh, ReferenceCloud* pointsIndexes, bool pointsWillBeInside, GenericProgressCallback* progressCb=0, GenericIndexedCloud* destCloud=0, unsigned indexShift=0);
 
+	//! Regular grid of slices (see extractSlices)
+	/** The slices are the cells of a regular grid defined in a local coordinate
+		system (typically the one of a clipping box). Two consecutive slices can
+		be separated by a gap.
+	**/
+	struct SlicesGrid
+	{
+		//! Transformation from the cloud coordinate system to the grid one (4x4 matrix, OpenGL style) or 0 if none
+		const float* transMat;
+		//! Grid origin (min corner of the slice (0,0,0) - local coordinate system)
+		CCVector3 origin;
+		//! Slice size
+		CCVector3 cellSize;
+		//! Gap between two consecutive slices
+		PointCoordinateType gap;
+		//! Min slice position along each dimension
+		int indexMins[3];
+		//! Max slice position along each dimension
+		int indexMaxs[3];
+
+		//! Default constructor
+		SlicesGrid()
+			: transMat(0)
+			, origin(0,0,0)
+			, cellSize(0,0,0)
+			, gap(0)
+		{
+			indexMins[0] = indexMins[1] = indexMins[2] = 0;
+			indexMaxs[0] = indexMaxs[1] = indexMaxs[2] = 0;
+		}
+
+		//! Returns the number of slices along a given dimension
+		inline int gridDim(unsigned char d) const { return indexMaxs[d] - indexMins[d] + 1; }
+
+		//! Returns the total number of slices
+		inline unsigned sliceCount() const { return static_cast<unsigned>(gridDim(0)) * static_cast<unsigned>(gridDim(1)) * static_cast<unsigned>(gridDim(2)); }
+
+		//! Returns the index of a slice (between 0 and sliceCount()-1)
+		inline unsigned sliceIndex(const int pos[]) const { return static_cast<unsigned>(((pos[2]-indexMins[2]) * gridDim(1) + (pos[1]-indexMins[1])) * gridDim(0) + (pos[0]-indexMins[0])); }
+
+		//! Converts a point to the grid coordinate system
+		inline void toLocal(const CCVector3& P, CCVector3& localP) const
+		{
+			if (transMat)
+			{
+				localP.x = transMat[0]*P.x + transMat[4]*P.y + transMat[8]*P.z + transMat[12];
+				localP.y = transMat[1]*P.x + transMat[5]*P.y + transMat[9]*P.z + transMat[13];
+				localP.z = transMat[2]*P.x + transMat[6]*P.y + transMat[10]*P.z + transMat[14];
+			}
+			else
+			{
+				localP = P;
+			}
+		}
+
+		//! Computes the position of the slice in which a point falls
+		/** The points outside the grid are associated to the closest slices.
+			\param localP point (grid coordinate system)
+			\param[out] pos slice position
+			\return false if the point falls in a gap
+		**/
+		bool getSlicePos(const CCVector3& localP, int pos[]) const;
+	};
+
+	//! Computes the extents of a slices grid so that it covers a whole cloud
+	/** The slices are repeated along the dimensions for which 'repeatDim' is true
+		(the other ones only have one slice). The transformation, the origin, the
+		slice size and the gap must be set beforehand.
+		\param aCloud cloud
+		\param grid slices grid (indexMins and indexMaxs are updated)
+		\param repeatDim whether the slices are repeated along each dimension
+		\return false if the cloud is empty or if the slice size (plus the gap) is null along a repeated dimension
+	**/
+	static bool computeSlicesGridExtents(GenericIndexedCloudPersist* aCloud, SlicesGrid& grid, const bool repeatDim[3]);
+
+	//! Sorts the points of a cloud by slice
+	/** The points are assigned to their slice in a single (parallel) pass, then
+		sorted by slice with a counting sort. The points of the slice #s (see
+		SlicesGrid::sliceIndex) are pointIndexes[sliceStarts[s]] to
+		pointIndexes[sliceStarts[s+1]-1] (by increasing index). The points
+		falling in a gap are ignored.
+		\param aCloud cloud
+		\param grid slices grid
+		\param[out] sliceStarts first position of each slice in 'pointIndexes' (sliceCount()+1 values)
+		\param[out] pointIndexes points indexes (sorted by slice)
+		\param octree the optional octree of the cloud (the cells that fall entirely inside a slice or a gap are processed as a whole)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success (false if there's not enough memory or if the process has been canceled)
+	**/
+	static bool extractSlices(	GenericIndexedCloudPersist* aCloud,
+								const SlicesGrid& grid,
+								std::vector<unsigned>& sliceStarts,
+								std::vector<unsigned>& pointIndexes,
+								const DgmOctree* octree = 0,
+								GenericProgressCallback* progressCb = 0);
+
+	//! Extracts the flat contour of each slice
+	/** See PointProjectionTools::extractFlatContour. The slices are processed in parallel.
+		\param aCloud cloud
+		\param sliceStarts first position of each slice in 'pointIndexes' (see extractSlices)
+		\param pointIndexes points indexes sorted by slice (see extractSlices)
+		\param maxEdgeLength max edge length (ignored if 0, in which case the contours are the convex hulls)
+		\param[out] contours contour vertices of each slice (empty if the slice has less than 3 points or if the extraction failed)
+		\param preferredDim optional preferred (normal) direction for the projection
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success (false if there's not enough memory or if the process has been canceled)
+	**/
+	static bool extractSlicesContours(	GenericIndexedCloudPersist* aCloud,
+										const std::vector<unsigned>& sliceStarts,
+										const std::vector<unsigned>& pointIndexes,
+										PointCoordinateType maxEdgeLength,
+										std::vector< std::vector<CCVector3> >& contours,
+										const PointCoordinateType* preferredDim = 0,
+										GenericProgressCallback* progressCb = 0);
+
 };
 
 }
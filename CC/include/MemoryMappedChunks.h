@@ -0,0 +1,145 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef MEMORY_MAPPED_CHUNKS_HEADER
+#define MEMORY_MAPPED_CHUNKS_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "CCConst.h"
+
+//Qt
+#include <QAtomicInt>
+
+//system
+#include <stddef.h>
+
+//! Out-of-core backing store for GenericChunkedArray chunks
+/** When enabled, the new chunks of all GenericChunkedArray structures (and
+	therefore the points, colors, normals and scalar fields of the clouds)
+	are stored in memory-mapped temporary files instead of the heap. Chunks
+	are grouped in big 'segments' (one temporary file and one mapping for
+	many chunks of the same size) so as to keep the number of files and
+	mappings low, even for huge clouds. The chunks keep the same address during their whole life, so that pointers
+	returned by GenericChunkedArray::getValue or GenericChunkedArray::chunkStartPtr
+	remain valid.
+
+	The residency of the mapped chunks (i.e. the amount of physical memory
+	they use) can be limited: the least recently used chunks are then
+	released from memory (their content is kept in the file and paged in
+	again transparently on the next access). Usage is tracked at chunk level
+	with lock-free access stamps, updated on allocation and on each access
+	(see GenericChunkedArray::getValue and GenericChunkedArray::chunkStartPtr).
+**/
+class CC_CORE_LIB_API MemoryMappedChunks
+{
+public:
+
+	//! Enables (or disables) the memory-mapped storage for all new chunks
+	/** Already allocated chunks are not affected.
+	**/
+	static void SetEnabled(bool state);
+
+	//! Returns whether new chunks are memory-mapped or not
+	static bool IsEnabled();
+
+	//! Sets the directory where the temporary files are created
+	/** By default, the system temporary directory is used.
+	**/
+	static void SetTempDirectory(const char* path);
+
+	//! Sets the maximum amount of physical memory used by the mapped chunks (in bytes)
+	/** \param maxResidentBytes residency limit (0 = no limit)
+	**/
+	static void SetResidencyLimit(size_t maxResidentBytes);
+
+	//! Returns the current residency limit (in bytes, 0 = no limit)
+	static size_t GetResidencyLimit();
+
+	//! (Re)allocates a chunk
+	/** New chunks are memory-mapped if this storage is enabled (they are
+		then directly mapped with their maximum size and never move). Otherwise
+		(or if the mapping fails) chunks are allocated on the heap.
+		\param chunk current chunk address (or 0 for a new chunk)
+		\param size new chunk size (in bytes)
+		\param maxSize maximum chunk size (in bytes)
+		\return new chunk address (or 0 if not enough memory)
+	**/
+	static void* Reallocate(void* chunk, size_t size, size_t maxSize);
+
+	//! Releases a chunk allocated with MemoryMappedChunks::Reallocate
+	static void Free(void* chunk);
+
+	//! Maps a new chunk
+	/** \param size chunk size (in bytes)
+		\return chunk address (or 0 if the mapping failed)
+	**/
+	static void* Map(size_t size);
+
+	//! Unmaps a chunk
+	/** The chunk content is discarded (its place in the segment may be reused by a next chunk).
+		\param chunk chunk address
+		\return false if the chunk is not a memory-mapped chunk
+	**/
+	static bool Unmap(void* chunk);
+
+	//! Returns whether a chunk is memory-mapped or not
+	static bool IsMapped(const void* chunk);
+
+	//! Marks a chunk as (recently) used
+	/** Only the chunk access stamp is updated (without any lock) so that
+		this method can be called on each element access. The least recently
+		used chunks may be released from memory if the residency limit is
+		exceeded.
+	**/
+	static inline void Touch(const void* chunk)
+	{
+		if (chunk && HasMappedChunks())
+			TouchMapped(chunk);
+	}
+
+	//! Returns whether at least one chunk is currently mapped
+	static inline bool HasMappedChunks()
+	{
+#ifdef CC_QT5
+		return s_mappedChunkCount.load() != 0;
+#else
+		return s_mappedChunkCount != 0;
+#endif
+	}
+
+	//! Returns the mapped and resident sizes of a chunk
+	/** \param chunk chunk address
+		\param mappedBytes mapped size (in bytes)
+		\param residentBytes part of the chunk currently held in physical memory (in bytes)
+		\return false if the chunk is not a memory-mapped chunk
+	**/
+	static bool GetChunkMemory(const void* chunk, size_t& mappedBytes, size_t& residentBytes);
+
+	//! Returns the total size of all mapped chunks (in bytes)
+	static size_t GetMappedBytes();
+
+protected:
+
+	//! Marks a chunk as (recently) used if it is a memory-mapped chunk
+	static void TouchMapped(const void* chunk);
+
+	//! Number of currently mapped chunks (so that the heap-only case costs a single atomic read)
+	static QAtomicInt s_mappedChunkCount;
+};
+
+#endif //MEMORY_MAPPED_CHUNKS_HEADER
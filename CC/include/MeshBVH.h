@@ -0,0 +1,116 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef MESH_BVH_HEADER
+#define MESH_BVH_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "CCTypes.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedMesh;
+
+//! Bounding volume hierarchy of the triangles of a mesh
+/** Binary tree of axis-aligned bounding-boxes. Each node is split
+	at the median of its triangles centers (along the largest dimension)
+	until it contains at most 'maxTrianglesPerLeaf' triangles.
+	The structure doesn't follow the mesh modifications: it must be
+	built again if the mesh (or its vertices) change.
+**/
+class CC_CORE_LIB_API MeshBVH
+{
+public:
+
+	//! Tree node
+	struct Node
+	{
+		//! Bounding-box min corner
+		PointCoordinateType bbMin[3];
+		//! Bounding-box max corner
+		PointCoordinateType bbMax[3];
+		//! Leaf: index of the first triangle (in triangleIndexes). Node: index of the second child (the first one is the next node)
+		unsigned first;
+		//! Leaf: number of triangles. Node: 0
+		unsigned count;
+
+		//! Returns whether the node is a leaf
+		inline bool isLeaf() const { return count != 0; }
+	};
+
+	//! Default constructor
+	MeshBVH();
+
+	//! Builds the structure
+	/** \param mesh a mesh
+		\param maxTrianglesPerLeaf max number of triangles per leaf
+		\return false if the mesh is empty or if there's not enough memory
+	**/
+	bool build(GenericIndexedMesh* mesh, unsigned maxTrianglesPerLeaf = 8);
+
+	//! Clears the structure
+	void clear();
+
+	//! Returns the associated mesh
+	inline GenericIndexedMesh* associatedMesh() const { return m_mesh; }
+
+	//! Returns the tree nodes (the first one is the root)
+	inline const std::vector<Node>& nodes() const { return m_nodes; }
+
+	//! Returns the triangles indexes (leaf by leaf)
+	inline const std::vector<unsigned>& triangleIndexes() const { return m_triangleIndexes; }
+
+protected:
+
+	//! Triangle info (for construction only)
+	struct TriangleBox
+	{
+		PointCoordinateType bbMin[3];
+		PointCoordinateType bbMax[3];
+		PointCoordinateType center[3];
+	};
+
+	//! Compares two triangles by their center (along a given dimension)
+	struct TriangleCenterComp
+	{
+		TriangleCenterComp(const std::vector<TriangleBox>& boxes, unsigned char dim) : m_boxes(boxes), m_dim(dim) {}
+
+		inline bool operator()(unsigned a, unsigned b) const { return m_boxes[a].center[m_dim] < m_boxes[b].center[m_dim]; }
+
+		const std::vector<TriangleBox>& m_boxes;
+		unsigned char m_dim;
+	};
+
+	//! Recursively builds the tree for the triangles in [first,first+count[
+	void buildNode(std::vector<TriangleBox>& boxes, unsigned first, unsigned count, unsigned maxTrianglesPerLeaf);
+
+	//! Associated mesh
+	GenericIndexedMesh* m_mesh;
+	//! Tree nodes
+	std::vector<Node> m_nodes;
+	//! Triangles indexes
+	std::vector<unsigned> m_triangleIndexes;
+};
+
+}
+
+#endif //MESH_BVH_HEADER
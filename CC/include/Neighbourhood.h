@@ -22,6 +22,7 @@
 #include "CCCoreLib.h"
 #include "GenericIndexedCloudPersist.h"
 #include "Matrix.h"
+#include "SymMatrix.h"
 #include "CCGeom.h"
 #include "CCMiscTools.h"
 
@@ -218,6 +219,12 @@ class CC_CORE_LIB_API Neighbourhood
 		//! Computes the covariance matrix
 		CCLib::SquareMatrixd computeCovarianceMatrix();
 
+		//! Computes the covariance matrix (fixed-size version - no dynamic allocation)
+		/** \param[out] covMat covariance matrix
+			\return success
+		**/
+		bool computeCovarianceMatrix(CCLib::SymMatrix3d& covMat);
+
 		//! Returns the largest radius (i.e. the distance to the farthest point to the centroid)
 		PointCoordinateType computeLargestRadius();
 
@@ -0,0 +1,77 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef NORMALS_ORIENTATION_TOOLS_HEADER
+#define NORMALS_ORIENTATION_TOOLS_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "CCToolbox.h"
+#include "CCGeom.h"
+#include "DgmOctree.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericProgressCallback;
+class GenericIndexedCloudPersist;
+
+//! Algorithms to resolve the (consistent) orientation of point-clouds normals
+class CC_CORE_LIB_API NormalsOrientationTools : public CCToolbox
+{
+public:
+
+	//! Orients the normals of a cloud with a Minimum Spanning Tree
+	/** See http://people.maths.ox.ac.uk/wendland/research/old/reconhtml/node3.html
+		The k-nearest neighbours graph is built in parallel (one job per octree cell)
+		and each edge is weighted by 1-|Ni.Nj|. The Minimum Spanning Tree (forest) is
+		then extracted with Kruskal's algorithm (parallel sort of the edges + union-find)
+		and the orientation of each patch is propagated from its first point, along
+		the tree edges.
+		\param theCloud processed cloud
+		\param[in,out] normals normals of the cloud points (one per point, inverted in place if necessary)
+		\param kNN number of neighbours used to build the graph
+		\param progressCb client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\param inputOctree if not set as input, octree will be automatically computed.
+		\param[out] patchCount number of disconnected patches (optional)
+		\param[out] inversionCount number of inverted normals (optional)
+		\return success (0) or error code (<0)
+	**/
+	static int orientNormalsWithMST(GenericIndexedCloudPersist* theCloud,
+									std::vector<CCVector3>& normals,
+									unsigned kNN,
+									GenericProgressCallback* progressCb = 0,
+									DgmOctree* inputOctree = 0,
+									unsigned* patchCount = 0,
+									unsigned* inversionCount = 0);
+
+protected:
+
+	//! Builds the (weighted) k-nearest neighbours graph for the points of a given cell
+	/** Method used by orientNormalsWithMST
+	**/
+	static bool computeCellMSTGraphAtLevel(	const DgmOctree::octreeCell& cell,
+											void** additionalParameters,
+											NormalizedProgress* nProgress = 0);
+};
+
+}
+
+#endif //NORMALS_ORIENTATION_TOOLS_HEADER
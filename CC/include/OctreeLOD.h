@@ -0,0 +1,136 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef OCTREE_LOD_HEADER
+#define OCTREE_LOD_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "DgmOctree.h"
+#include "GenericChunkedArray.h"
+
+//system
+#include <vector>
+
+namespace CCLib
+{
+
+class GenericIndexedCloudPersist;
+class GenericProgressCallback;
+
+//! Hierarchical (level of detail) ordering of the points of a cloud
+/** Each point is associated to the coarsest octree level at which it is the
+	first point of its cell (in the octree codes order). Therefore the points
+	of the levels 0 to L are exactly one point per non-empty cell of level L.
+	Inside a given level, the points are sorted by their cell code with reversed
+	digits (i.e. the coarsest child index varies first), so that any subset of
+	a level is spread over the whole cloud as well.
+
+	The points are sorted chunk by chunk (see GenericChunkedArray) so that the
+	first points of each chunk can be displayed directly with the chunk arrays.
+	For a given budget of N points, each chunk displays the same proportion of
+	each level, i.e. approximately N points that are uniformly distributed.
+
+	The structure doesn't follow the cloud modifications: it must be built
+	again if points are added, removed or swapped.
+**/
+class CC_CORE_LIB_API OctreeLOD
+{
+public:
+
+	//! Number of levels (octree levels 0 to MAX_OCTREE_LEVEL + the duplicate points)
+	static const unsigned LEVEL_COUNT = DgmOctree::MAX_OCTREE_LEVEL+2;
+
+	//! Number of points per chunk
+	static const unsigned CHUNK_SIZE = MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
+
+	//! Default constructor
+	OctreeLOD();
+
+	//! Builds the structure
+	/** \param cloud a point cloud
+		\param octree the cloud octree (optional: a temporary octree is computed if necessary)
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return false if the cloud is empty or if there's not enough memory
+	**/
+	bool build(GenericIndexedCloudPersist* cloud, DgmOctree* octree = 0, GenericProgressCallback* progressCb = 0);
+
+	//! Clears the structure
+	void clear();
+
+	//! Returns the number of points (0 if the structure is not built)
+	inline unsigned pointCount() const { return static_cast<unsigned>(m_localIndexes.size()); }
+
+	//! Returns the number of chunks
+	inline unsigned chunkCount() const { return (pointCount() + CHUNK_SIZE - 1) / CHUNK_SIZE; }
+
+	//! Returns the number of points of a given level
+	inline unsigned levelPopulation(unsigned char level) const { return m_levelStarts[level+1] - m_levelStarts[level]; }
+
+	//! Returns the number of points of the levels 0 to level-1
+	/** The points of the levels 0 to L are one point per non-empty octree cell of level L.
+	**/
+	inline unsigned levelStart(unsigned char level) const { return m_levelStarts[level]; }
+
+	//! Returns the sorted (local) indexes of the points of a given chunk
+	inline const unsigned* chunkIndexes(unsigned chunkIndex) const { return &(m_localIndexes[static_cast<size_t>(chunkIndex)*CHUNK_SIZE]); }
+
+	//! Returns the number of points of a given chunk to display for a given budget
+	/** The first points of the chunk should be displayed (see chunkIndexes).
+	**/
+	unsigned chunkDisplayCount(unsigned chunkIndex, unsigned budget) const;
+
+	//! Returns the (global) indexes of the points to display for a given budget
+	/** \param budget max number of points
+		\param[out] pointIndexes points indexes (approximately 'budget' indexes)
+		\return false if there's not enough memory
+	**/
+	bool getPoints(unsigned budget, std::vector<unsigned>& pointIndexes) const;
+
+	//! Returns the sorted (local) indexes of all the points (chunk by chunk)
+	inline const std::vector<unsigned>& localIndexes() const { return m_localIndexes; }
+
+	//! Returns the start of each level, for each chunk (LEVEL_COUNT+1 values per chunk)
+	inline const std::vector<unsigned>& chunkLevelStarts() const { return m_chunkLevelStarts; }
+
+	//! Sets the structure (e.g. loaded from a file)
+	/** The input vectors are swapped with the internal ones.
+		\param localIndexes sorted local indexes (see localIndexes)
+		\param chunkLevelStarts levels start for each chunk (see chunkLevelStarts)
+		\return false if the input structure is not consistent
+	**/
+	bool setStructure(std::vector<unsigned>& localIndexes, std::vector<unsigned>& chunkLevelStarts);
+
+	//! Swaps the content of two structures (e.g. to retrieve a structure built by another thread)
+	void swap(OctreeLOD& other);
+
+protected:
+
+	//! Updates the (global) levels start from the chunks ones
+	void updateLevelStarts();
+
+	//! Sorted local indexes (chunk by chunk)
+	std::vector<unsigned> m_localIndexes;
+	//! Start of each level (for each chunk)
+	std::vector<unsigned> m_chunkLevelStarts;
+	//! Start of each level (all chunks)
+	unsigned m_levelStarts[LEVEL_COUNT+1];
+};
+
+}
+
+#endif //OCTREE_LOD_HEADER
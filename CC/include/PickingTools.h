@@ -0,0 +1,118 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef PICKING_TOOLS_HEADER
+#define PICKING_TOOLS_HEADER
+
+//Local
+#include "CCCoreLib.h"
+#include "CCToolbox.h"
+#include "CCGeom.h"
+#include "GenericChunkedArray.h"
+
+namespace CCLib
+{
+
+class GenericIndexedCloudPersist;
+class GenericIndexedMesh;
+class DgmOctree;
+class MeshBVH;
+
+//! CPU picking of points and triangles (in screen space)
+/** The entities are projected on the screen with a 4x4 matrix (OpenGL style,
+	i.e. column-major) that transforms their coordinates into window (pixel)
+	coordinates: x = (M.P).x/(M.P).w, y = (M.P).y/(M.P).w, and depth = (M.P).z/(M.P).w
+	(normalized device coordinate: only the elements with a depth in [-1,1] and
+	w > 0 can be picked).
+	The element the nearest to the viewer (smallest depth) among those that fall
+	inside the picking area (a square centered on the picking position) is returned.
+**/
+class CC_CORE_LIB_API PickingTools : public CCToolbox
+{
+public:
+
+	//! Visibility table (see GenericCloud::testVisibility)
+	typedef GenericChunkedArray<1,uchar> VisibilityTableType;
+
+	//! Generic points filter (to exclude some points from picking, on top of the visibility table)
+	/** Warning: the filter may be called concurrently by several threads.
+	**/
+	class PointFilter
+	{
+	public:
+		//! Default destructor
+		virtual ~PointFilter() {}
+
+		//! Returns whether a given point can be picked
+		virtual bool canBePicked(unsigned pointIndex) const = 0;
+	};
+
+	//! Picks the nearest point
+	/** The octree (if any) is traversed from the root, and only the cells
+		that can be seen inside the picking area are visited. Otherwise all
+		the points are tested (in parallel).
+		\param cloud the cloud
+		\param projMat projection matrix (see class description)
+		\param pickPos picking position (window coordinates)
+		\param tolerance picking area half size (in pixels)
+		\param[out] pointIndex index of the picked point
+		\param[out] depth depth of the picked point
+		\param octree the optional octree of the cloud (ignored if it doesn't correspond to the cloud)
+		\param visibilityTable optional points visibility (only the POINT_VISIBLE ones can be picked)
+		\param filter optional points filter (only the points accepted by the filter can be picked)
+		\return whether a point has been picked or not
+	**/
+	static bool pickPoint(	GenericIndexedCloudPersist* cloud,
+							const double* projMat,
+							const CCVector2& pickPos,
+							PointCoordinateType tolerance,
+							unsigned& pointIndex,
+							double& depth,
+							const DgmOctree* octree = 0,
+							const VisibilityTableType* visibilityTable = 0,
+							const PointFilter* filter = 0);
+
+	//! Picks the nearest triangle
+	/** The BVH (if any) is traversed from the root, and only the nodes
+		that can be seen inside the picking area are visited. Otherwise all
+		the triangles are tested (in parallel).
+		A triangle is picked if its projection is closer than 'tolerance' (in
+		pixels) to the picking position. Triangles crossing the camera plane
+		are ignored.
+		\param mesh the mesh
+		\param projMat projection matrix (see class description)
+		\param pickPos picking position (window coordinates)
+		\param tolerance picking area half size (in pixels)
+		\param[out] triangleIndex index of the picked triangle
+		\param[out] depth depth of the picked triangle (at the nearest position from the picking position)
+		\param bvh the optional BVH of the mesh (ignored if it doesn't correspond to the mesh)
+		\param verticesVisibility optional vertices visibility (a triangle can only be picked if its 3 vertices are POINT_VISIBLE)
+		\return whether a triangle has been picked or not
+	**/
+	static bool pickTriangle(	GenericIndexedMesh* mesh,
+								const double* projMat,
+								const CCVector2& pickPos,
+								PointCoordinateType tolerance,
+								unsigned& triangleIndex,
+								double& depth,
+								const MeshBVH* bvh = 0,
+								const VisibilityTableType* verticesVisibility = 0);
+};
+
+}
+
+#endif //PICKING_TOOLS_HEADER
@@ -160,6 +160,21 @@ public:
 	static bool extractConcaveHull2D(	std::vector<IndexedCCVector2>& points,
 										std::list<IndexedCCVector2*>& hullPoints,
 										PointCoordinateType maxSquareLength = 0);
+
+	//! Extracts the (closed) flat contour of a set of points
+	/** Projects the points on their best fitting LS plane (or on a plane orthogonal
+		to a preferred direction) and extracts their 'concave' hull (see extractConcaveHull2D).
+		This method is thread-safe (as long as the input cloud can be read concurrently).
+		\param points input set of points
+		\param maxEdgeLength max edge length (ignored if 0, in which case the contour is the convex hull)
+		\param[out] contourPoints contour vertices (in 3D, on the projection plane)
+		\param preferredDim optional preferred (normal) direction for the projection
+		\return success
+	**/
+	static bool extractFlatContour(	GenericIndexedCloudPersist* points,
+									PointCoordinateType maxEdgeLength,
+									std::vector<CCVector3>& contourPoints,
+									const PointCoordinateType* preferredDim = 0);
 };
 
 }
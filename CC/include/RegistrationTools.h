@@ -159,7 +159,9 @@ public:
 
 	//! Registers two point clouds
 	/** This method implements the ICP algorithm (Besl et al.).
-		Warning: be sure to activate an INPUT/OUTPUT scalar field on the data cloud
+		The octree of the model cloud is only built once, and the (sampled) data
+		points are copied once and then transformed in place at each iteration
+		(the input data cloud and its scalar field are left untouched).
 		\param modelList the reference cloud (won't move)
 		\param dataList the cloud to register (will move)
 		\param totalTrans the resulting transformation (once the algorithm has converged)
@@ -0,0 +1,310 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef SYM_MATRIX_HEADER
+#define SYM_MATRIX_HEADER
+
+//local
+#include "CCGeom.h"
+
+//system
+#include <assert.h>
+#include <math.h>
+#include <string.h>
+
+namespace CCLib
+{
+
+	//! Fixed-size symmetric square matrix
+	/** Allocation-free counterpart of MatrixTpl for small symmetric matrices
+		(covariance matrices, normal equations, etc.). The coefficients are
+		stored on the stack, so that it can be used in tight per-point loops.
+		Template parameter 'N' is the matrix dimension. Only the upper triangular
+		part is used by the solvers.
+	**/
+	template <int N, typename Scalar> class SymMatrixTpl
+	{
+	public:
+
+		//! Default constructor (null matrix)
+		SymMatrixTpl() { toZero(); }
+
+		//! Sets all elements to 0
+		inline void toZero() { memset(m_values,0,sizeof(m_values)); }
+
+		//! Returns the matrix dimension
+		inline static unsigned size() { return static_cast<unsigned>(N); }
+
+		//! Adds the outer product of a vector with itself (i.e. v.v^T)
+		/** Only the upper triangular part is updated (see completeLowerPart).
+			\param v vector (size N)
+		**/
+		template <typename T> inline void addOuterProduct(const T v[])
+		{
+			for (int i=0; i<N; ++i)
+			{
+				Scalar vi = static_cast<Scalar>(v[i]);
+				for (int j=i; j<N; ++j)
+					m_values[i][j] += vi * static_cast<Scalar>(v[j]);
+			}
+		}
+
+		//! Copies the upper triangular part to the lower one
+		inline void completeLowerPart()
+		{
+			for (int i=1; i<N; ++i)
+				for (int j=0; j<i; ++j)
+					m_values[i][j] = m_values[j][i];
+		}
+
+		//! Multiplies all elements by a given coefficient
+		inline void scale(Scalar coef)
+		{
+			for (int i=0; i<N; ++i)
+				for (int j=0; j<N; ++j)
+					m_values[i][j] *= coef;
+		}
+
+		//! Computes eigen vectors (and values) with the Jacobian method
+		/** Same algorithm as MatrixTpl::computeJacobianEigenValuesAndVectors (see
+			the "Numerical Recipes") but without any dynamic allocation.
+			\param[out] eigenValues eigen values (absolute values)
+			\param[out] eigenVectors eigen vectors (as columns, i.e. eigenVectors[i][k] is the ith coordinate of the kth vector)
+			\param maxIterationCount max number of sweeps
+			\return success (false if the process hasn't converged)
+		**/
+		bool computeJacobianEigenValuesAndVectors(	Scalar eigenValues[N],
+													Scalar eigenVectors[N][N],
+													unsigned maxIterationCount = 50) const
+		{
+			//we work on a copy of the matrix
+			Scalar a[N][N];
+			memcpy(a,m_values,sizeof(m_values));
+
+			Scalar* d = eigenValues;
+			Scalar b[N], z[N];
+
+			//init
+			for (int ip=0; ip<N; ++ip)
+			{
+				for (int iq=0; iq<N; ++iq)
+					eigenVectors[ip][iq] = (ip == iq ? 1 : 0);
+				b[ip] = d[ip] = a[ip][ip]; //Initialize b and d to the diagonal of a.
+				z[ip] = 0; //This vector will accumulate terms of the form tapq as in equation (11.1.14)
+			}
+
+			for (unsigned i=1; i<=maxIterationCount; i++)
+			{
+				//Sum off-diagonal elements
+				Scalar sm = 0;
+				for (int ip=0; ip<N-1; ip++)
+					for (int iq=ip+1; iq<N; iq++)
+						sm += fabs(a[ip][iq]);
+
+				if (sm == 0) //The normal return, which relies on quadratic convergence to machine underflow.
+				{
+					//we only need the absolute values of eigenvalues
+					for (int ip=0; ip<N; ip++)
+						d[ip] = fabs(d[ip]);
+					return true;
+				}
+
+				Scalar tresh = 0;
+				if (i < 4)
+					tresh = sm / static_cast<Scalar>(5*N*N); //...on the first three sweeps.
+
+				for (int ip=0; ip<N-1; ip++)
+				{
+					for (int iq=ip+1; iq<N; iq++)
+					{
+						Scalar g = fabs(a[ip][iq]) * 100;
+						//After four sweeps, skip the rotation if the off-diagonal element is small.
+						if (	i > 4
+							&&	static_cast<float>(fabs(d[ip])+g) == static_cast<float>(fabs(d[ip]))
+							&&	static_cast<float>(fabs(d[iq])+g) == static_cast<float>(fabs(d[iq])) )
+						{
+							a[ip][iq] = 0;
+						}
+						else if (fabs(a[ip][iq]) > tresh)
+						{
+							Scalar h = d[iq]-d[ip];
+							Scalar t = 0;
+							if (static_cast<float>(fabs(h)+g) == static_cast<float>(fabs(h)))
+							{
+								t = a[ip][iq]/h; //t = 1/(2.theta)
+							}
+							else
+							{
+								Scalar theta = h/(2*a[ip][iq]); //Equation (11.1.10).
+								t = 1/(fabs(theta)+sqrt(1+theta*theta));
+								if (theta < 0)
+									t = -t;
+							}
+
+							Scalar c = 1/sqrt(t*t+1);
+							Scalar s = t*c;
+							Scalar tau = s/(1+c);
+							h = t * a[ip][iq];
+							z[ip] -= h;
+							z[iq] += h;
+							d[ip] -= h;
+							d[iq] += h;
+							a[ip][iq] = 0;
+
+							//Case of rotations 1 <= j < p
+							for (int j=0; j<ip; j++)
+								Rotate(a[j][ip],a[j][iq],s,tau);
+							//Case of rotations p < j < q
+							for (int j=ip+1; j<iq; j++)
+								Rotate(a[ip][j],a[j][iq],s,tau);
+							//Case of rotations q < j <= n
+							for (int j=iq+1; j<N; j++)
+								Rotate(a[ip][j],a[iq][j],s,tau);
+							//Last case
+							for (int j=0; j<N; j++)
+								Rotate(eigenVectors[j][ip],eigenVectors[j][iq],s,tau);
+						}
+					}
+				}
+
+				//update b, d and z
+				for (int ip=0; ip<N; ip++)
+				{
+					b[ip] += z[ip];
+					d[ip] = b[ip];
+					z[ip] = 0;
+				}
+			}
+
+			//Too many iterations!
+			return false;
+		}
+
+		//! Returns the smallest eigen value and its associated eigen vector
+		/** \param eigenValues eigen values (see computeJacobianEigenValuesAndVectors)
+			\param eigenVectors eigen vectors (see computeJacobianEigenValuesAndVectors)
+			\param[out] minEigenVector min eigen vector
+			\return min eigen value
+		**/
+		static Scalar GetMinEigenValueAndVector(const Scalar eigenValues[N], const Scalar eigenVectors[N][N], Scalar minEigenVector[N])
+		{
+			int minIndex = 0;
+			for (int i=1; i<N; ++i)
+				if (eigenValues[i] < eigenValues[minIndex])
+					minIndex = i;
+
+			for (int i=0; i<N; ++i)
+				minEigenVector[i] = eigenVectors[i][minIndex];
+			return eigenValues[minIndex];
+		}
+
+		//! Returns the biggest eigen value and its associated eigen vector
+		/** \param eigenValues eigen values (see computeJacobianEigenValuesAndVectors)
+			\param eigenVectors eigen vectors (see computeJacobianEigenValuesAndVectors)
+			\param[out] maxEigenVector max eigen vector
+			\return max eigen value
+		**/
+		static Scalar GetMaxEigenValueAndVector(const Scalar eigenValues[N], const Scalar eigenVectors[N][N], Scalar maxEigenVector[N])
+		{
+			int maxIndex = 0;
+			for (int i=1; i<N; ++i)
+				if (eigenValues[i] > eigenValues[maxIndex])
+					maxIndex = i;
+
+			for (int i=0; i<N; ++i)
+				maxEigenVector[i] = eigenVectors[i][maxIndex];
+			return eigenValues[maxIndex];
+		}
+
+		//! Solves the linear system M.x = b with a LDL^T (Cholesky) decomposition
+		/** \param b right-hand side vector
+			\param[out] x solution
+			\return success (false if the matrix is not positive definite)
+		**/
+		bool solveLDLT(const Scalar b[N], Scalar x[N]) const
+		{
+			//decomposition (L is unit lower triangular)
+			Scalar L[N][N];
+			Scalar D[N];
+
+			//relative tolerance for (numerically) null pivots
+			Scalar maxDiag = 0;
+			for (int i=0; i<N; ++i)
+				if (fabs(m_values[i][i]) > maxDiag)
+					maxDiag = fabs(m_values[i][i]);
+			const Scalar minPivot = maxDiag * static_cast<Scalar>(1.0e-12);
+
+			for (int j=0; j<N; ++j)
+			{
+				Scalar dj = m_values[j][j];
+				for (int k=0; k<j; ++k)
+					dj -= L[j][k] * L[j][k] * D[k];
+				if (!(dj > minPivot))
+					return false;
+				D[j] = dj;
+
+				for (int i=j+1; i<N; ++i)
+				{
+					Scalar lij = m_values[j][i]; //upper triangular part
+					for (int k=0; k<j; ++k)
+						lij -= L[i][k] * L[j][k] * D[k];
+					L[i][j] = lij / dj;
+				}
+			}
+
+			//forward substitution (L.y = b)
+			for (int i=0; i<N; ++i)
+			{
+				Scalar yi = b[i];
+				for (int k=0; k<i; ++k)
+					yi -= L[i][k] * x[k];
+				x[i] = yi;
+			}
+			//diagonal (D.z = y)
+			for (int i=0; i<N; ++i)
+				x[i] /= D[i];
+			//backward substitution (L^T.x = z)
+			for (int i=N-1; i>=0; --i)
+			{
+				for (int k=i+1; k<N; ++k)
+					x[i] -= L[k][i] * x[k];
+			}
+
+			return true;
+		}
+
+		//! Matrix coefficients
+		Scalar m_values[N][N];
+
+	protected:
+
+		//! Jacobi rotation (see MatrixTpl's ROTATE macro)
+		inline static void Rotate(Scalar& aij, Scalar& akl, Scalar s, Scalar tau)
+		{
+			Scalar g = aij;
+			Scalar h = akl;
+			aij = g-s*(h+g*tau);
+			akl = h+s*(g-h*tau);
+		}
+	};
+
+	//! Default 3x3 symmetric matrix (double precision)
+	typedef SymMatrixTpl<3,double> SymMatrix3d;
+
+} //namespace CCLib
+
+#endif //SYM_MATRIX_HEADER
@@ -80,6 +80,24 @@ void CCMiscTools::MakeMinAndMaxCubical(CCVector3& dimMin, CCVector3& dimMax, dou
 	}
 }
 
+void CCMiscTools::ComputeTransformedCubeBox(const CCVector3& center, PointCoordinateType halfSize, const float* transMat, CCVector3& boxMin, CCVector3& boxMax)
+{
+	CCVector3 H(halfSize,halfSize,halfSize);
+	if (transMat)
+	{
+		for (unsigned char d=0; d<3; ++d)
+			H.u[d] = halfSize * static_cast<PointCoordinateType>(fabs(transMat[d]) + fabs(transMat[4+d]) + fabs(transMat[8+d]));
+	}
+
+	//margin for rounding errors
+	PointCoordinateType maxAbsCoord = std::max<PointCoordinateType>(fabs(center.x),std::max<PointCoordinateType>(fabs(center.y),fabs(center.z))) + std::max(H.x,std::max(H.y,H.z));
+	PointCoordinateType margin = maxAbsCoord * static_cast<PointCoordinateType>(1.0e-5);
+	H += CCVector3(margin,margin,margin);
+
+	boxMin = center - H;
+	boxMax = center + H;
+}
+
 void CCMiscTools::EnlargeBox(CCVector3& dimMin, CCVector3& dimMax, double coef)
 {
     CCVector3 dd = (dimMax-dimMin) * static_cast<PointCoordinateType>(1.0+coef);
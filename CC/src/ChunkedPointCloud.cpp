@@ -72,7 +72,7 @@ void ChunkedPointCloud::getBoundingBox(PointCoordinateType bbMin[], PointCoordin
 {
 	if (!m_validBB)
 	{
-		m_points->computeMinAndMax();
+		computeBoundingBox();
 		m_validBB = true;
 	}
 
@@ -80,6 +80,37 @@ void ChunkedPointCloud::getBoundingBox(PointCoordinateType bbMin[], PointCoordin
 	memcpy(bbMax, m_points->getMax(), 3*sizeof(PointCoordinateType));
 }
 
+void ChunkedPointCloud::computeBoundingBox()
+{
+	CCVector3 bbMin(0,0,0);
+	CCVector3 bbMax(0,0,0);
+
+	if (size() != 0)
+	{
+		bbMin = bbMax = *point(0);
+
+		//we process each chunk in a row (no per-point indirection)
+		unsigned chunks = getChunksCount();
+		for (unsigned k=0; k<chunks; ++k)
+		{
+			const CCVector3* P = getChunkPoints(k);
+			unsigned chunkSize = getChunkSize(k);
+			for (unsigned i=0; i<chunkSize; ++i,++P)
+			{
+				if (P->x < bbMin.x) bbMin.x = P->x;
+				if (P->x > bbMax.x) bbMax.x = P->x;
+				if (P->y < bbMin.y) bbMin.y = P->y;
+				if (P->y > bbMax.y) bbMax.y = P->y;
+				if (P->z < bbMin.z) bbMin.z = P->z;
+				if (P->z > bbMax.z) bbMax.z = P->z;
+			}
+		}
+	}
+
+	m_points->setMin(bbMin.u);
+	m_points->setMax(bbMax.u);
+}
+
 void ChunkedPointCloud::invalidateBoundingBox()
 {
     m_validBB = false;
@@ -23,6 +23,10 @@
 #include "GenericIndexedCloudPersist.h"
 #include "CCMiscTools.h"
 #include "ScalarField.h"
+#include "SquareDistanceKernels.h"
+
+//Qt
+#include <QAtomicInt>
 
 //system
 #include <algorithm>
@@ -33,6 +37,7 @@
 
 //DGM: tests in progress
 //#define COMPUTE_NN_SEARCH_STATISTICS
+//#define COMPUTE_CELL_BUFFERS_STATISTICS
 //#define ADAPTATIVE_BINARY_SEARCH
 //#define OCTREE_TREE_TEST
 
@@ -206,6 +211,224 @@ int DgmOctree::build(const CCVector3& octreeMin, const CCVector3& octreeMax, con
     return genericBuild(progressCb);
 }
 
+//! Cell codes computation job (a range of points)
+/** Used by DgmOctree::genericBuild. Each job writes the codes of its
+	projected points at the beginning of its own sub-range of the output
+	array (the sub-ranges are compacted afterwards).
+**/
+struct octreeBuildChunk
+{
+	//! Associated cloud
+	GenericIndexedCloudPersist* cloud;
+	//! Associated octree
+	const DgmOctree* octree;
+	//! Octree bounding-box min corner
+	CCVector3 dimMin;
+	//! 'Accepted points' bounding-box
+	CCVector3 pointsMin,pointsMax;
+	//! Output array (first slot of this range)
+	DgmOctree::IndexAndCode* output;
+	//! First point index
+	unsigned begin;
+	//! Last point index (excluded)
+	unsigned end;
+	//! Number of projected points (output)
+	unsigned projectedCount;
+	//! Progress notification (shared by all the jobs)
+	ParallelProgressRelay* progress;
+};
+
+//! Computes the cell codes of a range of points
+static void ComputeCellCodes(octreeBuildChunk& chunk)
+{
+	static const unsigned PROGRESS_STEP = 4096;
+
+	const PointCoordinateType& cs = chunk.octree->getCellSize(DgmOctree::MAX_OCTREE_LEVEL);
+	const int maxLength = DgmOctree::MAX_OCTREE_LENGTH;
+
+	DgmOctree::IndexAndCode* it = chunk.output;
+	chunk.projectedCount = 0;
+
+	for (unsigned i=chunk.begin; i<chunk.end; i++)
+	{
+		const CCVector3* P = chunk.cloud->getPoint(i);
+
+		//does the point falls in the 'accepted points' box?
+		//(potentially different from the octree box - see DgmOctree::build)
+		if (	(P->x >= chunk.pointsMin.x) && (P->x <= chunk.pointsMax.x)
+			&&	(P->y >= chunk.pointsMin.y) && (P->y <= chunk.pointsMax.y)
+			&&	(P->z >= chunk.pointsMin.z) && (P->z <= chunk.pointsMax.z) )
+		{
+			//compute the position of the cell that includes this point
+			//(same as DgmOctree::getTheCellPosWhichIncludesThePoint)
+			int cellPos[3] = {	static_cast<int>((P->x - chunk.dimMin.x)/cs),
+								static_cast<int>((P->y - chunk.dimMin.y)/cs),
+								static_cast<int>((P->z - chunk.dimMin.z)/cs) };
+
+			//clipping
+			for (int dim=0; dim<3; ++dim)
+			{
+				if (cellPos[dim] < 0)
+					cellPos[dim] = 0;
+				else if (cellPos[dim] > maxLength)
+					cellPos[dim] = maxLength;
+			}
+
+			it->theIndex = i;
+			it->theCode = chunk.octree->generateTruncatedCellCode(cellPos,DgmOctree::MAX_OCTREE_LEVEL);
+
+			++it;
+			++chunk.projectedCount;
+		}
+
+		if (((i-chunk.begin+1) % PROGRESS_STEP) == 0 && !chunk.progress->steps(PROGRESS_STEP))
+			return;
+	}
+
+	unsigned remaining = ((chunk.end-chunk.begin) % PROGRESS_STEP);
+	if (remaining != 0)
+		chunk.progress->steps(remaining);
+}
+
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+//! Min. number of points for which the octree build is multi-threaded
+static const unsigned MIN_POINTS_FOR_MT_BUILD = (1<<16);
+
+void ComputeCellCodes_MT(octreeBuildChunk& chunk)
+{
+	//skip chunk if process has been canceled
+	if (!chunk.progress->isCanceled())
+		ComputeCellCodes(chunk);
+}
+
+//! Number of bits processed at each pass of the (LSD) radix sort
+static const unsigned RADIX_BITS = 11;
+//! Number of buckets per pass of the radix sort
+static const unsigned RADIX_BUCKETS = (1<<RADIX_BITS);
+
+//! Radix sort job (a range of elements)
+struct radixSortChunk
+{
+	//! Input array (for the current pass)
+	const DgmOctree::IndexAndCode* input;
+	//! Output array (for the current pass)
+	DgmOctree::IndexAndCode* output;
+	//! First element index
+	unsigned begin;
+	//! Last element index (excluded)
+	unsigned end;
+	//! Binary shift of the current digit
+	unsigned bitDec;
+	//! Histogram of the current digit (then the output positions for each bucket)
+	unsigned buckets[RADIX_BUCKETS];
+};
+
+void RadixSortHistogram_MT(radixSortChunk& chunk)
+{
+	memset(chunk.buckets,0,sizeof(unsigned)*RADIX_BUCKETS);
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+		++chunk.buckets[(chunk.input[i].theCode >> chunk.bitDec) & (RADIX_BUCKETS-1)];
+}
+
+void RadixSortScatter_MT(radixSortChunk& chunk)
+{
+	//stable: elements of a given chunk keep their relative order in each bucket
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+	{
+		const DgmOctree::IndexAndCode& element = chunk.input[i];
+		chunk.output[chunk.buckets[(element.theCode >> chunk.bitDec) & (RADIX_BUCKETS-1)]++] = element;
+	}
+}
+
+//! Multi-threaded LSD radix sort of octree codes
+/** Sorts the elements by ascending code order (exactly as with
+	DgmOctree::IndexAndCode::codeComp). As the sort is stable, points
+	lying in the same cell keep their original (index) order.
+	\return false if there's not enough memory (nothing is changed in this case)
+**/
+static bool RadixSortCellCodes_MT(DgmOctree::cellsContainer& codes, unsigned chunkCount)
+{
+	const unsigned count = static_cast<unsigned>(codes.size());
+	if (count < 2)
+		return true;
+
+	DgmOctree::cellsContainer buffer;
+	std::vector<radixSortChunk> chunks;
+	try
+	{
+		buffer.resize(count);
+		chunks.resize(std::max<unsigned>(1,std::min(chunkCount,count)));
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	const unsigned chunkSize = (count + static_cast<unsigned>(chunks.size()) - 1) / static_cast<unsigned>(chunks.size());
+	for (size_t k=0; k<chunks.size(); ++k)
+	{
+		chunks[k].begin = std::min(count,static_cast<unsigned>(k)*chunkSize);
+		chunks[k].end = std::min(count,chunks[k].begin+chunkSize);
+	}
+
+	DgmOctree::IndexAndCode* input = &(codes[0]);
+	DgmOctree::IndexAndCode* output = &(buffer[0]);
+
+	//only the 3*MAX_OCTREE_LEVEL lowest bits are used by the codes
+	for (unsigned bitDec=0; bitDec<3*DgmOctree::MAX_OCTREE_LEVEL; bitDec+=RADIX_BITS)
+	{
+		for (size_t k=0; k<chunks.size(); ++k)
+		{
+			chunks[k].input = input;
+			chunks[k].output = output;
+			chunks[k].bitDec = bitDec;
+		}
+
+		QtConcurrent::blockingMap(chunks, RadixSortHistogram_MT);
+
+		//convert the histograms to output positions (bucket by bucket, then chunk by chunk)
+		unsigned pos = 0;
+		bool singleBucket = false;
+		for (unsigned b=0; b<RADIX_BUCKETS; ++b)
+		{
+			unsigned bucketStart = pos;
+			for (size_t k=0; k<chunks.size(); ++k)
+			{
+				unsigned n = chunks[k].buckets[b];
+				chunks[k].buckets[b] = pos;
+				pos += n;
+			}
+			//all elements share the same digit? No need to move them!
+			if (pos - bucketStart == count)
+			{
+				singleBucket = true;
+				break;
+			}
+		}
+		assert(singleBucket || pos == count);
+
+		if (singleBucket)
+			continue;
+
+		QtConcurrent::blockingMap(chunks, RadixSortScatter_MT);
+
+		std::swap(input,output);
+	}
+
+	//the sorted elements are in the buffer?
+	if (input != &(codes[0]))
+		codes.swap(buffer);
+
+	return true;
+}
+
+#endif
+
 int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 {
     unsigned pointCount = (m_theAssociatedCloud ? m_theAssociatedCloud->size() : 0);
@@ -242,54 +465,84 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
         progressCb->start();
     }
 
-    //for all points
-    cellsContainer::iterator it = m_thePointsAndTheirCellCodes.begin();
-    for (unsigned i=0; i<pointCount; i++)
-    {
-        const CCVector3* P = m_theAssociatedCloud->getPoint(i);
+	//split the cloud in ranges of points
+	unsigned chunkCount = 1;
+#ifdef ENABLE_MT_OCTREE
+	const unsigned threadCount = static_cast<unsigned>(std::max(1,QThreadPool::globalInstance()->maxThreadCount()));
+	if (pointCount >= MIN_POINTS_FOR_MT_BUILD)
+		chunkCount = 4*threadCount; //a few more chunks than threads to balance the load
+#endif
 
-        //does the point falls in the 'accepted points' box?
-		//(potentially different from the octree box - see DgmOctree::build)
-        if (	(P->x >= m_pointsMin[0]) && (P->x <= m_pointsMax[0])
-			&&	(P->y >= m_pointsMin[1]) && (P->y <= m_pointsMax[1])
-			&&	(P->z >= m_pointsMin[2]) && (P->z <= m_pointsMax[2]) )
-        {
-            //compute the position of the cell that includes this point
-			int cellPos[3];
-            getTheCellPosWhichIncludesThePoint(P,cellPos);
-
-			//clipping X
-            if (cellPos[0] < 0)
-                cellPos[0] = 0;
-            else if (cellPos[0] > MAX_OCTREE_LENGTH)
-                cellPos[0] = MAX_OCTREE_LENGTH;
-            //clipping Y
-            if (cellPos[1] < 0)
-                cellPos[1] = 0;
-            else if (cellPos[1] > MAX_OCTREE_LENGTH)
-                cellPos[1] = MAX_OCTREE_LENGTH;
-            //clipping Z
-            if (cellPos[2] < 0)
-                cellPos[2] = 0;
-            else if (cellPos[2] > MAX_OCTREE_LENGTH)
-                cellPos[2] = MAX_OCTREE_LENGTH;
-
-            it->theIndex = i;
-            it->theCode = generateTruncatedCellCode(cellPos,MAX_OCTREE_LEVEL);
-
-            ++it;
-            ++m_numberOfProjectedPoints;
-        }
+	std::vector<octreeBuildChunk> chunks;
+	try
+	{
+		chunks.resize(chunkCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		m_thePointsAndTheirCellCodes.clear();
+		if (progressCb)
+			progressCb->stop();
+		delete nprogress;
+		return -1;
+	}
 
-		if (nprogress && !nprogress->oneStep())
+	ParallelProgressRelay progressRelay(nprogress);
+	{
+		const unsigned chunkSize = (pointCount + chunkCount - 1) / chunkCount;
+		for (unsigned k=0; k<chunkCount; ++k)
 		{
-			m_thePointsAndTheirCellCodes.clear();
-			m_numberOfProjectedPoints = 0;
-			progressCb->stop();
-			delete nprogress;
-			return 0;
+			octreeBuildChunk& chunk = chunks[k];
+			chunk.cloud = m_theAssociatedCloud;
+			chunk.octree = this;
+			chunk.dimMin = m_dimMin;
+			chunk.pointsMin = m_pointsMin;
+			chunk.pointsMax = m_pointsMax;
+			chunk.begin = std::min(pointCount,k*chunkSize);
+			chunk.end = std::min(pointCount,chunk.begin+chunkSize);
+			chunk.output = &(m_thePointsAndTheirCellCodes[0]) + chunk.begin;
+			chunk.projectedCount = 0;
+			chunk.progress = &progressRelay;
 		}
-    }
+	}
+
+	//for all points
+#ifdef ENABLE_MT_OCTREE
+	if (chunkCount > 1)
+	{
+		QtConcurrent::blockingMap(chunks, ComputeCellCodes_MT);
+	}
+	else
+#endif
+	{
+		ComputeCellCodes(chunks.front());
+	}
+
+	//remaining steps (notified by the other threads)
+	progressRelay.flush();
+
+	if (progressRelay.isCanceled())
+	{
+		m_thePointsAndTheirCellCodes.clear();
+		m_numberOfProjectedPoints = 0;
+		progressCb->stop();
+		delete nprogress;
+		return 0;
+	}
+
+	//compact the projected points (ranges are processed in order, so that
+	//the points order is the same as with a single range)
+	for (unsigned k=0; k<chunkCount; ++k)
+	{
+		const octreeBuildChunk& chunk = chunks[k];
+		if (m_numberOfProjectedPoints != chunk.begin && chunk.projectedCount != 0)
+		{
+			std::copy(	m_thePointsAndTheirCellCodes.begin() + chunk.begin,
+						m_thePointsAndTheirCellCodes.begin() + (chunk.begin + chunk.projectedCount),
+						m_thePointsAndTheirCellCodes.begin() + m_numberOfProjectedPoints);
+		}
+		m_numberOfProjectedPoints += chunk.projectedCount;
+	}
 
     if (m_numberOfProjectedPoints < pointCount)
         m_thePointsAndTheirCellCodes.resize(m_numberOfProjectedPoints); //smaller --> should always be ok
@@ -298,7 +551,18 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 		progressCb->setInfo("Sorting cells...");
 
     //we sort the 'cells' by ascending code order
-	std::sort(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),IndexAndCode::codeComp);
+#ifdef ENABLE_MT_OCTREE
+	if (m_numberOfProjectedPoints < MIN_POINTS_FOR_MT_BUILD || !RadixSortCellCodes_MT(m_thePointsAndTheirCellCodes,threadCount))
+#endif
+	{
+		std::sort(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),IndexAndCode::codeComp);
+	}
+
+#ifdef _DEBUG
+	//the codes must be in the same order as with codeComp (whatever the sort)
+	for (size_t i=1; i<m_thePointsAndTheirCellCodes.size(); ++i)
+		assert(!IndexAndCode::codeComp(m_thePointsAndTheirCellCodes[i],m_thePointsAndTheirCellCodes[i-1]));
+#endif
 
     //update the pre-computed 'number of cells per level of subdivision' array
     updateCellCountTable();
@@ -411,7 +675,7 @@ int DgmOctree::genericBuild(GenericProgressCallback* progressCb)
 
 		//check
 #ifdef _DEBUG
-		for (it=m_thePointsAndTheirCellCodes.begin();it!=m_thePointsAndTheirCellCodes.end();++it)
+		for (cellsContainer::const_iterator it=m_thePointsAndTheirCellCodes.begin();it!=m_thePointsAndTheirCellCodes.end();++it)
 			assert(getCell(it->theCode,MAX_OCTREE_LEVEL));
 #endif
 	}
@@ -458,56 +722,62 @@ void DgmOctree::updateCellSizeTable()
     }
 }
 
-void DgmOctree::updateCellCountTable()
+//! Cells statistics for a given level of subdivision
+struct cellsStatistics
 {
-	//level 0 is just the octree bounding-box
-	for (uchar i=0; i<=MAX_OCTREE_LEVEL; ++i)
-		computeCellsStatistics(i);
-}
+	unsigned cellCount;
+	unsigned maxCellPopulation;
+	double averageCellPopulation;
+	double stdDevCellPopulation;
+};
 
-void DgmOctree::computeCellsStatistics(uchar level)
+//! Computes statistics about cells for a given level of subdivision
+/** Shared by DgmOctree::computeCellsStatistics and its multi-threaded counterpart
+	(see DgmOctree::updateCellCountTable).
+**/
+static void ComputeCellsStatistics(const DgmOctree::cellsContainer& pointsAndCodes, uchar level, cellsStatistics& stats)
 {
-	assert(level<=MAX_OCTREE_LEVEL);
+	assert(level<=DgmOctree::MAX_OCTREE_LEVEL);
 
 	//empty octree case?!
-	if (m_thePointsAndTheirCellCodes.empty())
+	if (pointsAndCodes.empty())
 	{
 		//DGM: we make as if there were 1 point to avoid some degenerated cases!
-		m_cellCount[level] = 1;
-		m_maxCellPopulation[level] = 1;
-		m_averageCellPopulation[level] = 1.0;
-		m_stdDevCellPopulation[level] = 0.0;
+		stats.cellCount = 1;
+		stats.maxCellPopulation = 1;
+		stats.averageCellPopulation = 1.0;
+		stats.stdDevCellPopulation = 0.0;
 		return;
 	}
 
 	//level '0' specific case
 	if (level == 0)
 	{
-		m_cellCount[level] = 1;
-		m_maxCellPopulation[level] = static_cast<unsigned>(m_thePointsAndTheirCellCodes.size());
-		m_averageCellPopulation[level] = static_cast<double>(m_thePointsAndTheirCellCodes.size());
-		m_stdDevCellPopulation[level] = 0.0;
+		stats.cellCount = 1;
+		stats.maxCellPopulation = static_cast<unsigned>(pointsAndCodes.size());
+		stats.averageCellPopulation = static_cast<double>(pointsAndCodes.size());
+		stats.stdDevCellPopulation = 0.0;
 		return;
 	}
 
 	//binary shift for cell code truncation
-    uchar bitDec = GET_BIT_SHIFT(level);
+	uchar bitDec = GET_BIT_SHIFT(level);
 
 	//iterator on octree elements
-    cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin();
+	DgmOctree::cellsContainer::const_iterator p = pointsAndCodes.begin();
 
 	//we init scan with first element
-    OctreeCellCodeType predCode = (p->theCode >> bitDec);
-    unsigned counter = 0;
+	DgmOctree::OctreeCellCodeType predCode = (p->theCode >> bitDec);
+	unsigned counter = 0;
 	unsigned cellCounter = 0;
 	unsigned maxCellPop = 0;
 	double sum=0.0, sum2=0.0;
 
-    for (; p != m_thePointsAndTheirCellCodes.end(); ++p)
-    {
-        OctreeCellCodeType currentCode = (p->theCode >> bitDec);
-        if (predCode != currentCode)
-        {
+	for (; p != pointsAndCodes.end(); ++p)
+	{
+		DgmOctree::OctreeCellCodeType currentCode = (p->theCode >> bitDec);
+		if (predCode != currentCode)
+		{
 			sum += static_cast<double>(cellCounter);
 			sum2 += static_cast<double>(cellCounter) * static_cast<double>(cellCounter);
 
@@ -515,12 +785,12 @@ void DgmOctree::computeCellsStatistics(uchar level)
 				maxCellPop = cellCounter;
 
 			//new cell
-            predCode = currentCode;
+			predCode = currentCode;
 			cellCounter = 0;
-            ++counter;
-        }
+			++counter;
+		}
 		++cellCounter;
-    }
+	}
 
 	//don't forget last cell!
 	sum += static_cast<double>(cellCounter);
@@ -530,10 +800,381 @@ void DgmOctree::computeCellsStatistics(uchar level)
 	++counter;
 
 	assert(counter > 0);
-	m_cellCount[level] = counter;
-	m_maxCellPopulation[level] = maxCellPop;
-	m_averageCellPopulation[level] = sum/static_cast<double>(counter);
-	m_stdDevCellPopulation[level] = sqrt(sum2/static_cast<double>(counter) - m_averageCellPopulation[level]*m_averageCellPopulation[level]);
+	stats.cellCount = counter;
+	stats.maxCellPopulation = maxCellPop;
+	stats.averageCellPopulation = sum/static_cast<double>(counter);
+	stats.stdDevCellPopulation = sqrt(sum2/static_cast<double>(counter) - stats.averageCellPopulation*stats.averageCellPopulation);
+}
+
+void DgmOctree::computeCellsStatistics(uchar level)
+{
+	assert(level<=MAX_OCTREE_LEVEL);
+
+	cellsStatistics stats;
+	ComputeCellsStatistics(m_thePointsAndTheirCellCodes,level,stats);
+
+	m_cellCount[level] = stats.cellCount;
+	m_maxCellPopulation[level] = stats.maxCellPopulation;
+	m_averageCellPopulation[level] = stats.averageCellPopulation;
+	m_stdDevCellPopulation[level] = stats.stdDevCellPopulation;
+}
+
+#ifdef ENABLE_MT_OCTREE
+
+//! Per-level cells statistics job (see DgmOctree::updateCellCountTable)
+struct cellsStatisticsDesc_MT
+{
+	const DgmOctree::cellsContainer* pointsAndCodes;
+	uchar level;
+	cellsStatistics stats;
+};
+
+void ComputeCellsStatistics_MT(cellsStatisticsDesc_MT& desc)
+{
+	ComputeCellsStatistics(*desc.pointsAndCodes,desc.level,desc.stats);
+}
+
+#endif
+
+void DgmOctree::updateCellCountTable()
+{
+#ifdef ENABLE_MT_OCTREE
+	//each level requires a full scan of the octree, but levels are independent
+	if (m_thePointsAndTheirCellCodes.size() >= MIN_POINTS_FOR_MT_BUILD)
+	{
+		std::vector<cellsStatisticsDesc_MT> levels(MAX_OCTREE_LEVEL+1);
+		for (uchar i=0; i<=MAX_OCTREE_LEVEL; ++i)
+		{
+			levels[i].pointsAndCodes = &m_thePointsAndTheirCellCodes;
+			levels[i].level = i;
+		}
+
+		QtConcurrent::blockingMap(levels, ComputeCellsStatistics_MT);
+
+		for (uchar i=0; i<=MAX_OCTREE_LEVEL; ++i)
+		{
+			m_cellCount[i] = levels[i].stats.cellCount;
+			m_maxCellPopulation[i] = levels[i].stats.maxCellPopulation;
+			m_averageCellPopulation[i] = levels[i].stats.averageCellPopulation;
+			m_stdDevCellPopulation[i] = levels[i].stats.stdDevCellPopulation;
+		}
+		return;
+	}
+#endif
+
+	//level 0 is just the octree bounding-box
+	for (uchar i=0; i<=MAX_OCTREE_LEVEL; ++i)
+		computeCellsStatistics(i);
+}
+
+//! Compares the truncated cell code of an octree element with a truncated cell code
+struct TruncatedCodeComp
+{
+	uchar bitDec;
+
+	explicit TruncatedCodeComp(uchar dec) : bitDec(dec) {}
+
+	inline bool operator()(const DgmOctree::IndexAndCode& a, DgmOctree::OctreeCellCodeType truncatedCode) const { return (a.theCode >> bitDec) < truncatedCode; }
+	inline bool operator()(DgmOctree::OctreeCellCodeType truncatedCode, const DgmOctree::IndexAndCode& b) const { return truncatedCode < (b.theCode >> bitDec); }
+};
+
+//! Returns the max cell population for a given level of subdivision
+/** Jumps from cell to cell (efficient if cells are much less than points).
+**/
+static unsigned ComputeMaxCellPopulation(	DgmOctree::cellsContainer::const_iterator begin,
+											DgmOctree::cellsContainer::const_iterator end,
+											uchar bitDec)
+{
+	TruncatedCodeComp comp(bitDec);
+	unsigned maxCellPop = 0;
+	while (begin != end)
+	{
+		DgmOctree::cellsContainer::const_iterator next = std::upper_bound(begin,end,begin->theCode >> bitDec,comp);
+		maxCellPop = std::max(maxCellPop,static_cast<unsigned>(next-begin));
+		begin = next;
+	}
+	return maxCellPop;
+}
+
+//! Updates the cells statistics of a given level after some points have been inserted or removed
+/** \param begin first element of the octree (before update)
+	\param end last element of the octree (before update)
+	\param changedCodes inserted or removed elements (sorted by code)
+	\param level level of subdivision
+	\param insertion whether the elements are inserted or removed
+	\param newPointCount number of points in the octree after update
+	\param stats cells statistics (updated)
+	\return false if the max cell population must be recomputed (i.e. a former biggest cell has shrunk)
+**/
+static bool UpdateCellsStatistics(	DgmOctree::cellsContainer::const_iterator begin,
+									DgmOctree::cellsContainer::const_iterator end,
+									const DgmOctree::cellsContainer& changedCodes,
+									uchar level,
+									bool insertion,
+									unsigned newPointCount,
+									cellsStatistics& stats)
+{
+	if (newPointCount == 0)
+	{
+		//same degenerated case as ComputeCellsStatistics
+		stats.cellCount = 1;
+		stats.maxCellPopulation = 1;
+		stats.averageCellPopulation = 1.0;
+		stats.stdDevCellPopulation = 0.0;
+		return true;
+	}
+
+	if (level == 0)
+	{
+		stats.cellCount = 1;
+		stats.maxCellPopulation = newPointCount;
+		stats.averageCellPopulation = static_cast<double>(newPointCount);
+		stats.stdDevCellPopulation = 0.0;
+		return true;
+	}
+
+	uchar bitDec = GET_BIT_SHIFT(level);
+	TruncatedCodeComp comp(bitDec);
+
+	//sum of the squared populations (deduced from the current statistics)
+	double sum2 = static_cast<double>(stats.cellCount) * (stats.stdDevCellPopulation*stats.stdDevCellPopulation + stats.averageCellPopulation*stats.averageCellPopulation);
+	int cellCount = static_cast<int>(stats.cellCount);
+	bool maxIsValid = true;
+
+	DgmOctree::cellsContainer::const_iterator p = changedCodes.begin();
+	while (p != changedCodes.end())
+	{
+		DgmOctree::OctreeCellCodeType truncatedCode = (p->theCode >> bitDec);
+		DgmOctree::cellsContainer::const_iterator next = std::upper_bound(p,changedCodes.end(),truncatedCode,comp);
+		unsigned changed = static_cast<unsigned>(next-p);
+		p = next;
+
+		std::pair<DgmOctree::cellsContainer::const_iterator,DgmOctree::cellsContainer::const_iterator> cell = std::equal_range(begin,end,truncatedCode,comp);
+		unsigned before = static_cast<unsigned>(cell.second-cell.first);
+		unsigned after = 0;
+
+		if (insertion)
+		{
+			after = before + changed;
+			if (before == 0)
+				++cellCount;
+			if (after > stats.maxCellPopulation)
+				stats.maxCellPopulation = after;
+		}
+		else
+		{
+			assert(before >= changed);
+			after = before - changed;
+			if (after == 0)
+				--cellCount;
+			if (before == stats.maxCellPopulation)
+				maxIsValid = false;
+		}
+
+		sum2 += static_cast<double>(after)*static_cast<double>(after) - static_cast<double>(before)*static_cast<double>(before);
+	}
+
+	assert(cellCount > 0);
+	stats.cellCount = static_cast<unsigned>(cellCount);
+	stats.averageCellPopulation = static_cast<double>(newPointCount)/static_cast<double>(cellCount);
+	double variance = sum2/static_cast<double>(cellCount) - stats.averageCellPopulation*stats.averageCellPopulation;
+	stats.stdDevCellPopulation = (variance > 0 ? sqrt(variance) : 0.0);
+
+	return maxIsValid;
+}
+
+int DgmOctree::insertPoints(unsigned firstIndex, unsigned lastIndex)
+{
+	if (!m_theAssociatedCloud || firstIndex > lastIndex || lastIndex > m_theAssociatedCloud->size())
+		return -1;
+
+	//the octree must have been built first (its bounding-box is required)
+	if (m_numberOfProjectedPoints == 0)
+		return -1;
+
+	if (firstIndex == lastIndex)
+		return 0;
+
+	//compute the codes of the new points (only the ones inside the octree bounding-box)
+	cellsContainer newCodes;
+	try
+	{
+		newCodes.resize(lastIndex-firstIndex);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return -1;
+	}
+
+	ParallelProgressRelay progressRelay(0);
+	octreeBuildChunk chunk;
+	chunk.cloud = m_theAssociatedCloud;
+	chunk.octree = this;
+	chunk.dimMin = m_dimMin;
+	chunk.pointsMin = m_dimMin;
+	chunk.pointsMax = m_dimMax;
+	chunk.output = &(newCodes[0]);
+	chunk.begin = firstIndex;
+	chunk.end = lastIndex;
+	chunk.projectedCount = 0;
+	chunk.progress = &progressRelay;
+	ComputeCellCodes(chunk);
+
+	unsigned insertedCount = chunk.projectedCount;
+	if (insertedCount == 0)
+		return 0;
+	newCodes.resize(insertedCount); //smaller --> should always be ok
+
+	std::sort(newCodes.begin(),newCodes.end(),IndexAndCode::codeComp);
+
+	//make room for the new elements
+	unsigned formerCount = static_cast<unsigned>(m_thePointsAndTheirCellCodes.size());
+	try
+	{
+		m_thePointsAndTheirCellCodes.resize(formerCount+insertedCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return -1;
+	}
+
+	//update the cells statistics (with the former cells)
+	for (uchar level=0; level<=MAX_OCTREE_LEVEL; ++level)
+	{
+		cellsStatistics stats;
+		stats.cellCount = m_cellCount[level];
+		stats.maxCellPopulation = m_maxCellPopulation[level];
+		stats.averageCellPopulation = m_averageCellPopulation[level];
+		stats.stdDevCellPopulation = m_stdDevCellPopulation[level];
+
+		UpdateCellsStatistics(	m_thePointsAndTheirCellCodes.begin(),
+								m_thePointsAndTheirCellCodes.begin()+formerCount,
+								newCodes,
+								level,
+								true,
+								formerCount+insertedCount,
+								stats);
+
+		m_cellCount[level] = stats.cellCount;
+		m_maxCellPopulation[level] = stats.maxCellPopulation;
+		m_averageCellPopulation[level] = stats.averageCellPopulation;
+		m_stdDevCellPopulation[level] = stats.stdDevCellPopulation;
+	}
+
+	//merge the new (sorted) codes with the former ones, starting from the end
+	//(for a given code, the new points come after the former ones)
+	{
+		cellsContainer::iterator dest = m_thePointsAndTheirCellCodes.end();
+		cellsContainer::iterator former = m_thePointsAndTheirCellCodes.begin()+formerCount;
+		cellsContainer::const_iterator added = newCodes.end();
+		while (added != newCodes.begin())
+		{
+			if (former != m_thePointsAndTheirCellCodes.begin() && (added-1)->theCode < (former-1)->theCode)
+				*(--dest) = *(--former);
+			else
+				*(--dest) = *(--added);
+		}
+	}
+
+	m_numberOfProjectedPoints += insertedCount;
+
+	//update the bounding-box of the projected points (and the fill indexes)
+	for (cellsContainer::const_iterator p = newCodes.begin(); p != newCodes.end(); ++p)
+	{
+		const CCVector3* P = m_theAssociatedCloud->getPoint(p->theIndex);
+		for (uchar dim=0; dim<3; ++dim)
+		{
+			if (P->u[dim] < m_pointsMin.u[dim])
+				m_pointsMin.u[dim] = P->u[dim];
+			else if (P->u[dim] > m_pointsMax.u[dim])
+				m_pointsMax.u[dim] = P->u[dim];
+		}
+	}
+	updateCellSizeTable();
+
+	return static_cast<int>(insertedCount);
+}
+
+bool DgmOctree::removePoints(const std::vector<unsigned>& newIndexes)
+{
+	//gather the removed elements (they are already sorted by code)
+	cellsContainer removedCodes;
+	try
+	{
+		for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin(); p != m_thePointsAndTheirCellCodes.end(); ++p)
+		{
+			if (p->theIndex >= newIndexes.size())
+				return false; //invalid input
+			if (newIndexes[p->theIndex] == REMOVED_POINT_INDEX)
+				removedCodes.push_back(*p);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	unsigned formerCount = static_cast<unsigned>(m_thePointsAndTheirCellCodes.size());
+	unsigned newCount = formerCount - static_cast<unsigned>(removedCodes.size());
+
+	//update the cells statistics (with the former cells)
+	bool maxIsValid[MAX_OCTREE_LEVEL+1];
+	for (uchar level=0; level<=MAX_OCTREE_LEVEL; ++level)
+	{
+		maxIsValid[level] = true;
+		if (removedCodes.empty())
+			continue;
+
+		cellsStatistics stats;
+		stats.cellCount = m_cellCount[level];
+		stats.maxCellPopulation = m_maxCellPopulation[level];
+		stats.averageCellPopulation = m_averageCellPopulation[level];
+		stats.stdDevCellPopulation = m_stdDevCellPopulation[level];
+
+		maxIsValid[level] = UpdateCellsStatistics(	m_thePointsAndTheirCellCodes.begin(),
+													m_thePointsAndTheirCellCodes.end(),
+													removedCodes,
+													level,
+													false,
+													newCount,
+													stats);
+
+		m_cellCount[level] = stats.cellCount;
+		m_maxCellPopulation[level] = stats.maxCellPopulation;
+		m_averageCellPopulation[level] = stats.averageCellPopulation;
+		m_stdDevCellPopulation[level] = stats.stdDevCellPopulation;
+	}
+
+	//compaction + re-indexing (the codes order is preserved)
+	{
+		cellsContainer::iterator dest = m_thePointsAndTheirCellCodes.begin();
+		for (cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin(); p != m_thePointsAndTheirCellCodes.end(); ++p)
+		{
+			unsigned newIndex = newIndexes[p->theIndex];
+			if (newIndex != REMOVED_POINT_INDEX)
+			{
+				dest->theCode = p->theCode;
+				dest->theIndex = newIndex;
+				++dest;
+			}
+		}
+	}
+	m_thePointsAndTheirCellCodes.resize(newCount); //smaller --> should always be ok
+	m_numberOfProjectedPoints = newCount;
+
+	//eventually we recompute the max cell population where it is required
+	for (uchar level=1; level<=MAX_OCTREE_LEVEL; ++level)
+	{
+		if (maxIsValid[level] || newCount == 0)
+			continue;
+
+		if (static_cast<size_t>(m_cellCount[level]) * 16 < m_thePointsAndTheirCellCodes.size())
+			m_maxCellPopulation[level] = ComputeMaxCellPopulation(m_thePointsAndTheirCellCodes.begin(),m_thePointsAndTheirCellCodes.end(),GET_BIT_SHIFT(level));
+		else
+			computeCellsStatistics(level);
+	}
+
+	return true;
 }
 
 //! Pre-computed cell codes for all potential cell positions (along a unique dimension)
@@ -1006,6 +1647,46 @@ void DgmOctree::getNeighborCellsAround(const int cellPos[],
     }
 }
 
+bool DgmOctree::hasCellsInNeighbourhood(const int* cellPos,
+										uchar level,
+										int neighbourhoodLength,
+										cellIndexesContainer& cellIndexesBuffer) const
+{
+	if (m_numberOfProjectedPoints == 0)
+		return false;
+
+	//we look for the first coarser level at which a single cell is at least as large as the neighbourhood
+	int k = 0;
+	while ((1<<k) < neighbourhoodLength)
+		++k;
+	if (k >= static_cast<int>(level))
+		return true; //no coarser level to test (the whole octree is the neighbourhood)
+	uchar coarseLevel = static_cast<uchar>(level-k);
+
+	//position of the 'parent' cell
+	int coarsePos[3] = { cellPos[0]>>k, cellPos[1]>>k, cellPos[2]>>k };
+
+	//the parent cell itself
+	OctreeCellCodeType truncatedCellCode = generateTruncatedCellCode(coarsePos,coarseLevel);
+	if (truncatedCellCode != INVALID_CELL_CODE && getCellIndex(truncatedCellCode,GET_BIT_SHIFT(coarseLevel)) < m_numberOfProjectedPoints)
+		return true;
+
+	//and its direct neighbours (which enclose the whole neighbourhood)
+	bool found = true;
+	try
+	{
+		getNeighborCellsAround(coarsePos,cellIndexesBuffer,1,coarseLevel);
+		found = !cellIndexesBuffer.empty();
+	}
+	catch (.../*const std::bad_alloc&*/)
+	{
+		//not enough memory: we can't conclude
+	}
+	cellIndexesBuffer.clear();
+
+	return found;
+}
+
 void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSearchStruct &nNSS,
 												int neighbourhoodLength,
 												bool getOnlyPointsWithValidScalar/*=false*/) const
@@ -1423,6 +2104,94 @@ void DgmOctree::getPointsInNeighbourCellsAround(NearestNeighboursSphericalSearch
 }
 #endif
 
+void DgmOctree::updateNeighboursCoordinates(NearestNeighboursSearchStruct &nNSS) const
+{
+	NeighboursCoordinates& coords = nNSS.neighboursCoordinates;
+	const cellIndexesContainer& cells = nNSS.minimalCellsSetToVisit;
+
+	//we check which cells are still valid (i.e. are still the first ones to visit, at the same level)
+	size_t validCells = 0;
+	size_t maxCells = std::min(coords.cells.size(),cells.size());
+	while (	validCells < maxCells
+		&&	coords.cells[validCells].index == cells[validCells]
+		&&	coords.cells[validCells].level == nNSS.level)
+	{
+		++validCells;
+	}
+	if (validCells < coords.cells.size())
+	{
+		coords.resize(coords.cells[validCells].offset);
+		coords.cells.resize(validCells);
+	}
+	else if (coords.cells.empty())
+	{
+		//the block may have been used by another search algorithm
+		coords.resize(0);
+	}
+
+	//binary shift for cell code truncation
+	uchar bitDec = GET_BIT_SHIFT(nNSS.level);
+
+	//we copy the coordinates of the points lying in the new cells
+	for (size_t c=coords.cells.size(); c<cells.size(); ++c)
+	{
+		//current cell index (== index of its first point)
+		unsigned m = cells[c];
+		NeighboursCoordinates::Cell cell;
+		cell.index = m;
+		cell.level = nNSS.level;
+		cell.offset = coords.size();
+		coords.cells.push_back(cell);
+
+		cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+m;
+		OctreeCellCodeType code = (p->theCode >> bitDec);
+		while (m<m_numberOfProjectedPoints && (p->theCode >> bitDec) == code)
+		{
+			coords.push_back(*m_theAssociatedCloud->getPointPersistentPtr(p->theIndex),p->theIndex);
+			++m;
+			++p;
+		}
+	}
+}
+
+//! Computes the square distances between the query point and the neighbours (starting from a given one)
+/** The coordinates of the neighbours are mirrored in nNSS.neighboursCoordinates, so that
+	the distances can be computed in batch. Only the entries that don't match the current
+	neighbours (new ones, or ones that have been moved since the last call) are copied.
+**/
+static void ComputeNeighboursSquareDistances(DgmOctree::NearestNeighboursSearchStruct &nNSS, unsigned firstIndex)
+{
+	DgmOctree::NeighboursSet& neighbours = nNSS.pointsInNeighbourhood;
+	unsigned count = static_cast<unsigned>(neighbours.size());
+	if (firstIndex >= count)
+		return;
+
+	DgmOctree::NeighboursCoordinates& coords = nNSS.neighboursCoordinates;
+	//the block is not bound to cells anymore
+	coords.cells.clear();
+
+	//we synchronize the block with the neighbours
+	unsigned blockSize = coords.size();
+	if (blockSize != count)
+		coords.resize(count);
+	for (unsigned i=firstIndex; i<count; ++i)
+	{
+		const DgmOctree::PointDescriptor& P = neighbours[i];
+		if (i >= blockSize || coords.indexes[i] != P.pointIndex)
+			coords.set(i,*P.point,P.pointIndex);
+	}
+
+	SquareDistanceKernels::ComputeSquareDistances(	&coords.x[firstIndex],
+													&coords.y[firstIndex],
+													&coords.z[firstIndex],
+													count-firstIndex,
+													nNSS.queryPoint,
+													&coords.squareDists[firstIndex]);
+
+	for (unsigned i=firstIndex; i<count; ++i)
+		neighbours[i].squareDistd = coords.squareDists[i];
+}
+
 double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearchStruct &nNSS) const
 {
     //binary shift for cell code truncation
@@ -1507,8 +2276,8 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
     //query point and totally included inside the cell
     PointCoordinateType minDistToBorder = ComputeMinDistanceToCellBorder(&nNSS.queryPoint,cs,nNSS.cellCenter);
 
-    //cells for which we have already computed the distances from their points to the query point
-    unsigned alreadyProcessedCells = 0;
+    //points for which we have already computed the distance to the query point
+    unsigned alreadyProcessedPoints = 0;
 
     //Min (squared) distance of neighbours
     double minSquareDist = -1.0;
@@ -1530,31 +2299,30 @@ double DgmOctree::findTheNearestNeighborStartingFromCell(NearestNeighboursSearch
             ++nNSS.alreadyVisitedNeighbourhoodSize;
         }
 
-        //we compute distances for the new points
-        DgmOctree::cellIndexesContainer::const_iterator q;
-        for (q = nNSS.minimalCellsSetToVisit.begin()+alreadyProcessedCells; q != nNSS.minimalCellsSetToVisit.end(); ++q)
-        {
-            //current cell index (== index of its first point)
-            unsigned m = *q;
+        //we gather the coordinates of the points lying in the new cells
+        //(only once for all the query points lying in the same cell)
+        updateNeighboursCoordinates(nNSS);
 
-            //we scan the whole cell to see if it contains a closer point
-            cellsContainer::const_iterator p = m_thePointsAndTheirCellCodes.begin()+m;
-            OctreeCellCodeType code = (p->theCode >> bitDec);
-            while (m<m_numberOfProjectedPoints && (p->theCode >> bitDec) == code)
+        //and we compute distances for the new points (in batch)
+        const NeighboursCoordinates& coords = nNSS.neighboursCoordinates;
+        unsigned pointCount = coords.size();
+        if (alreadyProcessedPoints < pointCount)
+        {
+            double dist2;
+            unsigned i = SquareDistanceKernels::FindNearestPoint(	&coords.x[alreadyProcessedPoints],
+                                                                    &coords.y[alreadyProcessedPoints],
+                                                                    &coords.z[alreadyProcessedPoints],
+                                                                    pointCount-alreadyProcessedPoints,
+                                                                    nNSS.queryPoint,
+                                                                    dist2);
+            //we keep track of the closest one
+            if (i < pointCount-alreadyProcessedPoints && (dist2 < minSquareDist || minSquareDist < 0))
             {
-                //square distance to query point
-                double dist2 = (*m_theAssociatedCloud->getPointPersistentPtr(p->theIndex) - nNSS.queryPoint).norm2d();
-                //we keep track of the closest one
-                if (dist2 < minSquareDist || minSquareDist < 0)
-                {
-                    nNSS.theNearestPointIndex = p->theIndex;
-                    minSquareDist = dist2;
-                }
-                ++m;
-                ++p;
+                nNSS.theNearestPointIndex = coords.indexes[alreadyProcessedPoints+i];
+                minSquareDist = dist2;
             }
         }
-        alreadyProcessedCells = static_cast<unsigned>(nNSS.minimalCellsSetToVisit.size());
+        alreadyProcessedPoints = pointCount;
 
         //equivalent spherical neighbourhood radius (as we are actually looking to 'square' neighbourhoods,
         //we must check that the nearest points inside such neighbourhoods are indeed near enough to fall
@@ -1706,10 +2474,8 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
             ++visitedCellDistance;
         }
 
-        //we compute distances for the new points
-        NeighboursSet::iterator q;
-        for (q = nNSS.pointsInNeighbourhood.begin()+alreadyProcessedPoints; q != nNSS.pointsInNeighbourhood.end(); ++q)
-            q->squareDistd = (*q->point - nNSS.queryPoint).norm2d();
+        //we compute distances for the new points (in batch)
+        ComputeNeighboursSquareDistances(nNSS,alreadyProcessedPoints);
         alreadyProcessedPoints = static_cast<unsigned>(nNSS.pointsInNeighbourhood.size());
 
         //equivalent spherical neighbourhood radius (as we are actually looking to 'square' neighbourhoods,
@@ -1720,7 +2486,7 @@ unsigned DgmOctree::findNearestNeighborsStartingFromCell(	NearestNeighboursSearc
 
         //let's test all the previous 'not yet eligible' points and the new ones
         unsigned j = eligiblePoints;
-        for (q = nNSS.pointsInNeighbourhood.begin()+eligiblePoints; q != nNSS.pointsInNeighbourhood.end(); ++q,++j)
+        for (NeighboursSet::iterator q = nNSS.pointsInNeighbourhood.begin()+eligiblePoints; q != nNSS.pointsInNeighbourhood.end(); ++q,++j)
         {
             //if the point is eligible
             if (q->squareDistd <= squareEligibleDist)
@@ -3078,17 +3844,247 @@ int DgmOctree::extractCCs(uchar level, bool sixConnexity, GenericProgressCallbac
     return extractCCs(cellCodes, level, sixConnexity, progressCb);
 }
 
+/*** Connected components labelling ***/
+
+//! Connected components labelling: shared parameters
+/** The filled cells are sorted by ascending grid key (i + j*2^level + k*4^level),
+	i.e. slice by slice (k), then row by row (j). Each cell is an element of a
+	union-find structure ('parents') where the parent of a cell is always its
+	own index or the index of a preceding cell.
+**/
+struct ccLabellingParams
+{
+	//! Filled cells (sorted by grid key, which is stored as their 'code')
+	const DgmOctree::IndexAndCode* cells;
+	//! Union-find structure
+	unsigned* parents;
+	//! Level of subdivision
+	uchar level;
+	//! Whether to use 6-connexity (26-connexity otherwise)
+	bool sixConnexity;
+};
+
+//! Returns the representative of a cell (union-find)
+static inline unsigned FindRootCell(unsigned* parents, unsigned index)
+{
+	while (parents[index] != index)
+	{
+		parents[index] = parents[parents[index]]; //path halving
+		index = parents[index];
+	}
+	return index;
+}
+
+//! Merges the components of two cells (union-find)
+/** The representative of a component is always its smallest cell index.
+**/
+static inline void MergeCells(unsigned* parents, unsigned indexA, unsigned indexB)
+{
+	unsigned rootA = FindRootCell(parents,indexA);
+	unsigned rootB = FindRootCell(parents,indexB);
+	if (rootA < rootB)
+		parents[rootB] = rootA;
+	else if (rootB < rootA)
+		parents[rootA] = rootB;
+}
+
+//! Merges a cell with its neighbors in a given row (of the same slice or of the preceding one)
+/** \param params shared parameters
+	\param cellIndex cell index
+	\param cursor first cell of the row that could be a neighbor (updated)
+	\param end end of the range of cells in which the neighbors are searched
+	\param row neighbors row
+	\param firstCol first neighbor column
+	\param lastCol last neighbor column
+**/
+static inline void MergeWithRowNeighbors(	const ccLabellingParams& params,
+											unsigned cellIndex,
+											unsigned& cursor,
+											unsigned end,
+											int row,
+											int firstCol,
+											int lastCol)
+{
+	const DgmOctree::OctreeCellCodeType sliceMask = (static_cast<DgmOctree::OctreeCellCodeType>(1) << (2*params.level)) - 1;
+	const DgmOctree::OctreeCellCodeType firstKey = (static_cast<DgmOctree::OctreeCellCodeType>(row) << params.level) + static_cast<DgmOctree::OctreeCellCodeType>(firstCol);
+	const DgmOctree::OctreeCellCodeType lastKey = (static_cast<DgmOctree::OctreeCellCodeType>(row) << params.level) + static_cast<DgmOctree::OctreeCellCodeType>(lastCol);
+
+	//the cells are visited in ascending key order, so the cursor only moves forward
+	while (cursor < end && (params.cells[cursor].theCode & sliceMask) < firstKey)
+		++cursor;
+
+	for (unsigned n=cursor; n<end && (params.cells[n].theCode & sliceMask) <= lastKey; ++n)
+		MergeCells(params.parents,cellIndex,n);
+}
+
+//! Merges the cells of a slice with their neighbors
+/** \param params shared parameters
+	\param begin first cell of the slice
+	\param end last cell of the slice (excluded)
+	\param prevBegin first cell of the preceding slice (if adjacent)
+	\param prevEnd last cell of the preceding slice (excluded - empty range if the preceding slice is not adjacent)
+	\param inSlice whether to look for the neighbors inside the slice as well
+**/
+static void MergeSliceCells(const ccLabellingParams& params,
+							unsigned begin,
+							unsigned end,
+							unsigned prevBegin,
+							unsigned prevEnd,
+							bool inSlice)
+{
+	const DgmOctree::OctreeCellCodeType sliceMask = (static_cast<DgmOctree::OctreeCellCodeType>(1) << (2*params.level)) - 1;
+	const DgmOctree::OctreeCellCodeType colMask = (static_cast<DgmOctree::OctreeCellCodeType>(1) << params.level) - 1;
+	const int maxCoord = (1 << params.level) - 1;
+
+	//neighbors columns and rows
+	//6-connexity: (i-1,j) and (i,j-1) in the same slice, (i,j) in the preceding one
+	//26-connexity: (i-1,j) and (i-1..i+1,j-1) in the same slice, (i-1..i+1,j-1..j+1) in the preceding one
+	const int colShift = (params.sixConnexity ? 0 : 1);
+	const int rowShift = (params.sixConnexity ? 0 : 1);
+
+	//cursors on the neighbors rows (j-1 in the current slice, j-1 to j+1 in the preceding one)
+	unsigned currentCursor = begin;
+	unsigned prevCursors[3] = { prevBegin, prevBegin, prevBegin };
+
+	for (unsigned c=begin; c<end; ++c)
+	{
+		const DgmOctree::OctreeCellCodeType key = (params.cells[c].theCode & sliceMask);
+		const int i = static_cast<int>(key & colMask);
+		const int j = static_cast<int>(key >> params.level);
+		const int firstCol = std::max(0,i-colShift);
+		const int lastCol = std::min(maxCoord,i+colShift);
+
+		if (inSlice)
+		{
+			//previous cell in the same row
+			if (i > 0 && c > begin && (params.cells[c-1].theCode & sliceMask) == key-1)
+				MergeCells(params.parents,c,c-1);
+
+			//previous row
+			if (j > 0)
+				MergeWithRowNeighbors(params,c,currentCursor,c,j-1,firstCol,lastCol);
+		}
+
+		//preceding slice
+		if (prevBegin < prevEnd)
+		{
+			for (int d=-rowShift; d<=rowShift; ++d)
+			{
+				int row = j+d;
+				if (row >= 0 && row <= maxCoord)
+					MergeWithRowNeighbors(params,c,prevCursors[d+1],prevEnd,row,firstCol,lastCol);
+			}
+		}
+	}
+}
+
+//! Connected components labelling job: a 'slab' of consecutive slices
+struct ccLabellingSlab
+{
+	//! Shared parameters
+	const ccLabellingParams* params;
+	//! Index of the first cell of each slice (+ total number of cells)
+	const std::vector<unsigned>* sliceStarts;
+	//! First slice
+	unsigned firstSlice;
+	//! Last slice (excluded)
+	unsigned lastSlice;
+	//! Progress notification (shared by all the slabs)
+	ParallelProgressRelay* progress;
+};
+
+//! Returns whether two consecutive slices are adjacent
+static inline bool AreSlicesAdjacent(const ccLabellingParams& params, const std::vector<unsigned>& sliceStarts, unsigned slice)
+{
+	assert(slice > 0);
+	uchar bitDec = 2*params.level;
+	return ((params.cells[sliceStarts[slice-1]].theCode >> bitDec) + 1 == (params.cells[sliceStarts[slice]].theCode >> bitDec));
+}
+
+//! Labels the cells of a slab (the cells of the other slabs are not touched)
+static void LabelSlab(ccLabellingSlab& slab)
+{
+	const ccLabellingParams& params = *slab.params;
+	const std::vector<unsigned>& sliceStarts = *slab.sliceStarts;
+
+	for (unsigned s=slab.firstSlice; s<slab.lastSlice; ++s)
+	{
+		bool withPreceding = (s > slab.firstSlice && AreSlicesAdjacent(params,sliceStarts,s));
+		MergeSliceCells(params,
+						sliceStarts[s],
+						sliceStarts[s+1],
+						withPreceding ? sliceStarts[s-1] : 0,
+						withPreceding ? sliceStarts[s] : 0,
+						true);
+
+		if (!slab.progress->steps(1))
+			return;
+	}
+}
+
+//! Connected components extraction job: a range of cells
+struct ccFlaggingChunk
+{
+	//! Octree
+	const DgmOctree* octree;
+	//! Input cell codes
+	const DgmOctree::cellCodesContainer* cellCodes;
+	//! Filled cells (sorted by grid key)
+	const DgmOctree::IndexAndCode* cells;
+	//! Component label of each cell
+	const unsigned* labels;
+	//! Level of subdivision
+	uchar level;
+	//! First cell
+	unsigned begin;
+	//! Last cell (excluded)
+	unsigned end;
+	//! Progress notification (shared by all the chunks)
+	ParallelProgressRelay* progress;
+};
+
+//! Flags the points of a range of cells with their component label
+static void FlagCellsPoints(ccFlaggingChunk& chunk)
+{
+	ReferenceCloud Y(chunk.octree->associatedCloud());
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+	{
+		const DgmOctree::IndexAndCode& cell = chunk.cells[i];
+		chunk.octree->getPointsInCell((*chunk.cellCodes)[cell.theIndex],chunk.level,&Y,false);
+		ScalarType d = static_cast<ScalarType>(chunk.labels[i]);
+		for (unsigned j=0; j<Y.size(); ++j)
+			Y.setPointScalarValue(j,d);
+
+		if (!chunk.progress->steps(1))
+			return;
+	}
+}
+
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+//! Min. number of cells for which the connected components labelling is multi-threaded
+static const unsigned MIN_CELLS_FOR_MT_LABELLING = (1<<14);
+
+#endif
+
 int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool sixConnexity, GenericProgressCallback* progressCb) const
 {
-    size_t numberOfCells = cellCodes.size();
+	size_t numberOfCells = cellCodes.size();
 	if (numberOfCells == 0) //no cells!
-        return -1;
+		return -1;
 
 	//filled octree cells
-	std::vector<IndexAndCode> ccCells;
+	cellsContainer ccCells;
+	std::vector<unsigned> parents;
+	std::vector<unsigned> sliceStarts;
 	try
 	{
 		ccCells.resize(numberOfCells);
+		parents.resize(numberOfCells);
 	}
 	catch (std::bad_alloc)
 	{
@@ -3096,18 +4092,16 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool
 		return -2;
 	}
 
-    //we compute the position of each cell (grid coordinates)
-    int indexMin[3],indexMax[3];
+	//we compute the position of each cell (grid coordinates)
+	int indexMin[3],indexMax[3];
 	{
 		//binary shift for cell code truncation
 		uchar bitDec = GET_BIT_SHIFT(level);
 
 		for (size_t i=0; i<numberOfCells; i++)
 		{
-			ccCells[i].theCode = (cellCodes[i] >> bitDec);
-
 			int pos[3];
-			getCellPos(ccCells[i].theCode,level,pos,true);
+			getCellPos(cellCodes[i] >> bitDec,level,pos,true);
 
 			//we look for the actual min and max dimensions of the input cells set
 			//(which may not be the whole set of octree cells!)
@@ -3128,372 +4122,198 @@ int DgmOctree::extractCCs(const cellCodesContainer& cellCodes, uchar level, bool
 				indexMin[2] = indexMax[2] = pos[2];
 			}
 
-			//Warning: the cells will have to be sorted inside a slice afterwards!
-			ccCells[i].theIndex = (	static_cast<unsigned>(pos[0])				)
-								+ (	static_cast<unsigned>(pos[1]) << level		)
-								+ (	static_cast<unsigned>(pos[2]) << (2*level)	);
+			//the cells are sorted by 'grid key' (slice by slice, then row by row)
+			//and we keep track of their original index
+			ccCells[i].theIndex = static_cast<unsigned>(i);
+			ccCells[i].theCode = (	static_cast<OctreeCellCodeType>(pos[0])					)
+								+ (	static_cast<OctreeCellCodeType>(pos[1]) << level		)
+								+ (	static_cast<OctreeCellCodeType>(pos[2]) << (2*level)	);
+			parents[i] = static_cast<unsigned>(i);
 		}
 	}
 
-    //we deduce the size of the grid that totally include input cells
-    int gridSize[3];
+	//we sort the cells
+	unsigned chunkCount = 1;
+#ifdef ENABLE_MT_OCTREE
+	if (numberOfCells >= MIN_CELLS_FOR_MT_LABELLING)
+		chunkCount = 4*static_cast<unsigned>(std::max(1,QThreadPool::globalInstance()->maxThreadCount())); //a few more chunks than threads to balance the load
+	if (chunkCount == 1 || !RadixSortCellCodes_MT(ccCells,chunkCount))
+#endif
 	{
-		for (unsigned char k=0; k<3; k++)
-		{
-			gridSize[k] = indexMax[k] - indexMin[k] + 1;
-		}
+		std::sort(ccCells.begin(),ccCells.end(),IndexAndCode::codeComp); //ascending key order
 	}
 
-    //we sort the cells
-    std::sort(ccCells.begin(),ccCells.end(),IndexAndCode::indexComp); //ascending index code order
-
-    const int& di = gridSize[0];
-    const int& dj = gridSize[1];
-    const int& step = gridSize[2];
-
-    //instrumentation pour la recherche des 4 ou 8 voisins en 2D (donc en 3D --> 6 ou 26 voisins)
-    uchar neighborsInCurrentSlice=0, neighborsInPrecedingSlice=0;
-    int currentSliceNeighborsShifts[4], precedingSliceNeighborsShifts[9]; //maximum size to simplify code...
-
-	if (sixConnexity) //6-connexity
-    {
-        neighborsInCurrentSlice = 2;
-        currentSliceNeighborsShifts[0] = -(di+2);
-        currentSliceNeighborsShifts[1] = -1;
-
-        neighborsInPrecedingSlice = 1;
-        precedingSliceNeighborsShifts[0] = 0;
-    }
-    else //26-connexity
-    {
-        neighborsInCurrentSlice = 4;
-        currentSliceNeighborsShifts[0] = -1-(di+2);
-        currentSliceNeighborsShifts[1] = -(di+2);
-        currentSliceNeighborsShifts[2] = 1-(di+2);
-        currentSliceNeighborsShifts[3] = -1;
-
-        neighborsInPrecedingSlice = 9;
-        precedingSliceNeighborsShifts[0] = -1-(di+2);
-        precedingSliceNeighborsShifts[1] = -(di+2);
-        precedingSliceNeighborsShifts[2] = 1-(di+2);
-        precedingSliceNeighborsShifts[3] = -1;
-        precedingSliceNeighborsShifts[4] = 0;
-        precedingSliceNeighborsShifts[5] = 1;
-        precedingSliceNeighborsShifts[6] = -1+(di+2);
-        precedingSliceNeighborsShifts[7] = (di+2);
-        precedingSliceNeighborsShifts[8] = 1+(di+2);
-    }
-
-	//shared structures (to avoid repeated allocations)
-    std::vector<int> neighboursVal, neighboursMin;
+	//we look for the first cell of each (non empty) slice
 	try
 	{
-		neighboursVal.reserve(neighborsInCurrentSlice+neighborsInPrecedingSlice);
-		neighboursMin.reserve(neighborsInCurrentSlice+neighborsInPrecedingSlice);
+		uchar bitDec = 2*level;
+		sliceStarts.push_back(0);
+		for (size_t i=1; i<numberOfCells; i++)
+			if ((ccCells[i].theCode >> bitDec) != (ccCells[i-1].theCode >> bitDec))
+				sliceStarts.push_back(static_cast<unsigned>(i));
+		sliceStarts.push_back(static_cast<unsigned>(numberOfCells));
 	}
-	catch(std::bad_alloc)
+	catch (std::bad_alloc)
 	{
 		//not enough memory
 		return -2;
 	}
+	unsigned sliceCount = static_cast<unsigned>(sliceStarts.size()) - 1;
 
-    //temporary virtual 'slices'
-    int sliceSize = (di+2)*(dj+2); //add a margin to avoid "boundary effects"
-    int *slice = new int[sliceSize];
-    if (!slice) //Not enough memory
-        return -2;
-
-    int *oldSlice = new int[sliceSize];
-    if (!oldSlice) //Not enough memory
-    {
-        delete[] slice;
-        return -2;
-    }
-
-    //equivalence table between 'on the fly' labels
-    int* equivalentLabels = new int[numberOfCells+2];
-    if (!equivalentLabels) //Not enough memory
-    {
-        delete[] slice;
-        delete[] oldSlice;
-        return -2;
-    }
-    memset(equivalentLabels,0,sizeof(int)*(numberOfCells+2));
-
-    //equivalence between a cell index and its label
-    int* cellIndexToLabel = new int[numberOfCells];
-    if (!cellIndexToLabel) //Not enough memory
-    {
-        delete[] slice;
-        delete[] oldSlice;
-        delete[] equivalentLabels;
-        return -2;
-    }
-    memset(cellIndexToLabel,0,sizeof(int)*numberOfCells);
-
-    //progress notification
-	NormalizedProgress* nprogress = 0;
-    if (progressCb)
-    {
-        progressCb->reset();
-		nprogress = new NormalizedProgress(progressCb,step);
-        progressCb->setMethodTitle("Components Labeling");
-        char buffer[256];
-		sprintf(buffer,"Box: [%i*%i*%i]",gridSize[0],gridSize[1],gridSize[2]);
-        progressCb->setInfo(buffer);
-        progressCb->start();
-    }
-
-    //previous slice is empty by default
-    memset(oldSlice,0,sizeof(int)*sliceSize);
-
-    //current label
-    size_t currentLabel = 1;
+	//we split the slices in 'slabs' of (approximately) the same number of cells
+	ccLabellingParams params;
+	params.cells = &(ccCells[0]);
+	params.parents = &(parents[0]);
+	params.level = level;
+	params.sixConnexity = sixConnexity;
 
-    //process each slice
+	std::vector<ccLabellingSlab> slabs;
 	{
-		unsigned counter = 0;
-		const unsigned gridCoordMask = (1 << level)-1;
-		std::vector<IndexAndCode>::const_iterator _ccCells = ccCells.begin();
-
-		for (int k = indexMin[2]; k < indexMin[2]+step; k++)
+		unsigned cellsPerSlab = static_cast<unsigned>((numberOfCells + chunkCount - 1) / chunkCount);
+		ccLabellingSlab slab;
+		slab.params = &params;
+		slab.sliceStarts = &sliceStarts;
+		slab.progress = 0;
+		slab.firstSlice = 0;
+		for (unsigned s=0; s<sliceCount; ++s)
 		{
-			//initialize the 'current' slice
-			memset(slice,0,sizeof(int)*sliceSize);
-
-			//for each cell of the slice
-			while (counter<numberOfCells && static_cast<int>(_ccCells->theIndex >> (level<<1)) == k)
+			if (sliceStarts[s+1] - sliceStarts[slab.firstSlice] >= cellsPerSlab || s+1 == sliceCount)
 			{
-				int iind = static_cast<int>(_ccCells->theIndex & gridCoordMask);
-				int jind = static_cast<int>((_ccCells->theIndex >> level) & gridCoordMask);
-				int cellIndex = (iind-indexMin[0]+1) + (jind-indexMin[1]+1)*(di+2);
-				++_ccCells;
-
-				//we look if the cell has neighbors inside the slice
-				int* _slice = slice + cellIndex;
-				{
-					for (uchar n=0; n<neighborsInCurrentSlice; n++)
-					{
-						assert(cellIndex+currentSliceNeighborsShifts[n]<sliceSize);
-						const int& neighborLabel = _slice[currentSliceNeighborsShifts[n]];
-						if (neighborLabel>1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
-
-				//and in the previous slice
-				int* _oldSlice = oldSlice + cellIndex;
-				{
-					for (uchar n=0; n<neighborsInPrecedingSlice; n++)
-					{
-						assert(cellIndex+precedingSliceNeighborsShifts[n]<sliceSize);
-						const int& neighborLabel = _oldSlice[precedingSliceNeighborsShifts[n]];
-						if (neighborLabel>1)
-							neighboursVal.push_back(neighborLabel);
-					}
-				}
-
-				//number of neighbors for current cell
-				uchar p = (uchar)neighboursVal.size();
-
-				if (p == 0) //no neighbor
-				{
-					*_slice = static_cast<int>(++currentLabel); //we create a new label
-				}
-				else if (p == 1) //1 neighbor
-				{
-					*_slice = neighboursVal.back(); //we'll use its label
-					neighboursVal.pop_back();
-				}
-				else //more than 1 neighbor?
-				{
-					//we get the smallest label
-					std::sort(neighboursVal.begin(),neighboursVal.end());
-					int smallestLabel = neighboursVal[0];
-
-					//if they are not the same
-					if (smallestLabel != neighboursVal.back())
-					{
-						int lastLabel = 0;
-						neighboursMin.clear();
-						//we get the smallest equivalent label for each neighbor's branch
-						{
-							for (uchar n=0; n<p; n++)
-							{
-								// ... we start from it's C.C. indec
-								int label = neighboursVal[n];
-								//if it's not the same as the previous neighbor's
-								if (label != lastLabel)
-								{
-									//we update the 'before' value
-									assert(label<static_cast<int>(numberOfCells)+2);
-									lastLabel = label;
-
-									//we look for its real equivalent value
-									while (equivalentLabels[label] > 1)
-									{
-										label = equivalentLabels[label];
-										assert(label<static_cast<int>(numberOfCells)+2);
-									}
-
-									neighboursMin.push_back(label);
-								}
-							}
-						}
-
-						//get the smallest one
-						std::sort(neighboursMin.begin(),neighboursMin.end());
-						smallestLabel = neighboursMin[0];
-
-						//update the equivalence table by the way
-						//for all other branches
-						lastLabel = smallestLabel;
-						{
-							for (uchar n=1; n<neighboursMin.size(); n++)
-							{
-								int label = neighboursMin[n];
-								assert(label<static_cast<int>(numberOfCells)+2);
-								//we don't process it if it's the same label as the precedent neighbor
-								if (label != lastLabel)
-								{
-									equivalentLabels[label] = smallestLabel;
-									lastLabel = label;
-								}
-							}
-						}
-					}
-
-					//update current cell label
-					*_slice = smallestLabel;
-					neighboursVal.clear();
-				}
-
-				cellIndexToLabel[counter++] = *_slice;
+				slab.lastSlice = s+1;
+				slabs.push_back(slab);
+				slab.firstSlice = s+1;
 			}
+		}
+	}
 
-			if (counter == numberOfCells)
-				break;
-
-			std::swap(slice,oldSlice);
+	//progress notification
+	NormalizedProgress* nprogress = 0;
+	if (progressCb)
+	{
+		progressCb->reset();
+		nprogress = new NormalizedProgress(progressCb,sliceCount);
+		progressCb->setMethodTitle("Components Labeling");
+		char buffer[256];
+		sprintf(buffer,"Box: [%i*%i*%i]",indexMax[0]-indexMin[0]+1,indexMax[1]-indexMin[1]+1,indexMax[2]-indexMin[2]+1);
+		progressCb->setInfo(buffer);
+		progressCb->start();
+	}
 
-			if (nprogress)
-				nprogress->oneStep();
-		}
+	//each slab is labelled independently
+	//(the calling thread relays the progress of all the slabs)
+	ParallelProgressRelay labellingProgress(nprogress);
+	for (size_t i=0; i<slabs.size(); ++i)
+		slabs[i].progress = &labellingProgress;
+#ifdef ENABLE_MT_OCTREE
+	if (slabs.size() > 1)
+	{
+		QtConcurrent::blockingMap(slabs, LabelSlab);
+	}
+	else
+#endif
+	{
+		for (size_t i=0; i<slabs.size(); ++i)
+			LabelSlab(slabs[i]);
 	}
+	labellingProgress.flush();
 
-    //release some memory
-    delete[] slice;
-    delete[] oldSlice;
+	//then we merge the components along the slabs borders
+	for (size_t i=1; i<slabs.size(); ++i)
+	{
+		unsigned s = slabs[i].firstSlice;
+		if (AreSlicesAdjacent(params,sliceStarts,s))
+			MergeSliceCells(params,sliceStarts[s],sliceStarts[s+1],sliceStarts[s-1],sliceStarts[s],false);
+	}
 
-    if (progressCb)
+	if (progressCb)
 	{
 		progressCb->stop();
-        if (nprogress)
+		if (nprogress)
 			delete nprogress;
 		nprogress = 0;
 	}
 
-    if (currentLabel<2) //No CC found !!!
-    {
-        delete[] cellIndexToLabel;
-        delete[] equivalentLabels;
-        return -3;
-    }
+	if (labellingProgress.isCanceled())
+		return -4;
 
-    //path compression (http://en.wikipedia.org/wiki/Union_find)
-    assert(currentLabel<numberOfCells+2);
-	{
-		for (size_t i=2; i<=currentLabel; i++)
-		{
-			int label = equivalentLabels[i];
-			assert(label<static_cast<int>(numberOfCells)+2);
-			while (equivalentLabels[label] > 1) //equivalentLabels[0] == 0 !!!
-			{
-				label = equivalentLabels[label];
-				assert(label<static_cast<int>(numberOfCells)+2);
-			}
-			equivalentLabels[i] = label;
-		}
-	}
+	//we can release some memory
+	sliceStarts.clear();
 
-    //update leafs
+	//path compression (the parent of a cell is always a preceding cell)
+	//and components numbering (labels start at '1')
+	unsigned numberOfComponents = 0;
 	{
 		for (size_t i=0; i<numberOfCells; i++)
 		{
-			int label = cellIndexToLabel[i];
-			assert(label<static_cast<int>(numberOfCells)+2);
-			if (equivalentLabels[label]>1)
-				cellIndexToLabel[i] = equivalentLabels[label];
+			assert(parents[i] <= i);
+			if (parents[i] == i)
+				parents[i] = ++numberOfComponents;
+			else
+				parents[i] = parents[parents[i]];
 		}
 	}
+	const std::vector<unsigned>& labels = parents;
 
-    //hack: we use "equivalentLabels" to count how many components will have to be created
-	int numberOfComponents = 0;
-	{
-		memset(equivalentLabels,0,(numberOfCells+2)*sizeof(int));
-
-		for (size_t i=0; i<numberOfCells; i++)
-		{
-			assert(cellIndexToLabel[i]>1 && cellIndexToLabel[i]<static_cast<int>(numberOfCells)+2);
-			equivalentLabels[cellIndexToLabel[i]]=1;
-		}
-
-		//we create (following) indexes for each components
-		for (size_t i=2; i<numberOfCells+2; i++)
-			if (equivalentLabels[i] == 1)
-				equivalentLabels[i]=++numberOfComponents; //labels start at '1'
-	}
-    assert(equivalentLabels[0] == 0);
-    assert(equivalentLabels[1] == 0);
+	if (numberOfComponents == 0) //No CC found !!!
+		return -3;
 
-    //we flag each component's points with its label
+	//we flag each component's points with its label
 	{
 		if (progressCb)
 		{
 			progressCb->reset();
 			nprogress = new NormalizedProgress(progressCb,static_cast<unsigned>(numberOfCells));
 			char buffer[256];
-			sprintf(buffer,"Components: %i",numberOfComponents);
+			sprintf(buffer,"Components: %u",numberOfComponents);
 			progressCb->setMethodTitle("Connected Components Extraction");
 			progressCb->setInfo(buffer);
 			progressCb->start();
 		}
+		ParallelProgressRelay flaggingProgress(nprogress);
 
-		ReferenceCloud Y(m_theAssociatedCloud);
-		for (size_t i=0; i<numberOfCells; i++)
+		std::vector<ccFlaggingChunk> chunks(chunkCount);
 		{
-			assert(cellIndexToLabel[i]<static_cast<int>(numberOfCells)+2);
-
-			const int& label = equivalentLabels[cellIndexToLabel[i]];
-			assert(label>0);
-			getPointsInCell(ccCells[i].theCode,level,&Y,true);
-			Y.placeIteratorAtBegining();
-			ScalarType d = static_cast<ScalarType>(label);
-			for (unsigned j=0; j<Y.size(); ++j)
+			const unsigned cellCount = static_cast<unsigned>(numberOfCells);
+			const unsigned chunkSize = (cellCount + chunkCount - 1) / chunkCount;
+			for (unsigned k=0; k<chunkCount; ++k)
 			{
-				Y.setCurrentPointScalarValue(d);
-				Y.forwardIterator();
+				ccFlaggingChunk& chunk = chunks[k];
+				chunk.octree = this;
+				chunk.cellCodes = &cellCodes;
+				chunk.cells = &(ccCells[0]);
+				chunk.labels = &(labels[0]);
+				chunk.level = level;
+				chunk.begin = std::min(cellCount,k*chunkSize);
+				chunk.end = std::min(cellCount,chunk.begin+chunkSize);
+				chunk.progress = &flaggingProgress;
 			}
+		}
 
-			if (nprogress)
-				nprogress->oneStep();
+#ifdef ENABLE_MT_OCTREE
+		if (chunkCount > 1)
+		{
+			QtConcurrent::blockingMap(chunks, FlagCellsPoints);
+		}
+		else
+#endif
+		{
+			FlagCellsPoints(chunks.front());
 		}
+		flaggingProgress.flush();
 
 		if (progressCb)
 		{
 			progressCb->stop();
 			if (nprogress)
 				delete nprogress;
-			nprogress=0;
+			nprogress = 0;
 		}
-	}
 
-	if (cellIndexToLabel)
-		delete[] cellIndexToLabel;
-	if (equivalentLabels)
-		delete[] equivalentLabels;
+		if (flaggingProgress.isCanceled())
+			return -4;
+	}
 
-    return 0;
+	return 0;
 }
 
 /*** Octree-based cloud traversal mechanism ***/
@@ -3504,6 +4324,7 @@ DgmOctree::octreeCell::octreeCell(DgmOctree* _parentOctree)
     , truncatedCode(0)
     , index(0)
     , points(0)
+    , scratch(0)
 {
     assert(parentOctree && parentOctree->m_theAssociatedCloud);
     points = new ReferenceCloud(parentOctree->m_theAssociatedCloud);
@@ -3534,6 +4355,10 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
 	cell.level=level;
     cell.index = 0;
 
+	//scratch buffers (reused from one cell to the next)
+	CellScratchBuffers scratch;
+	cell.scratch = &scratch;
+
 	//binary shift for cell code truncation
     uchar bitDec = GET_BIT_SHIFT(level);
 
@@ -3604,6 +4429,18 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel(uchar level,
 	if (result)
 		result = (*func)(cell,additionalParameters, nprogress);
 
+#ifdef COMPUTE_CELL_BUFFERS_STATISTICS
+	FILE* fpBuffers=fopen("octree_log.txt","at");
+	if (fpBuffers)
+	{
+		fprintf(fpBuffers,"Function: %s\n",functionTitle ? functionTitle : "unknown");
+		fprintf(fpBuffers,"Cells: %u\n",cellCount);
+		fprintf(fpBuffers,"Points buffer allocations: 1\n");
+		fprintf(fpBuffers,"Scratch buffers allocations: %u\n\n",scratch.growthCount);
+		fclose(fpBuffers);
+	}
+#endif
+
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 	FILE* fp=fopen("octree_log.txt","at");
 	if (fp)
@@ -3651,6 +4488,10 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 	cell.level = startingLevel;
 	cell.index = 0;
 
+	//scratch buffers (reused from one cell to the next)
+	CellScratchBuffers scratch;
+	cell.scratch = &scratch;
+
     //progress notification
 #ifndef ENABLE_DOWN_TOP_TRAVERSAL
 	NormalizedProgress* nprogress = 0;
@@ -3893,7 +4734,11 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel(uchar startingLeve
 #ifdef ENABLE_MT_OCTREE
 
 #include <QtCore>
-#include <QApplication>
+#include <QCoreApplication>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QElapsedTimer>
+#include <QThreadPool>
 #include <QtConcurrentMap>
 
 /*** MULTI THREADING WRAPPER ***/
@@ -3905,57 +4750,401 @@ struct octreeCellDesc
 	uchar level;
 };
 
-static DgmOctree* s_octree_MT = 0;
-static DgmOctree::octreeCellFunc s_func_MT = 0;
-static void** s_userParams_MT = 0;
-static GenericProgressCallback* s_progressCb_MT = 0;
-static NormalizedProgress* s_normProgressCb_MT = 0;
-static bool s_cellFunc_MT_success = true;
+//! Progress callback relay for worker threads
+/** Cell functions notify their progress from the worker threads. This relay
+	only records the progress value, so that the actual (client) callback is
+	only updated from the calling thread (see RunOctreeCellFunc_MT).
+**/
+class octreeCellsProgressRelay_MT : public GenericProgressCallback
+{
+public:
+
+	octreeCellsProgressRelay_MT()
+		: m_percent(0)
+		, m_cancelRequested(false)
+	{}
+
+	//inherited from GenericProgressCallback
+	virtual void reset() { m_percent = 0; }
+	virtual void update(float percent) { m_percent = percent; }
+	virtual void setMethodTitle(const char*) {}
+	virtual void setInfo(const char*) {}
+	virtual void start() {}
+	virtual void stop() {}
+	virtual bool isCancelRequested() { return m_cancelRequested; }
+
+	//! Returns the last notified progress value (in percent)
+	inline float percent() const { return m_percent; }
+	//! Forwards the client cancel request to the worker threads
+	inline void requestCancel() { m_cancelRequested = true; }
+
+protected:
+
+	volatile float m_percent;
+	volatile bool m_cancelRequested;
+};
 
-void LaunchOctreeCellFunc_MT(const octreeCellDesc& desc)
+//! Cells queue of a single worker (a range of cells)
+struct octreeCellsQueue_MT
 {
-	//skip cell if process is aborted/has failed
-	if (!s_cellFunc_MT_success)
-		return;
+	QMutex mutex;
+	//! First remaining cell
+	unsigned head;
+	//! Last remaining cell (excluded)
+	unsigned tail;
+
+	octreeCellsQueue_MT() : head(0), tail(0) {}
+};
+
+//! Octree cell function job
+/** All the parameters of a given call to executeFunctionForAllCellsAtLevel_MT
+	or executeFunctionForAllCellsAtStartingLevel_MT (so that several jobs can
+	run concurrently).
+**/
+struct octreeCellsJob_MT
+{
+	DgmOctree* octree;
+	DgmOctree::octreeCellFunc func;
+	void** userParams;
+	NormalizedProgress* normProgress;
+
+	//! Cells to process
+	const std::vector<octreeCellDesc>* cells;
+	//! Max cell population (to pre-allocate the per-thread buffers)
+	unsigned maxCellPopulation;
+	//! Cumulated cost of the cells (cost[i] = cost of cells [0;i[)
+	std::vector<unsigned long long> cost;
+	//! Per-worker queues
+	octreeCellsQueue_MT* queues;
+	unsigned queueCount;
+
+	//! Whether the process should go on (i.e. no error/cancel request)
+	volatile bool success;
+
+	//! Number of (re-)allocations of the per-thread points buffers
+	QAtomicInt pointsBuffersGrowth;
+	//! Number of (re-)allocations of the per-thread scratch buffers
+	QAtomicInt scratchBuffersGrowth;
+
+	//! Number of running workers
+	unsigned activeWorkers;
+	QMutex activeWorkersMutex;
+	QWaitCondition workersFinished;
+};
+
+//! Worker descriptor
+struct octreeCellsWorker_MT
+{
+	octreeCellsJob_MT* job;
+	unsigned index;
+};
+
+//! Takes a cell from the given queue (front)
+static bool PopCell_MT(octreeCellsQueue_MT& queue, unsigned& cellIndex)
+{
+	QMutexLocker locker(&queue.mutex);
+	if (queue.head >= queue.tail)
+		return false;
+	cellIndex = queue.head++;
+	return true;
+}
+
+//! Steals the cells of the most loaded worker
+/** The 'thief' takes the back of the victim's range, corresponding to
+	half of its remaining cost (cells population may vary by orders of
+	magnitude, so that splitting by cells count would be unbalanced).
+**/
+static bool StealCells_MT(octreeCellsJob_MT& job, unsigned thiefIndex)
+{
+	while (job.success)
+	{
+		//look for the most loaded victim
+		unsigned victimIndex = thiefIndex;
+		unsigned long long maxCost = 0;
+		for (unsigned k=0; k<job.queueCount; ++k)
+		{
+			if (k == thiefIndex)
+				continue;
+			octreeCellsQueue_MT& queue = job.queues[k];
+			queue.mutex.lock();
+			unsigned head = queue.head;
+			unsigned tail = queue.tail;
+			queue.mutex.unlock();
+			if (head < tail && job.cost[tail]-job.cost[head] > maxCost)
+			{
+				maxCost = job.cost[tail]-job.cost[head];
+				victimIndex = k;
+			}
+		}
+
+		//no more work
+		if (victimIndex == thiefIndex)
+			return false;
+
+		unsigned first = 0, last = 0;
+		{
+			octreeCellsQueue_MT& victim = job.queues[victimIndex];
+			QMutexLocker locker(&victim.mutex);
+			if (victim.head >= victim.tail)
+				continue; //the victim has already finished, let's try another one
+
+			if (victim.tail - victim.head == 1)
+			{
+				first = victim.head;
+			}
+			else
+			{
+				unsigned long long halfCost = job.cost[victim.head] + (job.cost[victim.tail]-job.cost[victim.head])/2;
+				first = static_cast<unsigned>(std::upper_bound(job.cost.begin()+victim.head, job.cost.begin()+victim.tail, halfCost) - job.cost.begin());
+				first = std::max(victim.head+1,std::min(first,victim.tail-1));
+			}
+			last = victim.tail;
+			victim.tail = first;
+		}
+
+		octreeCellsQueue_MT& queue = job.queues[thiefIndex];
+		QMutexLocker locker(&queue.mutex);
+		queue.head = first;
+		queue.tail = last;
+		return true;
+	}
 
-	const DgmOctree::cellsContainer& pointsAndCodes = s_octree_MT->pointsAndTheirCellCodes();
+	return false;
+}
+
+static void ProcessOctreeCell_MT(octreeCellsJob_MT& job, DgmOctree::octreeCell& cell, const octreeCellDesc& desc)
+{
+	const DgmOctree::cellsContainer& pointsAndCodes = job.octree->pointsAndTheirCellCodes();
 
-    //cell descriptor
-    DgmOctree::octreeCell cell(s_octree_MT);
+    //cell descriptor (the points buffer is only re-allocated if it's too small)
 	cell.level = desc.level;
 	cell.index = desc.i1;
 	cell.truncatedCode = desc.truncatedCode;
+	cell.points->clear(false);
+	unsigned capacity = cell.points->capacity();
 	if (cell.points->reserve(desc.i2-desc.i1+1))
 	{
+		if (cell.points->capacity() != capacity)
+			job.pointsBuffersGrowth.fetchAndAddRelaxed(1);
+
 		for (unsigned i=desc.i1; i<=desc.i2; ++i)
 			cell.points->addPointIndex(pointsAndCodes[i].theIndex);
 
-		s_cellFunc_MT_success &= (*s_func_MT)(cell,s_userParams_MT,s_normProgressCb_MT);
+		if (!(*job.func)(cell,job.userParams,job.normProgress))
+			job.success = false;
 	}
 	else
 	{
-		s_cellFunc_MT_success = false;
+		job.success = false;
+	}
+}
+
+//! Progress notification (from the calling thread only)
+struct octreeCellsProgressNotifier_MT
+{
+	octreeCellsJob_MT* job;
+	GenericProgressCallback* progressCb;
+	octreeCellsProgressRelay_MT* relay;
+	bool cancelNotified;
+
+	//! Updates the client callback and forwards its cancel request to the workers
+	void notify()
+	{
+		if (progressCb)
+		{
+			progressCb->update(relay->percent());
+			if (!relay->isCancelRequested() && progressCb->isCancelRequested())
+				relay->requestCancel();
+		}
+
+		if (!job->success && !cancelNotified)
+		{
+			//display a message to make clear that the cancel order has been understood!
+			if (progressCb)
+				progressCb->setInfo("Cancelling...");
+			cancelNotified = true;
+		}
+
+		QCoreApplication::processEvents(); //let the application breath!
+	}
+};
+
+//! Processes the cells of a worker (then helps the other workers)
+/** \param worker worker descriptor
+	\param notifier progress notifier (only for the calling thread, 0 otherwise)
+**/
+static void ProcessWorkerCells_MT(octreeCellsWorker_MT& worker, octreeCellsProgressNotifier_MT* notifier)
+{
+	octreeCellsJob_MT& job = *worker.job;
+	octreeCellsQueue_MT& queue = job.queues[worker.index];
+
+	//per-thread cell descriptor and buffers (reused from one cell to the next)
+	DgmOctree::octreeCell cell(job.octree);
+	DgmOctree::CellScratchBuffers scratch;
+	cell.scratch = &scratch;
+	if (cell.points->reserve(job.maxCellPopulation))
+		job.pointsBuffersGrowth.fetchAndAddRelaxed(1);
+
+	//process our own cells first, then help the others
+	//(skip cells if process is aborted/has failed)
+	unsigned cellIndex = 0;
+	QElapsedTimer timer;
+	timer.start();
+	while (job.success)
+	{
+		if (!PopCell_MT(queue,cellIndex) && !(StealCells_MT(job,worker.index) && PopCell_MT(queue,cellIndex)))
+			break;
+		ProcessOctreeCell_MT(job,cell,(*job.cells)[cellIndex]);
+
+		if (notifier && timer.elapsed() >= 100)
+		{
+			notifier->notify();
+			timer.restart();
+		}
+	}
+
+	job.scratchBuffersGrowth.fetchAndAddRelaxed(static_cast<int>(scratch.growthCount));
+}
+
+void LaunchOctreeCellFunc_MT(octreeCellsWorker_MT& worker)
+{
+	ProcessWorkerCells_MT(worker,0);
+
+	octreeCellsJob_MT& job = *worker.job;
+	QMutexLocker locker(&job.activeWorkersMutex);
+	--job.activeWorkers;
+	job.workersFinished.wakeAll();
+}
+
+//! Applies a cell function to a set of cells (multi-threaded)
+/** Reentrant: all the parameters are stored in a local job structure.
+	The client progress callback is only updated from the calling thread.
+	\param octree octree
+	\param cells cells to process
+	\param func cell function
+	\param userParams cell function parameters
+	\param progressCb client progress callback (optional)
+	\param progressSteps total number of progress steps (see NormalizedProgress)
+	\param maxCellPopulation max cell population
+	\param functionTitle function title (for statistics only)
+	\return success
+**/
+static bool RunOctreeCellFunc_MT(	DgmOctree* octree,
+									const std::vector<octreeCellDesc>& cells,
+									DgmOctree::octreeCellFunc func,
+									void** userParams,
+									GenericProgressCallback* progressCb,
+									unsigned progressSteps,
+									unsigned maxCellPopulation,
+									const char* functionTitle)
+{
+	const unsigned cellCount = static_cast<unsigned>(cells.size());
+	const unsigned workerCount = std::max(1u,std::min(cellCount,static_cast<unsigned>(std::max(1,QThreadPool::globalInstance()->maxThreadCount()))));
+
+	octreeCellsJob_MT job;
+	std::vector<octreeCellsWorker_MT> workers; //the first worker is the calling thread
+	try
+	{
+		job.cost.resize(cellCount+1);
+		workers.resize(workerCount);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	//the cost of a cell is (roughly) proportional to its population
+	job.cost[0] = 0;
+	for (unsigned i=0; i<cellCount; ++i)
+		job.cost[i+1] = job.cost[i] + static_cast<unsigned long long>(cells[i].i2-cells[i].i1+1);
+
+	octreeCellsProgressRelay_MT progressRelay;
+
+	job.octree = octree;
+	job.func = func;
+	job.userParams = userParams;
+	job.normProgress = (progressCb ? new NormalizedProgress(&progressRelay,progressSteps) : 0);
+	job.cells = &cells;
+	job.maxCellPopulation = maxCellPopulation;
+	job.queues = new octreeCellsQueue_MT[workerCount];
+	job.queueCount = workerCount;
+	job.success = true;
+	job.pointsBuffersGrowth = 0;
+	job.scratchBuffersGrowth = 0;
+	job.activeWorkers = workerCount-1; //the calling thread is not counted
+
+	//initial distribution: contiguous ranges of (roughly) equal costs
+	{
+		unsigned first = 0;
+		for (unsigned k=0; k<workerCount; ++k)
+		{
+			unsigned long long targetCost = (job.cost[cellCount] * (k+1)) / workerCount;
+			unsigned last = (k+1 == workerCount ? cellCount : static_cast<unsigned>(std::upper_bound(job.cost.begin()+first, job.cost.end(), targetCost) - job.cost.begin()) - 1);
+			last = std::max(first,std::min(last,cellCount));
+			job.queues[k].head = first;
+			job.queues[k].tail = last;
+			first = last;
+
+			workers[k].job = &job;
+			workers[k].index = k;
+		}
 	}
 
-	if (!s_cellFunc_MT_success)
+	//the other workers are run by the thread pool
+	QFuture<void> future = QtConcurrent::map(workers.begin()+1, workers.end(), LaunchOctreeCellFunc_MT);
+
+	//the calling thread processes cells as well (and handles the progress notifications)
+	octreeCellsProgressNotifier_MT notifier;
+	notifier.job = &job;
+	notifier.progressCb = progressCb;
+	notifier.relay = &progressRelay;
+	notifier.cancelNotified = false;
+	ProcessWorkerCells_MT(workers[0],&notifier);
+
+	//then it waits for the other workers. If the calling thread belongs to the pool
+	//(nested call), it gives its place back while waiting: otherwise the queued
+	//workers may never start if the pool is saturated
+	QThreadPool::globalInstance()->releaseThread();
 	{
-		//TODO: display a message to make clear that the cancel order has been understood!
-		if (s_progressCb_MT)
+		job.activeWorkersMutex.lock();
+		while (job.activeWorkers != 0)
 		{
-			s_progressCb_MT->setInfo("Cancelling...");
-			QApplication::processEvents();
+			job.workersFinished.wait(&job.activeWorkersMutex,100);
+			job.activeWorkersMutex.unlock();
+
+			notifier.notify();
+
+			job.activeWorkersMutex.lock();
 		}
+		job.activeWorkersMutex.unlock();
+	}
+
+	future.waitForFinished();
+	QThreadPool::globalInstance()->reserveThread();
+
+#ifdef COMPUTE_CELL_BUFFERS_STATISTICS
+	FILE* fp=fopen("octree_log.txt","at");
+	if (fp)
+	{
+		fprintf(fp,"Function: %s\n",functionTitle ? functionTitle : "unknown");
+		fprintf(fp,"Cells: %u (threads: %u)\n",cellCount,workerCount);
+		fprintf(fp,"Points buffers allocations: %i\n",job.pointsBuffersGrowth.fetchAndAddRelaxed(0));
+		fprintf(fp,"Scratch buffers allocations: %i\n\n",job.scratchBuffersGrowth.fetchAndAddRelaxed(0));
+		fclose(fp);
+	}
+#else
+	(void)functionTitle; //only used for statistics
+#endif
 
-	//if (s_normProgressCb_MT)
-	//{
-	//	//QApplication::processEvents(); //let the application breath!
-	//	if (!s_normProgressCb_MT->oneStep())
-	//	{
-	//		s_cellFunc_MT_success = false;
-	//		return;
-	//	}
-	//}
+	delete[] job.queues;
+	job.queues = 0;
+	if (job.normProgress)
+	{
+		delete job.normProgress;
+		job.normProgress = 0;
 	}
+
+	return job.success;
 }
 
 unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
@@ -3969,7 +5158,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
 
 	const unsigned cellsNumber = getCellNumber(level);
 
-	//cells that will be processed by QtConcurrent::map
+	//cells that will be processed by the worker threads
 	std::vector<octreeCellDesc> cells;
 	cells.reserve(cellsNumber);
 	if (cells.capacity() < cellsNumber) //not enough memory
@@ -4007,18 +5196,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
     //don't forget the last cell!
 	cells.push_back(cellDesc);
 
-	//static wrap
-	s_octree_MT = this;
-	s_func_MT = func;
-	s_userParams_MT = additionalParameters;
-	s_cellFunc_MT_success = true;
-	s_progressCb_MT = progressCb;
-	if (s_normProgressCb_MT)
-	{
-		delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
-	}
-
     //progress notification
     if (progressCb)
     {
@@ -4028,7 +5205,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
         char buffer[512];
 		sprintf(buffer,"Octree level %i\nCells: %i\nMean population: %3.2f (+/-%3.2f)\nMax population: %d",level,static_cast<int>(cells.size()),m_averageCellPopulation[level],m_stdDevCellPopulation[level],m_maxCellPopulation[level]);
         progressCb->setInfo(buffer);
-		s_normProgressCb_MT = new NormalizedProgress(progressCb,m_theAssociatedCloud->size());
         progressCb->start();
     }
 
@@ -4039,7 +5215,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
 	s_binarySearchCount = 0.0;
 #endif
 
-	QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+	bool success = RunOctreeCellFunc_MT(this,cells,func,additionalParameters,progressCb,m_theAssociatedCloud->size(),m_maxCellPopulation[level],functionTitle);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 	FILE* fp=fopen("octree_log.txt","at");
@@ -4056,21 +5232,11 @@ unsigned DgmOctree::executeFunctionForAllCellsAtLevel_MT(uchar level,
 	}
 #endif
 
-	s_octree_MT = 0;
-	s_func_MT = 0;
-	s_userParams_MT = 0;
-
 	if (progressCb)
-	{
         progressCb->stop();
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = 0;
-		s_progressCb_MT = 0;
-	}
 
 	//if something went wrong, we clear everything and return 0!
-	if (!s_cellFunc_MT_success)
+	if (!success)
 		cells.clear();
 
     return static_cast<unsigned>(cells.size());
@@ -4090,7 +5256,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 
 	const unsigned cellsNumber = getCellNumber(startingLevel);
 
-	//cells that will be processed by QtConcurrent::map
+	//cells that will be processed by the worker threads
 	std::vector<octreeCellDesc> cells;
 	cells.reserve(cellsNumber); //at least!
 	if (cells.capacity() < cellsNumber) //not enough memory?
@@ -4280,15 +5446,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	double mean = static_cast<double>(popSum)/static_cast<double>(cells.size());
 	double stddev = sqrt(static_cast<double>(popSum2-popSum*popSum))/static_cast<double>(cells.size());
 
-	//static wrap
-	s_octree_MT = this;
-	s_func_MT = func;
-	s_userParams_MT = additionalParameters;
-	s_cellFunc_MT_success = true;
-	if (s_normProgressCb_MT)
-		delete s_normProgressCb_MT;
-	s_normProgressCb_MT = 0;
-
     //progress notification
     if (progressCb)
     {
@@ -4298,9 +5455,6 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
         char buffer[1024];
 		sprintf(buffer,"Octree levels %i - %i\nCells: %i\nMean population: %3.2f (+/-%3.2f)\nMax population: %llu",startingLevel,MAX_OCTREE_LEVEL,static_cast<int>(cells.size()),mean,stddev,maxPop);
         progressCb->setInfo(buffer);
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT = new NormalizedProgress(progressCb,static_cast<unsigned>(cells.size()));
         progressCb->start();
     }
 
@@ -4311,7 +5465,7 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	s_binarySearchCount = 0.0;
 #endif
 
-	QtConcurrent::blockingMap(cells, LaunchOctreeCellFunc_MT);
+	bool success = RunOctreeCellFunc_MT(this,cells,func,additionalParameters,progressCb,static_cast<unsigned>(cells.size()),static_cast<unsigned>(maxPop),functionTitle);
 
 #ifdef COMPUTE_NN_SEARCH_STATISTICS
 	FILE* fp=fopen("octree_log.txt","at");
@@ -4328,20 +5482,11 @@ unsigned DgmOctree::executeFunctionForAllCellsAtStartingLevel_MT(uchar startingL
 	}
 #endif
 
-	s_octree_MT = 0;
-	s_func_MT = 0;
-	s_userParams_MT = 0;
-
 	if (progressCb)
-	{
         progressCb->stop();
-		if (s_normProgressCb_MT)
-			delete s_normProgressCb_MT;
-		s_normProgressCb_MT=0;
-	}
 
 	//if something went wrong, we clear everything and return 0!
-	if (!s_cellFunc_MT_success)
+	if (!success)
 		cells.clear();
 
     return static_cast<unsigned>(cells.size());
@@ -34,11 +34,14 @@
 #include "LocalModel.h"
 #include "SimpleTriangle.h"
 #include "ScalarField.h"
+#include "SimpleCloud.h"
 
 //system
 #include <assert.h>
 #include <string.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
 #include <limits>
 
 using namespace CCLib;
@@ -234,6 +237,408 @@ int DistanceComputationTools::computeHausdorffDistance(GenericIndexedCloudPersis
 	return result;
 }
 
+//! Max number of (compared and reference) points per batch of tiles, relatively to the max number of points per tile
+/** See DistanceComputationTools::computeTiledHausdorffDistance.
+**/
+static const unsigned TILED_DISTANCE_BATCH_TILES = 16;
+
+//! Regular spatial tiling of a bounding-box (see DistanceComputationTools::computeTiledHausdorffDistance)
+struct TilingGrid
+{
+	//! Grid origin
+	CCVector3 origin;
+	//! Tile size (along each dimension)
+	double tileSize[3];
+	//! Number of tiles (along each dimension)
+	int tileCount[3];
+
+	//! Initializes the grid so that it contains (approximately) a given number of tiles
+	void init(const CCVector3& bbMin, const CCVector3& bbMax, unsigned desiredTileCount)
+	{
+		origin = bbMin;
+
+		//we use (roughly) cubical tiles, only along the non-flat dimensions
+		double volume = 1.0;
+		unsigned activeDims = 0;
+		for (unsigned char k=0; k<3; ++k)
+		{
+			double extent = static_cast<double>(bbMax.u[k]) - static_cast<double>(bbMin.u[k]);
+			if (extent > 0)
+			{
+				volume *= extent;
+				++activeDims;
+			}
+		}
+		double edge = (activeDims != 0 ? pow(volume/std::max<unsigned>(desiredTileCount,1),1.0/activeDims) : 0);
+
+		for (unsigned char k=0; k<3; ++k)
+		{
+			double extent = static_cast<double>(bbMax.u[k]) - static_cast<double>(bbMin.u[k]);
+			if (extent > 0 && edge > 0)
+			{
+				tileCount[k] = static_cast<int>(std::min<double>(ceil(extent/edge),65536.0));
+				tileCount[k] = std::max(tileCount[k],1);
+				tileSize[k] = extent/tileCount[k];
+			}
+			else
+			{
+				tileCount[k] = 1;
+				tileSize[k] = 1.0; //whatever (all points will fall in the same tile)
+			}
+		}
+	}
+
+	//! Returns the index of the tile containing a given coordinate (along a given dimension)
+	inline int tileIndex(PointCoordinateType coord, unsigned char dim) const
+	{
+		double t = floor((static_cast<double>(coord) - origin.u[dim]) / tileSize[dim]);
+		if (t < 0)
+			return 0;
+		if (t >= tileCount[dim])
+			return tileCount[dim]-1;
+		return static_cast<int>(t);
+	}
+
+	//! Returns the range of tiles overlapped by the interval [coord-margin ; coord+margin] (along a given dimension)
+	/** \return false if the interval doesn't overlap the grid
+	**/
+	inline bool tileRange(PointCoordinateType coord, double margin, unsigned char dim, int& first, int& last) const
+	{
+		double rel = static_cast<double>(coord) - origin.u[dim];
+		double f = floor((rel - margin) / tileSize[dim]);
+		double l = floor((rel + margin) / tileSize[dim]);
+		if (l < 0 || f >= tileCount[dim])
+			return false;
+		first = (f < 0 ? 0 : static_cast<int>(f));
+		last = (l >= tileCount[dim] ? tileCount[dim]-1 : static_cast<int>(l));
+		return true;
+	}
+};
+
+//! Computes the distances for a single tile (see DistanceComputationTools::computeTiledHausdorffDistance)
+static int ComputeTileHausdorffDistance(GenericIndexedCloudPersist* comparedCloud,
+										GenericIndexedCloudPersist* referenceCloud,
+										const unsigned* comparedIndexes,
+										unsigned comparedCount,
+										const unsigned* referenceIndexes,
+										unsigned referenceCount,
+										const DistanceComputationTools::Cloud2CloudDistanceComputationParams& params,
+										FILE* fp)
+{
+	//we copy the compared points of this tile (with their own scalar field)
+	SimpleCloud tileCloud;
+	if (!tileCloud.reserve(comparedCount) || !tileCloud.enableScalarField())
+		return -2;
+	for (unsigned i=0; i<comparedCount; ++i)
+		tileCloud.addPoint(*comparedCloud->getPoint(comparedIndexes[i]));
+
+	if (referenceCount == 0)
+	{
+		//no reference point in range
+		ScalarType maxDist = static_cast<ScalarType>(sqrt(static_cast<double>(params.maxSearchDist)*static_cast<double>(params.maxSearchDist)));
+		for (unsigned i=0; i<comparedCount; ++i)
+			tileCloud.setPointScalarValue(i,referenceCloud->testVisibility(*tileCloud.getPoint(i)) == POINT_VISIBLE ? maxDist : NAN_VALUE);
+	}
+	else
+	{
+		ReferenceCloud referenceTile(referenceCloud);
+		if (!referenceTile.reserve(referenceCount))
+			return -2;
+		for (unsigned i=0; i<referenceCount; ++i)
+			referenceTile.addPointIndex(referenceIndexes[i]);
+
+		//the octree level (if automatic) is determined for each tile
+		DistanceComputationTools::Cloud2CloudDistanceComputationParams tileParams = params;
+		if (DistanceComputationTools::computeHausdorffDistance(&tileCloud,&referenceTile,tileParams) < 0)
+			return -5;
+	}
+
+	//eventually we write the distances back
+	for (unsigned i=0; i<comparedCount; ++i)
+	{
+		ScalarType dist = tileCloud.getPointScalarValue(i);
+		if (fp)
+		{
+			if (	fwrite(&comparedIndexes[i],sizeof(unsigned),1,fp) != 1
+				||	fwrite(&dist,sizeof(ScalarType),1,fp) != 1)
+				return -3;
+		}
+		else
+		{
+			comparedCloud->setPointScalarValue(comparedIndexes[i],dist);
+		}
+	}
+
+	return 0;
+}
+
+//! Returns the range of tiles associated to a point (see DistanceComputationTools::computeTiledHausdorffDistance)
+/** A point is associated to all the tiles overlapped by its neighbourhood of radius
+	'margin' (use 0 to associate it to its own tile only).
+	\return false if the point is not associated to any tile
+**/
+static inline bool GetPointTiles(const TilingGrid& grid, const CCVector3* P, double margin, int first[3], int last[3])
+{
+	if (margin > 0)
+	{
+		return (	grid.tileRange(P->x,margin,0,first[0],last[0])
+				&&	grid.tileRange(P->y,margin,1,first[1],last[1])
+				&&	grid.tileRange(P->z,margin,2,first[2],last[2]) );
+	}
+
+	for (unsigned char k=0; k<3; ++k)
+		first[k] = last[k] = grid.tileIndex(P->u[k],k);
+	return true;
+}
+
+//! Counts the points of a cloud per tile (see DistanceComputationTools::computeTiledHausdorffDistance)
+/** \param cloud cloud
+	\param grid tiling grid
+	\param margin neighbourhood radius (see GetPointTiles)
+	\param tilePopulations output: number of points associated to each tile
+	\return success
+**/
+static bool CountPointsPerTile(	GenericIndexedCloudPersist* cloud,
+								const TilingGrid& grid,
+								double margin,
+								std::vector<unsigned>& tilePopulations)
+{
+	size_t tileCount = static_cast<size_t>(grid.tileCount[0]) * static_cast<size_t>(grid.tileCount[1]) * static_cast<size_t>(grid.tileCount[2]);
+
+	try
+	{
+		tilePopulations.clear();
+		tilePopulations.resize(tileCount,0);
+	}
+	catch(.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	unsigned pointCount = cloud->size();
+	for (unsigned j=0; j<pointCount; ++j)
+	{
+		int first[3],last[3];
+		if (!GetPointTiles(grid,cloud->getPoint(j),margin,first,last))
+			continue;
+
+		for (int tz=first[2]; tz<=last[2]; ++tz)
+			for (int ty=first[1]; ty<=last[1]; ++ty)
+				for (int tx=first[0]; tx<=last[0]; ++tx)
+					++tilePopulations[static_cast<size_t>(tx) + static_cast<size_t>(grid.tileCount[0]) * (static_cast<size_t>(ty) + static_cast<size_t>(grid.tileCount[1]) * static_cast<size_t>(tz))];
+	}
+
+	return true;
+}
+
+//! Sorts the points of a cloud associated to a range of tiles (see DistanceComputationTools::computeTiledHausdorffDistance)
+/** The cloud is read once, and only the indexes of the points associated to the tiles
+	[firstTile ; lastTile[ are stored (so that the memory used is bounded by the number
+	of points of these tiles).
+	\param cloud cloud
+	\param grid tiling grid
+	\param margin neighbourhood radius (see GetPointTiles)
+	\param tilePopulations number of points associated to each tile (see CountPointsPerTile)
+	\param firstTile first tile of the range
+	\param lastTile last tile of the range (excluded)
+	\param tileOffsets output: index of the first entry of each tile of the range in 'indexes' (plus one last entry for the end)
+	\param indexes output: point indexes sorted by tile
+	\return success
+**/
+static bool SortPointsByTile(	GenericIndexedCloudPersist* cloud,
+								const TilingGrid& grid,
+								double margin,
+								const std::vector<unsigned>& tilePopulations,
+								size_t firstTile,
+								size_t lastTile,
+								std::vector<size_t>& tileOffsets,
+								std::vector<unsigned>& indexes)
+{
+	assert(firstTile < lastTile && lastTile <= tilePopulations.size());
+	size_t rangeSize = lastTile - firstTile;
+
+	try
+	{
+		tileOffsets.resize(rangeSize+1);
+		tileOffsets[0] = 0;
+		for (size_t t=0; t<rangeSize; ++t)
+			tileOffsets[t+1] = tileOffsets[t] + tilePopulations[firstTile+t];
+		indexes.resize(tileOffsets[rangeSize]);
+	}
+	catch(.../*const std::bad_alloc&*/) //out of memory
+	{
+		tileOffsets.clear();
+		indexes.clear();
+		return false;
+	}
+
+	if (indexes.empty())
+		return true;
+
+	//the tiles of the range are consecutive: we can quickly skip the points outside of its 'z' slices
+	size_t sliceSize = static_cast<size_t>(grid.tileCount[0]) * static_cast<size_t>(grid.tileCount[1]);
+	int minTz = static_cast<int>(firstTile / sliceSize);
+	int maxTz = static_cast<int>((lastTile-1) / sliceSize);
+
+	//the offsets are shifted by one tile while filling the table
+	std::vector<size_t> fillOffsets(tileOffsets.begin(),tileOffsets.end()-1);
+
+	unsigned pointCount = cloud->size();
+	for (unsigned j=0; j<pointCount; ++j)
+	{
+		int first[3],last[3];
+		if (!GetPointTiles(grid,cloud->getPoint(j),margin,first,last) || last[2] < minTz || first[2] > maxTz)
+			continue;
+
+		for (int tz=first[2]; tz<=last[2]; ++tz)
+			for (int ty=first[1]; ty<=last[1]; ++ty)
+				for (int tx=first[0]; tx<=last[0]; ++tx)
+				{
+					size_t t = static_cast<size_t>(tx) + static_cast<size_t>(grid.tileCount[0]) * (static_cast<size_t>(ty) + static_cast<size_t>(grid.tileCount[1]) * static_cast<size_t>(tz));
+					if (t >= firstTile && t < lastTile)
+						indexes[fillOffsets[t-firstTile]++] = j;
+				}
+	}
+
+	return true;
+}
+
+int DistanceComputationTools::computeTiledHausdorffDistance(GenericIndexedCloudPersist* comparedCloud,
+															GenericIndexedCloudPersist* referenceCloud,
+															Cloud2CloudDistanceComputationParams& params,
+															unsigned maxPointsPerTile,
+															const char* outputFilename/*=0*/,
+															GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(comparedCloud && referenceCloud);
+
+	//the max search distance is mandatory (it defines the margin of the tiles)
+	if (params.maxSearchDist <= 0 || params.CPSet || maxPointsPerTile == 0)
+		return -1;
+
+	unsigned comparedCount = comparedCloud->size();
+	unsigned referenceCount = referenceCloud->size();
+	if (comparedCount == 0 || referenceCount == 0)
+		return -1;
+
+	//where to store the distances
+	if (!outputFilename && !comparedCloud->enableScalarField())
+		return -2;
+
+	//tiling of the compared cloud bounding-box
+	TilingGrid grid;
+	{
+		CCVector3 bbMin,bbMax;
+		comparedCloud->getBoundingBox(bbMin.u,bbMax.u);
+		unsigned tileCount = static_cast<unsigned>((static_cast<unsigned long long>(comparedCount) + maxPointsPerTile - 1) / maxPointsPerTile);
+		grid.init(bbMin,bbMax,tileCount);
+	}
+
+	//the points are only counted per tile (once and for all)
+	std::vector<unsigned> comparedPopulations,referencePopulations;
+	if (	!CountPointsPerTile(comparedCloud,grid,0,comparedPopulations)
+		||	!CountPointsPerTile(referenceCloud,grid,static_cast<double>(params.maxSearchDist),referencePopulations))
+		return -2;
+
+	FILE* fp = 0;
+	if (outputFilename)
+	{
+		fp = fopen(outputFilename,"wb");
+		if (!fp)
+			return -3;
+	}
+
+	//Progress callback
+	NormalizedProgress* nProgress = 0;
+	if (progressCb)
+	{
+		nProgress = new NormalizedProgress(progressCb,comparedCount);
+		char buffer[256];
+		sprintf(buffer,"Tiles=%i x %i x %i",grid.tileCount[0],grid.tileCount[1],grid.tileCount[2]);
+		progressCb->reset();
+		progressCb->setInfo(buffer);
+		progressCb->setMethodTitle("Cloud-Cloud Distance [tiled]");
+		progressCb->start();
+	}
+
+	//then the tiles are processed by batches of consecutive tiles: the point indexes of
+	//a batch are sorted by tile with one pass over each cloud. The memory used for the
+	//indexes is bounded by the batch size (the bigger the batches, the fewer passes).
+	const size_t maxBatchSize = static_cast<size_t>(maxPointsPerTile) * TILED_DISTANCE_BATCH_TILES;
+
+	int result = 0;
+	size_t tileCount = comparedPopulations.size();
+	std::vector<size_t> comparedOffsets,referenceOffsets;
+	std::vector<unsigned> comparedIndexes,referenceIndexes;
+	for (size_t batchStart=0; batchStart<tileCount && result >= 0; )
+	{
+		//a batch has at least one tile
+		size_t batchEnd = batchStart+1;
+		size_t batchSize = static_cast<size_t>(comparedPopulations[batchStart]) + referencePopulations[batchStart];
+		size_t batchComparedCount = comparedPopulations[batchStart];
+		while (batchEnd < tileCount)
+		{
+			size_t tileSize = static_cast<size_t>(comparedPopulations[batchEnd]) + referencePopulations[batchEnd];
+			if (batchSize + tileSize > maxBatchSize)
+				break;
+			batchSize += tileSize;
+			batchComparedCount += comparedPopulations[batchEnd];
+			++batchEnd;
+		}
+
+		//nothing to compute in this batch
+		if (batchComparedCount == 0)
+		{
+			batchStart = batchEnd;
+			continue;
+		}
+
+		if (	!SortPointsByTile(comparedCloud,grid,0,comparedPopulations,batchStart,batchEnd,comparedOffsets,comparedIndexes)
+			||	!SortPointsByTile(referenceCloud,grid,static_cast<double>(params.maxSearchDist),referencePopulations,batchStart,batchEnd,referenceOffsets,referenceIndexes))
+		{
+			result = -2;
+			break;
+		}
+
+		for (size_t t=0; t<batchEnd-batchStart; ++t)
+		{
+			unsigned count = static_cast<unsigned>(comparedOffsets[t+1]-comparedOffsets[t]);
+			if (count == 0)
+				continue;
+
+			result = ComputeTileHausdorffDistance(	comparedCloud,
+													referenceCloud,
+													&comparedIndexes[comparedOffsets[t]],
+													count,
+													referenceIndexes.empty() ? 0 : &referenceIndexes[0] + referenceOffsets[t],
+													static_cast<unsigned>(referenceOffsets[t+1]-referenceOffsets[t]),
+													params,
+													fp);
+			if (result < 0)
+				break;
+
+			if (nProgress && !nProgress->steps(count))
+			{
+				//process cancelled by the user
+				result = -4;
+				break;
+			}
+		}
+
+		batchStart = batchEnd;
+	}
+
+	if (fp)
+		fclose(fp);
+
+	if (progressCb)
+		progressCb->stop();
+	if (nProgress)
+		delete nProgress;
+
+	return result;
+}
+
 bool DistanceComputationTools::synchronizeOctrees(GenericIndexedCloudPersist* comparedCloud, GenericIndexedCloudPersist* referenceCloud, DgmOctree* &comparedOctree, DgmOctree* &referenceOctree, GenericProgressCallback* progressCb)
 {
     assert(comparedCloud && referenceCloud);
@@ -322,6 +727,23 @@ bool DistanceComputationTools::synchronizeOctrees(GenericIndexedCloudPersist* co
 	return (comparedOctree->getNumberOfProjectedPoints() != 0 && referenceOctree->getNumberOfProjectedPoints() != 0);
 }
 
+//! Tests whether a whole cell of the compared octree is out of reach (i.e. farther than the max search distance) of the reference cloud
+/** If the test succeeds, 'findTheNearestNeighborStartingFromCell' would fail for every point of the cell.
+**/
+static bool IsCellOutOfSearchRange(const DgmOctree* referenceOctree, DgmOctree::NearestNeighboursSearchStruct& nNSS)
+{
+	if (nNSS.maxSearchSquareDistd < 0)
+		return false;
+
+	//the points of the cells beyond this (cell) distance are necessarily farther than the max search distance
+	double maxDist = sqrt(nNSS.maxSearchSquareDistd);
+	double neighbourhoodLength = floor(maxDist / static_cast<double>(referenceOctree->getCellSize(nNSS.level))) + 1.0;
+	if (neighbourhoodLength >= static_cast<double>(OCTREE_LENGTH(nNSS.level)))
+		return false;
+
+	return !referenceOctree->hasCellsInNeighbourhood(nNSS.cellPos,nNSS.level,static_cast<int>(neighbourhoodLength),nNSS.minimalCellsSetToVisit);
+}
+
 //Description of expected 'additionalParameters'
 // [0] -> (GenericIndexedCloudPersist*) reference cloud
 // [1] -> (Octree*): reference cloud octree
@@ -339,6 +761,7 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 
 	//structure for the nearest neighbor search
 	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
 	nNSS.level								= cell.level;
 	nNSS.alreadyVisitedNeighbourhoodSize	= 0;
 	nNSS.theNearestPointIndex				= 0;
@@ -349,8 +772,23 @@ bool DistanceComputationTools::computeCellHausdorffDistance(const DgmOctree::oct
 	//and we deduce its center
 	referenceOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 
-	//for each point of the current cell (compared octree) we look for its nearest neighbour in the reference cloud
 	unsigned pointCount = cell.points->size();
+
+	//early termination: if no reference point can be found in the search range of the whole cell,
+	//all its points get the max search distance (as 'findTheNearestNeighborStartingFromCell' would fail for each of them)
+	if (IsCellOutOfSearchRange(referenceOctree,nNSS))
+	{
+		ScalarType maxDist = (nNSS.maxSearchSquareDistd > 0 ? static_cast<ScalarType>(sqrt(nNSS.maxSearchSquareDistd)) : 0);
+		for (unsigned i=0; i<pointCount; i++)
+		{
+			cell.points->getPoint(i,nNSS.queryPoint);
+			cell.points->setPointScalarValue(i,referenceCloud->testVisibility(nNSS.queryPoint) == POINT_VISIBLE ? maxDist : NAN_VALUE);
+		}
+
+		return (!nProgress || nProgress->steps(pointCount));
+	}
+
+	//for each point of the current cell (compared octree) we look for its nearest neighbour in the reference cloud
 	for (unsigned i=0; i<pointCount; i++)
 	{
 		cell.points->getPoint(i,nNSS.queryPoint);
@@ -400,6 +838,7 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const
 
 	//structure for the nearest neighbor seach
 	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
 	nNSS.level								= cell.level;
 	nNSS.alreadyVisitedNeighbourhoodSize	= 0;
 	nNSS.theNearestPointIndex				= 0;
@@ -409,6 +848,21 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const
 	//and we deduce its center
 	referenceOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
 
+	unsigned pointCount = cell.points->size();
+
+	//early termination (see computeCellHausdorffDistance)
+	if (IsCellOutOfSearchRange(referenceOctree,nNSS))
+	{
+		ScalarType maxDist = (nNSS.maxSearchSquareDistd > 0 ? static_cast<ScalarType>(sqrt(nNSS.maxSearchSquareDistd)) : NAN_VALUE);
+		for (unsigned i=0; i<pointCount; ++i)
+		{
+			cell.points->getPoint(i,nNSS.queryPoint);
+			cell.points->setPointScalarValue(i,referenceCloud->testVisibility(nNSS.queryPoint) == POINT_VISIBLE ? maxDist : NAN_VALUE);
+		}
+
+		return (!nProgress || nProgress->steps(pointCount));
+	}
+
 	//structures for determining the nearest neighbours of the 'nearest neighbour' (to compute the local model)
 	//either inside a sphere or the k nearest
 	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS_Model;
@@ -432,7 +886,6 @@ bool DistanceComputationTools::computeCellHausdorffDistanceWithLocalModel(const
 	std::vector<const LocalModel*> models;
 
 	//for each point of the current cell (compared octree) we look its nearest neighbour in the reference cloud
-	unsigned pointCount=cell.points->size();
 	for (unsigned i=0; i<pointCount; ++i)
 	{
 		//distance of the current point
@@ -48,14 +48,9 @@ FastMarching::FastMarching()
 
 FastMarching::~FastMarching()
 {
+	//the cells themselves are owned by the derived classes
 	if (m_theGrid)
-	{
-		for (unsigned i=0; i<m_gridSize; ++i)
-			if (m_theGrid[i])
-				delete m_theGrid[i];
-
 		delete[] m_theGrid;
-	}
 }
 
 float FastMarching::getTime(int pos[], bool absoluteCoordinates) const
@@ -217,8 +212,84 @@ void FastMarching::initTrialCells()
 
 void FastMarching::addTrialCell(unsigned index)
 {
-	m_theGrid[index]->state = Cell::TRIAL_CELL;
+	Cell* aCell = m_theGrid[index];
+	aCell->state = Cell::TRIAL_CELL;
+	aCell->trialPos = static_cast<unsigned>(m_trialCells.size());
 	m_trialCells.push_back(index);
+
+	siftUpTrialCell(aCell->trialPos);
+}
+
+void FastMarching::decreaseTrialCellTime(unsigned index, float T)
+{
+	Cell* aCell = m_theGrid[index];
+	assert(aCell && aCell->state == Cell::TRIAL_CELL);
+	assert(T <= aCell->T);
+
+	aCell->T = T;
+	siftUpTrialCell(aCell->trialPos);
+}
+
+void FastMarching::siftUpTrialCell(unsigned pos)
+{
+	assert(pos < m_trialCells.size());
+
+	unsigned index = m_trialCells[pos];
+	Cell* aCell = m_theGrid[index];
+
+	while (pos != 0)
+	{
+		unsigned parentPos = (pos-1)/2;
+		unsigned parentIndex = m_trialCells[parentPos];
+		Cell* parentCell = m_theGrid[parentIndex];
+		if (parentCell->T <= aCell->T)
+			break;
+
+		//move the parent down
+		m_trialCells[pos] = parentIndex;
+		parentCell->trialPos = pos;
+		pos = parentPos;
+	}
+
+	m_trialCells[pos] = index;
+	aCell->trialPos = pos;
+}
+
+void FastMarching::siftDownTrialCell(unsigned pos)
+{
+	assert(pos < m_trialCells.size());
+
+	unsigned count = static_cast<unsigned>(m_trialCells.size());
+	unsigned index = m_trialCells[pos];
+	Cell* aCell = m_theGrid[index];
+
+	while (true)
+	{
+		//look for the 'earliest' child
+		unsigned childPos = 2*pos+1;
+		if (childPos >= count)
+			break;
+		Cell* childCell = m_theGrid[m_trialCells[childPos]];
+		if (childPos+1 < count)
+		{
+			Cell* rightCell = m_theGrid[m_trialCells[childPos+1]];
+			if (rightCell->T < childCell->T)
+			{
+				++childPos;
+				childCell = rightCell;
+			}
+		}
+		if (aCell->T <= childCell->T)
+			break;
+
+		//move the child up
+		m_trialCells[pos] = m_trialCells[childPos];
+		childCell->trialPos = pos;
+		pos = childPos;
+	}
+
+	m_trialCells[pos] = index;
+	aCell->trialPos = pos;
 }
 
 void FastMarching::addActiveCell(unsigned index)
@@ -238,30 +309,19 @@ unsigned FastMarching::getNearestTrialCell()
 	if (m_trialCells.empty())
 		return 0; //0 = error
 
-	//we look for the "TRIAL" cell with the minimum time (T)
-	size_t minTCellIndexPos = 0;
-	unsigned minTCellIndex = m_trialCells[minTCellIndexPos];
-	CCLib::FastMarching::Cell* minTCell = m_theGrid[minTCellIndex];
-	assert(minTCell != 0);
+	//the "TRIAL" cell with the minimum time (T) is the root of the heap
+	unsigned minTCellIndex = m_trialCells.front();
+	assert(m_theGrid[minTCellIndex] != 0);
 
-	for (size_t i=1; i<m_trialCells.size(); ++i)
+	//we remove this cell from the TRIAL set (the last cell replaces it)
+	unsigned lastCellIndex = m_trialCells.back();
+	m_trialCells.pop_back();
+	if (!m_trialCells.empty())
 	{
-		unsigned cellIndex = m_trialCells[i];
-		CCLib::FastMarching::Cell* cell = m_theGrid[cellIndex];
-		assert(cell != 0);
-		
-		if (cell->T < minTCell->T)
-		{
-			minTCellIndexPos = i;
-			minTCellIndex = cellIndex;
-			minTCell = cell;
-		}
+		m_trialCells.front() = lastCellIndex;
+		siftDownTrialCell(0);
 	}
 
-	//we remove this cell from the TRIAL set
-	m_trialCells[minTCellIndexPos] = m_trialCells.back();
-	m_trialCells.pop_back();
-
 	return minTCellIndex;
 }
 
@@ -51,6 +51,13 @@ int FastMarchingForPropagation::init(	GenericCloud* theCloud,
 	DgmOctree::cellCodesContainer cellCodes;
 	theOctree->getCellCodes(level,cellCodes,true);
 
+	//the cells are stored contiguously
+	if (!instantiateCellsTpl(m_cells,cellCodes.size()))
+	{
+		//not enough memory
+		return -1;
+	}
+
 	ReferenceCloud Yk(theOctree->associatedCloud());
 
 	while (!cellCodes.empty())
@@ -68,7 +75,7 @@ int FastMarchingForPropagation::init(	GenericCloud* theCloud,
 		//on renseigne la grille
 		unsigned gridPos = FM_pos2index(cellPos);
 
-		PropagationCell* aCell = new PropagationCell;
+		PropagationCell* aCell = &m_cells[cellCodes.size()-1];
 		aCell->cellCode = cellCodes.back();
 		aCell->f = (constantAcceleration ? 1.0f : static_cast<float>(ScalarFieldTools::computeMeanScalarValue(&Yk)));
 
@@ -138,7 +145,7 @@ int FastMarchingForPropagation::step()
 					float t_new = computeT(nIndex);
 
 					if (t_new < t_old)
-						nCell->T = t_new;
+						decreaseTrialCellTime(nIndex,t_new);
 				}
 			}
 		}
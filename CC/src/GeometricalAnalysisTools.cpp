@@ -27,9 +27,11 @@
 #include "DgmOctreeReferenceCloud.h"
 #include "ScalarField.h"
 #include "ScalarFieldTools.h"
+#include "SymMatrix.h"
 
 //system
 #include <assert.h>
+#include <algorithm>
 
 using namespace CCLib;
 
@@ -571,6 +573,322 @@ bool GeometricalAnalysisTools::computePointsRoughnessInACellAtLevel(const DgmOct
 	return true;
 }
 
+//! Geometric features computation parameters (see GeometricalAnalysisTools::computeGeomFeatures)
+struct GeomFeaturesParams
+{
+	//! Requested features
+	const std::vector<GeometricalAnalysisTools::GeomFeatureDesc>* features;
+	//! Distinct radii (by decreasing order)
+	std::vector<PointCoordinateType> radii;
+	//! Features associated to each radius (indexes in 'features')
+	std::vector< std::vector<size_t> > featuresPerRadius;
+};
+
+int GeometricalAnalysisTools::computeGeomFeatures(	GenericIndexedCloudPersist* theCloud,
+													const std::vector<GeomFeatureDesc>& features,
+													GenericProgressCallback* progressCb/*=0*/,
+													DgmOctree* inputOctree/*=0*/)
+{
+	if (!theCloud || features.empty())
+        return -1;
+
+	unsigned numberOfPoints = theCloud->size();
+	if (numberOfPoints < 3)
+        return -2;
+
+	//check the requested features and group them by radius
+	GeomFeaturesParams params;
+	params.features = &features;
+	try
+	{
+		for (size_t i=0; i<features.size(); ++i)
+		{
+			const GeomFeatureDesc& desc = features[i];
+			if (desc.radius <= 0)
+				return -1;
+			if (desc.feature == GF_NORMAL ? (!desc.normals || desc.normals->currentSize() < numberOfPoints) : (!desc.sf || desc.sf->currentSize() < numberOfPoints))
+				return -1;
+
+			size_t r = 0;
+			while (r < params.radii.size() && params.radii[r] != desc.radius)
+				++r;
+			if (r == params.radii.size())
+			{
+				params.radii.push_back(desc.radius);
+				params.featuresPerRadius.resize(r+1);
+			}
+			params.featuresPerRadius[r].push_back(i);
+		}
+	}
+	catch(std::bad_alloc)
+	{
+		//not enough memory
+		return -1;
+	}
+
+	//sort the radii by decreasing order (the neighbourhood is extracted for the largest one)
+	for (size_t i=0; i+1<params.radii.size(); ++i)
+	{
+		size_t maxIndex = i;
+		for (size_t j=i+1; j<params.radii.size(); ++j)
+			if (params.radii[j] > params.radii[maxIndex])
+				maxIndex = j;
+		if (maxIndex != i)
+		{
+			std::swap(params.radii[i],params.radii[maxIndex]);
+			params.featuresPerRadius[i].swap(params.featuresPerRadius[maxIndex]);
+		}
+	}
+
+	DgmOctree* theOctree = inputOctree;
+	if (!theOctree)
+	{
+		theOctree = new DgmOctree(theCloud);
+		if (theOctree->build(progressCb)<1)
+		{
+			delete theOctree;
+			return -3;
+		}
+	}
+
+	uchar level = theOctree->findBestLevelForAGivenNeighbourhoodSizeExtraction(params.radii.front());
+
+	//parameters
+	void* additionalParameters[1] = { static_cast<void*>(&params) };
+
+	int result = 0;
+
+#ifndef ENABLE_MT_OCTREE
+	if (theOctree->executeFunctionForAllCellsAtLevel(level,
+#else
+	if (theOctree->executeFunctionForAllCellsAtLevel_MT(level,
+#endif
+														&computeGeomFeaturesInACellAtLevel,
+														additionalParameters,
+														progressCb,
+														"Geometric Features Computation") == 0)
+	{
+		//something went wrong
+		result = -4;
+	}
+
+	if (!inputOctree)
+        delete theOctree;
+
+	return result;
+}
+
+//! Predicate: whether a neighbour lies inside a sphere (see computeGeomFeaturesInACellAtLevel)
+struct NeighbourInSphere
+{
+	//! Default constructor
+	NeighbourInSphere(double squareRadius) : m_squareRadius(squareRadius) {}
+
+	//! Test (based on the squared distance computed by DgmOctree::findNeighborsInASphereStartingFromCell)
+	inline bool operator()(const DgmOctree::PointDescriptor& p) const { return p.squareDistd <= m_squareRadius; }
+
+	//! Squared radius
+	double m_squareRadius;
+};
+
+//! Returns the position of a point in a neighbourhood (or the neighbourhood size if it's not found)
+static unsigned FindNeighbourIndex(const DgmOctree::NeighboursSet& neighbours, unsigned neighborCount, unsigned globalIndex)
+{
+	unsigned localIndex = 0;
+	while (localIndex < neighborCount && neighbours[localIndex].pointIndex != globalIndex)
+		++localIndex;
+	return localIndex;
+}
+
+//"PER-CELL" METHOD: GEOMETRIC FEATURES
+//ADDITIONAL PARAMETERS (1):
+// [0] -> (GeomFeaturesParams*) params : requested features (grouped by radius)
+bool GeometricalAnalysisTools::computeGeomFeaturesInACellAtLevel(	const DgmOctree::octreeCell& cell,
+																	void** additionalParameters,
+																	NormalizedProgress* nProgress/*=0*/)
+{
+	//parameters
+	const GeomFeaturesParams& params = *static_cast<GeomFeaturesParams*>(additionalParameters[0]);
+	const std::vector<GeomFeatureDesc>& features = *params.features;
+	const PointCoordinateType maxRadius = params.radii.front();
+
+	//structure for nearest neighbors search
+	DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+	DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
+	nNSS.level = cell.level;
+	nNSS.prepare(maxRadius,cell.parentOctree->getCellSize(nNSS.level));
+	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//we already know some of the neighbours: the points in the current cell!
+	{
+		try
+		{
+			nNSS.pointsInNeighbourhood.resize(n);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+
+		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned i=0; i<n; ++i,++it)
+		{
+			it->point = cell.points->getPointPersistentPtr(i);
+			it->pointIndex = cell.points->getPointGlobalIndex(i);
+		}
+	}
+	nNSS.alreadyVisitedNeighbourhoodSize = 1;
+
+	//for each point in the cell
+	for (unsigned i=0; i<n; ++i)
+	{
+		cell.points->getPoint(i,nNSS.queryPoint);
+		const unsigned globalIndex = cell.points->getPointGlobalIndex(i);
+
+		//look for neighbors in a sphere (only once, for the largest radius)
+		//warning: there may be more points at the end of nNSS.pointsInNeighbourhood than the actual nearest neighbors (neighborCount)!
+		unsigned neighborCount = cell.parentOctree->findNeighborsInASphereStartingFromCell(nNSS,maxRadius,false);
+
+		for (size_t r=0; r<params.radii.size(); ++r)
+		{
+			const PointCoordinateType radius = params.radii[r];
+			if (r != 0)
+			{
+				//the neighbours at a smaller radius are a subset of the previous ones
+				double squareRadius = static_cast<double>(radius) * static_cast<double>(radius);
+				DgmOctree::NeighboursSet::iterator begin = nNSS.pointsInNeighbourhood.begin();
+				neighborCount = static_cast<unsigned>(std::partition(begin,begin+neighborCount,NeighbourInSphere(squareRadius)) - begin);
+			}
+
+			DgmOctreeReferenceCloud neighboursCloud(&nNSS.pointsInNeighbourhood,neighborCount);
+			Neighbourhood Z(&neighboursCloud);
+
+			//sorted eigen values (computed on demand)
+			bool eigenValuesComputed = false;
+			double eigenValues[3] = { 0, 0, 0 };
+
+			const std::vector<size_t>& featureIndexes = params.featuresPerRadius[r];
+			for (size_t k=0; k<featureIndexes.size(); ++k)
+			{
+				const GeomFeatureDesc& desc = features[featureIndexes[k]];
+
+				if (desc.feature == GF_NORMAL)
+				{
+					CCVector3 N(0,0,0);
+					if (neighborCount >= CC_LOCAL_MODEL_MIN_SIZE[LS])
+					{
+						const CCVector3* lsqPlaneNormal = Z.getLSQPlaneNormal();
+						if (lsqPlaneNormal) //should already be unit!
+							N = *lsqPlaneNormal;
+					}
+					desc.normals->setValue(globalIndex,N.u);
+					continue;
+				}
+
+				ScalarType value = NAN_VALUE;
+				switch (desc.feature)
+				{
+				case GF_MEAN_CURVATURE:
+				case GF_GAUSSIAN_CURVATURE:
+					if (neighborCount > 5)
+					{
+						//current point index in neighbourhood (to compute curvature at the right position!)
+						unsigned indexInNeighbourhood = FindNeighbourIndex(nNSS.pointsInNeighbourhood,neighborCount,globalIndex);
+						if (indexInNeighbourhood == neighborCount)
+							indexInNeighbourhood = 0;
+						value = Z.computeCurvature(indexInNeighbourhood,desc.feature == GF_MEAN_CURVATURE ? Neighbourhood::MEAN_CURV : Neighbourhood::GAUSSIAN_CURV);
+					}
+					break;
+
+				case GF_ROUGHNESS:
+					if (neighborCount > 3)
+					{
+						//the query point is temporarily placed at the end of the neighbours set
+						unsigned localIndex = FindNeighbourIndex(nNSS.pointsInNeighbourhood,neighborCount,globalIndex);
+						assert(localIndex < neighborCount);
+						if (localIndex+1 < neighborCount)
+							std::swap(nNSS.pointsInNeighbourhood[localIndex],nNSS.pointsInNeighbourhood[neighborCount-1]);
+
+						DgmOctreeReferenceCloud roughnessCloud(&nNSS.pointsInNeighbourhood,neighborCount-1); //we don't take the query point into account!
+						Neighbourhood Zr(&roughnessCloud);
+						const PointCoordinateType* lsq = Zr.getLSQPlane();
+						if (lsq)
+							value = static_cast<ScalarType>(fabs(DistanceComputationTools::computePoint2PlaneDistance(&nNSS.queryPoint,lsq)));
+
+						//swap the points back (the order is relevant for the other features)
+						if (localIndex+1 < neighborCount)
+							std::swap(nNSS.pointsInNeighbourhood[localIndex],nNSS.pointsInNeighbourhood[neighborCount-1]);
+					}
+					break;
+
+				case GF_DENSITY:
+					{
+						double sphereVolume = pow(static_cast<double>(radius), 3.0)*4.0*M_PI/3.0; // volume = 4/3 * pi * r^3
+						value = static_cast<ScalarType>(neighborCount/sphereVolume);
+					}
+					break;
+
+				case GF_LINEARITY:
+				case GF_PLANARITY:
+				case GF_SPHERICITY:
+					if (neighborCount >= 3)
+					{
+						if (!eigenValuesComputed)
+						{
+							eigenValuesComputed = true;
+							SymMatrix3d covMat;
+							double eigenVectors[3][3];
+							if (	Z.computeCovarianceMatrix(covMat)
+								&&	covMat.computeJacobianEigenValuesAndVectors(eigenValues,eigenVectors))
+							{
+								//sort them by decreasing order
+								std::sort(eigenValues,eigenValues+3);
+								std::swap(eigenValues[0],eigenValues[2]);
+							}
+							else
+							{
+								eigenValues[0] = eigenValues[1] = eigenValues[2] = 0;
+							}
+						}
+
+						const double& l1 = eigenValues[0];
+						const double& l2 = eigenValues[1];
+						const double& l3 = eigenValues[2];
+						if (l1 > 0)
+						{
+							if (desc.feature == GF_LINEARITY)
+								value = static_cast<ScalarType>((l1-l2)/l1);
+							else if (desc.feature == GF_PLANARITY)
+								value = static_cast<ScalarType>((l2-l3)/l1);
+							else
+								value = static_cast<ScalarType>(l3/l1);
+						}
+					}
+					break;
+
+				case GF_NEIGHBOR_COUNT:
+					value = static_cast<ScalarType>(neighborCount);
+					break;
+
+				default:
+					assert(false);
+					break;
+				}
+
+				desc.sf->setValue(globalIndex,value);
+			}
+		}
+
+		if (nProgress && !nProgress->oneStep())
+			return false;
+	}
+
+	return true;
+}
+
 CCVector3 GeometricalAnalysisTools::computeGravityCenter(GenericCloud* theCloud)
 {
 	assert(theCloud);
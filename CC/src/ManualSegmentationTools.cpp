@@ -26,33 +26,442 @@
 #include "GenericIndexedMesh.h"
 #include "SimpleMesh.h"
 #include "Polyline.h"
+#include "DgmOctree.h"
+#include "PointProjectionTools.h"
+#include "CCMiscTools.h"
 
 //system
+#include <stdio.h>
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
+#include <math.h>
 
 using namespace CCLib;
 
-ReferenceCloud* ManualSegmentationTools::segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat)
+//! Scanline edge table of a 2D polygon
+/** The polygon is cut in horizontal slabs (delimited by the vertices Y
+	coordinates) and each slab stores the edges that cross it. The slab
+	of a point is found by binary search, and only its edges have to be
+	tested (with the same test as ManualSegmentationTools::isPointInsidePoly).
+**/
+class PolygonScanlineTable
 {
-    assert(poly && aCloud);
+public:
 
-	CCLib::SquareMatrix* trans = (viewMat ? new CCLib::SquareMatrix(viewMat) : 0);
+	//! Edge (ordered as in the polygon)
+	struct Edge
+	{
+		CCVector2 A, B;
+	};
 
-	ReferenceCloud* Y = new ReferenceCloud(aCloud);
+	//! Initializes the table
+	/** \return false if there's not enough memory
+	**/
+	bool init(const std::vector<CCVector2>& vertices)
+	{
+		m_slabY.clear();
+		m_slabStart.clear();
+		m_edges.clear();
+
+		size_t vertCount = vertices.size();
+		if (vertCount < 2)
+			return true;
+
+		try
+		{
+			//bounding-box and slabs limits
+			m_slabY.reserve(vertCount);
+			m_minX = m_maxX = vertices[0].x;
+			for (size_t i=0; i<vertCount; ++i)
+			{
+				m_minX = std::min(m_minX,vertices[i].x);
+				m_maxX = std::max(m_maxX,vertices[i].x);
+				m_slabY.push_back(vertices[i].y);
+			}
+			std::sort(m_slabY.begin(),m_slabY.end());
+			m_slabY.erase(std::unique(m_slabY.begin(),m_slabY.end()),m_slabY.end());
+
+			if (m_slabY.size() < 2)
+			{
+				//flat polygon: nothing can be inside
+				m_slabY.clear();
+				return true;
+			}
+
+			//count the edges per slab (first pass) then fill the table (second pass)
+			size_t slabCount = m_slabY.size()-1;
+			m_slabStart.resize(slabCount+1,0);
+			for (int pass=0; pass<2; ++pass)
+			{
+				std::vector<unsigned> fillPos;
+				if (pass == 1)
+				{
+					for (size_t k=0; k<slabCount; ++k)
+						m_slabStart[k+1] += m_slabStart[k];
+					m_edges.resize(m_slabStart[slabCount]);
+					fillPos.assign(m_slabStart.begin(),m_slabStart.end()-1);
+				}
+
+				for (size_t i=1; i<=vertCount; ++i)
+				{
+					const CCVector2& A = vertices[i-1];
+					const CCVector2& B = vertices[i%vertCount];
+					if (A.y == B.y)
+						continue; //horizontal edges are never crossed
+
+					//the edge crosses the slabs between its min and max Y
+					size_t k0 = std::lower_bound(m_slabY.begin(),m_slabY.end(),std::min(A.y,B.y)) - m_slabY.begin();
+					size_t k1 = std::lower_bound(m_slabY.begin(),m_slabY.end(),std::max(A.y,B.y)) - m_slabY.begin();
+					for (size_t k=k0; k<k1; ++k)
+					{
+						if (pass == 0)
+						{
+							++m_slabStart[k+1];
+						}
+						else
+						{
+							Edge& e = m_edges[fillPos[k]++];
+							e.A = A;
+							e.B = B;
+						}
+					}
+				}
+			}
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			m_slabY.clear();
+			m_slabStart.clear();
+			m_edges.clear();
+			return false;
+		}
+
+		return true;
+	}
+
+	//! Returns the polygon bounding-box
+	inline void getBoundingBox(CCVector2& bbMin, CCVector2& bbMax) const
+	{
+		bbMin = CCVector2(m_minX,m_slabY.front());
+		bbMax = CCVector2(m_maxX,m_slabY.back());
+	}
+
+	//! Returns whether the polygon is empty (i.e. no point can be inside)
+	inline bool empty() const { return m_slabY.empty(); }
+
+	//! Tests if a point is inside the polygon
+	inline bool isInside(const CCVector2& P) const
+	{
+		if (m_slabY.empty() || P.x < m_minX || P.x > m_maxX)
+			return false;
+
+		//the last slab limit is excluded (see the inclusion test)
+		std::vector<PointCoordinateType>::const_iterator it = std::upper_bound(m_slabY.begin(),m_slabY.end(),P.y);
+		if (it == m_slabY.begin() || it == m_slabY.end())
+			return false;
+		size_t k = (it - m_slabY.begin()) - 1;
+
+		bool inside = false;
+		for (unsigned j=m_slabStart[k]; j<m_slabStart[k+1]; ++j)
+		{
+			const CCVector2& A = m_edges[j].A;
+			const CCVector2& B = m_edges[j].B;
+
+			//same test as ManualSegmentationTools::isPointInsidePoly (the edge is known to cross the slab)
+			PointCoordinateType t = (P.x-B.x)*(A.y-B.y) - (A.x-B.x)*(P.y-B.y);
+			if (A.y < B.y)
+				t=-t;
+			if (t < 0)
+				inside = !inside;
+		}
+
+		return inside;
+	}
+
+protected:
+
+	//! Slabs limits (sorted vertices Y coordinates, without duplicates)
+	std::vector<PointCoordinateType> m_slabY;
+	//! Index of the first edge of each slab (+ total number of edges)
+	std::vector<unsigned> m_slabStart;
+	//! Edges (slab by slab)
+	std::vector<Edge> m_edges;
+	//! Polygon X limits
+	PointCoordinateType m_minX, m_maxX;
+};
+
+//! Polygon segmentation job (a range of points or a range of octree cells)
+struct polySegmentationChunk
+{
+	//! Segmented cloud
+	GenericIndexedCloudPersist* cloud;
+	//! Polygon table
+	const PolygonScanlineTable* table;
+	//! Projection matrix (may be 0)
+	const double* projMat;
+	//! Output flags
+	unsigned char* flags;
+	//! Octree codes (may be 0)
+	const DgmOctree::IndexAndCode* codes;
+	//! Octree (if codes is not 0)
+	const DgmOctree* octree;
+	//! Octree level (if codes is not 0)
+	uchar level;
+	//! First element (point or code) index
+	unsigned begin;
+	//! Last element (point or code) index (excluded)
+	unsigned end;
+};
+
+//! Projects a point in screen space
+/** \return false if the point can't be projected (w = 0)
+**/
+static inline bool ProjectPoint(const CCVector3& P, const double* M, CCVector2& P2D)
+{
+	if (!M)
+	{
+		P2D = CCVector2(P.x,P.y);
+		return true;
+	}
+
+	double w = M[3]*P.x + M[7]*P.y + M[11]*P.z + M[15];
+	if (w == 0)
+		return false;
+	P2D = CCVector2(static_cast<PointCoordinateType>((M[0]*P.x + M[4]*P.y + M[8]*P.z + M[12])/w),
+					static_cast<PointCoordinateType>((M[1]*P.x + M[5]*P.y + M[9]*P.z + M[13])/w));
+	return true;
+}
+
+//! Returns whether an octree cell projection may intersect the polygon bounding-box
+static bool CellMayIntersectPolygon(const PointCoordinateType cellMin[], const PointCoordinateType cellMax[], const double* M, const CCVector2& polyMin, const CCVector2& polyMax)
+{
+	CCVector2 cellProjMin, cellProjMax;
+	for (unsigned c=0; c<8; ++c)
+	{
+		CCVector3 corner(	(c & 1) ? cellMax[0] : cellMin[0],
+							(c & 2) ? cellMax[1] : cellMin[1],
+							(c & 4) ? cellMax[2] : cellMin[2]);
+
+		//the projection of the cell is only bounded by the projection of its corners if they all lie in front of the camera
+		if (M && M[3]*corner.x + M[7]*corner.y + M[11]*corner.z + M[15] <= 0)
+			return true;
+
+		CCVector2 P2D;
+		ProjectPoint(corner,M,P2D);
+		if (c == 0)
+		{
+			cellProjMin = cellProjMax = P2D;
+		}
+		else
+		{
+			cellProjMin.x = std::min(cellProjMin.x,P2D.x);
+			cellProjMin.y = std::min(cellProjMin.y,P2D.y);
+			cellProjMax.x = std::max(cellProjMax.x,P2D.x);
+			cellProjMax.y = std::max(cellProjMax.y,P2D.y);
+		}
+	}
+
+	return !(	cellProjMax.x < polyMin.x || cellProjMin.x > polyMax.x
+			||	cellProjMax.y < polyMin.y || cellProjMin.y > polyMax.y);
+}
+
+void SegmentWithPolygon(polySegmentationChunk& chunk)
+{
+	if (!chunk.codes)
+	{
+		//simple range of points
+		for (unsigned i=chunk.begin; i<chunk.end; ++i)
+		{
+			CCVector2 P2D;
+			chunk.flags[i] = (ProjectPoint(*chunk.cloud->getPointPersistentPtr(i),chunk.projMat,P2D) && chunk.table->isInside(P2D)) ? 1 : 0;
+		}
+		return;
+	}
+
+	//range of octree cells
+	CCVector2 polyMin, polyMax;
+	chunk.table->getBoundingBox(polyMin,polyMax);
+	const unsigned char bitDec = GET_BIT_SHIFT(chunk.level);
+
+	unsigned i = chunk.begin;
+	while (i < chunk.end)
+	{
+		//current cell
+		DgmOctree::OctreeCellCodeType truncatedCode = (chunk.codes[i].theCode >> bitDec);
+		unsigned cellEnd = i+1;
+		while (cellEnd < chunk.end && (chunk.codes[cellEnd].theCode >> bitDec) == truncatedCode)
+			++cellEnd;
+
+		PointCoordinateType cellMin[3], cellMax[3];
+		chunk.octree->computeCellLimits(truncatedCode,chunk.level,cellMin,cellMax,true);
+
+		if (CellMayIntersectPolygon(cellMin,cellMax,chunk.projMat,polyMin,polyMax))
+		{
+			for (; i<cellEnd; ++i)
+			{
+				unsigned index = chunk.codes[i].theIndex;
+				CCVector2 P2D;
+				chunk.flags[index] = (ProjectPoint(*chunk.cloud->getPointPersistentPtr(index),chunk.projMat,P2D) && chunk.table->isInside(P2D)) ? 1 : 0;
+			}
+		}
+		else
+		{
+			//the whole cell is outside
+			for (; i<cellEnd; ++i)
+				chunk.flags[chunk.codes[i].theIndex] = 0;
+		}
+	}
+}
+
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#endif
+
+//! Approximate number of points per segmentation job
+static const unsigned POLY_SEGMENTATION_CHUNK_SIZE = (1<<16);
+//! Approximate number of points per octree cell (for cells rejection)
+static const unsigned POLY_SEGMENTATION_POINTS_PER_CELL = 256;
+
+bool ManualSegmentationTools::flagPointsInsidePoly(	GenericIndexedCloudPersist* aCloud,
+													const std::vector<CCVector2>& polyVertices,
+													std::vector<unsigned char>& insideFlags,
+													const double* projMat/*=0*/,
+													const DgmOctree* octree/*=0*/)
+{
+	assert(aCloud);
 
-	//we check for each point if it falls inside the polyline
 	unsigned count = aCloud->size();
-	for (unsigned i=0; i<count; ++i)
+
+	PolygonScanlineTable table;
+	std::vector<polySegmentationChunk> chunks;
+	try
 	{
-		CCVector3 P;
-		aCloud->getPoint(i,P);
+		insideFlags.resize(count);
+		if (!table.init(polyVertices))
+			return false;
+		if (count == 0)
+			return true;
+		if (table.empty())
+		{
+			std::fill(insideFlags.begin(),insideFlags.end(),0);
+			return true;
+		}
+
+		//the octree can only be used if it corresponds to the cloud
+		if (	octree
+			&&	(octree->associatedCloud() != aCloud || octree->getNumberOfProjectedPoints() != count || octree->pointsAndTheirCellCodes().size() != count))
+		{
+			octree = 0;
+		}
+
+		polySegmentationChunk chunk;
+		chunk.cloud = aCloud;
+		chunk.table = &table;
+		chunk.projMat = projMat;
+		chunk.flags = &(insideFlags[0]);
+		chunk.codes = 0;
+		chunk.octree = 0;
+		chunk.level = 0;
 
-		//we project the point in screen space first if necessary
-		if (trans)
-			trans->apply(P.u);
+		if (octree)
+		{
+			//the chunks are cut at the cells boundaries
+			chunk.codes = &(octree->pointsAndTheirCellCodes()[0]);
+			chunk.octree = octree;
+			chunk.level = octree->findBestLevelForAGivenPopulationPerCell(POLY_SEGMENTATION_POINTS_PER_CELL);
+			const unsigned char bitDec = GET_BIT_SHIFT(chunk.level);
 
-		bool pointInside = isPointInsidePoly(CCVector2(P.x,P.y),poly);
+			unsigned begin = 0;
+			while (begin < count)
+			{
+				unsigned end = std::min(count,begin+POLY_SEGMENTATION_CHUNK_SIZE);
+				DgmOctree::OctreeCellCodeType lastCode = (chunk.codes[end-1].theCode >> bitDec);
+				while (end < count && (chunk.codes[end].theCode >> bitDec) == lastCode)
+					++end;
+
+				chunk.begin = begin;
+				chunk.end = end;
+				chunks.push_back(chunk);
+				begin = end;
+			}
+		}
+		else
+		{
+			for (unsigned begin=0; begin<count; begin+=POLY_SEGMENTATION_CHUNK_SIZE)
+			{
+				chunk.begin = begin;
+				chunk.end = std::min(count,begin+POLY_SEGMENTATION_CHUNK_SIZE);
+				chunks.push_back(chunk);
+			}
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+#ifdef ENABLE_MT_OCTREE
+	if (chunks.size() > 1)
+	{
+		QtConcurrent::blockingMap(chunks, SegmentWithPolygon);
+		return true;
+	}
+#endif
+
+	for (size_t k=0; k<chunks.size(); ++k)
+		SegmentWithPolygon(chunks[k]);
+
+	return true;
+}
+
+ReferenceCloud* ManualSegmentationTools::segment(GenericIndexedCloudPersist* aCloud, const Polyline* poly, bool keepInside, const float* viewMat, const DgmOctree* octree)
+{
+	assert(poly && aCloud);
+
+	//polygon vertices
+	std::vector<CCVector2> polyVertices;
+	try
+	{
+		polyVertices.resize(poly->size());
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return 0;
+	}
+	for (unsigned j=0; j<poly->size(); ++j)
+	{
+		CCVector3 V;
+		poly->getPoint(j,V);
+		polyVertices[j] = CCVector2(V.x,V.y);
+	}
+
+	//the 4x4 visualization matrix (if any) is applied to the points homogeneous coordinates
+	double projMat[16];
+	if (viewMat)
+	{
+		for (unsigned k=0; k<16; ++k)
+			projMat[k] = static_cast<double>(viewMat[k]);
+	}
+
+	//we check for each point if it falls inside the polyline
+	std::vector<unsigned char> insideFlags;
+	if (!flagPointsInsidePoly(aCloud,polyVertices,insideFlags,viewMat ? projMat : 0,octree))
+	{
+		//not enough memory
+		return 0;
+	}
+
+	ReferenceCloud* Y = new ReferenceCloud(aCloud);
+
+	unsigned count = aCloud->size();
+	for (unsigned i=0; i<count; ++i)
+	{
+		bool pointInside = (insideFlags[i] != 0);
 		if ((keepInside && pointInside) || (!keepInside && !pointInside))
 		{
 			if (!Y->addPointIndex(i))
@@ -65,9 +474,6 @@ ReferenceCloud* ManualSegmentationTools::segment(GenericIndexedCloudPersist* aCl
 		}
 	}
 
-	if (trans)
-        delete trans;
-
 	return Y;
 }
 
@@ -287,3 +693,550 @@ GenericIndexedMesh* ManualSegmentationTools::segmentMesh(GenericIndexedMesh* the
 
 	return newMesh;
 }
+
+bool ManualSegmentationTools::SlicesGrid::getSlicePos(const CCVector3& localP, int pos[]) const
+{
+	bool inSlice = true;
+	for (unsigned char d=0; d<3; ++d)
+	{
+		PointCoordinateType cellSizePlusGap = cellSize.u[d] + gap;
+
+		//relative coordinates (between 0 and 1 inside a slice)
+		PointCoordinateType relPos = (localP.u[d] - origin.u[d]) / cellSizePlusGap;
+
+		int i = static_cast<int>(floor(relPos));
+		pos[d] = std::min( std::max(i, indexMins[d]), indexMaxs[d]);
+
+		if (gap != 0 && (relPos-static_cast<PointCoordinateType>(pos[d]))*cellSizePlusGap > cellSize.u[d])
+			inSlice = false;
+	}
+
+	return inSlice;
+}
+
+//! Approximate number of points per slices extraction job
+static const unsigned SLICES_EXTRACTION_CHUNK_SIZE = (1<<16);
+//! Approximate number of points per octree cell (for the bulk processing of the cells)
+static const unsigned SLICES_EXTRACTION_POINTS_PER_CELL = 256;
+//! Max number of histogram entries (all jobs together) for the counting sort
+static const unsigned SLICES_EXTRACTION_MAX_HISTOGRAM_SIZE = (1<<22);
+
+//! Slices extraction job (a range of points, or of octree codes)
+struct slicesExtractionChunk
+{
+	//! Cloud
+	GenericIndexedCloudPersist* cloud;
+	//! Slices grid
+	const ManualSegmentationTools::SlicesGrid* grid;
+	//! Octree codes (if any)
+	const DgmOctree::IndexAndCode* codes;
+	//! Octree (if any)
+	const DgmOctree* octree;
+	//! Octree level (for the bulk processing of the cells)
+	unsigned char level;
+	//! First element
+	unsigned begin;
+	//! Last element (excluded)
+	unsigned end;
+	//! Slice index of each point (-1 for the points falling in a gap)
+	int* sliceIndexes;
+	//! Slice population (then output positions) for the range of points
+	unsigned* counts;
+	//! Sorted points indexes (output)
+	unsigned* pointIndexes;
+	//! Local bounding-box (min corner)
+	CCVector3 bbMin;
+	//! Local bounding-box (max corner)
+	CCVector3 bbMax;
+	//! Whether the local bounding-box is valid
+	bool bbValid;
+
+	//! Default constructor
+	slicesExtractionChunk()
+		: cloud(0)
+		, grid(0)
+		, codes(0)
+		, octree(0)
+		, level(0)
+		, begin(0)
+		, end(0)
+		, sliceIndexes(0)
+		, counts(0)
+		, pointIndexes(0)
+		, bbMin(0,0,0)
+		, bbMax(0,0,0)
+		, bbValid(false)
+	{}
+};
+
+//! Returns the slice index of a point (or -1 if it falls in a gap)
+static inline int GetPointSliceIndex(const ManualSegmentationTools::SlicesGrid& grid, const CCVector3& P)
+{
+	CCVector3 localP;
+	grid.toLocal(P,localP);
+	int pos[3];
+	if (!grid.getSlicePos(localP,pos))
+		return -1;
+	return static_cast<int>(grid.sliceIndex(pos));
+}
+
+//! Computes the bounding-box of an octree cell in the grid coordinate system
+static void GetLocalCellBox(const ManualSegmentationTools::SlicesGrid& grid,
+							const DgmOctree* octree,
+							DgmOctree::OctreeCellCodeType truncatedCode,
+							unsigned char level,
+							CCVector3& localMin,
+							CCVector3& localMax)
+{
+	CCVector3 C;
+	octree->computeCellCenter(truncatedCode,level,C.u,true);
+	PointCoordinateType halfSize = octree->getCellSize(level) / 2;
+
+	CCVector3 localC;
+	grid.toLocal(C,localC);
+	CCMiscTools::ComputeTransformedCubeBox(localC,halfSize,grid.transMat,localMin,localMax);
+}
+
+static void ComputeSlicesGridExtents(slicesExtractionChunk& chunk)
+{
+	chunk.bbValid = false;
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+	{
+		CCVector3 localP;
+		chunk.grid->toLocal(*chunk.cloud->getPointPersistentPtr(i),localP);
+		if (chunk.bbValid)
+		{
+			for (unsigned char d=0; d<3; ++d)
+			{
+				if (localP.u[d] < chunk.bbMin.u[d])
+					chunk.bbMin.u[d] = localP.u[d];
+				else if (localP.u[d] > chunk.bbMax.u[d])
+					chunk.bbMax.u[d] = localP.u[d];
+			}
+		}
+		else
+		{
+			chunk.bbMin = chunk.bbMax = localP;
+			chunk.bbValid = true;
+		}
+	}
+}
+
+static void ComputeSliceIndexes(slicesExtractionChunk& chunk)
+{
+	const ManualSegmentationTools::SlicesGrid& grid = *chunk.grid;
+
+	if (!chunk.codes)
+	{
+		for (unsigned i=chunk.begin; i<chunk.end; ++i)
+			chunk.sliceIndexes[i] = GetPointSliceIndex(grid,*chunk.cloud->getPointPersistentPtr(i));
+		return;
+	}
+
+	//octree cells
+	const unsigned char bitDec = GET_BIT_SHIFT(chunk.level);
+	unsigned i = chunk.begin;
+	while (i < chunk.end)
+	{
+		DgmOctree::OctreeCellCodeType truncatedCode = (chunk.codes[i].theCode >> bitDec);
+		unsigned cellEnd = i+1;
+		while (cellEnd < chunk.end && (chunk.codes[cellEnd].theCode >> bitDec) == truncatedCode)
+			++cellEnd;
+
+		CCVector3 localMin,localMax;
+		GetLocalCellBox(grid,chunk.octree,truncatedCode,chunk.level,localMin,localMax);
+		int posMin[3],posMax[3];
+		bool minInSlice = grid.getSlicePos(localMin,posMin);
+		bool maxInSlice = grid.getSlicePos(localMax,posMax);
+
+		if (posMin[0] == posMax[0] && posMin[1] == posMax[1] && posMin[2] == posMax[2] && (maxInSlice || !minInSlice))
+		{
+			//the whole cell falls inside a single slice (or inside a gap)
+			int sliceIndex = (maxInSlice ? static_cast<int>(grid.sliceIndex(posMin)) : -1);
+			for (; i<cellEnd; ++i)
+				chunk.sliceIndexes[chunk.codes[i].theIndex] = sliceIndex;
+		}
+		else
+		{
+			for (; i<cellEnd; ++i)
+			{
+				unsigned index = chunk.codes[i].theIndex;
+				chunk.sliceIndexes[index] = GetPointSliceIndex(grid,*chunk.cloud->getPointPersistentPtr(index));
+			}
+		}
+	}
+}
+
+static void CountSlicesPopulation(slicesExtractionChunk& chunk)
+{
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+	{
+		int sliceIndex = chunk.sliceIndexes[i];
+		if (sliceIndex >= 0)
+			++chunk.counts[sliceIndex];
+	}
+}
+
+static void ScatterSlicesPoints(slicesExtractionChunk& chunk)
+{
+	//stable: the points of a given slice keep their (index) order
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+	{
+		int sliceIndex = chunk.sliceIndexes[i];
+		if (sliceIndex >= 0)
+			chunk.pointIndexes[chunk.counts[sliceIndex]++] = i;
+	}
+}
+
+//! Applies a function to all the jobs (in parallel if possible)
+static void ProcessSlicesChunks(std::vector<slicesExtractionChunk>& chunks, void (*func)(slicesExtractionChunk&))
+{
+#ifdef ENABLE_MT_OCTREE
+	if (chunks.size() > 1)
+	{
+		QtConcurrent::blockingMap(chunks, func);
+		return;
+	}
+#endif
+
+	for (size_t k=0; k<chunks.size(); ++k)
+		func(chunks[k]);
+}
+
+bool ManualSegmentationTools::computeSlicesGridExtents(GenericIndexedCloudPersist* aCloud, SlicesGrid& grid, const bool repeatDim[3])
+{
+	assert(aCloud);
+
+	unsigned count = aCloud->size();
+	if (count == 0)
+		return false;
+
+	std::vector<slicesExtractionChunk> chunks;
+	try
+	{
+		slicesExtractionChunk chunk;
+		chunk.cloud = aCloud;
+		chunk.grid = &grid;
+		for (unsigned begin=0; begin<count; begin+=SLICES_EXTRACTION_CHUNK_SIZE)
+		{
+			chunk.begin = begin;
+			chunk.end = std::min(count,begin+SLICES_EXTRACTION_CHUNK_SIZE);
+			chunks.push_back(chunk);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	ProcessSlicesChunks(chunks,ComputeSlicesGridExtents);
+
+	//merge the local bounding-boxes
+	CCVector3 bbMin = chunks.front().bbMin;
+	CCVector3 bbMax = chunks.front().bbMax;
+	for (size_t k=1; k<chunks.size(); ++k)
+	{
+		for (unsigned char d=0; d<3; ++d)
+		{
+			bbMin.u[d] = std::min(bbMin.u[d],chunks[k].bbMin.u[d]);
+			bbMax.u[d] = std::max(bbMax.u[d],chunks[k].bbMax.u[d]);
+		}
+	}
+
+	for (unsigned char d=0; d<3; ++d)
+	{
+		grid.indexMins[d] = grid.indexMaxs[d] = 0;
+		if (!repeatDim[d])
+			continue;
+
+		PointCoordinateType cellSizePlusGap = grid.cellSize.u[d] + grid.gap;
+		if (cellSizePlusGap < ZERO_TOLERANCE)
+			return false;
+
+		PointCoordinateType a = (bbMin.u[d] - grid.origin.u[d])/cellSizePlusGap; //don't forget the user defined gap between 'cells'
+		PointCoordinateType b = (bbMax.u[d] - grid.origin.u[d])/cellSizePlusGap;
+
+		grid.indexMins[d] = static_cast<int>(floor(a+static_cast<PointCoordinateType>(1.0e-6)));
+		grid.indexMaxs[d] = std::max(static_cast<int>(ceil(b-static_cast<PointCoordinateType>(1.0e-6)))-1, grid.indexMins[d]);
+	}
+
+	return true;
+}
+
+bool ManualSegmentationTools::extractSlices(GenericIndexedCloudPersist* aCloud,
+											const SlicesGrid& grid,
+											std::vector<unsigned>& sliceStarts,
+											std::vector<unsigned>& pointIndexes,
+											const DgmOctree* octree/*=0*/,
+											GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(aCloud);
+
+	unsigned count = aCloud->size();
+	unsigned sliceCount = grid.sliceCount();
+	if (sliceCount == 0)
+		return false;
+
+	//the octree can only be used if it corresponds to the cloud
+	if (	octree
+		&&	(octree->associatedCloud() != aCloud || octree->getNumberOfProjectedPoints() != count || octree->pointsAndTheirCellCodes().size() != count))
+	{
+		octree = 0;
+	}
+
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Slices extraction");
+		char buffer[256];
+		sprintf(buffer,"Points: %u\nSlices: %u",count,sliceCount);
+		progressCb->setInfo(buffer);
+		progressCb->start();
+	}
+
+	std::vector<int> sliceIndexes;
+	std::vector<slicesExtractionChunk> chunks;
+	std::vector<unsigned> histograms;
+	try
+	{
+		sliceIndexes.resize(count);
+		sliceStarts.resize(sliceCount+1);
+		pointIndexes.clear();
+
+		slicesExtractionChunk chunk;
+		chunk.cloud = aCloud;
+		chunk.grid = &grid;
+		chunk.sliceIndexes = (count ? &(sliceIndexes[0]) : 0);
+
+		if (octree)
+		{
+			//the chunks are cut at the cells boundaries
+			chunk.codes = &(octree->pointsAndTheirCellCodes()[0]);
+			chunk.octree = octree;
+			chunk.level = octree->findBestLevelForAGivenPopulationPerCell(SLICES_EXTRACTION_POINTS_PER_CELL);
+			const unsigned char bitDec = GET_BIT_SHIFT(chunk.level);
+
+			unsigned begin = 0;
+			while (begin < count)
+			{
+				unsigned end = std::min(count,begin+SLICES_EXTRACTION_CHUNK_SIZE);
+				DgmOctree::OctreeCellCodeType lastCode = (chunk.codes[end-1].theCode >> bitDec);
+				while (end < count && (chunk.codes[end].theCode >> bitDec) == lastCode)
+					++end;
+
+				chunk.begin = begin;
+				chunk.end = end;
+				chunks.push_back(chunk);
+				begin = end;
+			}
+		}
+		else
+		{
+			for (unsigned begin=0; begin<count; begin+=SLICES_EXTRACTION_CHUNK_SIZE)
+			{
+				chunk.begin = begin;
+				chunk.end = std::min(count,begin+SLICES_EXTRACTION_CHUNK_SIZE);
+				chunks.push_back(chunk);
+			}
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	//1st pass: slice index of each point
+	ProcessSlicesChunks(chunks,ComputeSliceIndexes);
+
+	if (progressCb)
+	{
+		progressCb->update(50.0f);
+		if (progressCb->isCancelRequested())
+		{
+			progressCb->stop();
+			return false;
+		}
+	}
+
+	//counting sort (the histograms of all the jobs must fit in memory)
+	unsigned chunkCount = std::max<unsigned>(1,(count + SLICES_EXTRACTION_CHUNK_SIZE - 1) / SLICES_EXTRACTION_CHUNK_SIZE);
+	chunkCount = std::max<unsigned>(1,std::min(chunkCount,SLICES_EXTRACTION_MAX_HISTOGRAM_SIZE / sliceCount));
+	try
+	{
+		histograms.resize(static_cast<size_t>(chunkCount) * sliceCount,0);
+
+		slicesExtractionChunk chunk;
+		chunk.sliceIndexes = (count ? &(sliceIndexes[0]) : 0);
+		chunks.resize(chunkCount,chunk);
+
+		const unsigned chunkSize = (count + chunkCount - 1) / chunkCount;
+		for (unsigned k=0; k<chunkCount; ++k)
+		{
+			chunks[k].begin = std::min(count,k*chunkSize);
+			chunks[k].end = std::min(count,chunks[k].begin+chunkSize);
+			chunks[k].counts = &(histograms[static_cast<size_t>(k) * sliceCount]);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		if (progressCb)
+			progressCb->stop();
+		return false;
+	}
+
+	ProcessSlicesChunks(chunks,CountSlicesPopulation);
+
+	//convert the histograms to output positions (slice by slice, then chunk by chunk)
+	unsigned pos = 0;
+	for (unsigned s=0; s<sliceCount; ++s)
+	{
+		sliceStarts[s] = pos;
+		for (unsigned k=0; k<chunkCount; ++k)
+		{
+			unsigned n = chunks[k].counts[s];
+			chunks[k].counts[s] = pos;
+			pos += n;
+		}
+	}
+	sliceStarts[sliceCount] = pos;
+
+	try
+	{
+		pointIndexes.resize(pos);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		if (progressCb)
+			progressCb->stop();
+		return false;
+	}
+
+	if (pos != 0)
+	{
+		for (unsigned k=0; k<chunkCount; ++k)
+			chunks[k].pointIndexes = &(pointIndexes[0]);
+
+		ProcessSlicesChunks(chunks,ScatterSlicesPoints);
+	}
+
+	if (progressCb)
+	{
+		progressCb->update(100.0f);
+		progressCb->stop();
+	}
+
+	return true;
+}
+
+//! Slice contour extraction job
+struct sliceContourJob
+{
+	//! Cloud
+	GenericIndexedCloudPersist* cloud;
+	//! Slice points indexes
+	const unsigned* indexes;
+	//! Number of points in the slice
+	unsigned count;
+	//! Max edge length
+	PointCoordinateType maxEdgeLength;
+	//! Preferred (normal) direction
+	const PointCoordinateType* preferredDim;
+	//! Output contour
+	std::vector<CCVector3>* contour;
+};
+
+static void ExtractSliceContour(sliceContourJob& job)
+{
+	job.contour->clear();
+	if (job.count < 3)
+		return;
+
+	ReferenceCloud slice(job.cloud);
+	if (!slice.reserve(job.count))
+		return;
+	for (unsigned i=0; i<job.count; ++i)
+		slice.addPointIndex(job.indexes[i]);
+
+	if (!PointProjectionTools::extractFlatContour(&slice,job.maxEdgeLength,*job.contour,job.preferredDim))
+		job.contour->clear();
+}
+
+bool ManualSegmentationTools::extractSlicesContours(GenericIndexedCloudPersist* aCloud,
+													const std::vector<unsigned>& sliceStarts,
+													const std::vector<unsigned>& pointIndexes,
+													PointCoordinateType maxEdgeLength,
+													std::vector< std::vector<CCVector3> >& contours,
+													const PointCoordinateType* preferredDim/*=0*/,
+													GenericProgressCallback* progressCb/*=0*/)
+{
+	assert(aCloud);
+	if (sliceStarts.empty())
+		return false;
+
+	unsigned sliceCount = static_cast<unsigned>(sliceStarts.size()) - 1;
+
+	std::vector<sliceContourJob> jobs;
+	try
+	{
+		contours.clear();
+		contours.resize(sliceCount);
+
+		for (unsigned s=0; s<sliceCount; ++s)
+		{
+			unsigned n = sliceStarts[s+1] - sliceStarts[s];
+			if (n < 3)
+				continue;
+
+			sliceContourJob job;
+			job.cloud = aCloud;
+			job.indexes = &(pointIndexes[sliceStarts[s]]);
+			job.count = n;
+			job.maxEdgeLength = maxEdgeLength;
+			job.preferredDim = preferredDim;
+			job.contour = &(contours[s]);
+			jobs.push_back(job);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	if (progressCb)
+	{
+		progressCb->reset();
+		progressCb->setMethodTitle("Slices contours");
+		char buffer[256];
+		sprintf(buffer,"Slices: %u",static_cast<unsigned>(jobs.size()));
+		progressCb->setInfo(buffer);
+		progressCb->start();
+	}
+
+	//the jobs are processed by blocks (so as to be able to cancel the process)
+	const size_t blockSize = 256;
+	for (size_t first=0; first<jobs.size(); first+=blockSize)
+	{
+		size_t last = std::min(jobs.size(),first+blockSize);
+#ifdef ENABLE_MT_OCTREE
+		QtConcurrent::blockingMap(jobs.begin()+first, jobs.begin()+last, ExtractSliceContour);
+#else
+		for (size_t k=first; k<last; ++k)
+			ExtractSliceContour(jobs[k]);
+#endif
+
+		if (progressCb)
+		{
+			progressCb->update(100.0f * static_cast<float>(last) / static_cast<float>(jobs.size()));
+			if (progressCb->isCancelRequested())
+			{
+				progressCb->stop();
+				return false;
+			}
+		}
+	}
+
+	if (progressCb)
+		progressCb->stop();
+
+	return true;
+}
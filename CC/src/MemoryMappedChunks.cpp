@@ -0,0 +1,720 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "MemoryMappedChunks.h"
+
+//Qt
+#include <QMutex>
+#include <QAtomicInt>
+#include <QAtomicPointer>
+
+//system
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+//Chunks are not mapped one by one (this would quickly exhaust the number of
+//files and mappings a process can open, see 'vm.max_map_count' on Linux):
+//they are stored in 'segments', i.e. big temporary files mapped in one go and
+//split in slots of the same size.
+
+//! Minimum segment size (64 Mb)
+static const size_t SEGMENT_MIN_SIZE = (static_cast<size_t>(1) << 26);
+
+//! Segments directory: address space granularity (one block = SEGMENT_MIN_SIZE bytes)
+static const unsigned DIRECTORY_BLOCK_SHIFT = 26;
+//! Segments directory: number of bits per level (2 levels)
+static const unsigned DIRECTORY_LEVEL_BITS = 11;
+//! Segments directory: number of entries per level
+static const size_t DIRECTORY_LEVEL_SIZE = (static_cast<size_t>(1) << DIRECTORY_LEVEL_BITS);
+
+//! Memory-mapped segment (one temporary file split in chunk slots)
+struct MappedSegment
+{
+	//! Default constructor
+	MappedSegment()
+		: base(0)
+		, size(0)
+		, slotSize(0)
+		, slotCount(0)
+		, slotPages(0)
+		, usedCount(0)
+		, stamps(0)
+#ifdef _WIN32
+		, file(INVALID_HANDLE_VALUE)
+		, mapping(0)
+#endif
+	{}
+
+	//! Destructor
+	~MappedSegment()
+	{
+		delete[] stamps;
+	}
+
+	//! Segment start address
+	char* base;
+	//! Segment size (in bytes)
+	size_t size;
+	//! Slot size (in bytes)
+	size_t slotSize;
+	//! Number of slots
+	unsigned slotCount;
+	//! Number of memory pages per slot
+	int slotPages;
+	//! Number of used slots
+	unsigned usedCount;
+	//! Whether each slot is used or not
+	std::vector<bool> used;
+	//! Access stamp of each slot (0 = not held in memory)
+	/** Read and written without locking the mutex.
+	**/
+	QAtomicInt* stamps;
+#ifdef _WIN32
+	//! Temporary file handle
+	HANDLE file;
+	//! File mapping handle
+	HANDLE mapping;
+#endif
+};
+
+//! Segments overlapping one block of the address space
+/** As segments are at least as big as a block, a block can't overlap more than 2 segments.
+**/
+struct DirectoryBlock
+{
+	QAtomicPointer<MappedSegment> segments[2];
+};
+
+//Segments directory (two levels of DIRECTORY_LEVEL_SIZE entries) so as to find the
+//segment of a chunk without locking the mutex. Segments are only added with the mutex
+//locked and they are never removed (their slots are reused by the next chunks).
+static QAtomicPointer<DirectoryBlock> s_directory[DIRECTORY_LEVEL_SIZE];
+
+//all segments
+static std::vector<MappedSegment*> s_segments;
+//segments with at least one free slot (per slot size)
+static std::map< size_t, std::vector<MappedSegment*> > s_availableSegments;
+//mutex protecting the above structures (and the non atomic variables below)
+static QMutex s_mutex;
+
+//whether new chunks should be mapped (read without locking the mutex)
+static QAtomicInt s_enabled(0);
+//access clock (the chunks touched since the last tick share the same stamp)
+static QAtomicInt s_clock(1);
+//number of memory pages held by the resident chunks
+static QAtomicInt s_residentPages(0);
+//residency limit (in memory pages, 0 = no limit)
+static QAtomicInt s_residencyLimitPages(0);
+
+QAtomicInt MemoryMappedChunks::s_mappedChunkCount(0);
+
+static std::string s_tempDir;
+static size_t s_residencyLimit = 0;
+static size_t s_mappedBytes = 0;
+
+//reads an atomic integer (without any memory barrier)
+static inline int LoadInt(const QAtomicInt& value)
+{
+#ifdef CC_QT5
+	return value.load();
+#else
+	return value;
+#endif
+}
+
+//reads an atomic pointer
+template <class T> static inline T* LoadPointer(const QAtomicPointer<T>& pointer)
+{
+#ifdef CC_QT5
+	return pointer.loadAcquire();
+#else
+	return pointer;
+#endif
+}
+
+static size_t GetPageSize()
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return static_cast<size_t>(info.dwPageSize);
+#else
+	return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+static std::string GetTempDirectory()
+{
+	if (!s_tempDir.empty())
+		return s_tempDir;
+
+#ifdef _WIN32
+	char buffer[MAX_PATH+1];
+	DWORD length = GetTempPathA(MAX_PATH+1,buffer);
+	if (length != 0 && length <= MAX_PATH)
+		return std::string(buffer,length);
+	return std::string(".");
+#else
+	const char* tmpDir = getenv("TMPDIR");
+	return std::string(tmpDir && tmpDir[0] != 0 ? tmpDir : "/tmp");
+#endif
+}
+
+//returns the directory block of a given address (or 0 if it has not been created yet)
+static DirectoryBlock* GetDirectoryBlock(size_t address, bool create)
+{
+	size_t block = (address >> DIRECTORY_BLOCK_SHIFT);
+	QAtomicPointer<DirectoryBlock>& level = s_directory[(block >> DIRECTORY_LEVEL_BITS) & (DIRECTORY_LEVEL_SIZE-1)];
+
+	DirectoryBlock* blocks = LoadPointer(level);
+	if (!blocks && create)
+	{
+		//only called with the mutex locked
+		blocks = new (std::nothrow) DirectoryBlock[DIRECTORY_LEVEL_SIZE];
+		if (!blocks)
+			return 0;
+		level.fetchAndStoreOrdered(blocks);
+	}
+
+	return (blocks ? blocks + (block & (DIRECTORY_LEVEL_SIZE-1)) : 0);
+}
+
+//returns the segment holding a given chunk (without locking the mutex)
+static MappedSegment* FindSegment(const void* chunk)
+{
+	size_t address = reinterpret_cast<size_t>(chunk);
+	DirectoryBlock* block = GetDirectoryBlock(address,false);
+	if (!block)
+		return 0;
+
+	for (unsigned i=0; i<2; ++i)
+	{
+		MappedSegment* segment = LoadPointer(block->segments[i]);
+		if (segment && address - reinterpret_cast<size_t>(segment->base) < segment->size)
+			return segment;
+	}
+
+	return 0;
+}
+
+//adds a segment to the directory
+static bool RegisterSegment(MappedSegment* segment)
+{
+	size_t firstBlock = (reinterpret_cast<size_t>(segment->base) >> DIRECTORY_BLOCK_SHIFT);
+	size_t lastBlock = ((reinterpret_cast<size_t>(segment->base) + (segment->size - 1)) >> DIRECTORY_BLOCK_SHIFT);
+
+	//first check that there's room in all blocks (the directory is read without lock)
+	for (size_t i=firstBlock; i<=lastBlock; ++i)
+	{
+		DirectoryBlock* block = GetDirectoryBlock(i << DIRECTORY_BLOCK_SHIFT,true);
+		//(very unlikely) aliasing of addresses beyond the directory range
+		if (!block || (LoadPointer(block->segments[0]) && LoadPointer(block->segments[1])))
+			return false;
+	}
+
+	for (size_t i=firstBlock; i<=lastBlock; ++i)
+	{
+		DirectoryBlock* block = GetDirectoryBlock(i << DIRECTORY_BLOCK_SHIFT,false);
+		assert(block);
+		block->segments[LoadPointer(block->segments[0]) ? 1 : 0].fetchAndStoreOrdered(segment);
+	}
+
+	return true;
+}
+
+//unmaps a segment and deletes the associated file
+static void ReleaseSegment(MappedSegment* segment)
+{
+#ifdef _WIN32
+	if (segment->base)
+		UnmapViewOfFile(segment->base);
+	if (segment->mapping)
+		CloseHandle(segment->mapping);
+	if (segment->file != INVALID_HANDLE_VALUE)
+		CloseHandle(segment->file); //deletes the file
+#else
+	if (segment->base)
+		munmap(segment->base,segment->size);
+#endif
+
+	delete segment;
+}
+
+//creates and maps a new segment
+static MappedSegment* CreateSegment(size_t slotSize, size_t pageSize)
+{
+	assert(slotSize != 0 && (slotSize % pageSize) == 0);
+
+	MappedSegment* segment = new (std::nothrow) MappedSegment;
+	if (!segment)
+		return 0;
+
+	//a segment is at least as big as a directory block
+	segment->slotSize = slotSize;
+	segment->slotCount = static_cast<unsigned>((SEGMENT_MIN_SIZE + slotSize - 1) / slotSize);
+	segment->slotPages = static_cast<int>(slotSize / pageSize);
+	segment->size = slotSize * segment->slotCount;
+	segment->stamps = new (std::nothrow) QAtomicInt[segment->slotCount];
+	if (!segment->stamps)
+	{
+		delete segment;
+		return 0;
+	}
+	try
+	{
+		segment->used.resize(segment->slotCount,false);
+	}
+	catch (const std::bad_alloc&)
+	{
+		delete segment;
+		return 0;
+	}
+
+	std::string tempDir = GetTempDirectory();
+
+#ifdef _WIN32
+	char filename[MAX_PATH+1];
+	if (GetTempFileNameA(tempDir.c_str(),"ccc",0,filename) == 0)
+	{
+		delete segment;
+		return 0;
+	}
+
+	segment->file = CreateFileA(filename,
+								GENERIC_READ | GENERIC_WRITE,
+								0,
+								0,
+								CREATE_ALWAYS,
+								FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE,
+								0);
+	if (segment->file == INVALID_HANDLE_VALUE)
+	{
+		DeleteFileA(filename);
+		delete segment;
+		return 0;
+	}
+
+	//the file is automatically extended to the mapping size
+	unsigned long long fileSize = static_cast<unsigned long long>(segment->size);
+	segment->mapping = CreateFileMappingA(segment->file,0,PAGE_READWRITE,static_cast<DWORD>(fileSize >> 32),static_cast<DWORD>(fileSize & 0xFFFFFFFF),0);
+	if (!segment->mapping)
+	{
+		ReleaseSegment(segment);
+		return 0;
+	}
+
+	segment->base = static_cast<char*>(MapViewOfFile(segment->mapping,FILE_MAP_ALL_ACCESS,0,0,segment->size));
+	if (!segment->base)
+	{
+		ReleaseSegment(segment);
+		return 0;
+	}
+#else
+	std::string filename = tempDir + "/CCLib_chunks_XXXXXX";
+	std::vector<char> buffer(filename.begin(),filename.end());
+	buffer.push_back(0);
+
+	int fd = mkstemp(&buffer[0]);
+	if (fd < 0)
+	{
+		delete segment;
+		return 0;
+	}
+	//the file will be deleted as soon as it is unmapped
+	unlink(&buffer[0]);
+
+	//the file is sparse: only the chunks actually written use disk space
+	if (ftruncate(fd,static_cast<off_t>(segment->size)) != 0)
+	{
+		close(fd);
+		delete segment;
+		return 0;
+	}
+
+	void* base = mmap(0,segment->size,PROT_READ | PROT_WRITE,MAP_SHARED,fd,0);
+	//the mapping keeps its own reference on the file
+	close(fd);
+	if (base == MAP_FAILED)
+	{
+		delete segment;
+		return 0;
+	}
+	segment->base = static_cast<char*>(base);
+#endif
+
+	try
+	{
+		s_segments.push_back(segment);
+	}
+	catch (const std::bad_alloc&)
+	{
+		ReleaseSegment(segment);
+		return 0;
+	}
+
+	if (!RegisterSegment(segment))
+	{
+		s_segments.pop_back();
+		ReleaseSegment(segment);
+		return 0;
+	}
+
+	return segment;
+}
+
+//returns the slot index of a chunk
+static inline unsigned GetSlotIndex(const MappedSegment* segment, const void* chunk)
+{
+	return static_cast<unsigned>((static_cast<const char*>(chunk) - segment->base) / segment->slotSize);
+}
+
+//releases the physical memory used by a slot (its content stays in the file)
+static void ReleaseSlotMemory(MappedSegment* segment, unsigned slot)
+{
+	char* ptr = segment->base + static_cast<size_t>(slot) * segment->slotSize;
+#ifdef _WIN32
+	//unlocking pages that are not locked removes them from the working set
+	VirtualUnlock(ptr,segment->slotSize);
+#elif defined(MADV_PAGEOUT)
+	madvise(ptr,segment->slotSize,MADV_PAGEOUT);
+#else
+	//shared file mapping: dirty pages are written back to the file, not lost
+	madvise(ptr,segment->slotSize,MADV_DONTNEED);
+#endif
+}
+
+//discards the content of a slot that is not used anymore
+static void DiscardSlot(MappedSegment* segment, unsigned slot)
+{
+#ifdef MADV_REMOVE
+	//frees the corresponding part of the file as well (no useless write back)
+	char* ptr = segment->base + static_cast<size_t>(slot) * segment->slotSize;
+	if (madvise(ptr,segment->slotSize,MADV_REMOVE) == 0)
+		return;
+#endif
+	ReleaseSlotMemory(segment,slot);
+}
+
+//! Resident slot (for sorting by access stamp)
+struct ResidentSlot
+{
+	int stamp;
+	MappedSegment* segment;
+	unsigned slot;
+
+	bool operator < (const ResidentSlot& other) const { return stamp < other.stamp; }
+};
+
+//releases the least recently used chunks until the residency limit is respected (mutex locked)
+static void EnforceResidencyLimit()
+{
+	int limitPages = LoadInt(s_residencyLimitPages);
+	if (limitPages == 0 || LoadInt(s_residentPages) <= limitPages)
+		return;
+
+	//the chunks touched from now on will be more recent than all the current ones
+	s_clock.fetchAndAddOrdered(1);
+
+	std::vector<ResidentSlot> residentSlots;
+	try
+	{
+		for (size_t i=0; i<s_segments.size(); ++i)
+		{
+			MappedSegment* segment = s_segments[i];
+			if (segment->usedCount == 0)
+				continue;
+			for (unsigned j=0; j<segment->slotCount; ++j)
+			{
+				int stamp = LoadInt(segment->stamps[j]);
+				if (stamp != 0 && segment->used[j])
+				{
+					ResidentSlot residentSlot;
+					residentSlot.stamp = stamp;
+					residentSlot.segment = segment;
+					residentSlot.slot = j;
+					residentSlots.push_back(residentSlot);
+				}
+			}
+		}
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory: we'll retry later
+		return;
+	}
+
+	std::sort(residentSlots.begin(),residentSlots.end());
+
+	//the most recently used chunk is always kept
+	for (size_t i=0; i+1<residentSlots.size() && LoadInt(s_residentPages) > limitPages; ++i)
+	{
+		ResidentSlot& residentSlot = residentSlots[i];
+		//if the stamp has changed, the chunk has just been touched again
+		if (residentSlot.segment->stamps[residentSlot.slot].testAndSetOrdered(residentSlot.stamp,0))
+		{
+			ReleaseSlotMemory(residentSlot.segment,residentSlot.slot);
+			s_residentPages.fetchAndAddOrdered(-residentSlot.segment->slotPages);
+		}
+	}
+}
+
+void MemoryMappedChunks::SetEnabled(bool state)
+{
+	s_enabled.fetchAndStoreOrdered(state ? 1 : 0);
+}
+
+bool MemoryMappedChunks::IsEnabled()
+{
+	return LoadInt(s_enabled) != 0;
+}
+
+void MemoryMappedChunks::SetTempDirectory(const char* path)
+{
+	QMutexLocker locker(&s_mutex);
+	s_tempDir = (path ? path : "");
+}
+
+void MemoryMappedChunks::SetResidencyLimit(size_t maxResidentBytes)
+{
+	QMutexLocker locker(&s_mutex);
+	s_residencyLimit = maxResidentBytes;
+
+	int limitPages = 0;
+	if (maxResidentBytes != 0)
+	{
+		size_t pageCount = maxResidentBytes / GetPageSize();
+		limitPages = (pageCount == 0 ? 1 : pageCount > 0x7FFFFFFF ? 0x7FFFFFFF : static_cast<int>(pageCount));
+	}
+	s_residencyLimitPages.fetchAndStoreOrdered(limitPages);
+
+	EnforceResidencyLimit();
+}
+
+size_t MemoryMappedChunks::GetResidencyLimit()
+{
+	QMutexLocker locker(&s_mutex);
+	return s_residencyLimit;
+}
+
+void* MemoryMappedChunks::Reallocate(void* chunk, size_t size, size_t maxSize)
+{
+	assert(size <= maxSize);
+
+	if (!chunk)
+	{
+		if (IsEnabled())
+		{
+			void* mappedChunk = Map(maxSize);
+			if (mappedChunk)
+				return mappedChunk;
+			//otherwise we fall back to the heap
+		}
+	}
+	else if (IsMapped(chunk))
+	{
+		//mapped chunks already have their maximum size
+		return (size <= maxSize ? chunk : 0);
+	}
+
+	return realloc(chunk,size);
+}
+
+void MemoryMappedChunks::Free(void* chunk)
+{
+	if (chunk && !(HasMappedChunks() && Unmap(chunk)))
+		free(chunk);
+}
+
+void* MemoryMappedChunks::Map(size_t size)
+{
+	if (size == 0)
+		return 0;
+
+	QMutexLocker locker(&s_mutex);
+
+	size_t pageSize = GetPageSize();
+	size_t slotSize = ((size + pageSize - 1) / pageSize) * pageSize;
+
+	MappedSegment* segment = 0;
+	try
+	{
+		std::vector<MappedSegment*>& availableSegments = s_availableSegments[slotSize];
+		if (availableSegments.empty())
+		{
+			segment = CreateSegment(slotSize,pageSize);
+			if (!segment)
+				return 0;
+			availableSegments.push_back(segment);
+		}
+		segment = availableSegments.back();
+
+		if (segment->usedCount + 1 == segment->slotCount)
+			availableSegments.pop_back();
+	}
+	catch (const std::bad_alloc&)
+	{
+		//not enough memory
+		return 0;
+	}
+
+	unsigned slot = static_cast<unsigned>(std::find(segment->used.begin(),segment->used.end(),false) - segment->used.begin());
+	assert(slot < segment->slotCount);
+	segment->used[slot] = true;
+	++segment->usedCount;
+	s_mappedBytes += slotSize;
+	s_mappedChunkCount.fetchAndAddOrdered(1);
+
+	//a new chunk is about to be filled: it becomes the most recently used one
+	int clock = s_clock.fetchAndAddOrdered(1) + 1;
+	int previousStamp = segment->stamps[slot].fetchAndStoreOrdered(clock);
+	assert(previousStamp == 0);
+	if (previousStamp == 0)
+		s_residentPages.fetchAndAddOrdered(segment->slotPages);
+
+	EnforceResidencyLimit();
+
+	return segment->base + static_cast<size_t>(slot) * slotSize;
+}
+
+bool MemoryMappedChunks::Unmap(void* chunk)
+{
+	if (!chunk || !HasMappedChunks())
+		return false;
+
+	QMutexLocker locker(&s_mutex);
+
+	MappedSegment* segment = FindSegment(chunk);
+	if (!segment)
+		return false;
+
+	unsigned slot = GetSlotIndex(segment,chunk);
+	assert(segment->base + static_cast<size_t>(slot) * segment->slotSize == chunk);
+	if (!segment->used[slot])
+	{
+		assert(false);
+		return false;
+	}
+
+	if (segment->stamps[slot].fetchAndStoreOrdered(0) != 0)
+		s_residentPages.fetchAndAddOrdered(-segment->slotPages);
+
+	//the chunk content is not needed anymore
+	DiscardSlot(segment,slot);
+
+	if (segment->usedCount == segment->slotCount)
+	{
+		//the segment becomes available again (if we can't store it, the slot is simply lost)
+		try
+		{
+			s_availableSegments[segment->slotSize].push_back(segment);
+		}
+		catch (const std::bad_alloc&)
+		{
+		}
+	}
+	segment->used[slot] = false;
+	--segment->usedCount;
+	s_mappedBytes -= segment->slotSize;
+	s_mappedChunkCount.fetchAndAddOrdered(-1);
+
+	return true;
+}
+
+bool MemoryMappedChunks::IsMapped(const void* chunk)
+{
+	return chunk && HasMappedChunks() && FindSegment(chunk) != 0;
+}
+
+void MemoryMappedChunks::TouchMapped(const void* chunk)
+{
+	MappedSegment* segment = FindSegment(chunk);
+	if (!segment)
+		return;
+
+	QAtomicInt& stamp = segment->stamps[GetSlotIndex(segment,chunk)];
+	int clock = LoadInt(s_clock);
+	int previousStamp = LoadInt(stamp);
+
+	//most of the time, the chunk has already been touched since the last clock tick
+	//(if the exchange fails, another thread has just touched it)
+	if (previousStamp == clock || !stamp.testAndSetOrdered(previousStamp,clock))
+		return;
+
+	if (previousStamp == 0)
+	{
+		//the chunk had been released from memory
+		int residentPages = s_residentPages.fetchAndAddOrdered(segment->slotPages) + segment->slotPages;
+		int limitPages = LoadInt(s_residencyLimitPages);
+		//we don't wait for the mutex (the limit will be enforced on a next call)
+		if (limitPages != 0 && residentPages > limitPages && s_mutex.tryLock())
+		{
+			EnforceResidencyLimit();
+			s_mutex.unlock();
+		}
+	}
+}
+
+bool MemoryMappedChunks::GetChunkMemory(const void* chunk, size_t& mappedBytes, size_t& residentBytes)
+{
+	if (!chunk || !HasMappedChunks())
+		return false;
+
+	MappedSegment* segment = FindSegment(chunk);
+	if (!segment)
+		return false;
+
+	mappedBytes = segment->slotSize;
+
+#ifdef __linux__
+	//we ask the system for the pages actually in memory
+	size_t pageSize = GetPageSize();
+	std::vector<unsigned char> pages(static_cast<size_t>(segment->slotPages));
+	if (mincore(const_cast<void*>(chunk),segment->slotSize,&pages[0]) == 0)
+	{
+		residentBytes = 0;
+		for (size_t i=0; i<pages.size(); ++i)
+			if (pages[i] & 1)
+				residentBytes += pageSize;
+		return true;
+	}
+#endif
+
+	residentBytes = (LoadInt(segment->stamps[GetSlotIndex(segment,chunk)]) != 0 ? segment->slotSize : 0);
+
+	return true;
+}
+
+size_t MemoryMappedChunks::GetMappedBytes()
+{
+	QMutexLocker locker(&s_mutex);
+	return s_mappedBytes;
+}
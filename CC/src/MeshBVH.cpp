@@ -0,0 +1,156 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "MeshBVH.h"
+
+//local
+#include "GenericIndexedMesh.h"
+
+//system
+#include <assert.h>
+#include <algorithm>
+
+using namespace CCLib;
+
+MeshBVH::MeshBVH()
+	: m_mesh(0)
+{
+}
+
+void MeshBVH::clear()
+{
+	m_mesh = 0;
+	m_nodes.clear();
+	m_triangleIndexes.clear();
+}
+
+bool MeshBVH::build(GenericIndexedMesh* mesh, unsigned maxTrianglesPerLeaf/*=8*/)
+{
+	clear();
+
+	if (!mesh || mesh->size() == 0)
+		return false;
+
+	unsigned triCount = mesh->size();
+	std::vector<TriangleBox> boxes;
+	try
+	{
+		boxes.resize(triCount);
+		m_triangleIndexes.resize(triCount);
+		//a binary tree has less than 2*(leaves) nodes
+		m_nodes.reserve(2*(triCount/std::max(1u,maxTrianglesPerLeaf/2)+1));
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		clear();
+		return false;
+	}
+
+	for (unsigned i=0; i<triCount; ++i)
+	{
+		CCVector3 A, B, C;
+		mesh->getTriangleSummits(i,A,B,C);
+
+		TriangleBox& box = boxes[i];
+		for (unsigned d=0; d<3; ++d)
+		{
+			box.bbMin[d] = std::min(A.u[d],std::min(B.u[d],C.u[d]));
+			box.bbMax[d] = std::max(A.u[d],std::max(B.u[d],C.u[d]));
+			box.center[d] = (box.bbMin[d] + box.bbMax[d]) / 2;
+		}
+		m_triangleIndexes[i] = i;
+	}
+
+	try
+	{
+		buildNode(boxes,0,triCount,std::max(1u,maxTrianglesPerLeaf));
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		clear();
+		return false;
+	}
+
+	m_mesh = mesh;
+
+	return true;
+}
+
+void MeshBVH::buildNode(std::vector<TriangleBox>& boxes, unsigned first, unsigned count, unsigned maxTrianglesPerLeaf)
+{
+	assert(count != 0);
+
+	size_t nodeIndex = m_nodes.size();
+	m_nodes.push_back(Node());
+
+	//node bounding-box (and bounding-box of the triangles centers)
+	PointCoordinateType bbMin[3], bbMax[3], cMin[3], cMax[3];
+	{
+		const TriangleBox& box = boxes[m_triangleIndexes[first]];
+		for (unsigned d=0; d<3; ++d)
+		{
+			bbMin[d] = box.bbMin[d];
+			bbMax[d] = box.bbMax[d];
+			cMin[d] = cMax[d] = box.center[d];
+		}
+	}
+	for (unsigned i=first+1; i<first+count; ++i)
+	{
+		const TriangleBox& box = boxes[m_triangleIndexes[i]];
+		for (unsigned d=0; d<3; ++d)
+		{
+			bbMin[d] = std::min(bbMin[d],box.bbMin[d]);
+			bbMax[d] = std::max(bbMax[d],box.bbMax[d]);
+			cMin[d] = std::min(cMin[d],box.center[d]);
+			cMax[d] = std::max(cMax[d],box.center[d]);
+		}
+	}
+	{
+		Node& node = m_nodes[nodeIndex];
+		for (unsigned d=0; d<3; ++d)
+		{
+			node.bbMin[d] = bbMin[d];
+			node.bbMax[d] = bbMax[d];
+		}
+	}
+
+	//split dimension: the largest extent of the centers
+	unsigned char dim = 0;
+	for (unsigned char d=1; d<3; ++d)
+		if (cMax[d]-cMin[d] > cMax[dim]-cMin[dim])
+			dim = d;
+
+	//leaf
+	if (count <= maxTrianglesPerLeaf || cMax[dim] <= cMin[dim])
+	{
+		m_nodes[nodeIndex].first = first;
+		m_nodes[nodeIndex].count = count;
+		return;
+	}
+
+	//median split
+	unsigned half = count/2;
+	std::vector<unsigned>::iterator begin = m_triangleIndexes.begin() + first;
+	std::nth_element(begin, begin+half, begin+count, TriangleCenterComp(boxes,dim));
+
+	buildNode(boxes,first,half,maxTrianglesPerLeaf);
+	unsigned secondChild = static_cast<unsigned>(m_nodes.size());
+	buildNode(boxes,first+half,count-half,maxTrianglesPerLeaf);
+
+	m_nodes[nodeIndex].first = secondChild;
+	m_nodes[nodeIndex].count = 0;
+}
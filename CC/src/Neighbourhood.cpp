@@ -21,6 +21,7 @@
 #include "GenericIndexedMesh.h"
 #include "GenericIndexedCloudPersist.h"
 #include "Matrix.h"
+#include "SymMatrix.h"
 #include "Delaunay2dMesh.h"
 #include "ConjugateGradient.h"
 #include "DistanceComputationTools.h"
@@ -30,6 +31,7 @@
 //system
 #include <string.h>
 #include <assert.h>
+#include <algorithm>
 
 using namespace CCLib;
 
@@ -146,12 +148,12 @@ void Neighbourhood::computeGravityCenter()
 	setGravityCenter(G);
 }
 
-CCLib::SquareMatrixd Neighbourhood::computeCovarianceMatrix()
+bool Neighbourhood::computeCovarianceMatrix(SymMatrix3d& covMat)
 {
 	assert(m_associatedCloud);
 	unsigned count = (m_associatedCloud ? m_associatedCloud->size() : 0);
 	if (!count)
-		return CCLib::SquareMatrixd();
+		return false;
 
 	//we get centroid
 	const CCVector3* G = getGravityCenter();
@@ -178,7 +180,6 @@ CCLib::SquareMatrixd Neighbourhood::computeCovarianceMatrix()
 	}
 
 	//symmetry
-	CCLib::SquareMatrixd covMat(3);
 	covMat.m_values[0][0] = mXX/(double)count;
 	covMat.m_values[1][1] = mYY/(double)count;
 	covMat.m_values[2][2] = mZZ/(double)count;
@@ -186,7 +187,21 @@ CCLib::SquareMatrixd Neighbourhood::computeCovarianceMatrix()
 	covMat.m_values[2][0] = covMat.m_values[0][2] = mXZ/(double)count;
 	covMat.m_values[2][1] = covMat.m_values[1][2] = mYZ/(double)count;
 
-	return covMat;
+	return true;
+}
+
+CCLib::SquareMatrixd Neighbourhood::computeCovarianceMatrix()
+{
+	SymMatrix3d covMat;
+	if (!computeCovarianceMatrix(covMat))
+		return CCLib::SquareMatrixd();
+
+	CCLib::SquareMatrixd mat(3);
+	for (unsigned i=0; i<3; ++i)
+		for (unsigned j=0; j<3; ++j)
+			mat.m_values[i][j] = covMat.m_values[i][j];
+
+	return mat;
 }
 
 PointCoordinateType Neighbourhood::computeLargestRadius()
@@ -233,24 +248,28 @@ bool Neighbourhood::computeLeastSquareBestFittingPlane()
 	if (pointCount > 3)
 	{
 		//we determine plane normal by computing the smallest eigen value of M = 1/n * S[(p-µ)*(p-µ)']
-		CCLib::SquareMatrixd eig = computeCovarianceMatrix().computeJacobianEigenValuesAndVectors();
+		//(fixed-size matrix: no dynamic allocation, as this is called for each point when computing normals)
+		SymMatrix3d covMat;
+		if (!computeCovarianceMatrix(covMat))
+			return false;
 
-		//invalid matrix?
-		if (!eig.isValid())
+		double eigenValues[3];
+		double eigenVectors[3][3];
+		if (!covMat.computeJacobianEigenValuesAndVectors(eigenValues,eigenVectors))
 			return false;
 
 		//get normal
 		{
 			double vec[3];
 			//the smallest eigen vector corresponds to the "least square best fitting plane" normal
-			eig.getMinEigenValueAndVector(vec);
+			SymMatrix3d::GetMinEigenValueAndVector(eigenValues,eigenVectors,vec);
 			theLSQPlaneVectors[2] = CCVector3::fromArray(vec);
 		}
 
 		//get also X (Y will be deduced by cross product, see below
 		{
 			double vec[3];
-			eig.getMaxEigenValueAndVector(vec);
+			SymMatrix3d::GetMaxEigenValueAndVector(eigenValues,eigenVectors,vec);
 			theLSQPlaneVectors[0] = CCVector3::fromArray(vec);
 		}
 
@@ -348,87 +367,32 @@ bool Neighbourhood::computeHeightFunction()
 		}
     }
 
-	//compute the A matrix and b vector
-	float *A = new float[6*count];
-	float *b = new float[count];
+	//we directly accumulate tA.A and tA.b (with A = [1 X Y X^2 X.Y Y^2] and b = [Z] for each point)
+	SymMatrixTpl<6,double> tAA;
+	double tAb[6] = {0,0,0,0,0,0};
 
 	float lmax2 = 0; //max (squared) dimension
 
     //for all points
+	for (unsigned i=0; i<count; ++i)
 	{
-		float* _A = A;
-		float* _b = b;
-		for (unsigned i=0; i<count; ++i)
-		{
-			CCVector3 P = *m_associatedCloud->getPoint(i) - *G;
-
-			float lX = static_cast<float>(P.u[idx_X]);
-			float lY = static_cast<float>(P.u[idx_Y]);
-			float lZ = static_cast<float>(P.u[idx_Z]);
-
-			*_A++ = 1.0f;
-			*_A++ = lX;
-			*_A++ = lY;
-			*_A = lX*lX;
-			//by the way, we track the max 'X' squared dimension
-			if (*_A > lmax2)
-				lmax2 = *_A;
-			++_A;
-			*_A++ = lX*lY;
-			*_A = lY*lY;
-			//by the way, we track the max 'Y' squared dimension
-			if (*_A > lmax2)
-				lmax2 = *_A;
-			++_A;
-
-			*_b++ = lZ;
-			lZ *= lZ;
-			//and don't forget to track the max 'Z' squared dimension as well
-			if (lZ > lmax2)
-				lmax2 = lZ;
-		}
-	}
+		CCVector3 P = *m_associatedCloud->getPoint(i) - *G;
 
-	//conjugate gradient initialization
-	//we solve tA.A.X=tA.b
-	ConjugateGradient<6,double> cg;
-	CCLib::SquareMatrixd& tAA = cg.A();
-	double* tAb = cg.b();
+		float lX = static_cast<float>(P.u[idx_X]);
+		float lY = static_cast<float>(P.u[idx_Y]);
+		float lZ = static_cast<float>(P.u[idx_Z]);
 
-	//compute tA.A and tA.b
-	{
-		for (unsigned i=0; i<6; ++i)
-		{
-			//tA.A part
-			for (unsigned j=i; j<6; ++j)
-			{
-				double tmp = 0;
-				float* _Ai = A+i;
-				float* _Aj = A+j;
-				for (unsigned k=0; k<count; ++k)
-				{
-					//tmp += A[(6*k)+i]*A[(6*k)+j];
-					tmp += static_cast<double>((*_Ai) * (*_Aj));
-					_Ai += 6;
-					_Aj += 6;
-				}
-				tAA.m_values[j][i] = tAA.m_values[i][j] = tmp;
-			}
+		float Ai[6] = { 1.0f, lX, lY, lX*lX, lX*lY, lY*lY };
 
-			//tA.b part
-			{
-				double tmp = 0;
-				float* _Ai = A+i;
-				float* _b = b;
-				for (unsigned k=0; k<count; ++k)
-				{
-					//tmp += A[(6*k)+i]*b[k];
-					tmp += static_cast<double>((*_Ai) * (*_b++));
-					_Ai += 6;
-				}
-				tAb[i] = tmp;
-			}
-		}
+		//tA.A part
+		tAA.addOuterProduct(Ai);
+		//tA.b part
+		for (unsigned j=0; j<6; ++j)
+			tAb[j] += static_cast<double>(Ai[j] * lZ);
+
+		//by the way, we track the max 'X', 'Y' and 'Z' squared dimensions
+		lmax2 = std::max(lmax2,std::max(Ai[3],Ai[5]));
+		lmax2 = std::max(lmax2,lZ*lZ);
 	}
 
 	//first guess for X: plane equation (a0.x+a1.y+a2.z=a3 --> z = a3/a2 - a0/a2.x - a1/a2.y)
@@ -439,15 +403,27 @@ bool Neighbourhood::computeHeightFunction()
 						0,
 						0 };
 
-	//special case: a0 = a1 = a2 = 0! //happens for perfectly flat surfaces!
-	if (X0[1] == 0 && X0[2] == 0)
-		X0[0] = 1.0;
+	//we solve tA.A.X=tA.b directly (the conjugate gradient is only used for degenerate systems)
+	if (!tAA.solveLDLT(tAb,X0))
+	{
+		//conjugate gradient initialization
+		ConjugateGradient<6,double> cg;
+		tAA.completeLowerPart();
+		for (unsigned i=0; i<6; ++i)
+		{
+			for (unsigned j=0; j<6; ++j)
+				cg.A().m_values[i][j] = tAA.m_values[i][j];
+			cg.b()[i] = tAb[i];
+		}
 
-	//init. conjugate gradient
-	cg.initConjugateGradient(X0);
+		//special case: a0 = a1 = a2 = 0! //happens for perfectly flat surfaces!
+		if (X0[1] == 0 && X0[2] == 0)
+			X0[0] = 1.0;
 
-    //conjugate gradient iterations
-	{
+		//init. conjugate gradient
+		cg.initConjugateGradient(X0);
+
+		//conjugate gradient iterations
 		double convergenceThreshold = static_cast<double>(lmax2) * 1.0e-8;  //max. error for convergence = 1e-8 of largest cloud dimension (empirical!)
 		for (unsigned i=0; i<1500; ++i)
 		{
@@ -456,14 +432,6 @@ bool Neighbourhood::computeHeightFunction()
 				break;
 		}
 	}
-	//fprintf(fp,"X%i=(%f,%f,%f,%f,%f,%f)\n",i,X0[0],X0[1],X0[2],X0[3],X0[4],X0[5]);
-	//fprintf(fp,"lastError=%E/%E\n",lastError,convergenceThreshold);
-	//fclose(fp);
-
-	delete[] A;
-	A = 0;
-	delete[] b;
-	b = 0;
 
 	//output
 	{
@@ -502,57 +470,37 @@ bool Neighbourhood::compute3DQuadric()
 
 	unsigned count = m_associatedCloud->size();
 
-    //we compute M = [x2 y2 z2 xy yz xz x y z 1] for all points
-    PointCoordinateType* M = new PointCoordinateType[count*10];
-    if (!M)
-        return false;
-
-	PointCoordinateType* _M = M;
+    //we directly accumulate D = tM.M where M = [x2 y2 z2 xy yz xz x y z 1] (for all points)
+    SymMatrixTpl<10,double> D;
 	for (unsigned i=0; i<count; ++i)
 	{
 		CCVector3 P = *m_associatedCloud->getPoint(i) - *G;
 
-        //we fill the ith line
-	    (*_M++) = P.x * P.x;
-	    (*_M++) = P.y * P.y;
-	    (*_M++) = P.z * P.z;
-	    (*_M++) = P.x * P.y;
-	    (*_M++) = P.y * P.z;
-	    (*_M++) = P.x * P.z;
-	    (*_M++) = P.x;
-	    (*_M++) = P.y;
-	    (*_M++) = P.z;
-	    (*_M++) = 1.0;
+        //ith line of M
+		PointCoordinateType Mi[10] = {	P.x * P.x,
+										P.y * P.y,
+										P.z * P.z,
+										P.x * P.y,
+										P.y * P.z,
+										P.x * P.z,
+										P.x,
+										P.y,
+										P.z,
+										1 };
+
+		D.addOuterProduct(Mi);
 	}
 
-    //D = tM.M
-    SquareMatrixd D(10);
-	for (unsigned l=0; l<10; ++l)
-	{
-        for (unsigned c=0; c<10; ++c)
-        {
-            double sum = 0;
-            _M = M;
-            for (unsigned i=0; i<count; ++i, _M+=10)
-                sum += static_cast<double>(_M[l] * _M[c]);
-
-            D.m_values[l][c] = sum;
-        }
-	}
-
-    //we don't need M anymore
-	delete[] M;
-	M=0;
-
     //now we compute eigen values and vectors of D
-	SquareMatrixd eig = D.computeJacobianEigenValuesAndVectors();
+	double eigenValues[10];
+	double eigenVectors[10][10];
     //failure?
-	if (!eig.isValid())
+	if (!D.computeJacobianEigenValuesAndVectors(eigenValues,eigenVectors))
 		return false;
 
 	//we get the eigen vector corresponding to the minimum eigen value
 	double vec[10];
-	/*double lambdaMin = */eig.getMinEigenValueAndVector(vec);
+	/*double lambdaMin = */SymMatrixTpl<10,double>::GetMinEigenValueAndVector(eigenValues,eigenVectors,vec);
 
     //we store result
 	{
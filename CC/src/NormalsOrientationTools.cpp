@@ -0,0 +1,499 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "NormalsOrientationTools.h"
+
+//local
+#include "GenericIndexedCloudPersist.h"
+#include "GenericProgressCallback.h"
+#include "ReferenceCloud.h"
+
+//system
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <algorithm>
+#include <new>
+
+using namespace CCLib;
+
+//! Invalid vertex index (for unused edge slots)
+static const unsigned MST_INVALID_VERTEX = static_cast<unsigned>(-1);
+
+//! Weighted graph edge
+struct MSTEdge
+{
+	//! First vertex (index)
+	unsigned v1;
+	//! Second vertex (index)
+	unsigned v2;
+	//! Associated weight
+	float weight;
+
+	//! Default constructor (unused edge)
+	MSTEdge() : v1(MST_INVALID_VERTEX), v2(MST_INVALID_VERTEX), weight(0) {}
+
+	//! Constructor (no vertex order)
+	MSTEdge(unsigned a, unsigned b, float w)
+		: v1(std::min(a,b))
+		, v2(std::max(a,b))
+		, weight(w)
+	{
+		assert(weight >= 0);
+	}
+
+	//! Strict weak ordering operator (by weight, then by vertices so that the order is deterministic)
+	inline bool operator < (const MSTEdge& other) const
+	{
+		if (weight != other.weight)
+			return weight < other.weight;
+		if (v1 != other.v1)
+			return v1 < other.v1;
+		return v2 < other.v2;
+	}
+
+	//! Returns whether the edge slot is unused
+	static bool IsUnused(const MSTEdge& edge) { return edge.v1 == MST_INVALID_VERTEX; }
+};
+
+//! Disjoint sets (union-find) structure
+class MSTDisjointSets
+{
+public:
+
+	//! Initializes the structure with 'count' singletons
+	/** \return false if there's not enough memory
+	**/
+	bool init(unsigned count)
+	{
+		try
+		{
+			m_parents.resize(count);
+			m_ranks.resize(count,0);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+		for (unsigned i=0; i<count; ++i)
+			m_parents[i] = i;
+
+		return true;
+	}
+
+	//! Returns the representative of the set that contains a given element
+	inline unsigned find(unsigned i)
+	{
+		//path halving
+		while (m_parents[i] != i)
+		{
+			m_parents[i] = m_parents[m_parents[i]];
+			i = m_parents[i];
+		}
+		return i;
+	}
+
+	//! Merges the sets that contain two elements
+	/** \return false if both elements were already in the same set
+	**/
+	inline bool merge(unsigned i, unsigned j)
+	{
+		i = find(i);
+		j = find(j);
+		if (i == j)
+			return false;
+
+		//union by rank
+		if (m_ranks[i] < m_ranks[j])
+			std::swap(i,j);
+		m_parents[j] = i;
+		if (m_ranks[i] == m_ranks[j])
+			++m_ranks[i];
+
+		return true;
+	}
+
+protected:
+
+	//! Parent of each element
+	std::vector<unsigned> m_parents;
+	//! Rank of each (root) element
+	std::vector<unsigned char> m_ranks;
+};
+
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+//! Min. number of edges for which the sort is multi-threaded
+static const size_t MIN_EDGES_FOR_MT_SORT = (1<<16);
+
+//! Edges sort job (a range of edges)
+struct edgesSortChunk
+{
+	//! First edge
+	MSTEdge* begin;
+	//! First edge of the second (sorted) half (merge only)
+	MSTEdge* middle;
+	//! Last edge (excluded)
+	MSTEdge* end;
+};
+
+void SortEdges_MT(edgesSortChunk& chunk)
+{
+	std::sort(chunk.begin,chunk.end);
+}
+
+void MergeEdges_MT(edgesSortChunk& chunk)
+{
+	std::inplace_merge(chunk.begin,chunk.middle,chunk.end);
+}
+
+#endif
+
+//! Sorts the graph edges by increasing weight
+/** Multi-threaded (if possible): each thread sorts a range of
+	edges, then the sorted ranges are merged two by two.
+**/
+static void SortEdges(std::vector<MSTEdge>& edges)
+{
+	if (edges.size() < 2)
+		return;
+
+#ifdef ENABLE_MT_OCTREE
+	const size_t threadCount = static_cast<size_t>(std::max(1,QThreadPool::globalInstance()->maxThreadCount()));
+	if (threadCount > 1 && edges.size() >= MIN_EDGES_FOR_MT_SORT)
+	{
+		//ranges boundaries
+		std::vector<MSTEdge*> bounds;
+		bounds.reserve(threadCount+1);
+		{
+			const size_t chunkSize = (edges.size() + threadCount - 1) / threadCount;
+			MSTEdge* data = &(edges[0]);
+			for (size_t k=0; k<threadCount; ++k)
+				bounds.push_back(data + std::min(edges.size(),k*chunkSize));
+			bounds.push_back(data + edges.size());
+		}
+
+		std::vector<edgesSortChunk> chunks;
+		chunks.reserve(threadCount);
+		for (size_t k=0; k+1<bounds.size(); ++k)
+		{
+			edgesSortChunk chunk;
+			chunk.begin = chunk.middle = bounds[k];
+			chunk.end = bounds[k+1];
+			chunks.push_back(chunk);
+		}
+		QtConcurrent::blockingMap(chunks, SortEdges_MT);
+
+		//merge the sorted ranges (two by two)
+		while (bounds.size() > 2)
+		{
+			chunks.clear();
+			std::vector<MSTEdge*> mergedBounds;
+			size_t k = 0;
+			for (; k+2<bounds.size(); k+=2)
+			{
+				edgesSortChunk chunk;
+				chunk.begin = bounds[k];
+				chunk.middle = bounds[k+1];
+				chunk.end = bounds[k+2];
+				chunks.push_back(chunk);
+				mergedBounds.push_back(bounds[k]);
+			}
+			//odd number of ranges: the last one is left as is
+			if (k+1<bounds.size())
+				mergedBounds.push_back(bounds[k]);
+			mergedBounds.push_back(bounds.back());
+
+			QtConcurrent::blockingMap(chunks, MergeEdges_MT);
+
+			bounds.swap(mergedBounds);
+		}
+
+		return;
+	}
+#endif
+
+	std::sort(edges.begin(),edges.end());
+}
+
+int NormalsOrientationTools::orientNormalsWithMST(	GenericIndexedCloudPersist* theCloud,
+													std::vector<CCVector3>& normals,
+													unsigned kNN,
+													GenericProgressCallback* progressCb/*=0*/,
+													DgmOctree* inputOctree/*=0*/,
+													unsigned* patchCount/*=0*/,
+													unsigned* inversionCount/*=0*/)
+{
+	if (!theCloud || kNN == 0)
+		return -1;
+
+	unsigned numberOfPoints = theCloud->size();
+	if (normals.size() != numberOfPoints)
+		return -1;
+
+	if (patchCount)
+		*patchCount = 0;
+	if (inversionCount)
+		*inversionCount = 0;
+
+	if (numberOfPoints == 0)
+		return 0;
+
+	DgmOctree* theOctree = inputOctree;
+	if (!theOctree)
+	{
+		theOctree = new DgmOctree(theCloud);
+		if (theOctree->build(progressCb)<1)
+		{
+			delete theOctree;
+			return -3;
+		}
+	}
+
+	uchar level = theOctree->findBestLevelForAGivenPopulationPerCell(kNN*2);
+
+	int result = 0;
+	try
+	{
+		//graph edges: 'kNN' slots per point (so that each cell can be processed independently)
+		std::vector<MSTEdge> edges;
+		edges.resize(static_cast<size_t>(numberOfPoints)*kNN);
+
+		//parameters
+		void* additionalParameters[3] = {	static_cast<void*>(&normals),
+											static_cast<void*>(&(edges[0])),
+											static_cast<void*>(&kNN) };
+
+#ifdef ENABLE_MT_OCTREE
+		if (theOctree->executeFunctionForAllCellsAtLevel_MT(level,
+#else
+		if (theOctree->executeFunctionForAllCellsAtLevel(	level,
+#endif
+															&computeCellMSTGraphAtLevel,
+															additionalParameters,
+															progressCb,
+															"Build kNN graph") == 0)
+		{
+			//something went wrong (or process canceled)
+			result = -5;
+		}
+		else
+		{
+			//remove the unused slots
+			edges.erase(std::remove_if(edges.begin(),edges.end(),MSTEdge::IsUnused),edges.end());
+
+			if (progressCb)
+			{
+				char buffer[256];
+				sprintf(buffer,"Compute Minimum spanning tree\nPoints: %u\nEdges: %u",numberOfPoints,static_cast<unsigned>(edges.size()));
+				progressCb->reset();
+				progressCb->setMethodTitle("Orient normals (MST)");
+				progressCb->setInfo(buffer);
+				progressCb->start();
+			}
+
+			//Kruskal's algorithm
+			SortEdges(edges);
+
+			MSTDisjointSets sets;
+			if (!sets.init(numberOfPoints))
+				throw std::bad_alloc();
+
+			//we keep the tree edges at the beginning of the same array
+			size_t treeEdgeCount = 0;
+			for (size_t i=0; i<edges.size(); ++i)
+			{
+				if (sets.merge(edges[i].v1,edges[i].v2))
+					edges[treeEdgeCount++] = edges[i];
+			}
+			edges.resize(treeEdgeCount);
+
+			//tree adjacency (compressed) table
+			std::vector<unsigned> firstNeighbor(numberOfPoints+1,0);
+			std::vector<unsigned> neighbors(2*treeEdgeCount);
+			{
+				for (size_t i=0; i<treeEdgeCount; ++i)
+				{
+					++firstNeighbor[edges[i].v1+1];
+					++firstNeighbor[edges[i].v2+1];
+				}
+				for (unsigned i=0; i<numberOfPoints; ++i)
+					firstNeighbor[i+1] += firstNeighbor[i];
+
+				std::vector<unsigned> fillPos(firstNeighbor.begin(),firstNeighbor.end()-1);
+				for (size_t i=0; i<treeEdgeCount; ++i)
+				{
+					neighbors[fillPos[edges[i].v1]++] = edges[i].v2;
+					neighbors[fillPos[edges[i].v2]++] = edges[i].v1;
+				}
+			}
+			//we don't need the edges anymore
+			std::vector<MSTEdge>().swap(edges);
+
+			//propagate the orientation along the tree (starting from the first point of each patch)
+			NormalizedProgress* nProgress = (progressCb ? new NormalizedProgress(progressCb,numberOfPoints) : 0);
+
+			std::vector<bool> visited(numberOfPoints,false);
+			std::vector<unsigned> stack;
+			unsigned patches = 0;
+			unsigned inversions = 0;
+			for (unsigned seed=0; seed<numberOfPoints && result == 0; ++seed)
+			{
+				if (visited[seed])
+					continue;
+
+				//new patch
+				++patches;
+				visited[seed] = true;
+				stack.push_back(seed);
+
+				while (!stack.empty())
+				{
+					unsigned v = stack.back();
+					stack.pop_back();
+
+					const CCVector3& N = normals[v];
+					for (unsigned j=firstNeighbor[v]; j<firstNeighbor[v+1]; ++j)
+					{
+						unsigned w = neighbors[j];
+						if (visited[w])
+							continue;
+
+						//invert normal if necessary
+						if (N.dot(normals[w]) < 0)
+						{
+							normals[w] = -normals[w];
+							++inversions;
+						}
+						visited[w] = true;
+						stack.push_back(w);
+					}
+
+					if (nProgress && !nProgress->oneStep())
+					{
+						//process canceled by user
+						result = -5;
+						break;
+					}
+				}
+			}
+
+			if (nProgress)
+			{
+				delete nProgress;
+				nProgress = 0;
+				progressCb->stop();
+			}
+
+			if (patchCount)
+				*patchCount = patches;
+			if (inversionCount)
+				*inversionCount = inversions;
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		result = -4;
+	}
+
+	if (!inputOctree)
+		delete theOctree;
+
+	return result;
+}
+
+//"PER-CELL" METHOD: K-NEAREST NEIGHBOURS GRAPH
+//ADDITIONAL PARAMETERS (3):
+// [0] -> (std::vector<CCVector3>*) normals : points normals
+// [1] -> (MSTEdge*) edges : graph edges ('kNN' slots per point)
+// [2] -> (unsigned*) kNN : number of neighbours
+bool NormalsOrientationTools::computeCellMSTGraphAtLevel(	const DgmOctree::octreeCell& cell,
+															void** additionalParameters,
+															NormalizedProgress* nProgress/*=0*/)
+{
+	//parameters
+	const std::vector<CCVector3>& normals	= *static_cast<std::vector<CCVector3>*>(additionalParameters[0]);
+	MSTEdge* edges							= static_cast<MSTEdge*>(additionalParameters[1]);
+	unsigned kNN							= *static_cast<unsigned*>(additionalParameters[2]);
+
+	//structure for the nearest neighbor search
+	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
+	nNSS.level								= cell.level;
+	nNSS.minNumberOfNeighbors				= kNN+1; //+1 because we'll get the query point itself!
+	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
+	cell.parentOctree->computeCellCenter(nNSS.cellPos,cell.level,nNSS.cellCenter);
+
+	unsigned n = cell.points->size(); //number of points in the current cell
+
+	//we already know some of the neighbours: the points in the current cell!
+	{
+		try
+		{
+			nNSS.pointsInNeighbourhood.resize(n);
+		}
+		catch (.../*const std::bad_alloc&*/) //out of memory
+		{
+			return false;
+		}
+
+		DgmOctree::NeighboursSet::iterator it = nNSS.pointsInNeighbourhood.begin();
+		for (unsigned i=0; i<n; ++i,++it)
+		{
+			it->point = cell.points->getPointPersistentPtr(i);
+			it->pointIndex = cell.points->getPointGlobalIndex(i);
+		}
+	}
+	nNSS.alreadyVisitedNeighbourhoodSize = 1;
+
+	//for each point in the cell
+	for (unsigned i=0; i<n; ++i)
+	{
+		cell.points->getPoint(i,nNSS.queryPoint);
+
+		unsigned neighborCount = cell.parentOctree->findNearestNeighborsStartingFromCell(nNSS,false);
+		neighborCount = std::min(neighborCount,kNN+1);
+
+		//current point index
+		unsigned index = cell.points->getPointGlobalIndex(i);
+		const CCVector3& N1 = normals[index];
+
+		//each point has its own slots: no need to synchronize the threads
+		MSTEdge* pointEdges = edges + static_cast<size_t>(index)*kNN;
+		unsigned edgeCount = 0;
+		for (unsigned j=0; j<neighborCount && edgeCount<kNN; ++j)
+		{
+			//current neighbor index
+			unsigned neighborIndex = nNSS.pointsInNeighbourhood[j].pointIndex;
+			if (index != neighborIndex)
+			{
+				const CCVector3& N2 = normals[neighborIndex];
+				float weight = std::max(0.0f,1.0f - static_cast<float>(fabs(N1.dot(N2))));
+				pointEdges[edgeCount++] = MSTEdge(index,neighborIndex,weight);
+			}
+		}
+
+		if (nProgress && !nProgress->oneStep())
+			return false;
+	}
+
+	return true;
+}
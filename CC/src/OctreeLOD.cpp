@@ -0,0 +1,329 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "OctreeLOD.h"
+
+//local
+#include "GenericIndexedCloudPersist.h"
+#include "GenericProgressCallback.h"
+
+//system
+#include <assert.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#endif
+
+using namespace CCLib;
+
+OctreeLOD::OctreeLOD()
+{
+	memset(m_levelStarts,0,sizeof(m_levelStarts));
+}
+
+void OctreeLOD::clear()
+{
+	m_localIndexes.clear();
+	m_chunkLevelStarts.clear();
+	memset(m_levelStarts,0,sizeof(m_levelStarts));
+}
+
+//! Point LOD descriptor (for construction only)
+struct LODPoint
+{
+	//! Level
+	unsigned char level;
+	//! Cell code at this level (with reversed digits)
+	DgmOctree::OctreeCellCodeType key;
+	//! Local index (in its chunk)
+	unsigned localIndex;
+
+	//! Sorting operator
+	inline bool operator < (const LODPoint& p) const
+	{
+		return (level < p.level || (level == p.level && (key < p.key || (key == p.key && localIndex < p.localIndex))));
+	}
+};
+
+//! LOD construction job (a range of octree codes, or a chunk of points)
+struct LODBuildChunk
+{
+	//! Octree codes
+	const DgmOctree::IndexAndCode* codes;
+	//! First element
+	unsigned begin;
+	//! Last element (excluded)
+	unsigned end;
+	//! Per-point descriptors (indexed by point index)
+	LODPoint* points;
+	//! Output: sorted local indexes (chunk jobs only)
+	unsigned* localIndexes;
+	//! Output: level starts (chunk jobs only)
+	unsigned* levelStarts;
+};
+
+//! Returns the LOD level of the point (sorted) after 'previousCode'
+static inline unsigned char GetLevel(DgmOctree::OctreeCellCodeType code, DgmOctree::OctreeCellCodeType previousCode)
+{
+	//the point is the first of its cell for all the levels at which the codes differ
+	DgmOctree::OctreeCellCodeType diff = (code ^ previousCode);
+	if (diff == 0)
+		return static_cast<unsigned char>(OctreeLOD::LEVEL_COUNT-1); //duplicate point (same cell at the deepest level)
+
+	unsigned char digits = 0;
+	while (diff)
+	{
+		diff >>= 3;
+		++digits;
+	}
+	return static_cast<unsigned char>(DgmOctree::MAX_OCTREE_LEVEL + 1 - digits);
+}
+
+//! Returns the cell code at a given level with reversed digits (i.e. the coarsest child index becomes the fastest varying one)
+static inline DgmOctree::OctreeCellCodeType GetReversedCode(DgmOctree::OctreeCellCodeType code, unsigned char level)
+{
+	if (level > DgmOctree::MAX_OCTREE_LEVEL)
+		level = static_cast<unsigned char>(DgmOctree::MAX_OCTREE_LEVEL);
+	code >>= GET_BIT_SHIFT(level);
+
+	DgmOctree::OctreeCellCodeType reversed = 0;
+	for (unsigned char i=0; i<level; ++i)
+	{
+		reversed = (reversed << 3) | (code & 7);
+		code >>= 3;
+	}
+	return reversed;
+}
+
+static void ComputePointsLevel(LODBuildChunk& chunk)
+{
+	for (unsigned i=chunk.begin; i<chunk.end; ++i)
+	{
+		const DgmOctree::IndexAndCode& current = chunk.codes[i];
+		LODPoint& P = chunk.points[current.theIndex];
+		P.level = (i == 0 ? 0 : GetLevel(current.theCode,chunk.codes[i-1].theCode));
+		P.key = GetReversedCode(current.theCode,P.level);
+		P.localIndex = (current.theIndex & ELEMENT_INDEX_BIT_MASK);
+	}
+}
+
+static void SortChunkPoints(LODBuildChunk& chunk)
+{
+	LODPoint* first = chunk.points + chunk.begin;
+	LODPoint* last = chunk.points + chunk.end;
+	std::sort(first,last);
+
+	memset(chunk.levelStarts,0,sizeof(unsigned)*(OctreeLOD::LEVEL_COUNT+1));
+	for (LODPoint* P=first; P!=last; ++P)
+	{
+		*chunk.localIndexes++ = P->localIndex;
+		++chunk.levelStarts[P->level+1];
+	}
+	for (unsigned l=1; l<=OctreeLOD::LEVEL_COUNT; ++l)
+		chunk.levelStarts[l] += chunk.levelStarts[l-1];
+}
+
+//! Applies a function to all the jobs (in parallel if possible)
+static void ProcessLODChunks(std::vector<LODBuildChunk>& chunks, void (*func)(LODBuildChunk&))
+{
+#ifdef ENABLE_MT_OCTREE
+	if (chunks.size() > 1)
+	{
+		QtConcurrent::blockingMap(chunks, func);
+		return;
+	}
+#endif
+
+	for (size_t k=0; k<chunks.size(); ++k)
+		func(chunks[k]);
+}
+
+bool OctreeLOD::build(GenericIndexedCloudPersist* cloud, DgmOctree* octree/*=0*/, GenericProgressCallback* progressCb/*=0*/)
+{
+	clear();
+
+	assert(cloud);
+	unsigned count = (cloud ? cloud->size() : 0);
+	if (count == 0)
+		return false;
+
+	//we need an octree with all the points of the cloud
+	DgmOctree* tempOctree = 0;
+	if (!octree || octree->associatedCloud() != cloud || octree->getNumberOfProjectedPoints() != count || octree->pointsAndTheirCellCodes().size() != count)
+	{
+		tempOctree = new DgmOctree(cloud);
+		if (tempOctree->build(progressCb) < 1 || tempOctree->getNumberOfProjectedPoints() != count)
+		{
+			delete tempOctree;
+			return false;
+		}
+		octree = tempOctree;
+	}
+
+	bool success = true;
+	try
+	{
+		std::vector<LODPoint> points(count);
+		m_localIndexes.resize(count);
+		m_chunkLevelStarts.resize(static_cast<size_t>(chunkCount())*(LEVEL_COUNT+1));
+
+		std::vector<LODBuildChunk> chunks;
+		LODBuildChunk chunk;
+		memset(&chunk,0,sizeof(LODBuildChunk));
+		chunk.codes = &(octree->pointsAndTheirCellCodes()[0]);
+		chunk.points = &(points[0]);
+		for (unsigned begin=0; begin<count; begin+=CHUNK_SIZE)
+		{
+			chunk.begin = begin;
+			chunk.end = std::min(count,begin+CHUNK_SIZE);
+			chunks.push_back(chunk);
+		}
+
+		//1st pass: level of each point (by octree codes ranges)
+		ProcessLODChunks(chunks,ComputePointsLevel);
+
+		//2nd pass: sort the points of each chunk
+		for (size_t k=0; k<chunks.size(); ++k)
+		{
+			chunks[k].localIndexes = &(m_localIndexes[chunks[k].begin]);
+			chunks[k].levelStarts = &(m_chunkLevelStarts[k*(LEVEL_COUNT+1)]);
+		}
+		ProcessLODChunks(chunks,SortChunkPoints);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		clear();
+		success = false;
+	}
+
+	if (tempOctree)
+	{
+		delete tempOctree;
+		tempOctree = 0;
+	}
+
+	if (success)
+		updateLevelStarts();
+
+	return success;
+}
+
+void OctreeLOD::updateLevelStarts()
+{
+	memset(m_levelStarts,0,sizeof(m_levelStarts));
+
+	unsigned chunks = chunkCount();
+	for (unsigned k=0; k<chunks; ++k)
+	{
+		const unsigned* chunkStarts = &(m_chunkLevelStarts[static_cast<size_t>(k)*(LEVEL_COUNT+1)]);
+		for (unsigned l=0; l<=LEVEL_COUNT; ++l)
+			m_levelStarts[l] += chunkStarts[l];
+	}
+}
+
+unsigned OctreeLOD::chunkDisplayCount(unsigned chunkIndex, unsigned budget) const
+{
+	assert(chunkIndex < chunkCount());
+	const unsigned* chunkStarts = &(m_chunkLevelStarts[static_cast<size_t>(chunkIndex)*(LEVEL_COUNT+1)]);
+	if (budget >= pointCount())
+		return chunkStarts[LEVEL_COUNT];
+
+	//we look for the level that is only partially displayed
+	unsigned level = 0;
+	while (level+1 < LEVEL_COUNT && m_levelStarts[level+1] <= budget)
+		++level;
+
+	//the chunk displays the same proportion of this level as the whole cloud
+	unsigned levelPop = levelPopulation(static_cast<unsigned char>(level));
+	unsigned chunkLevelPop = chunkStarts[level+1] - chunkStarts[level];
+	unsigned partialCount = 0;
+	if (levelPop != 0)
+		partialCount = static_cast<unsigned>((static_cast<double>(budget - m_levelStarts[level]) * chunkLevelPop) / levelPop);
+
+	return chunkStarts[level] + std::min(partialCount,chunkLevelPop);
+}
+
+bool OctreeLOD::getPoints(unsigned budget, std::vector<unsigned>& pointIndexes) const
+{
+	pointIndexes.clear();
+
+	try
+	{
+		pointIndexes.reserve(std::min(budget,pointCount()));
+		unsigned chunks = chunkCount();
+		for (unsigned k=0; k<chunks; ++k)
+		{
+			unsigned displayCount = chunkDisplayCount(k,budget);
+			const unsigned* _indexes = chunkIndexes(k);
+			unsigned chunkStart = k*CHUNK_SIZE;
+			for (unsigned i=0; i<displayCount; ++i)
+				pointIndexes.push_back(chunkStart + _indexes[i]);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		pointIndexes.clear();
+		return false;
+	}
+
+	return true;
+}
+
+bool OctreeLOD::setStructure(std::vector<unsigned>& localIndexes, std::vector<unsigned>& chunkLevelStarts)
+{
+	clear();
+
+	unsigned count = static_cast<unsigned>(localIndexes.size());
+	unsigned chunks = (count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+	if (chunkLevelStarts.size() != static_cast<size_t>(chunks)*(LEVEL_COUNT+1))
+		return false;
+
+	//consistency check
+	for (unsigned k=0; k<chunks; ++k)
+	{
+		unsigned chunkSize = (k+1 < chunks ? CHUNK_SIZE : count-k*CHUNK_SIZE);
+		const unsigned* chunkStarts = &(chunkLevelStarts[static_cast<size_t>(k)*(LEVEL_COUNT+1)]);
+		if (chunkStarts[0] != 0 || chunkStarts[LEVEL_COUNT] != chunkSize)
+			return false;
+		for (unsigned l=0; l<LEVEL_COUNT; ++l)
+			if (chunkStarts[l] > chunkStarts[l+1])
+				return false;
+		for (unsigned i=0; i<chunkSize; ++i)
+			if (localIndexes[static_cast<size_t>(k)*CHUNK_SIZE+i] >= chunkSize)
+				return false;
+	}
+
+	m_localIndexes.swap(localIndexes);
+	m_chunkLevelStarts.swap(chunkLevelStarts);
+	updateLevelStarts();
+
+	return true;
+}
+
+void OctreeLOD::swap(OctreeLOD& other)
+{
+	m_localIndexes.swap(other.m_localIndexes);
+	m_chunkLevelStarts.swap(other.m_chunkLevelStarts);
+	for (unsigned l=0; l<=LEVEL_COUNT; ++l)
+		std::swap(m_levelStarts[l],other.m_levelStarts[l]);
+}
@@ -0,0 +1,521 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "PickingTools.h"
+
+//local
+#include "GenericIndexedCloudPersist.h"
+#include "GenericIndexedMesh.h"
+#include "DgmOctree.h"
+#include "MeshBVH.h"
+#include "CCConst.h"
+
+//system
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+#include <vector>
+
+using namespace CCLib;
+
+//! Picking area (window coordinates)
+struct PickingArea
+{
+	//! Projection matrix
+	const double* M;
+	//! Picking position
+	double x, y;
+	//! Picking area half size
+	double tolerance;
+};
+
+//! Picked element
+struct PickedElement
+{
+	unsigned index;
+	double depth;
+	bool valid;
+
+	PickedElement() : index(0), depth(0), valid(false) {}
+
+	//! Keeps the nearest element (and the smallest index in case of equality, so that the result is deterministic)
+	inline void update(unsigned i, double d)
+	{
+		if (!valid || d < depth || (d == depth && i < index))
+		{
+			index = i;
+			depth = d;
+			valid = true;
+		}
+	}
+
+	//! Returns the max depth of the elements that can still be picked
+	inline double maxDepth() const { return valid ? depth : 1.0; }
+};
+
+//! Projects a point in window coordinates
+/** \return false if the point is behind the camera (w <= 0)
+**/
+static inline bool ProjectPoint(const double* M, const CCVector3& P, double& x, double& y, double& z)
+{
+	double w = M[3]*P.x + M[7]*P.y + M[11]*P.z + M[15];
+	if (w <= 0)
+		return false;
+
+	x = (M[0]*P.x + M[4]*P.y + M[8]*P.z  + M[12]) / w;
+	y = (M[1]*P.x + M[5]*P.y + M[9]*P.z  + M[13]) / w;
+	z = (M[2]*P.x + M[6]*P.y + M[10]*P.z + M[14]) / w;
+
+	return true;
+}
+
+//! Returns whether a box may contain elements that can be picked (conservative test)
+static bool BoxMayBePicked(const PickingArea& area, const PointCoordinateType bbMin[], const PointCoordinateType bbMax[], double maxDepth)
+{
+	double minX = 0, maxX = 0, minY = 0, maxY = 0, minZ = 0, maxZ = 0;
+	for (unsigned c=0; c<8; ++c)
+	{
+		CCVector3 corner(	(c & 1) ? bbMax[0] : bbMin[0],
+							(c & 2) ? bbMax[1] : bbMin[1],
+							(c & 4) ? bbMax[2] : bbMin[2]);
+
+		//the projection of the box is only bounded by the projection of its corners if they all lie in front of the camera
+		double x, y, z;
+		if (!ProjectPoint(area.M,corner,x,y,z))
+			return true;
+
+		if (c == 0)
+		{
+			minX = maxX = x;
+			minY = maxY = y;
+			minZ = maxZ = z;
+		}
+		else
+		{
+			minX = std::min(minX,x); maxX = std::max(maxX,x);
+			minY = std::min(minY,y); maxY = std::max(maxY,y);
+			minZ = std::min(minZ,z); maxZ = std::max(maxZ,z);
+		}
+	}
+
+	return !(	maxX < area.x-area.tolerance || minX > area.x+area.tolerance
+			||	maxY < area.y-area.tolerance || minY > area.y+area.tolerance
+			||	maxZ < -1.0 || minZ > maxDepth);
+}
+
+//! Tests a point
+static inline void TestPoint(const PickingArea& area, const CCVector3& P, unsigned index, PickedElement& picked)
+{
+	double x, y, z;
+	if (	ProjectPoint(area.M,P,x,y,z)
+		&&	fabs(x-area.x) <= area.tolerance
+		&&	fabs(y-area.y) <= area.tolerance
+		&&	z >= -1.0 && z <= 1.0)
+	{
+		picked.update(index,z);
+	}
+}
+
+//! Tests a triangle
+static inline void TestTriangle(const PickingArea& area, const CCVector3& A, const CCVector3& B, const CCVector3& C, unsigned index, PickedElement& picked)
+{
+	double a[3], b[3], c[3];
+	if (	!ProjectPoint(area.M,A,a[0],a[1],a[2])
+		||	!ProjectPoint(area.M,B,b[0],b[1],b[2])
+		||	!ProjectPoint(area.M,C,c[0],c[1],c[2]) )
+	{
+		return;
+	}
+
+	//quick rejection
+	if (	std::max(a[0],std::max(b[0],c[0])) < area.x-area.tolerance || std::min(a[0],std::min(b[0],c[0])) > area.x+area.tolerance
+		||	std::max(a[1],std::max(b[1],c[1])) < area.y-area.tolerance || std::min(a[1],std::min(b[1],c[1])) > area.y+area.tolerance)
+	{
+		return;
+	}
+
+	double abx = b[0]-a[0], aby = b[1]-a[1];
+	double acx = c[0]-a[0], acy = c[1]-a[1];
+	//edge-on triangles are not visible
+	if (abx*acy - aby*acx == 0)
+		return;
+
+	//nearest point of the (projected) triangle from the picking position
+	//(see 'Real-Time Collision Detection', C. Ericson, 5.1.5)
+	double u, v, w; //barycentric coordinates
+	{
+		double apx = area.x-a[0], apy = area.y-a[1];
+		double d1 = abx*apx + aby*apy;
+		double d2 = acx*apx + acy*apy;
+		double bpx = area.x-b[0], bpy = area.y-b[1];
+		double d3 = abx*bpx + aby*bpy;
+		double d4 = acx*bpx + acy*bpy;
+		double cpx = area.x-c[0], cpy = area.y-c[1];
+		double d5 = abx*cpx + aby*cpy;
+		double d6 = acx*cpx + acy*cpy;
+		double vc = d1*d4 - d3*d2;
+		double vb = d5*d2 - d1*d6;
+		double va = d3*d6 - d5*d4;
+
+		if (d1 <= 0 && d2 <= 0)
+		{
+			u = 1; v = 0; w = 0;
+		}
+		else if (d3 >= 0 && d4 <= d3)
+		{
+			u = 0; v = 1; w = 0;
+		}
+		else if (vc <= 0 && d1 >= 0 && d3 <= 0)
+		{
+			v = d1 / (d1-d3); u = 1-v; w = 0;
+		}
+		else if (d6 >= 0 && d5 <= d6)
+		{
+			u = 0; v = 0; w = 1;
+		}
+		else if (vb <= 0 && d2 >= 0 && d6 <= 0)
+		{
+			w = d2 / (d2-d6); u = 1-w; v = 0;
+		}
+		else if (va <= 0 && d4-d3 >= 0 && d5-d6 >= 0)
+		{
+			w = (d4-d3) / ((d4-d3) + (d5-d6)); u = 0; v = 1-w;
+		}
+		else
+		{
+			double denom = 1.0 / (va+vb+vc);
+			v = vb*denom; w = vc*denom; u = 1-v-w;
+		}
+	}
+
+	double dx = u*a[0] + v*b[0] + w*c[0] - area.x;
+	double dy = u*a[1] + v*b[1] + w*c[1] - area.y;
+	if (dx*dx + dy*dy > area.tolerance*area.tolerance)
+		return;
+
+	//the depth is an affine function of the window coordinates on a (planar) triangle
+	double z = u*a[2] + v*b[2] + w*c[2];
+	if (z >= -1.0 && z <= 1.0)
+		picked.update(index,z);
+}
+
+//! Returns whether a triangle is visible
+static inline bool IsTriangleVisible(GenericIndexedMesh* mesh, unsigned index, const PickingTools::VisibilityTableType* verticesVisibility)
+{
+	if (!verticesVisibility)
+		return true;
+
+	const TriangleSummitsIndexes* tsi = mesh->getTriangleIndexes(index);
+	return (	verticesVisibility->getValue(tsi->i1) == POINT_VISIBLE
+			&&	verticesVisibility->getValue(tsi->i2) == POINT_VISIBLE
+			&&	verticesVisibility->getValue(tsi->i3) == POINT_VISIBLE);
+}
+
+//! Returns whether a point can be picked
+static inline bool IsPointPickable(unsigned index, const PickingTools::VisibilityTableType* visibility, const PickingTools::PointFilter* filter)
+{
+	return (	(!visibility || visibility->getValue(index) == POINT_VISIBLE)
+			&&	(!filter || filter->canBePicked(index)) );
+}
+
+//! Picking job (a range of points or triangles)
+struct pickingChunk
+{
+	//! Picking area
+	const PickingArea* area;
+	//! Cloud (points picking)
+	GenericIndexedCloudPersist* cloud;
+	//! Mesh (triangles picking)
+	GenericIndexedMesh* mesh;
+	//! Visibility table (optional)
+	const PickingTools::VisibilityTableType* visibility;
+	//! Points filter (optional)
+	const PickingTools::PointFilter* filter;
+	//! First element index
+	unsigned begin;
+	//! Last element index (excluded)
+	unsigned end;
+	//! Result
+	PickedElement picked;
+};
+
+static void PickInChunk(pickingChunk& chunk)
+{
+	if (chunk.cloud)
+	{
+		for (unsigned i=chunk.begin; i<chunk.end; ++i)
+			if (IsPointPickable(i,chunk.visibility,chunk.filter))
+				TestPoint(*chunk.area,*chunk.cloud->getPointPersistentPtr(i),i,chunk.picked);
+	}
+	else
+	{
+		assert(chunk.mesh);
+		for (unsigned i=chunk.begin; i<chunk.end; ++i)
+		{
+			if (IsTriangleVisible(chunk.mesh,i,chunk.visibility))
+			{
+				CCVector3 A, B, C;
+				chunk.mesh->getTriangleSummits(i,A,B,C);
+				TestTriangle(*chunk.area,A,B,C,i,chunk.picked);
+			}
+		}
+	}
+}
+
+#ifdef ENABLE_MT_OCTREE
+
+#include <QtCore>
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+#endif
+
+//! Number of elements per picking job
+static const unsigned PICKING_CHUNK_SIZE = (1<<16);
+
+//! Tests all the points or triangles (by chunks, in parallel)
+static bool PickInAllElements(	const PickingArea& area,
+								GenericIndexedCloudPersist* cloud,
+								GenericIndexedMesh* mesh,
+								unsigned count,
+								const PickingTools::VisibilityTableType* visibility,
+								const PickingTools::PointFilter* filter,
+								PickedElement& picked)
+{
+	std::vector<pickingChunk> chunks;
+	try
+	{
+		chunks.reserve((count + PICKING_CHUNK_SIZE - 1) / PICKING_CHUNK_SIZE);
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	for (unsigned begin=0; begin<count; begin+=PICKING_CHUNK_SIZE)
+	{
+		pickingChunk chunk;
+		chunk.area = &area;
+		chunk.cloud = cloud;
+		chunk.mesh = mesh;
+		chunk.visibility = visibility;
+		chunk.filter = filter;
+		chunk.begin = begin;
+		chunk.end = std::min(count,begin+PICKING_CHUNK_SIZE);
+		chunks.push_back(chunk);
+	}
+
+#ifdef ENABLE_MT_OCTREE
+	if (chunks.size() > 1)
+		QtConcurrent::blockingMap(chunks, PickInChunk);
+	else
+#endif
+	for (size_t k=0; k<chunks.size(); ++k)
+		PickInChunk(chunks[k]);
+
+	for (size_t k=0; k<chunks.size(); ++k)
+		if (chunks[k].picked.valid)
+			picked.update(chunks[k].picked.index,chunks[k].picked.depth);
+
+	return true;
+}
+
+//! Max number of points in an octree cell to test them directly
+static const unsigned PICKING_OCTREE_LEAF_SIZE = 32;
+
+//! Compares a truncated cell code with the (truncated) code of an element (see std::upper_bound)
+struct TruncatedCodeComp
+{
+	TruncatedCodeComp(unsigned char bitDec) : m_bitDec(bitDec) {}
+
+	inline bool operator()(DgmOctree::OctreeCellCodeType truncatedCode, const DgmOctree::IndexAndCode& element) const
+	{
+		return truncatedCode < (element.theCode >> m_bitDec);
+	}
+
+	unsigned char m_bitDec;
+};
+
+//! Recursively visits the octree cells that can be seen inside the picking area
+static void PickInOctreeCell(	const PickingArea& area,
+								GenericIndexedCloudPersist* cloud,
+								const DgmOctree* octree,
+								const DgmOctree::IndexAndCode* codes,
+								unsigned begin,
+								unsigned end,
+								uchar level,
+								const PickingTools::VisibilityTableType* visibility,
+								const PickingTools::PointFilter* filter,
+								PickedElement& picked)
+{
+	assert(begin < end);
+
+	PointCoordinateType cellMin[3], cellMax[3];
+	octree->computeCellLimits(codes[begin].theCode >> GET_BIT_SHIFT(level),level,cellMin,cellMax,true);
+	if (!BoxMayBePicked(area,cellMin,cellMax,picked.maxDepth()))
+		return;
+
+	//small cell: we test its points directly
+	if (end-begin <= PICKING_OCTREE_LEAF_SIZE || level == DgmOctree::MAX_OCTREE_LEVEL)
+	{
+		for (unsigned i=begin; i<end; ++i)
+		{
+			unsigned index = codes[i].theIndex;
+			if (IsPointPickable(index,visibility,filter))
+				TestPoint(area,*cloud->getPointPersistentPtr(index),index,picked);
+		}
+		return;
+	}
+
+	//otherwise we visit its children (the codes are sorted)
+	uchar childLevel = level+1;
+	unsigned char bitDec = GET_BIT_SHIFT(childLevel);
+	unsigned i = begin;
+	while (i < end)
+	{
+		DgmOctree::OctreeCellCodeType childCode = (codes[i].theCode >> bitDec);
+		unsigned childEnd = static_cast<unsigned>(std::upper_bound(codes+i, codes+end, childCode, TruncatedCodeComp(bitDec)) - codes);
+		PickInOctreeCell(area,cloud,octree,codes,i,childEnd,childLevel,visibility,filter,picked);
+		i = childEnd;
+	}
+}
+
+bool PickingTools::pickPoint(	GenericIndexedCloudPersist* cloud,
+								const double* projMat,
+								const CCVector2& pickPos,
+								PointCoordinateType tolerance,
+								unsigned& pointIndex,
+								double& depth,
+								const DgmOctree* octree/*=0*/,
+								const VisibilityTableType* visibilityTable/*=0*/,
+								const PointFilter* filter/*=0*/)
+{
+	assert(cloud && projMat);
+
+	unsigned count = cloud->size();
+	if (count == 0)
+		return false;
+
+	PickingArea area;
+	area.M = projMat;
+	area.x = pickPos.x;
+	area.y = pickPos.y;
+	area.tolerance = tolerance;
+
+	//the visibility table and the octree can only be used if they correspond to the cloud
+	if (visibilityTable && visibilityTable->currentSize() != count)
+		visibilityTable = 0;
+	if (	octree
+		&&	(octree->associatedCloud() != cloud || octree->getNumberOfProjectedPoints() != count || octree->pointsAndTheirCellCodes().size() != count))
+	{
+		octree = 0;
+	}
+
+	PickedElement picked;
+	if (octree)
+	{
+		PickInOctreeCell(area,cloud,octree,&(octree->pointsAndTheirCellCodes()[0]),0,count,0,visibilityTable,filter,picked);
+	}
+	else if (!PickInAllElements(area,cloud,0,count,visibilityTable,filter,picked))
+	{
+		return false;
+	}
+
+	if (!picked.valid)
+		return false;
+
+	pointIndex = picked.index;
+	depth = picked.depth;
+
+	return true;
+}
+
+bool PickingTools::pickTriangle(GenericIndexedMesh* mesh,
+								const double* projMat,
+								const CCVector2& pickPos,
+								PointCoordinateType tolerance,
+								unsigned& triangleIndex,
+								double& depth,
+								const MeshBVH* bvh/*=0*/,
+								const VisibilityTableType* verticesVisibility/*=0*/)
+{
+	assert(mesh && projMat);
+
+	unsigned count = mesh->size();
+	if (count == 0)
+		return false;
+
+	PickingArea area;
+	area.M = projMat;
+	area.x = pickPos.x;
+	area.y = pickPos.y;
+	area.tolerance = tolerance;
+
+	//the BVH can only be used if it corresponds to the mesh
+	if (bvh && (bvh->associatedMesh() != mesh || bvh->triangleIndexes().size() != count))
+		bvh = 0;
+
+	PickedElement picked;
+	if (bvh)
+	{
+		const std::vector<MeshBVH::Node>& nodes = bvh->nodes();
+		const std::vector<unsigned>& triangleIndexes = bvh->triangleIndexes();
+
+		std::vector<unsigned> nodesToVisit;
+		nodesToVisit.push_back(0);
+		while (!nodesToVisit.empty())
+		{
+			const MeshBVH::Node& node = nodes[nodesToVisit.back()];
+			unsigned nodeIndex = nodesToVisit.back();
+			nodesToVisit.pop_back();
+
+			if (!BoxMayBePicked(area,node.bbMin,node.bbMax,picked.maxDepth()))
+				continue;
+
+			if (node.isLeaf())
+			{
+				for (unsigned j=node.first; j<node.first+node.count; ++j)
+				{
+					unsigned index = triangleIndexes[j];
+					if (IsTriangleVisible(mesh,index,verticesVisibility))
+					{
+						CCVector3 A, B, C;
+						mesh->getTriangleSummits(index,A,B,C);
+						TestTriangle(area,A,B,C,index,picked);
+					}
+				}
+			}
+			else
+			{
+				nodesToVisit.push_back(node.first);		//second child
+				nodesToVisit.push_back(nodeIndex+1);	//first child
+			}
+		}
+	}
+	else if (!PickInAllElements(area,0,mesh,count,verticesVisibility,0,picked))
+	{
+		return false;
+	}
+
+	if (!picked.valid)
+		return false;
+
+	triangleIndex = picked.index;
+	depth = picked.depth;
+
+	return true;
+}
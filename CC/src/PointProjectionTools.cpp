@@ -720,4 +720,68 @@ bool PointProjectionTools::extractConcaveHull2D(std::vector<IndexedCCVector2>& p
 	}
 
 	return true;
-}
\ No newline at end of file
+}
+
+bool PointProjectionTools::extractFlatContour(	GenericIndexedCloudPersist* points,
+												PointCoordinateType maxEdgeLength,
+												std::vector<CCVector3>& contourPoints,
+												const PointCoordinateType* preferredDim/*=0*/)
+{
+	contourPoints.clear();
+
+	assert(points);
+	if (!points)
+		return false;
+	unsigned ptsCount = points->size();
+	if (ptsCount < 3)
+		return false;
+
+	Neighbourhood Yk(points);
+	CCVector3 O,X,Y; //local base
+
+	//we project the input points on a plane
+	std::vector<IndexedCCVector2> points2D;
+	PointCoordinateType* planeEq = 0;
+	//if the user has specified a default direction, we'll use it as 'projecting plane'
+	PointCoordinateType preferredPlaneEq[4] = {0, 0, 0, 0};
+	if (preferredDim != 0)
+	{
+		const CCVector3* G = points->getPoint(0); //any point through which the point pass is ok
+		preferredPlaneEq[0] = preferredDim[0];
+		preferredPlaneEq[1] = preferredDim[1];
+		preferredPlaneEq[2] = preferredDim[2];
+		CCVector3::vnormalize(preferredPlaneEq);
+		preferredPlaneEq[3] = CCVector3::vdot(G->u,preferredPlaneEq);
+		planeEq = preferredPlaneEq;
+	}
+	if (!Yk.projectPointsOn2DPlane<IndexedCCVector2>(points2D,planeEq,&O,&X,&Y))
+	{
+		//not enough memory?
+		return false;
+	}
+
+	//update the points indexes (not done by Neighbourhood::projectPointsOn2DPlane)
+	for (unsigned i=0; i<ptsCount; ++i)
+		points2D[i].index = i;
+
+	//try to get the points on the convex/concave hull to build the contour
+	std::list<IndexedCCVector2*> hullPoints;
+	if (!extractConcaveHull2D(points2D,hullPoints,maxEdgeLength*maxEdgeLength))
+		return false;
+
+	try
+	{
+		contourPoints.reserve(hullPoints.size());
+	}
+	catch(...)
+	{
+		//not enough memory
+		return false;
+	}
+
+	//projection on the LS plane (in 3D)
+	for (std::list<IndexedCCVector2*>::const_iterator it = hullPoints.begin(); it != hullPoints.end(); ++it)
+		contourPoints.push_back(O + X*(*it)->x + Y*(*it)->y);
+
+	return true;
+}
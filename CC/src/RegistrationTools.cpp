@@ -129,6 +129,97 @@ void RegistrationTools::FilterTransformation(	const ScaledTransformation& inTran
 	}
 }
 
+//! Indicative number of points per cell of the model octree (see ICPRegistrationTools::RegisterClouds)
+static const unsigned ICP_MODEL_OCTREE_POINTS_PER_CELL = 16;
+
+//! Computes the Closest Point Set of the data cloud with the (persistent) model octree
+/** The model octree is built once for all and the (transformed) data points are
+	directly queried against it. The queries are sorted by model octree cell so
+	that consecutive queries lying in the same cell share the same neighbourhood.
+	The distances are stored as the data points scalar values.
+	\param dataCloud data points
+	\param modelOctree model octree
+	\param level octree level at which to perform the search
+	\param CPSet output closest point set
+	\param nNSS search structure (kept between calls to avoid re-allocations)
+	\param queryOrder temporary buffer (kept between calls to avoid re-allocations)
+	\return false if not enough memory
+**/
+static bool ComputeClosestPointSet(	ReferenceCloud* dataCloud,
+									const DgmOctree& modelOctree,
+									uchar level,
+									ReferenceCloud* CPSet,
+									DgmOctree::NearestNeighboursSearchStruct& nNSS,
+									DgmOctree::cellsContainer& queryOrder)
+{
+	unsigned count = dataCloud->size();
+	if (CPSet->size() != count && !CPSet->resize(count))
+		return false;
+
+	nNSS.level = level;
+	nNSS.maxSearchSquareDistd = -1.0;
+	nNSS.theNearestPointIndex = 0;
+
+	//previous query cell
+	int previousCellPos[3] = {0,0,0};
+	bool previousInBounds = false;
+
+	try
+	{
+		//we sort the queries by model octree cell (the points outside the octree come last)
+		queryOrder.resize(count);
+		for (unsigned i=0; i<count; ++i)
+		{
+			dataCloud->getPoint(i,nNSS.queryPoint);
+
+			bool inBounds = false;
+			modelOctree.getTheCellPosWhichIncludesThePoint(&nNSS.queryPoint,nNSS.cellPos,level,inBounds);
+
+			queryOrder[i].theIndex = i;
+			queryOrder[i].theCode = (inBounds ? modelOctree.generateTruncatedCellCode(nNSS.cellPos,level) : DgmOctree::INVALID_CELL_CODE);
+		}
+		std::sort(queryOrder.begin(),queryOrder.end(),DgmOctree::IndexAndCode::codeComp);
+
+		for (unsigned j=0; j<count; ++j)
+		{
+			unsigned i = queryOrder[j].theIndex;
+			dataCloud->getPoint(i,nNSS.queryPoint);
+
+			bool inBounds = false;
+			modelOctree.getTheCellPosWhichIncludesThePoint(&nNSS.queryPoint,nNSS.cellPos,level,inBounds);
+
+			//new cell? we must reset the neighbourhood
+			if (	j == 0 || !inBounds || !previousInBounds
+				||	nNSS.cellPos[0] != previousCellPos[0]
+				||	nNSS.cellPos[1] != previousCellPos[1]
+				||	nNSS.cellPos[2] != previousCellPos[2])
+			{
+				nNSS.minimalCellsSetToVisit.clear();
+				nNSS.alreadyVisitedNeighbourhoodSize = 0;
+				modelOctree.computeCellCenter(nNSS.cellPos,level,nNSS.cellCenter);
+
+				previousCellPos[0] = nNSS.cellPos[0];
+				previousCellPos[1] = nNSS.cellPos[1];
+				previousCellPos[2] = nNSS.cellPos[2];
+				previousInBounds = inBounds;
+			}
+
+			double squareDist = modelOctree.findTheNearestNeighborStartingFromCell(nNSS);
+			if (squareDist < 0) //shouldn't happen as there's no search limit
+				return false;
+
+			dataCloud->setPointScalarValue(i,static_cast<ScalarType>(sqrt(squareDist)));
+			CPSet->setPointIndex(i,nNSS.theNearestPointIndex);
+		}
+	}
+	catch(.../*const std::bad_alloc&*/) //out of memory
+	{
+		return false;
+	}
+
+	return true;
+}
+
 ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericIndexedCloudPersist* _modelCloud,
 																		GenericIndexedCloudPersist* _dataCloud,
 																		ScaledTransformation& transform,
@@ -181,7 +272,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericI
 	//DATA CLOUD (will move)
 	ReferenceCloud* dataCloud = 0;
 	ScalarField* _dataWeights = dataWeights;
-	SimpleCloud* rotatedDataCloud = 0; //temporary structure (rotated vertices)
+	SimpleCloud* rotatedDataCloud = 0; //temporary structure (rotated vertices, transformed in place)
 	{
 		if (_dataCloud->size()>samplingLimit) //shall we resample the clouds? (speed increase)
 		{
@@ -215,10 +306,42 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericI
 			}
 		}
 
-		if (!dataCloud || !dataCloud->enableScalarField()) //something bad happened
+		//we copy the data points once for all (they are then transformed in place at each iteration)
+		if (dataCloud)
 		{
-			if (dataCloud)
-				delete dataCloud;
+			unsigned count = dataCloud->size();
+			rotatedDataCloud = new SimpleCloud();
+			if (rotatedDataCloud->reserve(count) && rotatedDataCloud->enableScalarField())
+			{
+				for (unsigned i=0; i<count; ++i)
+					rotatedDataCloud->addPoint(*dataCloud->getPoint(i));
+			}
+			else
+			{
+				delete rotatedDataCloud;
+				rotatedDataCloud = 0;
+			}
+
+			delete dataCloud;
+			dataCloud = 0;
+
+			if (rotatedDataCloud)
+			{
+				dataCloud = new ReferenceCloud(rotatedDataCloud);
+				if (!dataCloud->addPointIndex(0,count)) //not enough memory
+				{
+					delete dataCloud;
+					dataCloud = 0;
+				}
+			}
+		}
+
+		if (!dataCloud) //something bad happened
+		{
+			if (rotatedDataCloud)
+				delete rotatedDataCloud;
+			if (_dataWeights && _dataWeights != dataWeights)
+				_dataWeights->release();
 			if (modelCloud && modelCloud != _modelCloud)
 				delete modelCloud;
 			if (_modelWeights && _modelWeights != modelWeights)
@@ -227,6 +350,24 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericI
 		}
 	}
 
+	//MODEL OCTREE (built once for all, as the model won't move)
+	DgmOctree modelOctree(modelCloud);
+	if (modelOctree.build(progressCb) < 1)
+	{
+		delete dataCloud;
+		delete rotatedDataCloud;
+		if (_dataWeights && _dataWeights != dataWeights)
+			_dataWeights->release();
+		if (modelCloud && modelCloud != _modelCloud)
+			delete modelCloud;
+		if (_modelWeights && _modelWeights != modelWeights)
+			_modelWeights->release();
+		return ICP_ERROR_DIST_COMPUTATION;
+	}
+	uchar modelOctreeLevel = modelOctree.findBestLevelForAGivenPopulationPerCell(ICP_MODEL_OCTREE_POINTS_PER_CELL);
+	DgmOctree::NearestNeighboursSearchStruct nNSS;
+	DgmOctree::cellsContainer queryOrder;
+
 	//Closest Point Set (see ICP algorithm)
 	ReferenceCloud* CPSet = new ReferenceCloud(modelCloud);
 	ScalarField* CPSetWeights = _modelWeights ? new ScalarField("CPSetWeights") : 0;
@@ -237,10 +378,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericI
 	double error = 0.0;
 
 	//we compute the initial distance between the two clouds (and the CPSet by the way)
-	dataCloud->forEach(ScalarFieldTools::SetScalarValueToNaN);
-	DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
-	params.CPSet = CPSet;
-	if (DistanceComputationTools::computeHausdorffDistance(dataCloud,modelCloud,params,progressCb) >= 0)
+	if (ComputeClosestPointSet(dataCloud,modelOctree,modelOctreeLevel,CPSet,nNSS,queryOrder))
 	{
 		//12/11/2008 - A.BEY: ICP guarantees only the decrease of the squared distances sum (not the distances sum)
 		error = ScalarFieldTools::computeMeanSquareScalarValue(dataCloud); //we only have positive SF values as we use the Hausdorff distance!
@@ -343,7 +481,7 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericI
 							c->addPointIndex(index); //can't fail, see above
 							newCPSet->addPointIndex(CPSet->getPointGlobalIndex(i)); //can't fail, see above
 							if (newdataWeights)
-								newdataWeights->addElement(_dataWeights->getValue(index));
+								newdataWeights->addElement(_dataWeights->getValue(i));
 							++realSize;
 						}
 					}
@@ -400,41 +538,11 @@ ICPRegistrationTools::RESULT_TYPE ICPRegistrationTools::RegisterClouds(	GenericI
 				FilterTransformation(currentTrans,filters,currentTrans);
 			}
 
-			//get rotated data cloud
-			if (!rotatedDataCloud || filterOutFarthestPoints)
-			{
-				//we create a new structure, with rotated points
-				SimpleCloud* newDataCloud = PointProjectionTools::applyTransformation(dataCloud, currentTrans);
-				if (!newDataCloud)
-				{
-					//not enough memory
-					result = ICP_ERROR_REGISTRATION_STEP;
-					break;
-				}
-				//update dataCloud
-				if (rotatedDataCloud)
-					delete rotatedDataCloud;
-				rotatedDataCloud = newDataCloud;
-				delete dataCloud;
-
-				dataCloud = new ReferenceCloud(rotatedDataCloud);
-				if (!dataCloud->addPointIndex(0,rotatedDataCloud->size()))
-				{
-					//not enough memory
-					delete dataCloud;
-					result = ICP_ERROR_REGISTRATION_STEP;
-					break;
-				}
-			}
-			else
-			{
-				//we simply have to rotate the existing temporary cloud
-				rotatedDataCloud->applyTransformation(currentTrans);
-			}
+			//we simply have to rotate the temporary cloud (in place)
+			rotatedDataCloud->applyTransformation(currentTrans);
 
 			//compute (new) distances to model
-			params.CPSet = CPSet;
-			if (DistanceComputationTools::computeHausdorffDistance(dataCloud,modelCloud,params)<0)
+			if (!ComputeClosestPointSet(dataCloud,modelOctree,modelOctreeLevel,CPSet,nNSS,queryOrder))
 			{
 				//an error occurred during distances computation...
 				result = ICP_ERROR_REGISTRATION_STEP;
@@ -0,0 +1,455 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "SquareDistanceKernels.h"
+
+//system
+#include <limits>
+
+//SSE2 is always available on x86_64 (and may be enabled on x86)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CC_SSE2_KERNELS
+#include <emmintrin.h>
+#endif
+
+//AVX kernels are compiled with a specific target (so that the rest of the library
+//doesn't require AVX) and are only called if the CPU (and the OS) supports them
+#if defined(CC_SSE2_KERNELS) && ( defined(__clang__) || (defined(__GNUC__) && (__GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))) || (defined(_MSC_VER) && _MSC_VER >= 1600) )
+#define CC_AVX_KERNELS
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define CC_AVX_TARGET
+#else
+#define CC_AVX_TARGET __attribute__((target("avx")))
+#endif
+#endif
+
+using namespace CCLib;
+
+/*** Scalar versions (reference) ***/
+
+static void ComputeSquareDistances_Scalar(	const PointCoordinateType* x,
+											const PointCoordinateType* y,
+											const PointCoordinateType* z,
+											unsigned count,
+											const CCVector3& Q,
+											double* squareDists)
+{
+	for (unsigned i=0; i<count; ++i)
+		squareDists[i] = (CCVector3(x[i],y[i],z[i]) - Q).norm2d();
+}
+
+static unsigned FindNearestPoint_Scalar(const PointCoordinateType* x,
+										const PointCoordinateType* y,
+										const PointCoordinateType* z,
+										unsigned count,
+										const CCVector3& Q,
+										double& minSquareDist)
+{
+	unsigned nearestIndex = count;
+	double bestSquareDist = std::numeric_limits<double>::infinity();
+	for (unsigned i=0; i<count; ++i)
+	{
+		double squareDist = (CCVector3(x[i],y[i],z[i]) - Q).norm2d();
+		if (squareDist < bestSquareDist)
+		{
+			bestSquareDist = squareDist;
+			nearestIndex = i;
+		}
+	}
+
+	minSquareDist = (nearestIndex < count ? bestSquareDist : -1.0);
+	return nearestIndex;
+}
+
+//! Merges the per-lane results of the vectorized versions of FindNearestPoint
+/** The smallest distance wins, and then the smallest index (so as to mimic the scalar version).
+**/
+static inline unsigned ReduceNearestPoint(const double* laneSquareDists, const double* laneIndexes, unsigned laneCount, unsigned nearestIndex, double& bestSquareDist)
+{
+	for (unsigned j=0; j<laneCount; ++j)
+	{
+		//lanes that were never updated (or only with invalid values) are ignored
+		if (!(laneSquareDists[j] < std::numeric_limits<double>::infinity()))
+			continue;
+
+		if (laneSquareDists[j] < bestSquareDist || (laneSquareDists[j] == bestSquareDist && static_cast<unsigned>(laneIndexes[j]) < nearestIndex))
+		{
+			bestSquareDist = laneSquareDists[j];
+			nearestIndex = static_cast<unsigned>(laneIndexes[j]);
+		}
+	}
+	return nearestIndex;
+}
+
+#ifdef CC_SSE2_KERNELS
+
+/*** SSE2 versions (4 points at a time) ***/
+
+//! Square distances of 4 points (as two pairs of doubles)
+static inline void SquareDistances4_SSE2(	const PointCoordinateType* x,
+											const PointCoordinateType* y,
+											const PointCoordinateType* z,
+											const __m128& qx,
+											const __m128& qy,
+											const __m128& qz,
+											__m128d& d01,
+											__m128d& d23)
+{
+	//the differences are computed in single precision (as CCVector3::operator-)
+	__m128 dx = _mm_sub_ps(_mm_loadu_ps(x),qx);
+	__m128 dy = _mm_sub_ps(_mm_loadu_ps(y),qy);
+	__m128 dz = _mm_sub_ps(_mm_loadu_ps(z),qz);
+
+	//and the squares in double precision (as CCVector3::norm2d)
+	__m128d dx01 = _mm_cvtps_pd(dx);
+	__m128d dy01 = _mm_cvtps_pd(dy);
+	__m128d dz01 = _mm_cvtps_pd(dz);
+	__m128d dx23 = _mm_cvtps_pd(_mm_movehl_ps(dx,dx));
+	__m128d dy23 = _mm_cvtps_pd(_mm_movehl_ps(dy,dy));
+	__m128d dz23 = _mm_cvtps_pd(_mm_movehl_ps(dz,dz));
+
+	d01 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx01,dx01),_mm_mul_pd(dy01,dy01)),_mm_mul_pd(dz01,dz01));
+	d23 = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dx23,dx23),_mm_mul_pd(dy23,dy23)),_mm_mul_pd(dz23,dz23));
+}
+
+static void ComputeSquareDistances_SSE2(const PointCoordinateType* x,
+										const PointCoordinateType* y,
+										const PointCoordinateType* z,
+										unsigned count,
+										const CCVector3& Q,
+										double* squareDists)
+{
+	const __m128 qx = _mm_set1_ps(Q.x);
+	const __m128 qy = _mm_set1_ps(Q.y);
+	const __m128 qz = _mm_set1_ps(Q.z);
+
+	unsigned i = 0;
+	for (; i+4<=count; i+=4)
+	{
+		__m128d d01,d23;
+		SquareDistances4_SSE2(x+i,y+i,z+i,qx,qy,qz,d01,d23);
+		_mm_storeu_pd(squareDists+i,d01);
+		_mm_storeu_pd(squareDists+i+2,d23);
+	}
+
+	//remaining points
+	ComputeSquareDistances_Scalar(x+i,y+i,z+i,count-i,Q,squareDists+i);
+}
+
+//! Selects 'b' where 'mask' is set and 'a' elsewhere
+static inline __m128d Select_SSE2(const __m128d& a, const __m128d& b, const __m128d& mask)
+{
+	return _mm_or_pd(_mm_and_pd(mask,b),_mm_andnot_pd(mask,a));
+}
+
+static unsigned FindNearestPoint_SSE2(	const PointCoordinateType* x,
+										const PointCoordinateType* y,
+										const PointCoordinateType* z,
+										unsigned count,
+										const CCVector3& Q,
+										double& minSquareDist)
+{
+	const __m128 qx = _mm_set1_ps(Q.x);
+	const __m128 qy = _mm_set1_ps(Q.y);
+	const __m128 qz = _mm_set1_ps(Q.z);
+
+	//per-lane best distances and indexes (indexes are stored as doubles: they are exact up to 2^53)
+	__m128d best01 = _mm_set1_pd(std::numeric_limits<double>::infinity());
+	__m128d best23 = best01;
+	__m128d bestIndex01 = _mm_setzero_pd();
+	__m128d bestIndex23 = _mm_setzero_pd();
+	__m128d index01 = _mm_set_pd(1.0,0.0);
+	__m128d index23 = _mm_set_pd(3.0,2.0);
+	const __m128d four = _mm_set1_pd(4.0);
+
+	unsigned i = 0;
+	for (; i+4<=count; i+=4)
+	{
+		__m128d d01,d23;
+		SquareDistances4_SSE2(x+i,y+i,z+i,qx,qy,qz,d01,d23);
+
+		//strict comparison: the first point wins in case of equality (per lane)
+		__m128d mask01 = _mm_cmplt_pd(d01,best01);
+		__m128d mask23 = _mm_cmplt_pd(d23,best23);
+		best01 = Select_SSE2(best01,d01,mask01);
+		best23 = Select_SSE2(best23,d23,mask23);
+		bestIndex01 = Select_SSE2(bestIndex01,index01,mask01);
+		bestIndex23 = Select_SSE2(bestIndex23,index23,mask23);
+
+		index01 = _mm_add_pd(index01,four);
+		index23 = _mm_add_pd(index23,four);
+	}
+
+	double laneSquareDists[4], laneIndexes[4];
+	_mm_storeu_pd(laneSquareDists,best01);
+	_mm_storeu_pd(laneSquareDists+2,best23);
+	_mm_storeu_pd(laneIndexes,bestIndex01);
+	_mm_storeu_pd(laneIndexes+2,bestIndex23);
+
+	double bestSquareDist = std::numeric_limits<double>::infinity();
+	unsigned nearestIndex = ReduceNearestPoint(laneSquareDists,laneIndexes,4,count,bestSquareDist);
+
+	//remaining points (their indexes are greater than all the others)
+	if (i < count)
+	{
+		double tailSquareDist;
+		unsigned tailIndex = FindNearestPoint_Scalar(x+i,y+i,z+i,count-i,Q,tailSquareDist);
+		if (tailIndex < count-i && tailSquareDist < bestSquareDist)
+		{
+			bestSquareDist = tailSquareDist;
+			nearestIndex = i+tailIndex;
+		}
+	}
+
+	minSquareDist = (nearestIndex < count ? bestSquareDist : -1.0);
+	return nearestIndex;
+}
+
+#endif //CC_SSE2_KERNELS
+
+#ifdef CC_AVX_KERNELS
+
+/*** AVX versions (8 points at a time) ***/
+
+//! Square distances of 8 points (as two quadruplets of doubles)
+CC_AVX_TARGET static inline void SquareDistances8_AVX(	const PointCoordinateType* x,
+														const PointCoordinateType* y,
+														const PointCoordinateType* z,
+														const __m256& qx,
+														const __m256& qy,
+														const __m256& qz,
+														__m256d& d0123,
+														__m256d& d4567)
+{
+	//the differences are computed in single precision (as CCVector3::operator-)
+	__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(x),qx);
+	__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(y),qy);
+	__m256 dz = _mm256_sub_ps(_mm256_loadu_ps(z),qz);
+
+	//and the squares in double precision (as CCVector3::norm2d)
+	__m256d dx0123 = _mm256_cvtps_pd(_mm256_castps256_ps128(dx));
+	__m256d dy0123 = _mm256_cvtps_pd(_mm256_castps256_ps128(dy));
+	__m256d dz0123 = _mm256_cvtps_pd(_mm256_castps256_ps128(dz));
+	__m256d dx4567 = _mm256_cvtps_pd(_mm256_extractf128_ps(dx,1));
+	__m256d dy4567 = _mm256_cvtps_pd(_mm256_extractf128_ps(dy,1));
+	__m256d dz4567 = _mm256_cvtps_pd(_mm256_extractf128_ps(dz,1));
+
+	d0123 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx0123,dx0123),_mm256_mul_pd(dy0123,dy0123)),_mm256_mul_pd(dz0123,dz0123));
+	d4567 = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx4567,dx4567),_mm256_mul_pd(dy4567,dy4567)),_mm256_mul_pd(dz4567,dz4567));
+}
+
+CC_AVX_TARGET static void ComputeSquareDistances_AVX(	const PointCoordinateType* x,
+														const PointCoordinateType* y,
+														const PointCoordinateType* z,
+														unsigned count,
+														const CCVector3& Q,
+														double* squareDists)
+{
+	const __m256 qx = _mm256_set1_ps(Q.x);
+	const __m256 qy = _mm256_set1_ps(Q.y);
+	const __m256 qz = _mm256_set1_ps(Q.z);
+
+	unsigned i = 0;
+	for (; i+8<=count; i+=8)
+	{
+		__m256d d0123,d4567;
+		SquareDistances8_AVX(x+i,y+i,z+i,qx,qy,qz,d0123,d4567);
+		_mm256_storeu_pd(squareDists+i,d0123);
+		_mm256_storeu_pd(squareDists+i+4,d4567);
+	}
+
+	//remaining points (not with the scalar version, to avoid costly AVX/SSE transitions)
+	for (; i<count; ++i)
+		squareDists[i] = (CCVector3(x[i],y[i],z[i]) - Q).norm2d();
+}
+
+//! Selects 'b' where 'mask' is set and 'a' elsewhere
+CC_AVX_TARGET static inline __m256d Select_AVX(const __m256d& a, const __m256d& b, const __m256d& mask)
+{
+	return _mm256_or_pd(_mm256_and_pd(mask,b),_mm256_andnot_pd(mask,a));
+}
+
+CC_AVX_TARGET static unsigned FindNearestPoint_AVX(	const PointCoordinateType* x,
+													const PointCoordinateType* y,
+													const PointCoordinateType* z,
+													unsigned count,
+													const CCVector3& Q,
+													double& minSquareDist)
+{
+	const __m256 qx = _mm256_set1_ps(Q.x);
+	const __m256 qy = _mm256_set1_ps(Q.y);
+	const __m256 qz = _mm256_set1_ps(Q.z);
+
+	//per-lane best distances and indexes (indexes are stored as doubles: they are exact up to 2^53)
+	__m256d best0123 = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+	__m256d best4567 = best0123;
+	__m256d bestIndex0123 = _mm256_setzero_pd();
+	__m256d bestIndex4567 = _mm256_setzero_pd();
+	__m256d index0123 = _mm256_set_pd(3.0,2.0,1.0,0.0);
+	__m256d index4567 = _mm256_set_pd(7.0,6.0,5.0,4.0);
+	const __m256d eight = _mm256_set1_pd(8.0);
+
+	unsigned i = 0;
+	for (; i+8<=count; i+=8)
+	{
+		__m256d d0123,d4567;
+		SquareDistances8_AVX(x+i,y+i,z+i,qx,qy,qz,d0123,d4567);
+
+		//strict comparison: the first point wins in case of equality (per lane)
+		__m256d mask0123 = _mm256_cmp_pd(d0123,best0123,_CMP_LT_OQ);
+		__m256d mask4567 = _mm256_cmp_pd(d4567,best4567,_CMP_LT_OQ);
+		best0123 = Select_AVX(best0123,d0123,mask0123);
+		best4567 = Select_AVX(best4567,d4567,mask4567);
+		bestIndex0123 = Select_AVX(bestIndex0123,index0123,mask0123);
+		bestIndex4567 = Select_AVX(bestIndex4567,index4567,mask4567);
+
+		index0123 = _mm256_add_pd(index0123,eight);
+		index4567 = _mm256_add_pd(index4567,eight);
+	}
+
+	double laneSquareDists[8], laneIndexes[8];
+	_mm256_storeu_pd(laneSquareDists,best0123);
+	_mm256_storeu_pd(laneSquareDists+4,best4567);
+	_mm256_storeu_pd(laneIndexes,bestIndex0123);
+	_mm256_storeu_pd(laneIndexes+4,bestIndex4567);
+
+	double bestSquareDist = std::numeric_limits<double>::infinity();
+	unsigned nearestIndex = ReduceNearestPoint(laneSquareDists,laneIndexes,8,count,bestSquareDist);
+
+	//remaining points (their indexes are greater than all the others)
+	//not with the scalar version, to avoid costly AVX/SSE transitions
+	for (; i<count; ++i)
+	{
+		double squareDist = (CCVector3(x[i],y[i],z[i]) - Q).norm2d();
+		if (squareDist < bestSquareDist)
+		{
+			bestSquareDist = squareDist;
+			nearestIndex = i;
+		}
+	}
+
+	minSquareDist = (nearestIndex < count ? bestSquareDist : -1.0);
+	return nearestIndex;
+}
+
+//! Whether the CPU and the OS support AVX instructions
+static bool IsAVXSupported()
+{
+#ifdef _MSC_VER
+	int cpuInfo[4];
+	__cpuid(cpuInfo,1);
+	bool osxsave = ((cpuInfo[2] & (1 << 27)) != 0);
+	bool avx = ((cpuInfo[2] & (1 << 28)) != 0);
+	//the OS must save the YMM registers as well
+	return osxsave && avx && ((_xgetbv(0) & 6) == 6);
+#else
+	return __builtin_cpu_supports("avx") != 0;
+#endif
+}
+
+#endif //CC_AVX_KERNELS
+
+//! Returns the best implementation supported by the CPU and the compiler
+static SquareDistanceKernels::Implementation GetBestImplementation()
+{
+#ifdef CC_AVX_KERNELS
+	if (IsAVXSupported())
+		return SquareDistanceKernels::AVX;
+#endif
+#ifdef CC_SSE2_KERNELS
+	return SquareDistanceKernels::SSE2;
+#else
+	return SquareDistanceKernels::SCALAR;
+#endif
+}
+
+//! Below this number of points, the vectorized versions are not worth it
+static const unsigned MIN_POINTS_FOR_AVX = 16;
+static const unsigned MIN_POINTS_FOR_SSE2_NEAREST = 8;
+
+//! Current implementation (selected once and for all at load time)
+static SquareDistanceKernels::Implementation s_implementation = GetBestImplementation();
+
+SquareDistanceKernels::Implementation SquareDistanceKernels::GetImplementation()
+{
+	return s_implementation;
+}
+
+SquareDistanceKernels::Implementation SquareDistanceKernels::SetImplementation(Implementation impl)
+{
+	Implementation best = GetBestImplementation();
+	s_implementation = (impl < best ? impl : best);
+	return s_implementation;
+}
+
+void SquareDistanceKernels::ComputeSquareDistances(	const PointCoordinateType* x,
+													const PointCoordinateType* y,
+													const PointCoordinateType* z,
+													unsigned count,
+													const CCVector3& Q,
+													double* squareDists)
+{
+	switch (s_implementation)
+	{
+#ifdef CC_AVX_KERNELS
+	case AVX:
+		if (count >= MIN_POINTS_FOR_AVX)
+		{
+			ComputeSquareDistances_AVX(x,y,z,count,Q,squareDists);
+			break;
+		}
+		//otherwise we use the SSE2 version
+#endif
+#ifdef CC_SSE2_KERNELS
+	case SSE2:
+		ComputeSquareDistances_SSE2(x,y,z,count,Q,squareDists);
+		break;
+#endif
+	default:
+		ComputeSquareDistances_Scalar(x,y,z,count,Q,squareDists);
+		break;
+	}
+}
+
+unsigned SquareDistanceKernels::FindNearestPoint(	const PointCoordinateType* x,
+													const PointCoordinateType* y,
+													const PointCoordinateType* z,
+													unsigned count,
+													const CCVector3& Q,
+													double& minSquareDist)
+{
+	switch (s_implementation)
+	{
+#ifdef CC_AVX_KERNELS
+	case AVX:
+		if (count >= MIN_POINTS_FOR_AVX)
+			return FindNearestPoint_AVX(x,y,z,count,Q,minSquareDist);
+		//otherwise we use the SSE2 version
+#endif
+#ifdef CC_SSE2_KERNELS
+	case SSE2:
+		if (count >= MIN_POINTS_FOR_SSE2_NEAREST)
+			return FindNearestPoint_SSE2(x,y,z,count,Q,minSquareDist);
+#endif
+	default:
+		break;
+	}
+
+	return FindNearestPoint_Scalar(x,y,z,count,Q,minSquareDist);
+}
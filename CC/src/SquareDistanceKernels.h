@@ -0,0 +1,86 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef SQUARE_DISTANCE_KERNELS_HEADER
+#define SQUARE_DISTANCE_KERNELS_HEADER
+
+//Local
+#include "CCGeom.h"
+
+namespace CCLib
+{
+
+//! Batched square distance computation between a query point and a block of points
+/** Points are stored as a structure of arrays (one contiguous array per dimension).
+	The best implementation (AVX, SSE2 or plain scalar code) is selected at runtime.
+	Whatever the implementation, the results are strictly the same as the ones of
+	the scalar expression '(P - Q).norm2d()' (i.e. coordinates are subtracted in
+	single precision and squared/summed in double precision, in the same order).
+**/
+class SquareDistanceKernels
+{
+public:
+
+	//! Available implementations
+	enum Implementation { SCALAR = 0, SSE2 = 1, AVX = 2 };
+
+	//! Returns the implementation currently in use
+	static Implementation GetImplementation();
+
+	//! Forces the implementation to use (for testing purpose)
+	/** If the requested implementation is not supported by the CPU (or by the
+		compiler), the best supported one is used instead.
+		\return the implementation actually in use
+	**/
+	static Implementation SetImplementation(Implementation impl);
+
+	//! Computes the square distances between a query point and a block of points
+	/** \param x X coordinates of the points
+		\param y Y coordinates of the points
+		\param z Z coordinates of the points
+		\param count number of points
+		\param Q query point
+		\param squareDists output square distances (count values)
+	**/
+	static void ComputeSquareDistances(	const PointCoordinateType* x,
+										const PointCoordinateType* y,
+										const PointCoordinateType* z,
+										unsigned count,
+										const CCVector3& Q,
+										double* squareDists);
+
+	//! Looks for the nearest point of a block relatively to a query point
+	/** In case of equality, the point with the smallest index wins.
+		\param x X coordinates of the points
+		\param y Y coordinates of the points
+		\param z Z coordinates of the points
+		\param count number of points
+		\param Q query point
+		\param minSquareDist output square distance of the nearest point (-1 if count==0)
+		\return the index of the nearest point (or 'count' if the block is empty)
+	**/
+	static unsigned FindNearestPoint(	const PointCoordinateType* x,
+										const PointCoordinateType* y,
+										const PointCoordinateType* z,
+										unsigned count,
+										const CCVector3& Q,
+										double& minSquareDist);
+};
+
+}
+
+#endif //SQUARE_DISTANCE_KERNELS_HEADER
@@ -0,0 +1,185 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: cloud-to-cloud distance with a max search distance (single vs multi-threaded)
+//on clouds with large non-overlapping regions
+//Usage: C2CDistanceBenchmark [point count (default: 2M)] [overlap ratio (default: 0.3)]
+
+//CCLib
+#include <ChunkedPointCloud.h>
+#include <DgmOctree.h>
+#include <DistanceComputationTools.h>
+
+//Qt
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+
+//system
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+using namespace CCLib;
+
+//! Returns a (pseudo) random value between 0 and 1
+static PointCoordinateType Random01()
+{
+	return static_cast<PointCoordinateType>(rand()) / static_cast<PointCoordinateType>(RAND_MAX);
+}
+
+//! Generates a wavy surface over [0;100*xRatio]x[0;100]
+static bool GenerateSurface(ChunkedPointCloud& cloud, unsigned count, PointCoordinateType xRatio, PointCoordinateType zShift)
+{
+	if (!cloud.reserve(count))
+		return false;
+
+	for (unsigned i=0; i<count; ++i)
+	{
+		PointCoordinateType x = Random01() * 100 * xRatio;
+		PointCoordinateType y = Random01() * 100;
+		cloud.addPoint(CCVector3(x,y,2 * sin(x/10) * cos(y/10) + zShift));
+	}
+
+	return true;
+}
+
+//! Computes the distances and returns the time (in ms)
+static qint64 TimeDistances(ChunkedPointCloud& compared,
+							ChunkedPointCloud& reference,
+							DistanceComputationTools::Cloud2CloudDistanceComputationParams params,
+							DgmOctree* comparedOctree,
+							DgmOctree* referenceOctree,
+							std::vector<ScalarType>& distances)
+{
+	//the distances must be initialized (see DistanceComputationTools::computeHausdorffDistance)
+	for (unsigned i=0; i<compared.size(); ++i)
+		compared.setPointScalarValue(i,NAN_VALUE);
+
+	QElapsedTimer timer;
+	timer.start();
+	if (DistanceComputationTools::computeHausdorffDistance(&compared,&reference,params,0,comparedOctree,referenceOctree) < 0)
+		return -1;
+	qint64 elapsed = timer.elapsed();
+
+	distances.resize(compared.size());
+	for (unsigned i=0; i<compared.size(); ++i)
+		distances[i] = compared.getPointScalarValue(i);
+
+	return elapsed;
+}
+
+//! Returns the number of different distances (NaN values are considered equal)
+static unsigned CountDifferences(const std::vector<ScalarType>& a, const std::vector<ScalarType>& b)
+{
+	unsigned count = 0;
+	for (size_t i=0; i<a.size(); ++i)
+		if (a[i] != b[i] && !(a[i] != a[i] && b[i] != b[i]))
+			++count;
+	return count;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned pointCount = (argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 2000000);
+	PointCoordinateType overlap = (argc > 2 ? static_cast<PointCoordinateType>(atof(argv[2])) : static_cast<PointCoordinateType>(0.3));
+
+	//the reference cloud only covers a part of the compared one
+	srand(0);
+	ChunkedPointCloud compared, reference;
+	if (	!GenerateSurface(compared,pointCount,1,0)
+		||	!GenerateSurface(reference,pointCount,overlap,static_cast<PointCoordinateType>(0.1))
+		||	!compared.enableScalarField())
+	{
+		printf("Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	DgmOctree* comparedOctree = 0;
+	DgmOctree* referenceOctree = 0;
+	if (!DistanceComputationTools::synchronizeOctrees(&compared,&reference,comparedOctree,referenceOctree))
+	{
+		printf("Failed to build the octrees!\n");
+		return EXIT_FAILURE;
+	}
+
+	DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
+	params.octreeLevel = comparedOctree->findBestLevelForComparisonWithOctree(referenceOctree);
+	params.maxSearchDist = 1;
+
+	const int maxThreadCount = QThread::idealThreadCount();
+	printf("Cloud-to-cloud distance: %u points (overlap: %.0f%%), level %i, max search distance: %g\n\n",
+			pointCount,
+			static_cast<double>(overlap)*100,
+			static_cast<int>(params.octreeLevel),
+			static_cast<double>(params.maxSearchDist));
+
+	//reference: without max search distance (multi-threaded, as it's much longer)
+	QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+	std::vector<ScalarType> fullDistances, singleThreadDistances, multiThreadDistances;
+	DistanceComputationTools::Cloud2CloudDistanceComputationParams fullParams = params;
+	fullParams.maxSearchDist = -1;
+	fullParams.multiThread = true;
+	qint64 fullTime = TimeDistances(compared,reference,fullParams,comparedOctree,referenceOctree,fullDistances);
+
+	DistanceComputationTools::Cloud2CloudDistanceComputationParams singleThreadParams = params;
+	singleThreadParams.multiThread = false;
+	qint64 singleThreadTime = TimeDistances(compared,reference,singleThreadParams,comparedOctree,referenceOctree,singleThreadDistances);
+
+	DistanceComputationTools::Cloud2CloudDistanceComputationParams multiThreadParams = params;
+	multiThreadParams.multiThread = true;
+	qint64 multiThreadTime = TimeDistances(compared,reference,multiThreadParams,comparedOctree,referenceOctree,multiThreadDistances);
+
+	delete comparedOctree;
+	delete referenceOctree;
+
+	if (fullTime < 0 || singleThreadTime < 0 || multiThreadTime < 0)
+	{
+		printf("Failed to compute the distances!\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Mode\t\t\t\tTime (ms)\n");
+	printf("%i threads (no max distance)\t%lld\n",maxThreadCount,static_cast<long long>(fullTime));
+	printf("1 thread\t\t\t%lld\n",static_cast<long long>(singleThreadTime));
+	printf("%i threads\t\t\t%lld\t(speedup: %.2f)\n",
+			maxThreadCount,
+			static_cast<long long>(multiThreadTime),
+			multiThreadTime > 0 ? static_cast<double>(singleThreadTime)/multiThreadTime : 0.0);
+
+	//both modes must give the same distances
+	unsigned differences = CountDifferences(singleThreadDistances,multiThreadDistances);
+	if (differences != 0)
+	{
+		printf("Error: %u different distances between the single and multi-threaded modes!\n",differences);
+		return EXIT_FAILURE;
+	}
+
+	//and the points in range must have the same distance as without max search distance
+	unsigned inRangeDifferences = 0;
+	for (size_t i=0; i<fullDistances.size(); ++i)
+		if (fullDistances[i] <= params.maxSearchDist && fullDistances[i] != singleThreadDistances[i])
+			++inRangeDifferences;
+	if (inRangeDifferences != 0)
+	{
+		printf("Error: %u different distances (in range) with and without max search distance!\n",inRangeDifferences);
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
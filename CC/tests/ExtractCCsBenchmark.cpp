@@ -0,0 +1,144 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: connected components labelling (DgmOctree::extractCCs) at levels 8 to 12
+//Usage: ExtractCCsBenchmark [point count (default: 5M)]
+
+//CCLib
+#include <AutoSegmentationTools.h>
+#include <ChunkedPointCloud.h>
+#include <DgmOctree.h>
+#include <ScalarField.h>
+
+//Qt
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+
+//system
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CCLib;
+
+//! Returns a (pseudo) random value between 0 and 1
+static PointCoordinateType Random01()
+{
+	return static_cast<PointCoordinateType>(rand()) / static_cast<PointCoordinateType>(RAND_MAX);
+}
+
+//! Generates a cloud made of many separate 'blobs' (so that there are many components at each level)
+static bool GenerateBlobs(ChunkedPointCloud& cloud, unsigned count)
+{
+	if (!cloud.reserve(count))
+		return false;
+
+	srand(0);
+	const unsigned blobCount = 1000;
+	for (unsigned i=0; i<count; ++i)
+	{
+		//blobs centers on a regular grid (10x10x10)
+		unsigned b = (i % blobCount);
+		CCVector3 C(static_cast<PointCoordinateType>(b % 10),
+					static_cast<PointCoordinateType>((b / 10) % 10),
+					static_cast<PointCoordinateType>(b / 100));
+		//points on a sphere (with holes depending on the level)
+		PointCoordinateType theta = 2 * static_cast<PointCoordinateType>(M_PI) * Random01();
+		PointCoordinateType z = 2 * Random01() - 1;
+		PointCoordinateType r = sqrt(1 - z*z);
+		CCVector3 P(r*cos(theta), r*sin(theta), z);
+		cloud.addPoint(C * 10 + P * 3);
+	}
+
+	return cloud.enableScalarField();
+}
+
+//! Labels the connected components and returns the time (in ms)
+static qint64 TimeLabelling(ChunkedPointCloud& cloud, DgmOctree& octree, int level, unsigned& componentCount)
+{
+	QElapsedTimer timer;
+	timer.start();
+	if (AutoSegmentationTools::labelConnectedComponents(&cloud,static_cast<uchar>(level),false,0,&octree) < 0)
+		return -1;
+	qint64 elapsed = timer.elapsed();
+
+	//the labels start at 1
+	ScalarField* sf = cloud.getCurrentInScalarField();
+	sf->computeMinAndMax();
+	componentCount = static_cast<unsigned>(sf->getMax());
+
+	return elapsed;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned pointCount = (argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 5000000);
+
+	ChunkedPointCloud cloud;
+	if (!GenerateBlobs(cloud,pointCount))
+	{
+		printf("Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	DgmOctree octree(&cloud);
+	if (octree.build() < 1)
+	{
+		printf("Failed to build the octree!\n");
+		return EXIT_FAILURE;
+	}
+
+	const int maxThreadCount = QThread::idealThreadCount();
+	printf("Connected components labelling: %u points (1 vs %i threads)\n\n",pointCount,maxThreadCount);
+	printf("Level\tCells\t\tComponents\t1 thread (ms)\t%i threads (ms)\tSpeedup\n",maxThreadCount);
+
+	//levels above 10 require 64 bits octree codes (see OCTREE_CODES_64_BITS)
+	const int maxLevel = (DgmOctree::MAX_OCTREE_LEVEL < 12 ? DgmOctree::MAX_OCTREE_LEVEL : 12);
+	for (int level=8; level<=maxLevel; ++level)
+	{
+		unsigned singleThreadCount = 0, multiThreadCount = 0;
+
+		QThreadPool::globalInstance()->setMaxThreadCount(1);
+		qint64 singleThreadTime = TimeLabelling(cloud,octree,level,singleThreadCount);
+
+		QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+		qint64 multiThreadTime = TimeLabelling(cloud,octree,level,multiThreadCount);
+
+		if (singleThreadTime < 0 || multiThreadTime < 0)
+		{
+			printf("Failed to label the components (level %i)!\n",level);
+			return EXIT_FAILURE;
+		}
+		//both paths must give the same components
+		if (singleThreadCount != multiThreadCount)
+		{
+			printf("Error: different number of components (level %i)!\n",level);
+			return EXIT_FAILURE;
+		}
+
+		printf("%i\t%u\t\t%u\t\t%lld\t\t%lld\t\t%.2f\n",
+				level,
+				octree.getCellNumber(static_cast<uchar>(level)),
+				multiThreadCount,
+				static_cast<long long>(singleThreadTime),
+				static_cast<long long>(multiThreadTime),
+				multiThreadTime > 0 ? static_cast<double>(singleThreadTime)/multiThreadTime : 0.0);
+	}
+
+	return EXIT_SUCCESS;
+}
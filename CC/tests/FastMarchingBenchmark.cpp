@@ -0,0 +1,140 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: Fast Marching front propagation (FastMarchingForPropagation) on octree grids of levels 6 to 10
+//Usage: FastMarchingBenchmark [grid size (default: 1500, i.e. 2.25M points)]
+
+//CCLib
+#include <ChunkedPointCloud.h>
+#include <DgmOctree.h>
+#include <FastMarchingForPropagation.h>
+#include <ReferenceCloud.h>
+
+//Qt
+#include <QElapsedTimer>
+
+//system
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CCLib;
+
+//! Surface extent (along X and Y)
+static const PointCoordinateType SURFACE_EXTENT = 100;
+
+//! Generates a wavy surface sampled on a regular grid
+static bool GenerateSurface(ChunkedPointCloud& cloud, unsigned size)
+{
+	if (!cloud.reserve(size*size))
+		return false;
+
+	for (unsigned j=0; j<size; ++j)
+	{
+		for (unsigned i=0; i<size; ++i)
+		{
+			PointCoordinateType x = static_cast<PointCoordinateType>(i) * SURFACE_EXTENT / size;
+			PointCoordinateType y = static_cast<PointCoordinateType>(j) * SURFACE_EXTENT / size;
+			cloud.addPoint(CCVector3(x,y,5 * sin(x/10) * cos(y/10)));
+		}
+	}
+
+	//the propagation stores the front arrival times in the cloud scalar field
+	return cloud.enableScalarField();
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned gridSize = (argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 1500);
+
+	ChunkedPointCloud cloud;
+	if (!GenerateSurface(cloud,gridSize))
+	{
+		printf("Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	DgmOctree octree(&cloud);
+	if (octree.build() < 1)
+	{
+		printf("Failed to build the octree!\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Fast Marching propagation: %u points (seed: first point)\n\n",cloud.size());
+	printf("Level\tCells\t\tInit (ms)\tPropagation (ms)\tus/cell\t\tReached points\n");
+
+	const CCVector3* seedPoint = cloud.getPoint(0);
+	for (int level=6; level<=10 && level<=DgmOctree::MAX_OCTREE_LEVEL; ++level)
+	{
+		uchar octreeLevel = static_cast<uchar>(level);
+
+		//the sampled surface is only continuous if the cells are larger than the grid step
+		if (octree.getCellSize(octreeLevel) < SURFACE_EXTENT / gridSize)
+		{
+			printf("%i\t(cells smaller than the grid step: skipped)\n",level);
+			continue;
+		}
+
+		QElapsedTimer timer;
+		timer.start();
+
+		FastMarchingForPropagation fm;
+		//a sampled surface may only be connected diagonally at fine levels
+		fm.setExtendedConnectivity(true);
+		if (fm.init(&cloud,&octree,octreeLevel,true) < 0)
+		{
+			printf("Failed to initialize the grid (level %i)!\n",level);
+			return EXIT_FAILURE;
+		}
+		qint64 initTime = timer.restart();
+
+		int pos[3];
+		octree.getTheCellPosWhichIncludesThePoint(seedPoint,pos,octreeLevel);
+		if (!fm.setSeedCell(pos) || fm.propagate() < 0)
+		{
+			printf("Failed to propagate the front (level %i)!\n",level);
+			return EXIT_FAILURE;
+		}
+		qint64 propagationTime = timer.elapsed();
+
+		ReferenceCloud reached(&cloud);
+		if (!fm.extractPropagatedPoints(&reached))
+		{
+			printf("Not enough memory!\n");
+			return EXIT_FAILURE;
+		}
+
+		//the surface is continuous: the front must reach all the points
+		if (reached.size() != cloud.size())
+		{
+			printf("Error: only %u points reached (level %i)!\n",reached.size(),level);
+			return EXIT_FAILURE;
+		}
+
+		unsigned cellCount = octree.getCellNumber(octreeLevel);
+		printf("%i\t%u\t\t%lld\t\t%lld\t\t\t%.3f\t\t%u\n",
+				level,
+				cellCount,
+				static_cast<long long>(initTime),
+				static_cast<long long>(propagationTime),
+				cellCount != 0 ? static_cast<double>(propagationTime) * 1000.0 / cellCount : 0.0,
+				reached.size());
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,138 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Benchmark: octree build time (cell codes computation + radix sort) against the number of threads
+//Usage: OctreeBuildBenchmark [point count (default: 10M)]
+
+//CCLib
+#include <ChunkedPointCloud.h>
+#include <DgmOctree.h>
+
+//Qt
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+
+//system
+#include <algorithm>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CCLib;
+
+//! Returns a (pseudo) random value between 0 and 1
+static PointCoordinateType Random01()
+{
+	return static_cast<PointCoordinateType>(rand()) / static_cast<PointCoordinateType>(RAND_MAX);
+}
+
+//! Generates a terrain-like cloud (points on a smooth surface, in random order)
+static bool GenerateTerrain(ChunkedPointCloud& cloud, unsigned count)
+{
+	if (!cloud.reserve(count))
+		return false;
+
+	srand(0);
+	for (unsigned i=0; i<count; ++i)
+	{
+		PointCoordinateType x = 100 * Random01();
+		PointCoordinateType y = 100 * Random01();
+		PointCoordinateType z = 10 * sin(x/10) * cos(y/10) + Random01()/10;
+		cloud.addPoint(CCVector3(x,y,z));
+	}
+
+	return true;
+}
+
+//! Builds the octree several times and returns the best time (in ms)
+static qint64 TimeBuild(ChunkedPointCloud& cloud, int repeat)
+{
+	qint64 best = -1;
+	for (int r=0; r<repeat; ++r)
+	{
+		DgmOctree octree(&cloud);
+		QElapsedTimer timer;
+		timer.start();
+		if (octree.build() < 1)
+			return -1;
+		qint64 elapsed = timer.elapsed();
+		if (best < 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+int main(int argc, char* argv[])
+{
+	unsigned pointCount = (argc > 1 ? static_cast<unsigned>(atoi(argv[1])) : 10000000);
+	const int repeat = 3;
+
+	ChunkedPointCloud cloud;
+	if (!GenerateTerrain(cloud,pointCount))
+	{
+		printf("Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+	printf("Octree build: %u points (best of %i runs)\n\n",pointCount,repeat);
+
+	//build time against the number of threads
+	const int maxThreadCount = QThread::idealThreadCount();
+	printf("Threads\tBuild (ms)\tSpeedup\n");
+	qint64 singleThreadTime = -1;
+	for (int threadCount=1; threadCount<=maxThreadCount; threadCount = (threadCount < maxThreadCount ? std::min(2*threadCount,maxThreadCount) : 2*threadCount))
+	{
+		QThreadPool::globalInstance()->setMaxThreadCount(threadCount);
+		qint64 elapsed = TimeBuild(cloud,repeat);
+		if (elapsed < 0)
+		{
+			printf("Failed to build the octree!\n");
+			return EXIT_FAILURE;
+		}
+		if (threadCount == 1)
+			singleThreadTime = elapsed;
+		printf("%i\t%lld\t\t%.2f\n",threadCount,static_cast<long long>(elapsed),elapsed > 0 ? static_cast<double>(singleThreadTime)/elapsed : 0.0);
+	}
+	QThreadPool::globalInstance()->setMaxThreadCount(maxThreadCount);
+
+	//reference: sort of the same codes with std::sort (single-threaded, as before the radix sort)
+	{
+		DgmOctree octree(&cloud);
+		if (octree.build() < 1)
+			return EXIT_FAILURE;
+		DgmOctree::cellsContainer codes = octree.pointsAndTheirCellCodes();
+		std::sort(codes.begin(),codes.end(),DgmOctree::IndexAndCode::indexComp); //back to the points order
+
+		QElapsedTimer timer;
+		timer.start();
+		std::sort(codes.begin(),codes.end(),DgmOctree::IndexAndCode::codeComp);
+		printf("\nReference: std::sort of the codes: %lld ms\n",static_cast<long long>(timer.elapsed()));
+
+		//the radix sort must give the same codes order
+		const DgmOctree::cellsContainer& octreeCodes = octree.pointsAndTheirCellCodes();
+		for (size_t i=0; i<codes.size(); ++i)
+		{
+			if (codes[i].theCode != octreeCodes[i].theCode)
+			{
+				printf("Error: the octree codes are not sorted as with std::sort!\n");
+				return EXIT_FAILURE;
+			}
+		}
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,177 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Test: the subsets of points returned by OctreeLOD::getPoints are spatially uniform
+//Usage: OctreeLODTest
+
+//CCLib
+#include <ChunkedPointCloud.h>
+#include <DgmOctree.h>
+#include <OctreeLOD.h>
+
+//system
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+using namespace CCLib;
+
+//! Returns a (pseudo) random value between 0 and 1
+static PointCoordinateType Random01()
+{
+	return static_cast<PointCoordinateType>(rand()) / static_cast<PointCoordinateType>(RAND_MAX);
+}
+
+//! Generates a cloud with a very dense cluster (90% of the points in 0.001% of the volume)
+/** The cluster points come first, so that the first points of the cloud are not uniform at all.
+**/
+static bool GenerateClusteredCloud(ChunkedPointCloud& cloud, unsigned count)
+{
+	if (!cloud.reserve(count))
+		return false;
+
+	srand(0);
+	unsigned clusterCount = count / 10 * 9;
+	for (unsigned i=0; i<count; ++i)
+	{
+		CCVector3 P(Random01(),Random01(),Random01());
+		if (i < clusterCount)
+			cloud.addPoint(CCVector3(10,10,10) + P * 2);
+		else
+			cloud.addPoint(P * 100);
+	}
+
+	return true;
+}
+
+//! Checks the subset of points returned for a given budget
+static bool CheckBudget(const OctreeLOD& lod, const DgmOctree& octree, unsigned budget)
+{
+	std::vector<unsigned> pointIndexes;
+	if (!lod.getPoints(budget,pointIndexes))
+	{
+		printf("Not enough memory!\n");
+		return false;
+	}
+
+	//approximately 'budget' points (each chunk may round its share down)
+	unsigned count = static_cast<unsigned>(pointIndexes.size());
+	if (count > budget || count + lod.chunkCount() < budget)
+	{
+		printf("Error: %u points returned for a budget of %u\n",count,budget);
+		return false;
+	}
+
+	//deepest octree level that is entirely displayed
+	unsigned char level = 0;
+	while (level+1 <= DgmOctree::MAX_OCTREE_LEVEL && lod.levelStart(level+2) <= budget)
+		++level;
+
+	//cell code (at this level) of each point
+	const DgmOctree::cellsContainer& pointsAndCodes = octree.pointsAndTheirCellCodes();
+	unsigned char bitShift = GET_BIT_SHIFT(level);
+	std::vector<DgmOctree::OctreeCellCodeType> pointCodes(pointsAndCodes.size());
+	for (size_t i=0; i<pointsAndCodes.size(); ++i)
+		pointCodes[pointsAndCodes[i].theIndex] = (pointsAndCodes[i].theCode >> bitShift);
+
+	std::vector<DgmOctree::OctreeCellCodeType> subsetCodes(count);
+	std::vector<bool> selected(pointCodes.size(),false);
+	for (unsigned i=0; i<count; ++i)
+	{
+		unsigned index = pointIndexes[i];
+		if (index >= pointCodes.size() || selected[index])
+		{
+			printf("Error: invalid or duplicate point index (%u)\n",index);
+			return false;
+		}
+		selected[index] = true;
+		subsetCodes[i] = pointCodes[index];
+	}
+	std::sort(subsetCodes.begin(),subsetCodes.end());
+
+	//the subset must cover all the (non empty) cells of this level...
+	unsigned cellCount = 0, maxPointsPerCell = 0;
+	for (unsigned i=0; i<count; )
+	{
+		unsigned j = i+1;
+		while (j < count && subsetCodes[j] == subsetCodes[i])
+			++j;
+		++cellCount;
+		maxPointsPerCell = std::max(maxPointsPerCell,j-i);
+		i = j;
+	}
+
+	//...with at most one point per cell of the next level (i.e. 8 points), except
+	//at the deepest level (the next 'level' is made of the duplicate points)
+	printf("Budget %u: %u points, level %i: %u/%u cells, max %u points per cell\n",
+			budget,
+			count,
+			level,
+			cellCount,
+			octree.getCellNumber(level),
+			maxPointsPerCell);
+
+	if (cellCount != octree.getCellNumber(level) || (level < DgmOctree::MAX_OCTREE_LEVEL && maxPointsPerCell > 8))
+	{
+		printf("Error: the subset is not uniform\n");
+		return false;
+	}
+
+	return true;
+}
+
+int main()
+{
+	ChunkedPointCloud cloud;
+	if (!GenerateClusteredCloud(cloud,1000000))
+	{
+		printf("Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	DgmOctree octree(&cloud);
+	if (octree.build() < 1)
+	{
+		printf("Failed to build the octree!\n");
+		return EXIT_FAILURE;
+	}
+
+	OctreeLOD lod;
+	if (!lod.build(&cloud,&octree) || lod.pointCount() != cloud.size())
+	{
+		printf("Failed to build the L.O.D. structure!\n");
+		return EXIT_FAILURE;
+	}
+
+	//the points of the levels 0 to L are one point per non-empty cell of level L
+	for (unsigned char level=0; level<=DgmOctree::MAX_OCTREE_LEVEL; ++level)
+	{
+		if (lod.levelStart(level+1) != octree.getCellNumber(level))
+		{
+			printf("Error: wrong population for level %i\n",level);
+			return EXIT_FAILURE;
+		}
+	}
+
+	const unsigned budgets[] = { 1000, 10000, 100000, 500000 };
+	for (unsigned i=0; i<sizeof(budgets)/sizeof(unsigned); ++i)
+		if (!CheckBudget(lod,octree,budgets[i]))
+			return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,167 @@
+//##########################################################################
+//#                                                                        #
+//#                               CCLIB                                    #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+//Test: triangle picking with a BVH gives the same results as the brute force picking
+//Usage: PickingTest
+
+//CCLib
+#include <ChunkedPointCloud.h>
+#include <MeshBVH.h>
+#include <PickingTools.h>
+#include <SimpleMesh.h>
+
+//system
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+using namespace CCLib;
+
+//! Returns a (pseudo) random value between 0 and 1
+static double Random01()
+{
+	return static_cast<double>(rand()) / static_cast<double>(RAND_MAX);
+}
+
+//! Generates a bumpy terrain mesh (grid of size x size vertices in [0;100]x[0;100])
+static bool GenerateTerrain(ChunkedPointCloud& vertices, SimpleMesh& mesh, unsigned size)
+{
+	if (!vertices.reserve(size*size) || !mesh.reserve(2*(size-1)*(size-1)))
+		return false;
+
+	for (unsigned j=0; j<size; ++j)
+	{
+		for (unsigned i=0; i<size; ++i)
+		{
+			PointCoordinateType x = static_cast<PointCoordinateType>(i) * 100 / (size-1);
+			PointCoordinateType y = static_cast<PointCoordinateType>(j) * 100 / (size-1);
+			vertices.addPoint(CCVector3(x,y,5 * sin(x/7) * cos(y/5)));
+		}
+	}
+
+	for (unsigned j=0; j+1<size; ++j)
+	{
+		for (unsigned i=0; i+1<size; ++i)
+		{
+			unsigned v = i + j*size;
+			mesh.addTriangle(v,v+1,v+size);
+			mesh.addTriangle(v+1,v+size+1,v+size);
+		}
+	}
+
+	return true;
+}
+
+//! Sets a perspective window matrix (OpenGL style) for a camera above the terrain looking down
+/** \param M output matrix (column-major)
+	\param C camera position
+	\param f focal (in pixels)
+	\param width window width (in pixels)
+	\param height window height (in pixels)
+**/
+static void SetWindowMatrix(double M[16], const CCVector3& C, double f, double width, double height)
+{
+	//the distance to the camera (w) is C.z - z
+	const double zNear = 1.0, zFar = 1000.0;
+	const double A = (zFar + zNear) / (zFar - zNear);
+	const double B = -2.0 * zFar * zNear / (zFar - zNear);
+
+	for (unsigned i=0; i<16; ++i)
+		M[i] = 0;
+
+	//x_win = f*(x-C.x)/w + width/2
+	M[0] = f; M[8] = -width/2; M[12] = -f*C.x + width/2*C.z;
+	//y_win = f*(y-C.y)/w + height/2
+	M[5] = f; M[9] = -height/2; M[13] = -f*C.y + height/2*C.z;
+	//depth = A + B/w
+	M[10] = -A; M[14] = A*C.z + B;
+	//w = C.z - z
+	M[11] = -1; M[15] = C.z;
+}
+
+int main()
+{
+	ChunkedPointCloud vertices;
+	SimpleMesh mesh(&vertices);
+	if (!GenerateTerrain(vertices,mesh,300))
+	{
+		printf("Not enough memory!\n");
+		return EXIT_FAILURE;
+	}
+
+	MeshBVH bvh;
+	if (!bvh.build(&mesh))
+	{
+		printf("Failed to build the BVH!\n");
+		return EXIT_FAILURE;
+	}
+
+	const double width = 800, height = 600;
+	const CCVector3 cameraPositions[] = { CCVector3(50,50,150), CCVector3(20,70,40), CCVector3(90,10,12) };
+	const PointCoordinateType tolerances[] = { 0, 2, 10 };
+
+	srand(0);
+	unsigned pickCount = 0, pickedCount = 0, errorCount = 0;
+	for (unsigned c=0; c<sizeof(cameraPositions)/sizeof(CCVector3); ++c)
+	{
+		double M[16];
+		SetWindowMatrix(M,cameraPositions[c],500,width,height);
+
+		for (unsigned t=0; t<sizeof(tolerances)/sizeof(PointCoordinateType); ++t)
+		{
+			for (unsigned k=0; k<200; ++k)
+			{
+				CCVector2 pickPos(static_cast<PointCoordinateType>(Random01()*width), static_cast<PointCoordinateType>(Random01()*height));
+
+				unsigned bruteForceIndex = 0, bvhIndex = 0;
+				double bruteForceDepth = 0, bvhDepth = 0;
+				bool bruteForcePicked = PickingTools::pickTriangle(&mesh,M,pickPos,tolerances[t],bruteForceIndex,bruteForceDepth);
+				bool bvhPicked = PickingTools::pickTriangle(&mesh,M,pickPos,tolerances[t],bvhIndex,bvhDepth,&bvh);
+
+				++pickCount;
+				if (bruteForcePicked)
+					++pickedCount;
+
+				//the same triangle must be picked (or at least a triangle at the same depth)
+				if (	bruteForcePicked != bvhPicked
+					||	(bruteForcePicked && bruteForceIndex != bvhIndex && fabs(bruteForceDepth - bvhDepth) > 1.0e-12))
+				{
+					printf("Error: camera #%u, tolerance %g, position (%g,%g): brute force = %i (#%u, depth %g) / BVH = %i (#%u, depth %g)\n",
+							c,
+							static_cast<double>(tolerances[t]),
+							static_cast<double>(pickPos.x),
+							static_cast<double>(pickPos.y),
+							bruteForcePicked ? 1 : 0,
+							bruteForceIndex,
+							bruteForceDepth,
+							bvhPicked ? 1 : 0,
+							bvhIndex,
+							bvhDepth);
+					++errorCount;
+				}
+			}
+		}
+	}
+
+	printf("%u picking tests (%u triangles): %u picked, %u error(s)\n",pickCount,mesh.size(),pickedCount,errorCount);
+
+	//most positions should hit the terrain
+	if (errorCount != 0 || pickedCount < pickCount/2)
+		return EXIT_FAILURE;
+
+	return EXIT_SUCCESS;
+}
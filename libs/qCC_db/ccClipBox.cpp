@@ -27,6 +27,7 @@
 #include <ccSphere.h>
 #include <ccTorus.h>
 #include <ccHObjectCaster.h>
+#include <ccOctree.h>
 
 //system
 #include <assert.h>
@@ -167,6 +168,7 @@ ccClipBox::ccClipBox(ccHObject* associatedEntity, QString name/*= QString("clipp
 	: ccHObject(name)
 	, m_associatedEntity(0)
 	, m_activeComponent(NONE)
+	, m_octreeVersion(0)
 {
 	setSelectionBehavior(SELECTION_IGNORED);
 
@@ -202,6 +204,7 @@ void ccClipBox::setAssociatedEntity(ccHObject* associatedEntity)
 		ccHObjectCaster::ToGenericPointCloud(m_associatedEntity)->unallocateVisibilityArray();
 	}
 	m_associatedEntity = 0;
+	m_octreeIntersector.clear();
 
 	//try to initialize new one
 	if (associatedEntity)
@@ -510,6 +513,53 @@ void ccClipBox::update(bool shrink/*=false*/)
 
 	ccGenericPointCloud::VisibilityTableType* visTable = cloud->getTheVisibilityArray();
 
+	//spatially indexed update
+	if (getOctreeIntersector())
+	{
+		ccGLMatrix transMat;
+		if (m_glTransEnabled)
+			transMat = m_glTrans.inverse();
+		const ccGLMatrix* localTrans = m_glTransEnabled ? &transMat : 0;
+
+		std::vector<ccOctreeBoxIntersector::Cell>& cells = m_octreeIntersector.cells();
+		for (size_t i=0; i<cells.size(); ++i)
+		{
+			ccOctreeBoxIntersector::Cell& cell = cells[i];
+			ccOctreeBoxIntersector::OctreeCellPosition position = m_octreeIntersector.positionFromBox(cell,m_box,localTrans);
+
+			if (position == ccOctreeBoxIntersector::CELL_INTERSECT_BOX)
+			{
+				//the points of the cells intersecting the box borders are tested one by one
+				for (unsigned j=0; j<cell.count; ++j)
+				{
+					unsigned index = m_octreeIntersector.pointIndex(cell.startIndex+j);
+					if (!shrink || visTable->getValue(index) == POINT_VISIBLE)
+					{
+						CCVector3 P = *cloud->getPoint(index);
+						if (localTrans)
+							localTrans->apply(P);
+						visTable->setValue(index,m_box.contains(P) ? POINT_VISIBLE : POINT_HIDDEN);
+					}
+				}
+			}
+			else if (position != cell.position)
+			{
+				//the other ones are updated in bulk (only if their position has changed)
+				uchar visibility = (position == ccOctreeBoxIntersector::CELL_INSIDE_BOX ? POINT_VISIBLE : POINT_HIDDEN);
+				for (unsigned j=0; j<cell.count; ++j)
+				{
+					unsigned index = m_octreeIntersector.pointIndex(cell.startIndex+j);
+					if (!shrink || visTable->getValue(index) == POINT_VISIBLE)
+						visTable->setValue(index,visibility);
+				}
+			}
+
+			cell.position = static_cast<uchar>(position);
+		}
+
+		return;
+	}
+
 	if (m_glTransEnabled)
 	{
 		ccGLMatrix transMat;
@@ -542,6 +592,31 @@ void ccClipBox::update(bool shrink/*=false*/)
 	}
 }
 
+ccOctreeBoxIntersector* ccClipBox::getOctreeIntersector()
+{
+	if (!m_associatedEntity || !m_associatedEntity->isKindOf(CC_TYPES::POINT_CLOUD))
+		return 0;
+
+	ccOctree* octree = ccHObjectCaster::ToGenericPointCloud(m_associatedEntity)->getOctree();
+	if (!octree)
+	{
+		m_octreeIntersector.clear();
+		return 0;
+	}
+
+	//(re)build the classifier if the octree has changed
+	//(the version is checked as well, as a new octree may be allocated at the same address)
+	if (	static_cast<CCLib::DgmOctree*>(octree) != m_octreeIntersector.associatedOctree()
+		||	octree->getVersion() != m_octreeVersion)
+	{
+		if (!m_octreeIntersector.build(octree))
+			return 0;
+		m_octreeVersion = octree->getVersion();
+	}
+
+	return &m_octreeIntersector;
+}
+
 ccBBox ccClipBox::getMyOwnBB()
 {
 	return m_box;
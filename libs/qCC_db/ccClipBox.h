@@ -24,6 +24,7 @@
 #include "ccHObject.h"
 #include "ccInteractor.h"
 #include "ccGLMatrix.h"
+#include "ccOctreeBoxIntersector.h"
 
 //Qt
 #include <QObject>
@@ -94,10 +95,18 @@ public:
 	void shift(const CCVector3& v);
 
 	//! Updates associated entity 'visibility'
-	/** \param shrink Whether box is shrinking (faster) or not
+	/** If the associated cloud has an octree, only the points of the cells
+		intersecting the box borders are tested individually (the other cells
+		are updated in bulk, and only if their position has changed).
+		\param shrink Whether box is shrinking (faster) or not
 	**/
 	void update(bool shrink = false);
 
+	//! Returns the octree cells classifier of the associated cloud
+	/** \return the classifier or 0 if the associated cloud has no (valid) octree
+	**/
+	ccOctreeBoxIntersector* getOctreeIntersector();
+
 	//! Resets box
 	void reset();
 
@@ -131,6 +140,11 @@ protected:
 
 	//! View matrix
 	ccGLMatrixd m_viewMatrix;
+
+	//! Associated cloud octree cells classifier (see update)
+	ccOctreeBoxIntersector m_octreeIntersector;
+	//! Version of the octree the classifier has been built on (see ccOctree::getVersion)
+	unsigned m_octreeVersion;
 };
 
 #endif //CC_CLIP_BOX_HEADER
@@ -75,6 +75,10 @@ struct glDrawContext
 	bool decimateCloudOnMove;
 	//! Whether to decimate big meshes when rotating the camera
 	bool decimateMeshOnMove;
+	//! Max number of displayed points per cloud when decimation is active (0 = MAX_LOD_POINTS_NUMBER)
+	unsigned lodPointsBudget;
+	//! Set by the entities that could not display all their points (because of the L.O.D. budget)
+	bool lodDisplayIncomplete;
 
 	//! Currently displayed color scale (the corresponding scalar field in fact)
 	ccScalarField* sfColorScaleToDisplay;
@@ -111,6 +115,8 @@ struct glDrawContext
 		, renderZoom(1.0f)
 		, decimateCloudOnMove(true)
 		, decimateMeshOnMove(true)
+		, lodPointsBudget(0)
+		, lodDisplayIncomplete(false)
 		, sfColorScaleToDisplay(0)
 		, colorRampShader(0)
 		, customRenderingShader(0)
@@ -31,6 +31,7 @@
 
 //CCLib
 #include <MeshSamplingTools.h>
+#include <MeshBVH.h>
 #include <SimpleCloud.h>
 
 //system
@@ -43,11 +44,51 @@ ccGenericMesh::ccGenericMesh(QString name/*=QString()*/)
 	, m_materialsShown(false)
 	, m_showWired(false)
 	, m_stippling(false)
+	, m_bvh(0)
 {
 	setVisible(true);
 	lockVisibility(false);
 }
 
+ccGenericMesh::~ccGenericMesh()
+{
+	deleteBVH();
+}
+
+void ccGenericMesh::notifyGeometryUpdate()
+{
+	//the BVH doesn't follow the mesh modifications
+	deleteBVH();
+
+	ccHObject::notifyGeometryUpdate();
+}
+
+const CCLib::MeshBVH* ccGenericMesh::getBVH()
+{
+	//triangles may have been added or removed without notification
+	if (m_bvh && m_bvh->triangleIndexes().size() != size())
+		deleteBVH();
+
+	if (!m_bvh && size() != 0)
+	{
+		m_bvh = new CCLib::MeshBVH();
+		if (!m_bvh->build(this))
+		{
+			ccLog::Warning(QString("[ccGenericMesh::getBVH] Failed to compute the BVH of mesh '%1' (not enough memory?)").arg(getName()));
+			deleteBVH();
+		}
+	}
+
+	return m_bvh;
+}
+
+void ccGenericMesh::deleteBVH()
+{
+	if (m_bvh)
+		delete m_bvh;
+	m_bvh = 0;
+}
+
 void ccGenericMesh::showNormals(bool state)
 {
 	showTriNorms(state);
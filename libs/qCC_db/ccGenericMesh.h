@@ -32,6 +32,11 @@ class ccGenericPointCloud;
 class ccPointCloud;
 class ccMaterialSet;
 
+namespace CCLib
+{
+	class MeshBVH;
+}
+
 //! Generic mesh interface
 class QCC_DB_LIB_API ccGenericMesh : public CCLib::GenericIndexedMesh, public ccHObject
 {
@@ -44,13 +49,25 @@ public:
 	ccGenericMesh(QString name = QString());
 
 	//! Destructor
-	virtual ~ccGenericMesh() {};
+	virtual ~ccGenericMesh();
 
 	//inherited methods (ccDrawableObject)
 	virtual void showNormals(bool state);
 
 	//inherited methods (ccHObject)
 	virtual bool isSerializable() const { return true; }
+	virtual void notifyGeometryUpdate();
+
+	//! Returns the BVH (bounding volume hierarchy) of the triangles
+	/** Used to accelerate the picking (see CCLib::PickingTools::pickTriangle).
+		The structure is computed if necessary, and deleted as soon as the
+		geometry is updated (see notifyGeometryUpdate).
+		\return the BVH (or 0 if it couldn't be computed)
+	**/
+	const CCLib::MeshBVH* getBVH();
+
+	//! Deletes the BVH (if any)
+	void deleteBVH();
 
 	//! Returns the vertices cloud
 	virtual ccGenericPointCloud* getAssociatedCloud() const = 0;
@@ -214,6 +231,9 @@ protected:
 
 	//! Polygon stippling state
 	bool m_stippling;
+
+	//! Triangles BVH (see getBVH)
+	CCLib::MeshBVH* m_bvh;
 };
 
 #endif //CC_GENERIC_MESH_HEADER
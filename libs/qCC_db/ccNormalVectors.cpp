@@ -342,6 +342,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithHF(const CCLib::DgmOctree::octreeCe
 	PointCoordinateType radius	= *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+	CCLib::DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
 	nNSS.level												= cell.level;
 	nNSS.prepare(radius,cell.parentOctree->getCellSize(nNSS.level));
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
@@ -411,6 +412,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithLS(const CCLib::DgmOctree::octreeCe
 	PointCoordinateType radius	= *static_cast<PointCoordinateType*>(additionalParameters[1]);
 
 	CCLib::DgmOctree::NearestNeighboursSphericalSearchStruct nNSS;
+	CCLib::DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
 	nNSS.level												= cell.level;
 	nNSS.prepare(radius,cell.parentOctree->getCellSize(nNSS.level));
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
@@ -463,6 +465,7 @@ bool ccNormalVectors::ComputeNormsAtLevelWithTri(	const CCLib::DgmOctree::octree
 	NormsTableType* theNorms = static_cast<NormsTableType*>(additionalParameters[0]);
 
 	CCLib::DgmOctree::NearestNeighboursSearchStruct nNSS;
+	CCLib::DgmOctree::ScopedScratchBuffers scratch(nNSS,cell.scratch);
 	nNSS.level												= cell.level;
 	nNSS.minNumberOfNeighbors								= NUMBER_OF_POINTS_FOR_NORM_WITH_TRI;
 	cell.parentOctree->getCellPos(cell.truncatedCode,cell.level,nNSS.cellPos,true);
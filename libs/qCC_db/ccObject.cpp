@@ -49,8 +49,11 @@
 	v3.4 - 01/09/2014 - ccIndexedTransformation and ccIndexedTransformationBuffer added + CC_CLASS_ENUM is now coded on 64 bits
 	v3.5 - 02/13/2014 - ccSensor class updated
 	v3.6 - 05/30/2014 - ccGLWindow and associated structures (viewport, etc.) now use double precision
+	v3.7 - 10/18/2026 - the cloud octree structure is now saved along with the cloud
+	v3.8 - 10/18/2026 - chunked arrays are now saved as independently compressed blocks (with an index table)
+	v3.9 - 10/18/2026 - the cloud L.O.D. structure is now saved along with the cloud
 **/
-const unsigned c_currentDBVersion = 36; //3.6
+const unsigned c_currentDBVersion = 39; //3.9
 
 // Persistent settings key for storing the last generated entity ID
 static const QString s_uniqueIDKey("UniqueID");
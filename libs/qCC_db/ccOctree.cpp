@@ -31,6 +31,9 @@
 #include <Neighbourhood.h>
 #include <CCMiscTools.h>
 
+//Qt
+#include <QAtomicInt>
+
 ccOctreeSpinBox::ccOctreeSpinBox(QWidget* parent/*=0*/)
 	: QSpinBox(parent)
 	, m_octreeBoxWidth(0)
@@ -98,9 +101,11 @@ ccOctree::ccOctree(ccGenericPointCloud* aCloud)
 	, m_glListID(-1)
 	, m_shouldBeRefreshed(true)
 	, m_frustrumIntersector(0)
+	, m_version(0)
 {
 	setVisible(false);
 	lockVisibility(false);
+	updateVersion();
 }
 
 ccOctree::~ccOctree()
@@ -137,6 +142,49 @@ void ccOctree::clear()
 	}
 
 	DgmOctree::clear();
+
+	updateVersion();
+}
+
+//! Last version given to an octree (see ccOctree::getVersion)
+static QAtomicInt s_lastOctreeVersion(0);
+
+void ccOctree::updateVersion()
+{
+	m_version = static_cast<unsigned>(s_lastOctreeVersion.fetchAndAddOrdered(1) + 1);
+}
+
+void ccOctree::invalidateDerivedStructures()
+{
+	updateVersion();
+
+	//the display must be refreshed
+	m_shouldBeRefreshed = true;
+
+	//and the frustum intersector rebuilt
+	if (m_frustrumIntersector)
+	{
+		delete m_frustrumIntersector;
+		m_frustrumIntersector = 0;
+	}
+}
+
+int ccOctree::insertPoints(unsigned firstIndex, unsigned lastIndex)
+{
+	int result = DgmOctree::insertPoints(firstIndex,lastIndex);
+	if (result > 0)
+		invalidateDerivedStructures();
+
+	return result;
+}
+
+bool ccOctree::removePoints(const std::vector<unsigned>& newIndexes)
+{
+	bool success = DgmOctree::removePoints(newIndexes);
+	if (success)
+		invalidateDerivedStructures();
+
+	return success;
 }
 
 ccBBox ccOctree::getMyOwnBB()
@@ -158,6 +206,8 @@ void ccOctree::multiplyBoundingBox(const PointCoordinateType multFactor)
 
 	for (int i=0;i<=MAX_OCTREE_LEVEL;++i)
 		m_cellSize[i] *= multFactor;
+
+	updateVersion();
 }
 
 void ccOctree::translateBoundingBox(const CCVector3& T)
@@ -166,6 +216,217 @@ void ccOctree::translateBoundingBox(const CCVector3& T)
 	m_dimMax += T;
 	m_pointsMin += T;
 	m_pointsMax += T;
+
+	updateVersion();
+}
+
+//! Octree structure header (see ccOctree::structureToFile)
+struct OctreeStructureHeader
+{
+	uint8_t maxLevel;
+	uint8_t cellCodeSize;
+	uint8_t coordinateSize;
+	uint8_t indexAndCodeSize;
+
+	//! Returns the header corresponding to the current build
+	static OctreeStructureHeader Current()
+	{
+		OctreeStructureHeader header;
+		header.maxLevel = static_cast<uint8_t>(CCLib::DgmOctree::MAX_OCTREE_LEVEL);
+		header.cellCodeSize = static_cast<uint8_t>(sizeof(CCLib::DgmOctree::OctreeCellCodeType));
+		header.coordinateSize = static_cast<uint8_t>(sizeof(PointCoordinateType));
+		header.indexAndCodeSize = static_cast<uint8_t>(sizeof(CCLib::DgmOctree::IndexAndCode));
+		return header;
+	}
+
+	//! Returns whether two headers are compatible
+	bool operator == (const OctreeStructureHeader& h) const
+	{
+		return		maxLevel == h.maxLevel
+				&&	cellCodeSize == h.cellCodeSize
+				&&	coordinateSize == h.coordinateSize
+				&&	indexAndCodeSize == h.indexAndCodeSize;
+	}
+};
+
+bool ccOctree::structureToFile(QFile& out) const
+{
+	assert(out.isOpen() && (out.openMode() & QIODevice::WriteOnly));
+
+	if (!m_theAssociatedCloud)
+		return false;
+
+	uint32_t cloudSize = static_cast<uint32_t>(m_theAssociatedCloud->size());
+	uint32_t projectedPoints = static_cast<uint32_t>(m_numberOfProjectedPoints);
+	uint32_t codesCount = static_cast<uint32_t>(m_thePointsAndTheirCellCodes.size());
+
+	//block size (so that incompatible builds can skip it)
+	uint64_t blockSize =	sizeof(OctreeStructureHeader)
+						+	3*4 //cloud size, number of projected points and number of codes
+						+	4*sizeof(PointCoordinateType)*3 //bounding-boxes
+						+	sizeof(m_cellSize)
+						+	sizeof(m_fillIndexes)
+						+	sizeof(m_cellCount)
+						+	sizeof(m_maxCellPopulation)
+						+	sizeof(m_averageCellPopulation)
+						+	sizeof(m_stdDevCellPopulation)
+						+	static_cast<uint64_t>(codesCount)*sizeof(IndexAndCode);
+	if (out.write((const char*)&blockSize,8)<0)
+		return WriteError();
+
+	//header
+	OctreeStructureHeader header = OctreeStructureHeader::Current();
+	if (out.write((const char*)&header,sizeof(OctreeStructureHeader))<0)
+		return WriteError();
+
+	//number of points
+	if (	out.write((const char*)&cloudSize,4)<0
+		||	out.write((const char*)&projectedPoints,4)<0)
+		return WriteError();
+
+	//bounding-boxes
+	if (	out.write((const char*)m_dimMin.u,sizeof(PointCoordinateType)*3)<0
+		||	out.write((const char*)m_dimMax.u,sizeof(PointCoordinateType)*3)<0
+		||	out.write((const char*)m_pointsMin.u,sizeof(PointCoordinateType)*3)<0
+		||	out.write((const char*)m_pointsMax.u,sizeof(PointCoordinateType)*3)<0)
+		return WriteError();
+
+	//per-level tables
+	if (	out.write((const char*)m_cellSize,sizeof(m_cellSize))<0
+		||	out.write((const char*)m_fillIndexes,sizeof(m_fillIndexes))<0
+		||	out.write((const char*)m_cellCount,sizeof(m_cellCount))<0
+		||	out.write((const char*)m_maxCellPopulation,sizeof(m_maxCellPopulation))<0
+		||	out.write((const char*)m_averageCellPopulation,sizeof(m_averageCellPopulation))<0
+		||	out.write((const char*)m_stdDevCellPopulation,sizeof(m_stdDevCellPopulation))<0)
+		return WriteError();
+
+	//sorted codes
+	if (out.write((const char*)&codesCount,4)<0)
+		return WriteError();
+	if (codesCount)
+	{
+		if (out.write((const char*)&(m_thePointsAndTheirCellCodes[0]),static_cast<qint64>(codesCount)*sizeof(IndexAndCode))<0)
+			return WriteError();
+	}
+
+	return true;
+}
+
+bool ccOctree::structureFromFile(QFile& in, short dataVersion, bool& restored)
+{
+	assert(in.isOpen() && (in.openMode() & QIODevice::ReadOnly));
+
+	restored = false;
+	clear();
+
+	//block size
+	uint64_t blockSize = 0;
+	if (in.read((char*)&blockSize,8)<0)
+		return ReadError();
+	qint64 blockEnd = in.pos() + static_cast<qint64>(blockSize);
+
+	//header
+	OctreeStructureHeader header;
+	if (in.read((char*)&header,sizeof(OctreeStructureHeader))<0)
+		return ReadError();
+	if (!(header == OctreeStructureHeader::Current()))
+	{
+		ccLog::Warning("[ccOctree] Stored octree is not compatible with this version (it will be recomputed if necessary)");
+		return in.seek(blockEnd) ? true : ReadError();
+	}
+
+	//number of points
+	uint32_t cloudSize = 0;
+	uint32_t projectedPoints = 0;
+	if (	in.read((char*)&cloudSize,4)<0
+		||	in.read((char*)&projectedPoints,4)<0)
+		return ReadError();
+	m_numberOfProjectedPoints = projectedPoints;
+
+	//bounding-boxes
+	if (	in.read((char*)m_dimMin.u,sizeof(PointCoordinateType)*3)<0
+		||	in.read((char*)m_dimMax.u,sizeof(PointCoordinateType)*3)<0
+		||	in.read((char*)m_pointsMin.u,sizeof(PointCoordinateType)*3)<0
+		||	in.read((char*)m_pointsMax.u,sizeof(PointCoordinateType)*3)<0)
+		return ReadError();
+
+	//per-level tables
+	if (	in.read((char*)m_cellSize,sizeof(m_cellSize))<0
+		||	in.read((char*)m_fillIndexes,sizeof(m_fillIndexes))<0
+		||	in.read((char*)m_cellCount,sizeof(m_cellCount))<0
+		||	in.read((char*)m_maxCellPopulation,sizeof(m_maxCellPopulation))<0
+		||	in.read((char*)m_averageCellPopulation,sizeof(m_averageCellPopulation))<0
+		||	in.read((char*)m_stdDevCellPopulation,sizeof(m_stdDevCellPopulation))<0)
+		return ReadError();
+
+	//sorted codes
+	uint32_t codesCount = 0;
+	if (in.read((char*)&codesCount,4)<0)
+		return ReadError();
+
+	//check consistency with the associated cloud before loading the (big) codes array
+	bool isStale = (!m_theAssociatedCloud || cloudSize != m_theAssociatedCloud->size() || codesCount != projectedPoints || projectedPoints > cloudSize);
+	if (!isStale)
+	{
+		CCVector3 bbMin,bbMax;
+		m_theAssociatedCloud->getBoundingBox(bbMin.u,bbMax.u);
+		for (unsigned char k=0; k<3; ++k)
+		{
+			if (projectedPoints == cloudSize)
+			{
+				//all points are projected: the bounding-boxes should be exactly the same
+				if (m_pointsMin.u[k] != bbMin.u[k] || m_pointsMax.u[k] != bbMax.u[k])
+					isStale = true;
+			}
+			else if (m_pointsMin.u[k] < bbMin.u[k] || m_pointsMax.u[k] > bbMax.u[k])
+			{
+				isStale = true;
+			}
+		}
+	}
+
+	if (!isStale && codesCount)
+	{
+		try
+		{
+			m_thePointsAndTheirCellCodes.resize(codesCount);
+		}
+		catch(std::bad_alloc)
+		{
+			ccLog::Warning("[ccOctree] Not enough memory to restore the stored octree (it will be recomputed if necessary)");
+			clear();
+			return in.seek(blockEnd) ? true : ReadError();
+		}
+
+		if (in.read((char*)&(m_thePointsAndTheirCellCodes[0]),static_cast<qint64>(codesCount)*sizeof(IndexAndCode))<0)
+		{
+			clear();
+			return ReadError();
+		}
+
+		//we don't want to crash on a corrupted file
+		for (unsigned i=0; i<codesCount; ++i)
+		{
+			if (m_thePointsAndTheirCellCodes[i].theIndex >= cloudSize)
+			{
+				isStale = true;
+				break;
+			}
+		}
+	}
+
+	if (isStale)
+	{
+		ccLog::Warning("[ccOctree] Stored octree is not consistent with its associated cloud (it will be recomputed if necessary)");
+		clear();
+		return in.seek(blockEnd) ? true : ReadError();
+	}
+
+	//the display must be refreshed
+	m_shouldBeRefreshed = true;
+	restored = (m_numberOfProjectedPoints != 0);
+
+	return true;
 }
 
 void ccOctree::drawMeOnly(CC_DRAW_CONTEXT& context)
@@ -108,6 +108,14 @@ public:
 	**/
 	void translateBoundingBox(const CCVector3& T);
 
+	//! Returns the version of the octree structure
+	/** The version changes each time the structure (or its bounding-box) is
+		modified and it is unique among all octrees. It can be used to validate
+		the structures built on an octree (even if a new octree is later
+		allocated at the same address).
+	**/
+	unsigned getVersion() const { return m_version; }
+
 	//! Returns class ID
 	virtual CC_CLASS_ENUM getClassID() const { return CC_TYPES::POINT_OCTREE; }
 
@@ -119,6 +127,8 @@ public:
 
 	//inherited from DgmOctree
 	virtual void clear();
+	virtual int insertPoints(unsigned firstIndex, unsigned lastIndex);
+	virtual bool removePoints(const std::vector<unsigned>& newIndexes);
 
 	//Inherited from ccHObject
 	virtual ccBBox getMyOwnBB();
@@ -144,11 +154,41 @@ public:
 	bool intersectWithFrustrum(	ccCameraSensor* sensor,
 								std::vector<unsigned>& inCameraFrustrum);
 
+	/*** SERIALIZATION ***/
+
+	//! Saves the octree structure
+	/** The octree is not a serializable entity by itself: its structure
+		is saved along with its associated cloud (see ccPointCloud::toFile_MeOnly)
+		so that it can be restored instead of being recomputed at loading time.
+		\param out output file (already opened)
+		\return success
+	**/
+	bool structureToFile(QFile& out) const;
+
+	//! Restores the octree structure
+	/** The stored structure is only restored if it is compatible with the
+		current build (max octree level, coordinates type) and consistent with
+		the associated cloud (number of points, bounding-box). Otherwise it is
+		skipped and 'restored' is set to false (the octree should then be
+		recomputed if necessary).
+		\param in input file (already opened)
+		\param dataVersion file version
+		\param[out] restored whether the structure has been restored or not
+		\return false only in case of read error
+	**/
+	bool structureFromFile(QFile& in, short dataVersion, bool& restored);
+
 protected:
 
 	//Inherited from ccHObject
 	void drawMeOnly(CC_DRAW_CONTEXT& context);
 
+	//! Invalidates the structures deduced from the octree cells (after an incremental update)
+	void invalidateDerivedStructures();
+
+	//! Gives a new version to the octree structure (see getVersion)
+	void updateVersion();
+
 	/*** RENDERING METHODS ***/
 
 	static bool DrawCellAsABox(	const CCLib::DgmOctree::octreeCell& cell,
@@ -171,6 +211,9 @@ protected:
 
 	ccOctreeFrustrumIntersector* m_frustrumIntersector;
 
+	//! Octree structure version (see getVersion)
+	unsigned m_version;
+
 };
 
 #endif //CC_OCTREE_HEADER
@@ -0,0 +1,123 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccOctreeBoxIntersector.h"
+
+//CCLib
+#include <GenericIndexedCloudPersist.h>
+#include <CCMiscTools.h>
+
+//system
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+ccOctreeBoxIntersector::ccOctreeBoxIntersector()
+	: m_associatedOctree(0)
+	, m_cellHalfSize(0)
+{
+}
+
+void ccOctreeBoxIntersector::clear()
+{
+	m_associatedOctree = 0;
+	m_cells.clear();
+	m_cellHalfSize = 0;
+}
+
+bool ccOctreeBoxIntersector::build(CCLib::DgmOctree* octree, unsigned pointsPerCell/*=64*/)
+{
+	clear();
+
+	if (!octree || octree->getNumberOfProjectedPoints() == 0)
+		return false;
+
+	//the points that are not projected in the octree would never be processed!
+	if (!octree->associatedCloud() || octree->getNumberOfProjectedPoints() != octree->associatedCloud()->size())
+		return false;
+
+	uchar level = octree->findBestLevelForAGivenPopulationPerCell(pointsPerCell);
+
+	CCLib::DgmOctree::cellIndexesContainer cellIndexes;
+	if (!octree->getCellIndexes(level,cellIndexes))
+		return false;
+
+	try
+	{
+		m_cells.resize(cellIndexes.size());
+	}
+	catch(std::bad_alloc)
+	{
+		//not enough memory
+		return false;
+	}
+
+	const CCLib::DgmOctree::cellsContainer& pointsAndCodes = octree->pointsAndTheirCellCodes();
+	unsigned char bitDec = GET_BIT_SHIFT(level);
+	unsigned pointCount = octree->getNumberOfProjectedPoints();
+
+	for (size_t i=0; i<cellIndexes.size(); ++i)
+	{
+		Cell& cell = m_cells[i];
+		cell.startIndex = cellIndexes[i];
+		cell.count = (i+1 < cellIndexes.size() ? cellIndexes[i+1] : pointCount) - cell.startIndex;
+		cell.position = CELL_UNKNOWN;
+
+		CCLib::DgmOctree::OctreeCellCodeType truncatedCode = (pointsAndCodes[cell.startIndex].theCode >> bitDec);
+		octree->computeCellCenter(truncatedCode,level,cell.center.u,true);
+	}
+
+	m_cellHalfSize = octree->getCellSize(level) / 2;
+	m_associatedOctree = octree;
+
+	return true;
+}
+
+void ccOctreeBoxIntersector::invalidate()
+{
+	for (size_t i=0; i<m_cells.size(); ++i)
+		m_cells[i].position = CELL_UNKNOWN;
+}
+
+void ccOctreeBoxIntersector::getLocalCellBox(const Cell& cell, const ccGLMatrix* localTrans, CCVector3& localMin, CCVector3& localMax) const
+{
+	CCVector3 C = cell.center;
+	if (localTrans)
+		localTrans->apply(C);
+
+	CCLib::CCMiscTools::ComputeTransformedCubeBox(C,m_cellHalfSize,localTrans ? localTrans->data() : 0,localMin,localMax);
+}
+
+ccOctreeBoxIntersector::OctreeCellPosition ccOctreeBoxIntersector::positionFromBox(const Cell& cell, const ccBBox& box, const ccGLMatrix* localTrans) const
+{
+	CCVector3 localMin,localMax;
+	getLocalCellBox(cell,localTrans,localMin,localMax);
+
+	const CCVector3& boxMin = box.minCorner();
+	const CCVector3& boxMax = box.maxCorner();
+
+	bool inside = true;
+	for (unsigned char d=0; d<3; ++d)
+	{
+		if (localMax.u[d] < boxMin.u[d] || localMin.u[d] > boxMax.u[d])
+			return CELL_OUTSIDE_BOX;
+		if (localMin.u[d] < boxMin.u[d] || localMax.u[d] > boxMax.u[d])
+			inside = false;
+	}
+
+	return inside ? CELL_INSIDE_BOX : CELL_INTERSECT_BOX;
+}
@@ -0,0 +1,124 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_OCTREE_BOX_INTERSECTOR_HEADER
+#define CC_OCTREE_BOX_INTERSECTOR_HEADER
+
+//Local
+#include "qCC_db.h"
+#include "ccBBox.h"
+#include "ccGLMatrix.h"
+
+//CCLib
+#include <DgmOctree.h>
+
+//system
+#include <vector>
+
+//! Classifies the cells of an octree relatively to a (possibly rotated) box
+/** The cells are extracted once (at a level adapted to interactive updates)
+	so that the points of the cells lying completely inside or outside the
+	box can be processed in bulk. Only the points of the cells intersecting
+	the box borders have to be tested individually.
+**/
+class QCC_DB_LIB_API ccOctreeBoxIntersector
+{
+public:
+
+	//! Position of a cell relatively to a box
+	enum OctreeCellPosition
+	{
+		CELL_OUTSIDE_BOX	= 0,	/**< The cell is completely outside the box **/
+		CELL_INSIDE_BOX		= 1,	/**< The cell is completely inside the box **/
+		CELL_INTERSECT_BOX	= 2,	/**< The cell intersects the box borders **/
+		CELL_UNKNOWN		= 3,	/**< The cell has not been classified yet **/
+	};
+
+	//! Octree cell descriptor
+	struct Cell
+	{
+		//! Index of the first point of the cell (in the octree 'pointsAndTheirCellCodes' table)
+		unsigned startIndex;
+		//! Number of points in the cell
+		unsigned count;
+		//! Cell center
+		CCVector3 center;
+		//! Last computed position (see OctreeCellPosition)
+		uchar position;
+	};
+
+	//! Default constructor
+	ccOctreeBoxIntersector();
+
+	//! Prepares the structure (extracts the octree cells)
+	/** The octree must contain all the points of its associated cloud.
+		\param octree octree
+		\param pointsPerCell indicative number of points per cell
+		\return success
+	**/
+	bool build(CCLib::DgmOctree* octree, unsigned pointsPerCell = 64);
+
+	//! Clears the structure
+	void clear();
+
+	//! Returns the associated octree (if any)
+	CCLib::DgmOctree* associatedOctree() const { return m_associatedOctree; }
+
+	//! Returns the extracted cells
+	std::vector<Cell>& cells() { return m_cells; }
+	//! Returns the extracted cells (const version)
+	const std::vector<Cell>& cells() const { return m_cells; }
+
+	//! Returns the half size of the extracted cells
+	PointCoordinateType cellHalfSize() const { return m_cellHalfSize; }
+
+	//! Returns the (global) index of the i-th point of the octree
+	/** The points of a given cell are stored in [startIndex ; startIndex+count[
+	**/
+	inline unsigned pointIndex(unsigned i) const { return m_associatedOctree->pointsAndTheirCellCodes()[i].theIndex; }
+
+	//! Resets the position of all cells to CELL_UNKNOWN
+	void invalidate();
+
+	//! Computes the bounding box of a cell expressed in another coordinate system
+	/** The box is slightly enlarged to be robust to rounding errors.
+		\param cell cell
+		\param localTrans transformation to the other coordinate system (or 0 if none)
+		\param[out] localMin box min corner
+		\param[out] localMax box max corner
+	**/
+	void getLocalCellBox(const Cell& cell, const ccGLMatrix* localTrans, CCVector3& localMin, CCVector3& localMax) const;
+
+	//! Returns the position of a cell relatively to a box
+	/** \param cell cell
+		\param box box (in its own coordinate system)
+		\param localTrans transformation from the cloud coordinate system to the box one (or 0 if none)
+		\return cell position (relatively to the box)
+	**/
+	OctreeCellPosition positionFromBox(const Cell& cell, const ccBBox& box, const ccGLMatrix* localTrans) const;
+
+protected:
+
+	//! Associated octree
+	CCLib::DgmOctree* m_associatedOctree;
+	//! Extracted cells
+	std::vector<Cell> m_cells;
+	//! Half size of the extracted cells
+	PointCoordinateType m_cellHalfSize;
+};
+
+#endif //CC_OCTREE_BOX_INTERSECTOR_HEADER
@@ -41,6 +41,9 @@
 #include "ccScalarField.h"
 #include "ccGenericGLDisplay.h"
 
+//Qt
+#include <QtConcurrentRun>
+
 //system
 #include <assert.h>
 
@@ -51,6 +54,8 @@ ccPointCloud::ccPointCloud(QString name) throw()
 	, m_normals(0)
 	, m_currentDisplayedScalarField(0)
 	, m_currentDisplayedScalarFieldIndex(-1)
+	, m_lodFailed(false)
+	, m_lodJob(0)
 {
 	init();
 }
@@ -304,6 +309,9 @@ void ccPointCloud::init() throw()
 
 void ccPointCloud::clear()
 {
+	//must be done first (a background computation may still read the points)
+	clearLOD();
+
 	ChunkedPointCloud::clear();
 	ccGenericPointCloud::clear();
 
@@ -387,11 +395,15 @@ const ccPointCloud& ccPointCloud::append(ccPointCloud* addedCloud, unsigned poin
 	if (size() == pointCountBefore) //in some cases points have already been copied! (ok it's tricky)
 	{
 		//we remove structures that are not compatible with fusion process
-		deleteOctree();
 		unallocateVisibilityArray();
 
 		for (unsigned i=0; i<addedPoints; i++)
 			addPoint(*addedCloud->getPoint(i));
+
+		//the octree is updated (instead of being rebuilt) if all new points fall inside
+		ccOctree* octree = getOctree();
+		if (octree && octree->insertPoints(pointCountBefore,size()) != static_cast<int>(addedPoints))
+			deleteOctree();
 	}
 
 	//deprecate internal structures
@@ -685,6 +697,9 @@ void ccPointCloud::unallocateColors()
 
 bool ccPointCloud::reserveThePointsTable(unsigned newNumberOfPoints)
 {
+	//the background L.O.D. computation reads the points
+	cancelLODComputation();
+
 	return m_points->reserve(newNumberOfPoints);
 }
 
@@ -813,6 +828,8 @@ bool ccPointCloud::reserve(unsigned newNumberOfPoints)
 	if (newNumberOfPoints < size())
 		return false;
 
+	cancelLODComputation();
+
 	//call parent method first (for points + scalar fields)
 	if (!ChunkedPointCloud::reserve(newNumberOfPoints))
 	{
@@ -841,6 +858,8 @@ bool ccPointCloud::resize(unsigned newNumberOfPoints)
 	if (newNumberOfPoints < size() && isLocked())
 		return false;
 
+	clearLOD();
+
 	//call parent method first (for points + scalar fields)
 	if (!ChunkedPointCloud::resize(newNumberOfPoints))
 	{
@@ -968,6 +987,9 @@ bool ccPointCloud::hasDisplayedScalarField() const
 
 void ccPointCloud::refreshBB()
 {
+	//the points have been modified: the L.O.D. structure is not valid anymore
+	clearLOD();
+
 	invalidateBoundingBox();
 	notifyGeometryUpdate();	//calls releaseVBOs()
 }
@@ -1270,9 +1292,36 @@ void ccPointCloud::applyGLTransformation(const ccGLMatrix& trans)
 
 void ccPointCloud::applyRigidTransformation(const ccGLMatrix& trans)
 {
+	//the L.O.D. structure is cleared with the octree (see below)
+	cancelLODComputation();
+
 	unsigned count = size();
-	for (unsigned i=0; i<count; i++)
-		trans.apply(*point(i));
+
+	//we transform the points chunk by chunk, and update the bounding-box on the fly
+	CCVector3 bbMin(0,0,0);
+	CCVector3 bbMax(0,0,0);
+	if (count != 0)
+	{
+		bbMin = bbMax = trans * (*point(0));
+
+		unsigned chunks = getChunksCount();
+		for (unsigned k=0; k<chunks; ++k)
+		{
+			CCVector3* P = chunkPoints(k);
+			unsigned chunkSize = getChunkSize(k);
+			for (unsigned i=0; i<chunkSize; ++i,++P)
+			{
+				trans.apply(*P);
+
+				if (P->x < bbMin.x) bbMin.x = P->x;
+				if (P->x > bbMax.x) bbMax.x = P->x;
+				if (P->y < bbMin.y) bbMin.y = P->y;
+				if (P->y > bbMax.y) bbMax.y = P->y;
+				if (P->z < bbMin.z) bbMin.z = P->z;
+				if (P->z > bbMax.z) bbMax.z = P->z;
+			}
+		}
+	}
 
 	//we must also take care of the normals!
 	if (hasNormals())
@@ -1328,8 +1377,13 @@ void ccPointCloud::applyRigidTransformation(const ccGLMatrix& trans)
 	//the octree is invalidated by rotation...
 	deleteOctree();
 
-	// ... as the bounding box
-	refreshBB(); //calls notifyGeometryUpdate + releaseVBOs
+	notifyGeometryUpdate(); //calls releaseVBOs()
+
+	//refreshBB();
+	//--> instead, we update BBox directly (already computed above)
+	m_points->setMin(bbMin.u);
+	m_points->setMax(bbMax.u);
+	m_validBB = true;
 }
 
 void ccPointCloud::translate(const CCVector3& T)
@@ -1337,6 +1391,9 @@ void ccPointCloud::translate(const CCVector3& T)
 	if (fabs(T.x)+fabs(T.y)+fabs(T.z) < ZERO_TOLERANCE)
 		return;
 
+	//the L.O.D. structure remains valid (as the octree)
+	cancelLODComputation();
+
 	unsigned count = size();
 	{
 		for (unsigned i=0; i<count; i++)
@@ -1367,6 +1424,12 @@ void ccPointCloud::translate(const CCVector3& T)
 
 void ccPointCloud::multiply(PointCoordinateType fx, PointCoordinateType fy, PointCoordinateType fz)
 {
+	//the L.O.D. structure remains valid (as the octree) only for a uniform scaling
+	if (fx==fy && fx==fz && fx > 0)
+		cancelLODComputation();
+	else
+		clearLOD();
+
 	unsigned count = size();
 	{
 		for (unsigned i=0; i<count; i++)
@@ -1440,6 +1503,9 @@ void ccPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
 	if (firstIndex == secondIndex)
 		return;
 
+	//the L.O.D. structure is not valid anymore
+	clearLOD();
+
 	//points + associated SF values
 	ChunkedPointCloud::swapPoints(firstIndex,secondIndex);
 
@@ -1461,6 +1527,129 @@ void ccPointCloud::swapPoints(unsigned firstIndex, unsigned secondIndex)
 	releaseVBOs();
 }
 
+bool ccPointCloud::computeLOD(CCLib::GenericProgressCallback* progressCb/*=0*/)
+{
+	cancelLODComputation();
+
+	m_lodFailed = !m_lod.build(this,getOctree(),progressCb);
+	if (m_lodFailed)
+		ccLog::Warning(QString("[ccPointCloud::computeLOD] Failed to compute the L.O.D. structure of cloud '%1' (not enough memory?)").arg(getName()));
+
+	return !m_lodFailed;
+}
+
+//! Progress callback that only forwards cancel requests (no GUI, as it's used by a worker thread)
+class LODCancelCallback : public CCLib::GenericProgressCallback
+{
+public:
+	LODCancelCallback() : m_cancelRequested(0) {}
+	virtual void reset() {}
+	virtual void update(float) {}
+	virtual void setMethodTitle(const char*) {}
+	virtual void setInfo(const char*) {}
+	virtual void start() {}
+	virtual void stop() {}
+	virtual bool isCancelRequested() { return m_cancelRequested.fetchAndAddRelaxed(0) != 0; }
+
+	//! Requests the process to stop
+	void requestCancel() { m_cancelRequested.fetchAndStoreOrdered(1); }
+
+protected:
+	QAtomicInt m_cancelRequested;
+};
+
+struct ccPointCloud::LODBuildJob
+{
+	//! Structure being built
+	CCLib::OctreeLOD lod;
+	//! Cancel requests
+	LODCancelCallback cancelCallback;
+	//! Computation result
+	QFuture<bool> future;
+};
+
+static bool BuildLOD(CCLib::OctreeLOD* lod, CCLib::GenericIndexedCloudPersist* cloud, CCLib::GenericProgressCallback* progressCb)
+{
+	//the cloud octree can't be used (it may be deleted by the main thread meanwhile)
+	return lod->build(cloud,0,progressCb);
+}
+
+bool ccPointCloud::computeLODInBackground()
+{
+	if (m_lodJob)
+	{
+		if (!m_lodJob->future.isFinished())
+			return false;
+
+		bool success = m_lodJob->future.result();
+		//points may have been added meanwhile (without reallocation)
+		bool upToDate = (m_lodJob->lod.pointCount() == size());
+		if (success && upToDate)
+			m_lod.swap(m_lodJob->lod);
+
+		delete m_lodJob;
+		m_lodJob = 0;
+
+		if (!success)
+		{
+			m_lodFailed = true;
+			ccLog::Warning(QString("[ccPointCloud::computeLODInBackground] Failed to compute the L.O.D. structure of cloud '%1' (not enough memory?)").arg(getName()));
+			return false;
+		}
+		else if (upToDate)
+		{
+			return true;
+		}
+		//otherwise the result is outdated: we restart the computation
+	}
+
+	unsigned count = size();
+	if (count != 0 && m_lod.pointCount() == count)
+		return true;
+	if (count == 0 || m_lodFailed)
+		return false;
+
+	//the bounding box is computed now, so that the worker thread only reads the cloud
+	PointCoordinateType bbMin[3],bbMax[3];
+	ChunkedPointCloud::getBoundingBox(bbMin,bbMax);
+
+	m_lodJob = new LODBuildJob;
+	m_lodJob->future = QtConcurrent::run(	BuildLOD,
+											&m_lodJob->lod,
+											static_cast<CCLib::GenericIndexedCloudPersist*>(this),
+											static_cast<CCLib::GenericProgressCallback*>(&m_lodJob->cancelCallback));
+
+	return false;
+}
+
+void ccPointCloud::cancelLODComputation()
+{
+	if (!m_lodJob)
+		return;
+
+	m_lodJob->cancelCallback.requestCancel();
+	m_lodJob->future.waitForFinished();
+
+	delete m_lodJob;
+	m_lodJob = 0;
+}
+
+void ccPointCloud::clearLOD()
+{
+	cancelLODComputation();
+
+	m_lod.clear();
+	m_lodFailed = false;
+}
+
+void ccPointCloud::deleteOctree()
+{
+	//the L.O.D. structure is based on the octree cells
+	clearLOD();
+
+	ccGenericPointCloud::deleteOctree();
+}
+
 void ccPointCloud::getDrawingParameters(glDrawParams& params) const
 {
 	//color override
@@ -1691,9 +1880,22 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 		// L.O.D.
 		unsigned numberOfPoints = size();
 		unsigned decimStep = 1;
-		if (numberOfPoints > MAX_LOD_POINTS_NUMBER && context.decimateCloudOnMove &&  MACRO_LODActivated(context))
+		unsigned lodBudget = 0; //number of points displayed with the L.O.D. structure (0 = not used)
+		unsigned maxDisplayedPoints = context.lodPointsBudget != 0 ? context.lodPointsBudget : MAX_LOD_POINTS_NUMBER;
+		if (numberOfPoints > maxDisplayedPoints && context.decimateCloudOnMove &&  MACRO_LODActivated(context))
 		{
-			decimStep = static_cast<int>(ceil(static_cast<float>(numberOfPoints) / MAX_LOD_POINTS_NUMBER));
+			//the L.O.D. structure can only be used with display arrays (i.e. no hidden points and no picking)
+			bool lodCompatible = (	!pushPointNames
+								&&	!isVisibilityTableInstantiated()
+								&&	!(glParams.showSF && m_currentDisplayedScalarField->mayHaveHiddenValues()) );
+
+			//the structure is computed in the background (simple decimation meanwhile)
+			if (lodCompatible && computeLODInBackground())
+				lodBudget = maxDisplayedPoints;
+			else
+				decimStep = static_cast<int>(ceil(static_cast<float>(numberOfPoints) / maxDisplayedPoints));
+
+			context.lodDisplayIncomplete = true;
 		}
 
 		/*** DISPLAY ***/
@@ -1902,9 +2104,17 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 							glChunkSFPointer(k,decimStep,useVBOs);
 						}
 
-						if (decimStep > 1)
-							chunkSize = static_cast<unsigned>( floor(static_cast<float>(chunkSize)/decimStep) );
-						glDrawArrays(GL_POINTS,0,chunkSize);
+						if (lodBudget != 0)
+						{
+							//the first points of each chunk (in L.O.D. order) give a uniform subset
+							glDrawElements(GL_POINTS,m_lod.chunkDisplayCount(k,lodBudget),GL_UNSIGNED_INT,m_lod.chunkIndexes(k));
+						}
+						else
+						{
+							if (decimStep > 1)
+								chunkSize = static_cast<unsigned>( floor(static_cast<float>(chunkSize)/decimStep) );
+							glDrawArrays(GL_POINTS,0,chunkSize);
+						}
 					}
 
 					if (glParams.showNorms)
@@ -2049,9 +2259,17 @@ void ccPointCloud::drawMeOnly(CC_DRAW_CONTEXT& context)
 					if (glParams.showColors)
 						glChunkColorPointer(k,decimStep,useVBOs);
 
-					if (decimStep > 1)
-						chunkSize = static_cast<unsigned>(floor(static_cast<float>(chunkSize)/decimStep));
-					glDrawArrays(GL_POINTS,0,chunkSize);
+					if (lodBudget != 0)
+					{
+						//the first points of each chunk (in L.O.D. order) give a uniform subset
+						glDrawElements(GL_POINTS,m_lod.chunkDisplayCount(k,lodBudget),GL_UNSIGNED_INT,m_lod.chunkIndexes(k));
+					}
+					else
+					{
+						if (decimStep > 1)
+							chunkSize = static_cast<unsigned>(floor(static_cast<float>(chunkSize)/decimStep));
+						glDrawArrays(GL_POINTS,0,chunkSize);
+					}
 				}
 
 				glDisableClientState(GL_VERTEX_ARRAY);
@@ -2236,21 +2454,42 @@ ccGenericPointCloud* ccPointCloud::createNewCloudFromVisibilitySelection(bool re
 	//shall the visible points be erased from this cloud?
 	if (removeSelectedPoints && !isLocked())
 	{
+		unsigned count = size();
+
+		//new index of each point (to update the octree instead of rebuilding it)
+		ccOctree* octree = getOctree();
+		std::vector<unsigned> newIndexes;
+		if (octree)
+		{
+			try
+			{
+				newIndexes.resize(count,CCLib::DgmOctree::REMOVED_POINT_INDEX);
+			}
+			catch(std::bad_alloc)
+			{
+				//not enough memory: we'll simply delete the octree
+				octree = 0;
+				deleteOctree();
+			}
+		}
+
 		//we remove all visible points
 		unsigned lastPoint = 0;
-		unsigned count = size();
 		for (unsigned i=0; i<count; ++i)
 		{
 			if (m_pointsVisibility->getValue(i) != POINT_VISIBLE)
 			{
 				if (i != lastPoint)
 					swapPoints(lastPoint,i);
+				if (octree)
+					newIndexes[i] = lastPoint;
 				++lastPoint;
 			}
 		}
 
-		//we disable octree
-		deleteOctree();
+		//we update the octree
+		if (octree && !octree->removePoints(newIndexes))
+			deleteOctree();
 
 		//TODO
 		//ccMesh* mesh = getMesh();
@@ -2707,6 +2946,59 @@ bool ccPointCloud::toFile_MeOnly(QFile& out) const
 			return WriteError();
 	}
 
+	//octree structure (dataVersion>=37)
+	{
+		ccOctree* octree = const_cast<ccPointCloud*>(this)->getOctree();
+		bool hasOctree = (octree && octree->getNumberOfProjectedPoints() != 0);
+		if (out.write((const char*)&hasOctree,sizeof(bool))<0)
+			return WriteError();
+		if (hasOctree)
+		{
+			if (!octree->structureToFile(out))
+				return false;
+		}
+	}
+
+	//L.O.D. structure (dataVersion>=39)
+	{
+		bool hasLOD = (m_lod.pointCount() != 0 && m_lod.pointCount() == size());
+		if (out.write((const char*)&hasLOD,sizeof(bool))<0)
+			return WriteError();
+		if (hasLOD)
+		{
+			const std::vector<unsigned>& localIndexes = m_lod.localIndexes();
+			const std::vector<unsigned>& chunkLevelStarts = m_lod.chunkLevelStarts();
+			uint32_t indexesCount = static_cast<uint32_t>(localIndexes.size());
+			uint32_t startsCount = static_cast<uint32_t>(chunkLevelStarts.size());
+
+			//block size (so that incompatible builds can skip it)
+			uint64_t blockSize =	1 + 4 //header (number of levels and chunk size)
+								+	4 + static_cast<uint64_t>(indexesCount)*4
+								+	4 + static_cast<uint64_t>(startsCount)*4;
+			if (out.write((const char*)&blockSize,8)<0)
+				return WriteError();
+
+			//header
+			uint8_t levelCount = static_cast<uint8_t>(CCLib::OctreeLOD::LEVEL_COUNT);
+			uint32_t chunkSize = static_cast<uint32_t>(CCLib::OctreeLOD::CHUNK_SIZE);
+			if (	out.write((const char*)&levelCount,1)<0
+				||	out.write((const char*)&chunkSize,4)<0)
+				return WriteError();
+
+			//sorted local indexes
+			if (out.write((const char*)&indexesCount,4)<0)
+				return WriteError();
+			if (out.write((const char*)&(localIndexes[0]),static_cast<qint64>(indexesCount)*4)<0)
+				return WriteError();
+
+			//levels start (per chunk)
+			if (out.write((const char*)&startsCount,4)<0)
+				return WriteError();
+			if (startsCount && out.write((const char*)&(chunkLevelStarts[0]),static_cast<qint64>(startsCount)*4)<0)
+				return WriteError();
+		}
+	}
+
 	return true;
 }
 
@@ -2844,6 +3136,113 @@ bool ccPointCloud::fromFile_MeOnly(QFile& in, short dataVersion, int flags)
 			setCurrentDisplayedScalarField(displayedScalarFieldIndex);
 	}
 
+	//octree structure (dataVersion>=37)
+	if (dataVersion >= 37)
+	{
+		bool hasOctree = false;
+		if (in.read((char*)&hasOctree,sizeof(bool))<0)
+			return ReadError();
+		if (hasOctree)
+		{
+			deleteOctree();
+			ccOctree* octree = new ccOctree(this);
+			bool restored = false;
+			if (!octree->structureFromFile(in, dataVersion, restored))
+			{
+				delete octree;
+				return false;
+			}
+			if (restored)
+			{
+				octree->setDisplay(getDisplay());
+				addChild(octree);
+			}
+			else
+			{
+				//stale or incompatible octree: it will be recomputed on demand
+				delete octree;
+			}
+		}
+	}
+
+	//L.O.D. structure (dataVersion>=39)
+	clearLOD();
+	if (dataVersion >= 39)
+	{
+		bool hasLOD = false;
+		if (in.read((char*)&hasLOD,sizeof(bool))<0)
+			return ReadError();
+		if (hasLOD)
+		{
+			uint64_t blockSize = 0;
+			if (in.read((char*)&blockSize,8)<0)
+				return ReadError();
+			qint64 blockEnd = in.pos() + static_cast<qint64>(blockSize);
+
+			//header
+			uint8_t levelCount = 0;
+			uint32_t chunkSize = 0;
+			if (	in.read((char*)&levelCount,1)<0
+				||	in.read((char*)&chunkSize,4)<0)
+				return ReadError();
+
+			uint32_t indexesCount = 0;
+			if (in.read((char*)&indexesCount,4)<0)
+				return ReadError();
+
+			bool restored = false;
+			if (	levelCount == CCLib::OctreeLOD::LEVEL_COUNT
+				&&	chunkSize == CCLib::OctreeLOD::CHUNK_SIZE
+				&&	indexesCount == size())
+			{
+				std::vector<unsigned> localIndexes;
+				std::vector<unsigned> chunkLevelStarts;
+				try
+				{
+					localIndexes.resize(indexesCount);
+				}
+				catch(std::bad_alloc)
+				{
+					//not enough memory: the structure will be recomputed on demand
+					indexesCount = 0;
+				}
+
+				if (indexesCount)
+				{
+					if (in.read((char*)&(localIndexes[0]),static_cast<qint64>(indexesCount)*4)<0)
+						return ReadError();
+
+					uint32_t startsCount = 0;
+					if (in.read((char*)&startsCount,4)<0)
+						return ReadError();
+					try
+					{
+						chunkLevelStarts.resize(startsCount);
+					}
+					catch(std::bad_alloc)
+					{
+						startsCount = 0;
+					}
+
+					if (startsCount)
+					{
+						if (in.read((char*)&(chunkLevelStarts[0]),static_cast<qint64>(startsCount)*4)<0)
+							return ReadError();
+						//setStructure checks the structure consistency (we don't want to crash on a corrupted file)
+						restored = m_lod.setStructure(localIndexes,chunkLevelStarts);
+					}
+				}
+			}
+
+			if (!restored)
+			{
+				ccLog::Warning("[ccPointCloud] Stored L.O.D. structure is not compatible with this version or with the cloud (it will be recomputed if necessary)");
+				if (!in.seek(blockEnd))
+					return ReadError();
+			}
+		}
+	}
+
 	//notifyGeometryUpdate(); //FIXME: we can't call it now as the dependent 'pointers' are not valid yet!
 
 	//We should update the VBOs (just in case)
@@ -2883,13 +3282,20 @@ CCLib::ReferenceCloud* ccPointCloud::crop(const ccBBox& box, bool inside/*=true*
 		return 0;
 	}
 
-	for (unsigned i=0; i<count; ++i)
+	//we process the points chunk by chunk
+	unsigned chunks = getChunksCount();
+	for (unsigned k=0; k<chunks; ++k)
 	{
-		const CCVector3* P = point(i);
-		bool pointIsInside = box.contains(*P);
-		if (inside == pointIsInside)
+		const CCVector3* P = getChunkPoints(k);
+		unsigned chunkSize = getChunkSize(k);
+		unsigned firstIndex = k * MAX_NUMBER_OF_ELEMENTS_PER_CHUNK;
+		for (unsigned i=0; i<chunkSize; ++i,++P)
 		{
-			ref->addPointIndex(i);
+			bool pointIsInside = box.contains(*P);
+			if (inside == pointIsInside)
+			{
+				ref->addPointIndex(firstIndex+i);
+			}
 		}
 	}
 
@@ -27,6 +27,7 @@
 #include <ReferenceCloud.h>
 #include <ChunkedPointCloud.h>
 #include <GenericProgressCallback.h>
+#include <OctreeLOD.h>
 
 //Local
 #include "qCC_db.h"
@@ -289,6 +290,9 @@ public:
 	virtual void applyRigidTransformation(const ccGLMatrix& trans);
 	//virtual bool isScalarFieldEnabled() const;
 	virtual void refreshBB();
+	/** WARNING: the L.O.D. structure is cleared as well.
+	**/
+	virtual void deleteOctree();
 
 	//! Interpolate colors from another cloud
 	bool interpolateColorsFrom(	ccGenericPointCloud* cloud,
@@ -507,6 +511,32 @@ public:
 	**/
 	CCLib::ReferenceCloud* crop2D(const ccPolyline* poly, unsigned char orthoDim, bool inside = true);
 
+	//! Computes the L.O.D. (level of detail) structure
+	/** Used to display a uniform subset of the points of big clouds (see MAX_LOD_POINTS_NUMBER).
+		The cloud octree is used if it exists (otherwise a temporary octree is computed).
+		\param progressCb the client application can get some notification of the process progress through this callback mechanism (see GenericProgressCallback)
+		\return success
+	**/
+	bool computeLOD(CCLib::GenericProgressCallback* progressCb = 0);
+
+	//! Computes the L.O.D. (level of detail) structure in the background
+	/** Starts the computation if necessary (a temporary octree is always used, as the
+		cloud octree may be deleted meanwhile). Should be called again (e.g. at each
+		display) to retrieve the structure once the computation is finished.
+		\return whether the structure is ready
+	**/
+	bool computeLODInBackground();
+
+	//! Clears the L.O.D. (level of detail) structure
+	/** Any background computation is canceled.
+	**/
+	void clearLOD();
+
+	//! Returns the L.O.D. (level of detail) structure
+	/** The structure is empty if it has not been computed yet (or if it has been invalidated).
+	**/
+	const CCLib::OctreeLOD& getLOD() const { return m_lod; }
+
 protected:
 
 	//! Appends a cloud to this one
@@ -536,6 +566,22 @@ protected:
 	//! Currently displayed scalar field index
 	int m_currentDisplayedScalarFieldIndex;
 
+	//! L.O.D. (level of detail) structure
+	CCLib::OctreeLOD m_lod;
+	//! Whether the L.O.D. structure computation has failed (so as not to try again at each display)
+	bool m_lodFailed;
+
+	//! Background L.O.D. computation
+	struct LODBuildJob;
+	//! Running background L.O.D. computation (if any)
+	LODBuildJob* m_lodJob;
+
+	//! Cancels the background L.O.D. computation (if any)
+	/** Must be called before the cloud is modified, as the computation reads the points.
+		The current L.O.D. structure is kept.
+	**/
+	void cancelLODComputation();
+
 protected: // VBO
 
 	//! Init/updates VBOs
@@ -24,7 +24,6 @@
 #include "ccPointCloud.h"
 
 //CCLib
-#include <Neighbourhood.h>
 #include <PointProjectionTools.h>
 #include <CCMiscTools.h>
 
@@ -411,8 +410,30 @@ bool ccPolyline::ExtractFlatContour(CCLib::GenericIndexedCloudPersist* points,
 {
 	parts.clear();
 
-	//extract whole contour
-	ccPolyline* basePoly = ExtractFlatContour(points,maxEdgelLength,preferredDim);
+	assert(points);
+	if (!points || points->size() < 3)
+		return false;
+
+	//extract the contour vertices
+	std::vector<CCVector3> contourPoints;
+	if (!CCLib::PointProjectionTools::extractFlatContour(points,maxEdgelLength,contourPoints,preferredDim))
+	{
+		ccLog::Warning("[ccPolyline::ExtractFlatContour] Failed to extract the contour of the input points (not enough memory?)!");
+		return false;
+	}
+
+	return CreateFlatContour(contourPoints,maxEdgelLength,parts,allowSplitting);
+}
+
+bool ccPolyline::CreateFlatContour(	const std::vector<CCVector3>& contourPoints,
+									PointCoordinateType maxEdgelLength,
+									std::vector<ccPolyline*>& parts,
+									bool allowSplitting/*=true*/)
+{
+	parts.clear();
+
+	//create whole contour
+	ccPolyline* basePoly = CreateFlatContour(contourPoints);
 	if (!basePoly)
 	{
 		return false;
@@ -430,7 +451,6 @@ bool ccPolyline::ExtractFlatContour(CCLib::GenericIndexedCloudPersist* points,
 	basePoly = 0;
 
 	return success;
-
 }
 
 ccPolyline* ccPolyline::ExtractFlatContour(	CCLib::GenericIndexedCloudPersist* points,
@@ -444,46 +464,20 @@ ccPolyline* ccPolyline::ExtractFlatContour(	CCLib::GenericIndexedCloudPersist* p
 	if (ptsCount < 3)
 		return 0;
 
-	CCLib::Neighbourhood Yk(points);
-	CCVector3 O,X,Y; //local base
-
-	//we project the input points on a plane
-	std::vector<CCLib::PointProjectionTools::IndexedCCVector2> points2D;
-	PointCoordinateType* planeEq = 0;
-	//if the user has specified a default direction, we'll use it as 'projecting plane'
-	PointCoordinateType preferredPlaneEq[4] = {0, 0, 0, 0};
-	if (preferredDim != 0)
+	//extract the contour vertices
+	std::vector<CCVector3> contourPoints;
+	if (!CCLib::PointProjectionTools::extractFlatContour(points,maxEdgelLength,contourPoints,preferredDim))
 	{
-		const CCVector3* G = points->getPoint(0); //any point through which the point pass is ok
-		preferredPlaneEq[0] = preferredDim[0];
-		preferredPlaneEq[1] = preferredDim[1];
-		preferredPlaneEq[2] = preferredDim[2];
-		CCVector3::vnormalize(preferredPlaneEq);
-		preferredPlaneEq[3] = CCVector3::vdot(G->u,preferredPlaneEq);
-		planeEq = preferredPlaneEq;
-	}
-	if (!Yk.projectPointsOn2DPlane<CCLib::PointProjectionTools::IndexedCCVector2>(points2D,planeEq,&O,&X,&Y))
-	{
-		ccLog::Warning("[ccPolyline::ExtractFlatContour] Failed to project the points on the LS plane (not enough memory?)!");
+		ccLog::Warning("[ccPolyline::ExtractFlatContour] Failed to extract the contour of the input points (not enough memory?)!");
 		return 0;
 	}
 
-	//update the points indexes (not done by Neighbourhood::projectPointsOn2DPlane)
-	{
-		for (unsigned i=0; i<ptsCount; ++i)
-			points2D[i].index = i;
-	}
-
-	//try to get the points on the convex/concave hull to build the contour and the polygon
-	std::list<CCLib::PointProjectionTools::IndexedCCVector2*> hullPoints;
-	if (!CCLib::PointProjectionTools::extractConcaveHull2D(	points2D,
-															hullPoints,
-															maxEdgelLength*maxEdgelLength) )
-	{
-		ccLog::Error("[ccPolyline::ExtractFlatContour] Failed to compute the convex hull of the input points!");
-	}
+	return CreateFlatContour(contourPoints);
+}
 
-	unsigned hullPtsCount = static_cast<unsigned>(hullPoints.size());
+ccPolyline* ccPolyline::CreateFlatContour(const std::vector<CCVector3>& contourPoints)
+{
+	unsigned hullPtsCount = static_cast<unsigned>(contourPoints.size());
 
 	//create vertices
 	ccPointCloud* contourVertices = new ccPointCloud();
@@ -492,13 +486,12 @@ ccPolyline* ccPolyline::ExtractFlatContour(	CCLib::GenericIndexedCloudPersist* p
 		{
 			delete contourVertices;
 			contourVertices = 0;
-			ccLog::Error("[ccPolyline::ExtractFlatContour] Not enough memory!");
+			ccLog::Error("[ccPolyline::CreateFlatContour] Not enough memory!");
 			return 0;
 		}
 
-		//projection on the LS plane (in 3D)
-		for (std::list<CCLib::PointProjectionTools::IndexedCCVector2*>::const_iterator it = hullPoints.begin(); it != hullPoints.end(); ++it)
-			contourVertices->addPoint(O + X*(*it)->x + Y*(*it)->y);
+		for (unsigned i=0; i<hullPtsCount; ++i)
+			contourVertices->addPoint(contourPoints[i]);
 		contourVertices->setName("vertices");
 		contourVertices->setEnabled(false);
 	}
@@ -517,7 +510,7 @@ ccPolyline* ccPolyline::ExtractFlatContour(	CCLib::GenericIndexedCloudPersist* p
 	{
 		delete contourPolyline;
 		contourPolyline = 0;
-		ccLog::Warning("[ccPolyline::ExtractFlatContour] Not enough memory to create the contour polyline!");
+		ccLog::Warning("[ccPolyline::CreateFlatContour] Not enough memory to create the contour polyline!");
 	}
 
 	return contourPolyline;
@@ -116,6 +116,27 @@ public:
 											PointCoordinateType maxEdgelLength = 0,
 											const PointCoordinateType* preferredDim = 0);
 
+	//! Creates a closed contour polyline from its vertices
+	/** See CCLib::PointProjectionTools::extractFlatContour.
+		\param contourPoints contour vertices
+		\return contour polyline (or 0 if an error occurred)
+	**/
+	static ccPolyline* CreateFlatContour(const std::vector<CCVector3>& contourPoints);
+
+	//! Creates one or several parts of a closed contour polyline from its vertices
+	/** See CCLib::PointProjectionTools::extractFlatContour.
+		\warning output polylines set (parts) may be empty if all the vertices are too far from each other!
+		\param contourPoints contour vertices
+		\param maxEdgelLength max edge length (used to split the contour)
+		\param[out] parts output polyline parts
+		\param allowSplitting whether the polyline can be split or not
+		\return success
+	**/
+	static bool CreateFlatContour(	const std::vector<CCVector3>& contourPoints,
+									PointCoordinateType maxEdgelLength,
+									std::vector<ccPolyline*>& parts,
+									bool allowSplitting = true);
+
 	//! Extracts one or several parts of the (2D) contour polyline of a point cloud
 	/** Projects the cloud on its best fitting LS plane first.
 		\warning output polylines set (parts) may be empty if all the vertices are too far from each other!
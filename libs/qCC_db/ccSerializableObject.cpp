@@ -0,0 +1,236 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "ccSerializableObject.h"
+
+//Qt
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+//System
+#include <assert.h>
+#include <algorithm>
+
+//! zlib compression level for array blocks (fast)
+static const int c_arrayBlockCompressionLevel = 1;
+
+//! Groups the bytes of the values by position (i.e. all first bytes, then all second bytes, etc.)
+/** Floating point values and indexes compress a lot better this way.
+**/
+static void ShuffleBytes(const char* in, char* out, unsigned size, unsigned valueSize)
+{
+	unsigned count = size / valueSize;
+	for (unsigned b=0; b<valueSize; ++b)
+	{
+		const char* src = in + b;
+		for (unsigned i=0; i<count; ++i, src += valueSize)
+			*out++ = *src;
+	}
+}
+
+//! Inverse of ShuffleBytes
+static void UnshuffleBytes(const char* in, char* out, unsigned size, unsigned valueSize)
+{
+	unsigned count = size / valueSize;
+	for (unsigned b=0; b<valueSize; ++b)
+	{
+		char* dest = out + b;
+		for (unsigned i=0; i<count; ++i, dest += valueSize)
+			*dest = *in++;
+	}
+}
+
+void ccSerializationHelper::CompressArrayBlock(ArrayBlock& block)
+{
+	assert(static_cast<unsigned>(block.data.size()) == block.rawSize);
+
+	QByteArray compressed;
+	if (block.valueSize > 1 && block.rawSize % block.valueSize == 0)
+	{
+		QByteArray shuffled;
+		shuffled.resize(static_cast<int>(block.rawSize));
+		ShuffleBytes(block.data.constData(),shuffled.data(),block.rawSize,block.valueSize);
+		compressed = qCompress(shuffled,c_arrayBlockCompressionLevel);
+	}
+	else
+	{
+		compressed = qCompress(block.data,c_arrayBlockCompressionLevel);
+	}
+
+	//the block is stored raw if compression doesn't help
+	if (!compressed.isEmpty() && static_cast<unsigned>(compressed.size()) < block.rawSize)
+		block.data = compressed;
+	block.storedSize = static_cast<unsigned>(block.data.size());
+}
+
+void ccSerializationHelper::UncompressArrayBlock(ArrayBlock& block)
+{
+	assert(static_cast<unsigned>(block.data.size()) == block.storedSize);
+
+	//raw block
+	if (block.storedSize == block.rawSize)
+	{
+		//we must detach the data from the file buffer
+		block.data = QByteArray(block.data.constData(),block.data.size());
+		return;
+	}
+
+	QByteArray uncompressed = qUncompress(block.data);
+	if (static_cast<unsigned>(uncompressed.size()) != block.rawSize)
+	{
+		block.data.clear();
+		return;
+	}
+
+	if (block.valueSize > 1 && block.rawSize % block.valueSize == 0)
+	{
+		block.data.resize(static_cast<int>(block.rawSize));
+		UnshuffleBytes(uncompressed.constData(),block.data.data(),block.rawSize,block.valueSize);
+	}
+	else
+	{
+		block.data = uncompressed;
+	}
+}
+
+size_t ccSerializationHelper::ArrayBlocksBatchSize()
+{
+	int threadCount = std::max(1,QThreadPool::globalInstance()->maxThreadCount());
+	return static_cast<size_t>(std::max(8,2*threadCount));
+}
+
+bool ccSerializationHelper::WriteArrayBlocks(std::vector<ArrayBlock>& blocks, QFile& out)
+{
+	//block count (dataVersion>=38)
+	::uint32_t blockCount = static_cast< ::uint32_t >(blocks.size());
+	if (out.write((const char*)&blockCount,4) < 0)
+		return ccSerializableObject::WriteError();
+
+	//index table (dataVersion>=38)
+	//--> we don't know the stored sizes yet: we'll come back later
+	qint64 tablePos = out.pos();
+	std::vector< ::uint32_t > table(2*blocks.size(),0);
+	if (out.write((const char*)&table[0],static_cast<qint64>(table.size()*4)) < 0)
+		return ccSerializableObject::WriteError();
+
+	//blocks data (dataVersion>=38)
+	size_t batchSize = ArrayBlocksBatchSize();
+	for (size_t first=0; first<blocks.size(); first+=batchSize)
+	{
+		size_t count = std::min(batchSize,blocks.size()-first);
+		QtConcurrent::blockingMap(blocks.begin()+first, blocks.begin()+(first+count), CompressArrayBlock);
+
+		for (size_t i=first; i<first+count; ++i)
+		{
+			if (out.write(blocks[i].data.constData(),blocks[i].data.size()) < 0)
+				return ccSerializableObject::WriteError();
+			table[2*i  ] = static_cast< ::uint32_t >(blocks[i].elementCount);
+			table[2*i+1] = static_cast< ::uint32_t >(blocks[i].storedSize);
+			//release memory
+			blocks[i].data.clear();
+		}
+	}
+
+	//now we can write the index table
+	qint64 endPos = out.pos();
+	if (!out.seek(tablePos) || out.write((const char*)&table[0],static_cast<qint64>(table.size()*4)) < 0 || !out.seek(endPos))
+		return ccSerializableObject::WriteError();
+
+	return true;
+}
+
+bool ccSerializationHelper::ReadArrayBlocksTable(QFile& in, unsigned elementSize, unsigned valueSize, unsigned elementCount, std::vector<ArrayBlock>& blocks)
+{
+	//block count (dataVersion>=38)
+	::uint32_t blockCount = 0;
+	if (in.read((char*)&blockCount,4) < 0)
+		return ccSerializableObject::ReadError();
+	if (blockCount == 0 || blockCount > elementCount)
+		return ccSerializableObject::CorruptError();
+
+	//index table (dataVersion>=38)
+	std::vector< ::uint32_t > table;
+	try
+	{
+		table.resize(2*blockCount);
+		blocks.resize(blockCount);
+	}
+	catch (const std::bad_alloc&)
+	{
+		return ccSerializableObject::MemoryError();
+	}
+	if (in.read((char*)&table[0],static_cast<qint64>(table.size()*4)) < 0)
+		return ccSerializableObject::ReadError();
+
+	unsigned totalCount = 0;
+	for (size_t i=0; i<blocks.size(); ++i)
+	{
+		ArrayBlock& block = blocks[i];
+		block.elementCount = table[2*i];
+		if (block.elementCount == 0 || block.elementCount > elementCount-totalCount || block.elementCount > MAX_NUMBER_OF_ELEMENTS_PER_CHUNK)
+			return ccSerializableObject::CorruptError();
+		block.rawSize = block.elementCount * elementSize;
+		block.storedSize = table[2*i+1];
+		block.valueSize = valueSize;
+		//a block is never bigger than its raw data
+		if (block.storedSize == 0 || block.storedSize > block.rawSize)
+			return ccSerializableObject::CorruptError();
+		totalCount += block.elementCount;
+	}
+
+	if (totalCount != elementCount)
+		return ccSerializableObject::CorruptError();
+
+	return true;
+}
+
+bool ccSerializationHelper::ReadArrayBlocks(QFile& in, std::vector<ArrayBlock>& blocks, size_t first, size_t count)
+{
+	assert(first+count <= blocks.size());
+
+	//we read all the blocks at once
+	qint64 totalSize = 0;
+	for (size_t i=first; i<first+count; ++i)
+		totalSize += blocks[i].storedSize;
+
+	QByteArray buffer;
+	try
+	{
+		buffer.resize(static_cast<int>(totalSize));
+	}
+	catch (const std::bad_alloc&)
+	{
+		return ccSerializableObject::MemoryError();
+	}
+	if (in.read(buffer.data(),totalSize) != totalSize)
+		return ccSerializableObject::ReadError();
+
+	//then uncompress them in parallel
+	const char* storedData = buffer.constData();
+	for (size_t i=first; i<first+count; ++i)
+	{
+		blocks[i].data = QByteArray::fromRawData(storedData,static_cast<int>(blocks[i].storedSize));
+		storedData += blocks[i].storedSize;
+	}
+	QtConcurrent::blockingMap(blocks.begin()+first, blocks.begin()+(first+count), UncompressArrayBlock);
+
+	for (size_t i=first; i<first+count; ++i)
+		if (static_cast<unsigned>(blocks[i].data.size()) != blocks[i].rawSize)
+			return ccSerializableObject::CorruptError();
+
+	return true;
+}
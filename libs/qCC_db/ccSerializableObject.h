@@ -19,6 +19,7 @@
 #define CC_SERIALIZABLE_OBJECT_HEADER
 
 //Local
+#include "qCC_db.h"
 #include "ccLog.h"
 
 //CCLib
@@ -28,10 +29,12 @@
 //System
 #include <stdio.h>
 #include <stdint.h>
+#include <vector>
 
 //Qt
 #include <QFile>
 #include <QDataStream>
+#include <QByteArray>
 
 //! Serializable object interface
 class ccSerializableObject
@@ -92,7 +95,7 @@ public:
 };
 
 //! Serialization helpers
-class ccSerializationHelper
+class QCC_DB_LIB_API ccSerializationHelper
 {
 public:
 
@@ -164,20 +167,30 @@ public:
 		if (out.write((const char*)&elementCount,4) < 0)
 			return ccSerializableObject::WriteError();
 
-		//array data (dataVersion>=20)
-		//--> we write each chunk as a block (faster)
-		while (elementCount!=0)
+		//array data (dataVersion>=38)
+		//--> each chunk is written as an independently compressed block
+		if (elementCount != 0)
 		{
+			std::vector<ArrayBlock> blocks;
 			unsigned chunksCount = chunkArray.chunksCount();
-			for (unsigned i=0; i<chunksCount; ++i)
+			for (unsigned i=0; i<chunksCount && elementCount!=0; ++i)
 			{
-				//DGM: since dataVersion>=22, we make sure to write as much items as declared in 'currentSize'!
+				//since dataVersion>=22, we make sure to write as much items as declared in 'currentSize'!
 				unsigned toWrite = std::min<unsigned>(elementCount,chunkArray.chunkSize(i));
-				if (out.write((const char*)chunkArray.chunkStartPtr(i),sizeof(ElementType)*N*toWrite) < 0)
-					return ccSerializableObject::WriteError();
+				ArrayBlock block;
+				block.elementCount = toWrite;
+				block.rawSize = static_cast<unsigned>(sizeof(ElementType)*N*toWrite);
+				block.valueSize = static_cast<unsigned>(sizeof(ElementType));
+				block.data = QByteArray::fromRawData((const char*)chunkArray.chunkStartPtr(i),static_cast<int>(block.rawSize));
+				blocks.push_back(block);
 				assert(toWrite <= elementCount);
 				elementCount -= toWrite;
 			}
+			if (elementCount != 0)
+				return ccSerializableObject::MemoryError();
+
+			if (!WriteArrayBlocks(blocks,out))
+				return false;
 		}
 
 		return true;
@@ -204,6 +217,11 @@ public:
 			if (!chunkArray.resize(elementCount))
 				return ccSerializableObject::MemoryError();
 
+			//array data (dataVersion>=38)
+			//--> compressed blocks
+			if (dataVersion >= 38)
+				return GenericArrayFromBlocks<N,ElementType,ElementType>(chunkArray,in,elementCount);
+
 			//array data (dataVersion>=20)
 			//--> we read each chunk as a block (faster)
 			unsigned chunksCount = chunkArray.chunksCount();
@@ -239,6 +257,11 @@ public:
 			if (!chunkArray.resize(elementCount))
 				return ccSerializableObject::MemoryError();
 
+			//array data (dataVersion>=38)
+			//--> compressed blocks
+			if (dataVersion >= 38)
+				return GenericArrayFromBlocks<N,ElementType,FileElementType>(chunkArray,in,elementCount);
+
 			//array data (dataVersion>=20)
 			//--> saldy we can't read it as a block...
 			//we must convert each element, value by value!
@@ -271,6 +294,112 @@ public:
 
 protected:
 
+	//! Block of array data (dataVersion>=38)
+	/** Each chunk of a GenericChunkedArray structure is stored as an independent
+		block. The blocks are (de)compressed in parallel and an index table (element
+		count and stored size of each block) is written before the blocks themselves.
+	**/
+	struct ArrayBlock
+	{
+		//! Number of elements in this block
+		unsigned elementCount;
+		//! Raw (uncompressed) size in bytes
+		unsigned rawSize;
+		//! Stored size in bytes (equal to 'rawSize' if the block is not compressed)
+		unsigned storedSize;
+		//! Size of a single value (the bytes of the values are shuffled before compression)
+		unsigned valueSize;
+		//! Block data (raw or compressed)
+		QByteArray data;
+
+		//! Default constructor
+		ArrayBlock() : elementCount(0), rawSize(0), storedSize(0), valueSize(1) {}
+	};
+
+	//! Compresses and writes a set of array blocks (dataVersion>=38)
+	/** \param blocks blocks to write (raw data, may be released after the call)
+		\param out output file
+		\return success
+	**/
+	static bool WriteArrayBlocks(std::vector<ArrayBlock>& blocks, QFile& out);
+
+	//! Reads the index table of a set of array blocks (dataVersion>=38)
+	/** \param in input file
+		\param elementSize size of an element in file (in bytes)
+		\param valueSize size of a single value in file (in bytes)
+		\param elementCount total number of elements (for consistency checks)
+		\param[out] blocks blocks (without their data)
+		\return success
+	**/
+	static bool ReadArrayBlocksTable(QFile& in, unsigned elementSize, unsigned valueSize, unsigned elementCount, std::vector<ArrayBlock>& blocks);
+
+	//! Reads and uncompresses (in parallel) a range of array blocks (dataVersion>=38)
+	/** \param in input file (blocks must be read in order)
+		\param blocks blocks (see ReadArrayBlocksTable)
+		\param first index of the first block to read
+		\param count number of blocks to read
+		\return success
+	**/
+	static bool ReadArrayBlocks(QFile& in, std::vector<ArrayBlock>& blocks, size_t first, size_t count);
+
+	//! Returns the number of array blocks that should be read at once
+	static size_t ArrayBlocksBatchSize();
+
+	//! Compresses a single array block (the block is kept raw if compression is useless)
+	static void CompressArrayBlock(ArrayBlock& block);
+
+	//! Uncompresses a single array block (data is cleared on error)
+	static void UncompressArrayBlock(ArrayBlock& block);
+
+	//! Loads the (compressed) blocks of a GenericChunkedArray structure (dataVersion>=38)
+	/** \param chunkArray GenericChunkedArray structure to load (already resized)
+		\param in input file
+		\param elementCount number of elements
+		\return success
+	**/
+	template <int N, class ElementType, class FileElementType> static bool GenericArrayFromBlocks(GenericChunkedArray<N,ElementType>& chunkArray, QFile& in, unsigned elementCount)
+	{
+		std::vector<ArrayBlock> blocks;
+		if (!ReadArrayBlocksTable(in,static_cast<unsigned>(sizeof(FileElementType)*N),static_cast<unsigned>(sizeof(FileElementType)),elementCount,blocks))
+			return false;
+
+		//we only keep a few blocks in memory at the same time
+		unsigned index = 0;
+		size_t batchSize = ArrayBlocksBatchSize();
+		for (size_t first=0; first<blocks.size(); first+=batchSize)
+		{
+			size_t count = std::min(batchSize,blocks.size()-first);
+			if (!ReadArrayBlocks(in,blocks,first,count))
+				return false;
+
+			for (size_t b=first; b<first+count; ++b)
+			{
+				const FileElementType* values = reinterpret_cast<const FileElementType*>(blocks[b].data.constData());
+				unsigned remaining = blocks[b].elementCount;
+				while (remaining != 0)
+				{
+					//the blocks may not be aligned with the chunks (in theory)
+					unsigned offset = (index & ELEMENT_INDEX_BIT_MASK);
+					unsigned contiguous = std::min<unsigned>(remaining,MAX_NUMBER_OF_ELEMENTS_PER_CHUNK-offset);
+					ElementType* dest = chunkArray.chunkStartPtr(index >> CHUNK_INDEX_BIT_DEC) + offset*N;
+					for (unsigned k=0; k<contiguous*N; ++k)
+						dest[k] = static_cast<ElementType>(values[k]);
+					values += contiguous*N;
+					index += contiguous;
+					remaining -= contiguous;
+				}
+				//release memory
+				blocks[b].data.clear();
+			}
+		}
+		assert(index == elementCount);
+
+		//update array boundaries
+		chunkArray.computeMinAndMax();
+
+		return true;
+	}
+
 	static bool ReadArrayHeader(QFile& in,
 								short dataVersion,
 								::uint8_t &componentCount,
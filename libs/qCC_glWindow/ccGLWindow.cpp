@@ -17,6 +17,7 @@
 
 //CCLib
 #include <CCConst.h>
+#include <PickingTools.h>
 
 //qCC
 #include "ccGLWindow.h"
@@ -36,8 +37,10 @@
 #include <ccSphere.h> //for the pivot symbol
 #include <ccPolyline.h>
 #include <ccPointCloud.h>
+#include <ccScalarField.h>
 #include <ccColorRampShader.h>
 #include <ccClipBox.h>
+#include <ccOctree.h>
 #include <ccPlatform.h>
 
 //CCFbo
@@ -51,6 +54,7 @@
 #include <QtGui>
 #include <QWheelEvent>
 #include <QElapsedTimer>
+#include <QTimer>
 #include <QSettings>
 #include <QApplication>
 
@@ -62,6 +66,7 @@
 //System
 #include <string.h>
 #include <math.h>
+#include <limits.h>
 #include <algorithm>
 
 //Min and max zoom ratio (relative)
@@ -141,6 +146,8 @@ ccGLWindow::ccGLWindow(	QWidget *parent,
 	, m_glWidth(0)
 	, m_glHeight(0)
 	, m_lodActivated(false)
+	, m_lodRefinement(false)
+	, m_lodPointsBudget(0)
 	, m_shouldBeRefreshed(false)
 	, m_cursorMoved(false)
 	, m_unclosable(false)
@@ -570,6 +577,22 @@ void ccGLWindow::paintGL()
 		bool doDrawCross = (!m_captureMode.enabled && !m_viewportParams.perspectiveView && !(m_fbo && m_activeGLFilter) && getDisplayParameters().displayCross);
 		draw3D(context,doDrawCross,m_fbo);
 		m_updateFBO = false;
+
+		//progressive refinement of the decimated clouds (one step per idle frame)
+		if (m_lodRefinement && !m_lodActivated)
+		{
+			if (context.lodDisplayIncomplete)
+			{
+				//we double the number of displayed points for the next frame
+				m_lodPointsBudget = (m_lodPointsBudget < (1U << 31) ? 2*m_lodPointsBudget : UINT_MAX);
+				QTimer::singleShot(0,this,SLOT(redraw()));
+			}
+			else
+			{
+				//all points have been displayed
+				m_lodRefinement = false;
+			}
+		}
 	}
 
 	/****************************************/
@@ -872,7 +895,16 @@ void ccGLWindow::draw3D(CC_DRAW_CONTEXT& context, bool doDrawCross, ccFrameBuffe
 	if (m_customLightEnabled || m_sunLightEnabled)
 		context.flags |= CC_LIGHT_ENABLED;
 	if (m_lodActivated)
+	{
+		context.flags |= CC_LOD_ACTIVATED;
+		context.lodPointsBudget = 0; //default budget (MAX_LOD_POINTS_NUMBER)
+	}
+	else if (m_lodRefinement)
+	{
 		context.flags |= CC_LOD_ACTIVATED;
+		context.lodPointsBudget = m_lodPointsBudget;
+	}
+	context.lodDisplayIncomplete = false;
 
 	//we enable absolute sun light (if activated)
 	if (m_sunLightEnabled)
@@ -1967,6 +1999,7 @@ void ccGLWindow::mousePressEvent(QMouseEvent *event)
 		{
 			m_lastMousePos = event->pos();
 			m_lodActivated = true;
+			m_lodRefinement = false;
 
 			QApplication::setOverrideCursor(QCursor(Qt::SizeAllCursor));
 		}
@@ -1982,6 +2015,7 @@ void ccGLWindow::mousePressEvent(QMouseEvent *event)
 			m_lastMouseOrientation = convertMousePositionToOrientation(event->x(), event->y());
 			m_lastMousePos = event->pos();
 			m_lodActivated = true;
+			m_lodRefinement = false;
 
 			QApplication::setOverrideCursor(QCursor(Qt::PointingHandCursor));
 
@@ -2206,7 +2240,13 @@ void ccGLWindow::mouseReleaseEvent(QMouseEvent *event)
 
 	//reset to default state
 	m_cursorMoved = false;
-	m_lodActivated = false;
+	if (m_lodActivated)
+	{
+		//the decimated clouds will be progressively refined (instead of being fully displayed at once)
+		m_lodRefinement = true;
+		m_lodPointsBudget = 2*MAX_LOD_POINTS_NUMBER;
+		m_lodActivated = false;
+	}
 	QApplication::restoreOverrideCursor();
 
 	if (m_interactionMode == SEGMENT_ENTITY)
@@ -2427,123 +2467,132 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 		return -1;
 	}
 
-	makeCurrent();
+	int selectedID=-1,subSelectedID=-1;
+	std::set<int> selectedIDs; //for ENTITY_RECT_PICKING mode only
 
-	//no need to clear display, we don't draw anything new!
-	//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+	//points and triangles are picked on the CPU (the OpenGL 'selection' mode is way too slow with big entities)
+	if (pickingMode == POINT_PICKING || pickingMode == TRIANGLE_PICKING || pickingMode == AUTO_POINT_PICKING)
+	{
+		startCPUBasedPointPicking(pickingMode,centerX,centerY,pickWidth,pickHeight,selectedID,subSelectedID);
+	}
+	else
+	{
+		makeCurrent();
 
-	//setup selection buffers
-	memset(m_pickingBuffer,0,sizeof(GLuint)*CC_PICKING_BUFFER_SIZE);
-	glSelectBuffer(CC_PICKING_BUFFER_SIZE,m_pickingBuffer);
-	glRenderMode(GL_SELECT);
-	glInitNames();
+		//no need to clear display, we don't draw anything new!
+		//glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-	//get viewport
-	GLint viewport[4];
-	glGetIntegerv(GL_VIEWPORT,viewport);
+		//setup selection buffers
+		memset(m_pickingBuffer,0,sizeof(GLuint)*CC_PICKING_BUFFER_SIZE);
+		glSelectBuffer(CC_PICKING_BUFFER_SIZE,m_pickingBuffer);
+		glRenderMode(GL_SELECT);
+		glInitNames();
 
-	//3D objects picking
-	{
-		context.flags = CC_DRAW_3D | pickingFlags;
+		//get viewport
+		GLint viewport[4];
+		glGetIntegerv(GL_VIEWPORT,viewport);
 
-		glEnable(GL_DEPTH_TEST);
+		//3D objects picking
+		{
+			context.flags = CC_DRAW_3D | pickingFlags;
 
-		//projection matrix
-		glMatrixMode(GL_PROJECTION);
-		//restrict drawing to the picking area
-		glLoadIdentity();
-		gluPickMatrix((GLdouble)centerX,(GLdouble)(viewport[3]-centerY),(GLdouble)pickWidth,(GLdouble)pickHeight,viewport);
-		glMultMatrixd(getProjectionMatd());
+			glEnable(GL_DEPTH_TEST);
 
-		//model view matrix
-		glMatrixMode(GL_MODELVIEW);
-		glLoadMatrixd(getModelViewMatd());
+			//projection matrix
+			glMatrixMode(GL_PROJECTION);
+			//restrict drawing to the picking area
+			glLoadIdentity();
+			gluPickMatrix((GLdouble)centerX,(GLdouble)(viewport[3]-centerY),(GLdouble)pickWidth,(GLdouble)pickHeight,viewport);
+			glMultMatrixd(getProjectionMatd());
 
-		//display 3D objects
-		if (m_globalDBRoot)
-			m_globalDBRoot->draw(context);
-		if (m_winDBRoot)
-			m_winDBRoot->draw(context);
+			//model view matrix
+			glMatrixMode(GL_MODELVIEW);
+			glLoadMatrixd(getModelViewMatd());
 
-		ccGLUtils::CatchGLError("ccGLWindow::startPicking.draw(3D)");
-	}
+			//display 3D objects
+			if (m_globalDBRoot)
+				m_globalDBRoot->draw(context);
+			if (m_winDBRoot)
+				m_winDBRoot->draw(context);
 
-	//2D objects picking
-	if (pickingMode == ENTITY_PICKING || pickingMode == ENTITY_RECT_PICKING || pickingMode == FAST_PICKING)
-	{
-		context.flags = CC_DRAW_2D | pickingFlags;
+			ccGLUtils::CatchGLError("ccGLWindow::startPicking.draw(3D)");
+		}
+
+		//2D objects picking
+		if (pickingMode == ENTITY_PICKING || pickingMode == ENTITY_RECT_PICKING || pickingMode == FAST_PICKING)
+		{
+			context.flags = CC_DRAW_2D | pickingFlags;
 
-		glDisable(GL_DEPTH_TEST);
+			glDisable(GL_DEPTH_TEST);
 
-		//we must first grab the 2D ortho view projection matrix
-		setStandardOrthoCenter();
-		glMatrixMode(GL_PROJECTION);
-		double orthoProjMatd[OPENGL_MATRIX_SIZE];
-		glGetDoublev(GL_PROJECTION_MATRIX, orthoProjMatd);
-		//restrict drawing to the picking area
-		glLoadIdentity();
-		gluPickMatrix((GLdouble)centerX,(GLdouble)(viewport[3]-centerY),(GLdouble)pickWidth,(GLdouble)pickHeight,viewport);
-		glMultMatrixd(orthoProjMatd);
-		glMatrixMode(GL_MODELVIEW);
+			//we must first grab the 2D ortho view projection matrix
+			setStandardOrthoCenter();
+			glMatrixMode(GL_PROJECTION);
+			double orthoProjMatd[OPENGL_MATRIX_SIZE];
+			glGetDoublev(GL_PROJECTION_MATRIX, orthoProjMatd);
+			//restrict drawing to the picking area
+			glLoadIdentity();
+			gluPickMatrix((GLdouble)centerX,(GLdouble)(viewport[3]-centerY),(GLdouble)pickWidth,(GLdouble)pickHeight,viewport);
+			glMultMatrixd(orthoProjMatd);
+			glMatrixMode(GL_MODELVIEW);
 
-		//we display 2D objects
-		if (m_globalDBRoot)
-			m_globalDBRoot->draw(context);
-		if (m_winDBRoot)
-			m_winDBRoot->draw(context);
+			//we display 2D objects
+			if (m_globalDBRoot)
+				m_globalDBRoot->draw(context);
+			if (m_winDBRoot)
+				m_winDBRoot->draw(context);
 
-		ccGLUtils::CatchGLError("ccGLWindow::startPicking.draw(2D)");
-	}
+			ccGLUtils::CatchGLError("ccGLWindow::startPicking.draw(2D)");
+		}
 
-	glFlush();
+		glFlush();
 
-	// returning to normal rendering mode
-	int hits = glRenderMode(GL_RENDER);
+		// returning to normal rendering mode
+		int hits = glRenderMode(GL_RENDER);
 
-	ccGLUtils::CatchGLError("ccGLWindow::startPicking.render");
+		ccGLUtils::CatchGLError("ccGLWindow::startPicking.render");
 
-	ccLog::PrintDebug("Picking hits: %i",hits);
-	if (hits<0)
-	{
-		ccLog::Warning("Too many items inside picking zone! Try to zoom in...");
-		return -1;
-	}
+		ccLog::PrintDebug("Picking hits: %i",hits);
+		if (hits<0)
+		{
+			ccLog::Warning("Too many items inside picking zone! Try to zoom in...");
+			return -1;
+		}
 
-	//process hits
-	int selectedID=-1,subSelectedID=-1;
-	std::set<int> selectedIDs; //for ENTITY_RECT_PICKING mode only
-	{
-		GLuint minMinDepth = (~0);
-		const GLuint* _selectBuf = m_pickingBuffer;
-		for (int i=0;i<hits;++i)
+		//process hits
 		{
-			const GLuint& n = _selectBuf[0]; //number of names on stack
-			if (n) //if we draw anything outside of 'glPushName()... glPopName()' then it will appear here with as an empty set!
+			GLuint minMinDepth = (~0);
+			const GLuint* _selectBuf = m_pickingBuffer;
+			for (int i=0;i<hits;++i)
 			{
-				//n should be equal to 1 (CC_DRAW_ENTITY_NAMES mode) or 2 (CC_DRAW_POINT_NAMES/CC_DRAW_TRIANGLES_NAMES modes)!
-				assert(n==1 || n==2);
-				const GLuint& minDepth = _selectBuf[1];
-				//const GLuint& maxDepth = _selectBuf[2];
-				const GLuint& currentID = _selectBuf[3];
-
-				if (pickingMode == ENTITY_RECT_PICKING)
+				const GLuint& n = _selectBuf[0]; //number of names on stack
+				if (n) //if we draw anything outside of 'glPushName()... glPopName()' then it will appear here with as an empty set!
 				{
-					//pick them all!
-					selectedIDs.insert(currentID);
-				}
-				else
-				{
-					//if there are multiple hits, we keep only the nearest
-					if (selectedID < 0 || minDepth < minMinDepth)
+					//n should be equal to 1 (CC_DRAW_ENTITY_NAMES mode) or 2 (CC_DRAW_POINT_NAMES/CC_DRAW_TRIANGLES_NAMES modes)!
+					assert(n==1 || n==2);
+					const GLuint& minDepth = _selectBuf[1];
+					//const GLuint& maxDepth = _selectBuf[2];
+					const GLuint& currentID = _selectBuf[3];
+
+					if (pickingMode == ENTITY_RECT_PICKING)
 					{
-						selectedID = currentID;
-						subSelectedID = (n>1 ? _selectBuf[4] : -1);
-						minMinDepth = minDepth;
+						//pick them all!
+						selectedIDs.insert(currentID);
+					}
+					else
+					{
+						//if there are multiple hits, we keep only the nearest
+						if (selectedID < 0 || minDepth < minMinDepth)
+						{
+							selectedID = currentID;
+							subSelectedID = (n>1 ? _selectBuf[4] : -1);
+							minMinDepth = minDepth;
+						}
 					}
 				}
-			}
 
-			_selectBuf += (3+n);
+				_selectBuf += (3+n);
+			}
 		}
 	}
 
@@ -2619,6 +2668,160 @@ int ccGLWindow::startPicking(PICKING_MODE pickingMode, int centerX, int centerY,
 	return selectedID;
 }
 
+//! Multiplies two OpenGL (column-major) 4x4 matrices: C = A.B
+static void MultMatrixd(const double* A, const double* B, double* C)
+{
+	for (unsigned c=0; c<4; ++c)
+		for (unsigned r=0; r<4; ++r)
+			C[c*4+r] = A[r]*B[c*4] + A[4+r]*B[c*4+1] + A[8+r]*B[c*4+2] + A[12+r]*B[c*4+3];
+}
+
+//! CPU picking parameters
+struct CPUPickingParams
+{
+	ccGLWindow* win;
+	bool pickPoints;
+	bool pickTriangles;
+	CCVector2 pickPos;
+	PointCoordinateType tolerance;
+
+	//results
+	int selectedID;
+	int subSelectedID;
+	double depth;
+};
+
+//! Excludes the points hidden by the displayed scalar field (same rule as ccPointCloud::drawMeOnly)
+class SFHiddenPointsFilter : public CCLib::PickingTools::PointFilter
+{
+public:
+	SFHiddenPointsFilter(const ccGenericPointCloud* cloud) : m_cloud(cloud) {}
+
+	//inherited from CCLib::PickingTools::PointFilter
+	virtual bool canBePicked(unsigned pointIndex) const { return m_cloud->getPointScalarValueColor(pointIndex) != 0; }
+
+protected:
+	const ccGenericPointCloud* m_cloud;
+};
+
+//! Recursively picks the points or triangles of the entities displayed in a given window
+static void CPUPickInEntity(ccHObject* obj, const double* windowMat, CPUPickingParams& params)
+{
+	//same rules as ccHObject::draw
+	if (!obj->isEnabled())
+		return;
+
+	//apply 3D 'temporary' transformation (for display only)
+	double entityMat[OPENGL_MATRIX_SIZE];
+	if (obj->isGLTransEnabled())
+	{
+		const float* glTrans = obj->getGLTransformation().data();
+		double glTransd[OPENGL_MATRIX_SIZE];
+		for (unsigned i=0; i<OPENGL_MATRIX_SIZE; ++i)
+			glTransd[i] = static_cast<double>(glTrans[i]);
+		MultMatrixd(windowMat,glTransd,entityMat);
+		windowMat = entityMat;
+	}
+
+	if (obj->isVisible() && obj->getDisplay() == params.win)
+	{
+		unsigned index = 0;
+		double depth = 0;
+		if (params.pickPoints && obj->isKindOf(CC_TYPES::POINT_CLOUD))
+		{
+			ccGenericPointCloud* cloud = ccHObjectCaster::ToGenericPointCloud(obj);
+
+			//points hidden by the displayed scalar field can't be picked
+			bool sfHiddenPoints = false;
+			if (cloud->isA(CC_TYPES::POINT_CLOUD) && cloud->hasDisplayedScalarField() && cloud->sfShown())
+			{
+				ccScalarField* sf = static_cast<ccPointCloud*>(cloud)->getCurrentDisplayedScalarField();
+				sfHiddenPoints = (sf && sf->getColorScale() && sf->mayHaveHiddenValues());
+			}
+			SFHiddenPointsFilter sfFilter(cloud);
+
+			if (CCLib::PickingTools::pickPoint(	cloud,
+												windowMat,
+												params.pickPos,
+												params.tolerance,
+												index,
+												depth,
+												cloud->getOctree(),
+												cloud->isVisibilityTableInstantiated() ? cloud->getTheVisibilityArray() : 0,
+												sfHiddenPoints ? &sfFilter : 0))
+			{
+				if (params.selectedID < 0 || depth < params.depth)
+				{
+					params.selectedID = static_cast<int>(cloud->getUniqueIDForDisplay());
+					params.subSelectedID = static_cast<int>(index);
+					params.depth = depth;
+				}
+			}
+		}
+		else if (params.pickTriangles && obj->isKindOf(CC_TYPES::MESH))
+		{
+			ccGenericMesh* mesh = ccHObjectCaster::ToGenericMesh(obj);
+			ccGenericPointCloud* vertices = mesh->getAssociatedCloud();
+			//the mesh BVH is computed at the first picking (and kept until the mesh is modified)
+			if (vertices && CCLib::PickingTools::pickTriangle(	mesh,
+																windowMat,
+																params.pickPos,
+																params.tolerance,
+																index,
+																depth,
+																mesh->getBVH(),
+																vertices->isVisibilityTableInstantiated() ? vertices->getTheVisibilityArray() : 0))
+			{
+				if (params.selectedID < 0 || depth < params.depth)
+				{
+					params.selectedID = static_cast<int>(mesh->getUniqueIDForDisplay());
+					params.subSelectedID = static_cast<int>(index);
+					params.depth = depth;
+				}
+			}
+		}
+	}
+
+	for (unsigned i=0; i<obj->getChildrenNumber(); ++i)
+		CPUPickInEntity(obj->getChild(i),windowMat,params);
+}
+
+void ccGLWindow::startCPUBasedPointPicking(PICKING_MODE pickingMode, int centerX, int centerY, int pickWidth, int pickHeight, int& selectedID, int& subSelectedID)
+{
+	selectedID = subSelectedID = -1;
+
+	CPUPickingParams params;
+	params.win = this;
+	params.pickPoints = (pickingMode == POINT_PICKING || pickingMode == AUTO_POINT_PICKING);
+	params.pickTriangles = (pickingMode == TRIANGLE_PICKING || pickingMode == AUTO_POINT_PICKING);
+	params.tolerance = static_cast<PointCoordinateType>(std::max(pickWidth,pickHeight)) / 2;
+	params.selectedID = params.subSelectedID = -1;
+	params.depth = 0;
+
+	//window matrix: viewport * projection * modelview (see gluProject)
+	int VP[4];
+	getViewportArray(VP);
+	params.pickPos = CCVector2(static_cast<PointCoordinateType>(centerX), static_cast<PointCoordinateType>(VP[3]-centerY));
+
+	double viewportMat[OPENGL_MATRIX_SIZE] = {	static_cast<double>(VP[2])/2,	0,								0,	0,
+												0,								static_cast<double>(VP[3])/2,	0,	0,
+												0,								0,								1,	0,
+												VP[0]+static_cast<double>(VP[2])/2,	VP[1]+static_cast<double>(VP[3])/2,	0,	1 };
+	double projMat[OPENGL_MATRIX_SIZE], windowMat[OPENGL_MATRIX_SIZE];
+	MultMatrixd(viewportMat,getProjectionMatd(),projMat);
+	MultMatrixd(projMat,getModelViewMatd(),windowMat);
+
+	if (m_globalDBRoot)
+		CPUPickInEntity(m_globalDBRoot,windowMat,params);
+	if (m_winDBRoot)
+		CPUPickInEntity(m_winDBRoot,windowMat,params);
+
+	ccLog::PrintDebug("Picked entity: %i (element #%i)",params.selectedID,params.subSelectedID);
+
+	selectedID = params.selectedID;
+	subSelectedID = params.subSelectedID;
+}
+
 void ccGLWindow::displayNewMessage(	const QString& message,
 									MessagePosition pos,
 									bool append/*=false*/,
@@ -565,7 +565,19 @@ protected:
 		\return item ID (if any) or <1 otherwise
 	**/
 	int startPicking(PICKING_MODE mode, int centerX, int centerY, int width = 5, int height = 5, int* subID = 0);
-	
+
+	//! Picks the nearest point or triangle on the CPU (no OpenGL selection involved)
+	/** Only for POINT_PICKING, TRIANGLE_PICKING and AUTO_POINT_PICKING modes.
+		\param mode picking mode
+		\param centerX picking area center X position
+		\param centerY picking area center y position
+		\param width picking area width
+		\param height picking area height
+		\param[out] selectedID picked entity ID (or -1)
+		\param[out] subSelectedID picked point or triangle index (or -1)
+	**/
+	void startCPUBasedPointPicking(PICKING_MODE mode, int centerX, int centerY, int width, int height, int& selectedID, int& subSelectedID);
+
 	//! Updates currently active items list (m_activeItems)
 	/** The items must be currently displayed in this context
 		AND at least one of them must be under the mouse cursor.
@@ -649,6 +661,10 @@ protected:
 
 	//! L.O.D. (level of detail) display mode
 	bool m_lodActivated;
+	//! Whether the decimated clouds are being progressively refined (after a L.O.D. display)
+	bool m_lodRefinement;
+	//! Current max number of displayed points per cloud during the refinement
+	unsigned m_lodPointsBudget;
 	//! Whether the display should be refreshed on next call to 'refresh'
 	bool m_shouldBeRefreshed;
 	//! Whether the mouse cursor has moved after being pressed or not
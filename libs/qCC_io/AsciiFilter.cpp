@@ -17,12 +17,16 @@
 
 #include "AsciiFilter.h"
 #include "ccCoordinatesShiftManager.h"
+#include "InputMemoryFile.h"
 
 //Qt
 #include <QFile>
 #include <QFileInfo>
 #include <QTextStream>
 #include <QSharedPointer>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QtConcurrentMap>
 
 //CClib
 #include <ScalarField.h>
@@ -37,6 +41,8 @@
 //System
 #include <string.h>
 #include <assert.h>
+#include <limits.h>
+#include <stdint.h>
 
 //declaration of static member
 QSharedPointer<AsciiSaveDlg> AsciiFilter::s_saveDialog(0);
@@ -559,6 +565,585 @@ cloudAttributesDescriptor prepareCloud(	const AsciiOpenDlg::Sequence &openSequen
 	return cloudDesc;
 }
 
+//! Returns whether a character is a white space (see QChar::isSpace)
+static inline bool IsBlank(char c)
+{
+	return (c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\v' || c == '\f');
+}
+
+//! Parses a floating point value (same result as QString::toDouble, whatever the current locale)
+/** \return 0 if the token is not a valid number (as QString::toDouble)
+**/
+static double ParseDouble(const char* begin, const char* end)
+{
+	//trim white spaces
+	while (begin != end && IsBlank(*begin))
+		++begin;
+	while (end != begin && IsBlank(end[-1]))
+		--end;
+
+	const char* c = begin;
+	bool negative = false;
+	if (c != end && (*c == '-' || *c == '+'))
+		negative = (*c++ == '-');
+
+	//mantissa
+	uint64_t mantissa = 0;
+	int digitCount = 0;
+	int exponent = 0;
+	bool validDigits = false;
+	for (; c != end && *c >= '0' && *c <= '9'; ++c)
+	{
+		validDigits = true;
+		if (mantissa == 0 && *c == '0')
+			continue; //leading zeros
+		if (digitCount < 19)
+			mantissa = mantissa*10 + static_cast<uint64_t>(*c-'0');
+		else
+			++exponent;
+		++digitCount;
+	}
+	if (c != end && *c == '.')
+	{
+		for (++c; c != end && *c >= '0' && *c <= '9'; ++c)
+		{
+			validDigits = true;
+			if (mantissa == 0 && *c == '0')
+			{
+				--exponent;
+				continue;
+			}
+			if (digitCount < 19)
+			{
+				mantissa = mantissa*10 + static_cast<uint64_t>(*c-'0');
+				--exponent;
+			}
+			++digitCount;
+		}
+	}
+
+	//exponent
+	if (validDigits && c != end && (*c == 'e' || *c == 'E'))
+	{
+		++c;
+		bool negativeExp = false;
+		if (c != end && (*c == '-' || *c == '+'))
+			negativeExp = (*c++ == '-');
+		if (c == end || *c < '0' || *c > '9')
+		{
+			validDigits = false;
+		}
+		else
+		{
+			int e = 0;
+			for (; c != end && *c >= '0' && *c <= '9'; ++c)
+				if (e < 100000)
+					e = e*10 + (*c-'0');
+			exponent += (negativeExp ? -e : e);
+		}
+	}
+
+	//exact conversion (the mantissa and the power of 10 are both exactly representable)
+	static const double s_powersOf10[] = {	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+											1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+	if (validDigits && c == end && digitCount <= 15 && exponent >= -22 && exponent <= 22)
+	{
+		double value = static_cast<double>(mantissa);
+		if (exponent < 0)
+			value /= s_powersOf10[-exponent];
+		else
+			value *= s_powersOf10[exponent];
+		return negative ? -value : value;
+	}
+
+	//otherwise we rely on Qt (long mantissa, special values, invalid numbers, etc.)
+	return QByteArray(begin,static_cast<int>(end-begin)).toDouble();
+}
+
+//! Parses an integer value (same result as QString::toInt)
+/** \return 0 if the token is not a valid integer (as QString::toInt)
+**/
+static int ParseInt(const char* begin, const char* end)
+{
+	//trim white spaces
+	while (begin != end && IsBlank(*begin))
+		++begin;
+	while (end != begin && IsBlank(end[-1]))
+		--end;
+
+	const char* c = begin;
+	bool negative = false;
+	if (c != end && (*c == '-' || *c == '+'))
+		negative = (*c++ == '-');
+	if (c == end)
+		return 0;
+
+	int64_t value = 0;
+	for (; c != end; ++c)
+	{
+		if (*c < '0' || *c > '9')
+			return 0;
+		value = value*10 + (*c-'0');
+		if (value > static_cast<int64_t>(INT_MAX) + 1)
+			return 0;
+	}
+	if (negative)
+		value = -value;
+
+	return (value >= INT_MIN && value <= INT_MAX ? static_cast<int>(value) : 0);
+}
+
+//! Line that couldn't be loaded
+struct asciiBadLine
+{
+	//! Line number (inside the block)
+	unsigned lineNumber;
+	//! Number of parts (or -1 for an empty line)
+	int partCount;
+};
+
+//! ASCII file block (parsed by a single thread)
+struct asciiFileBlock
+{
+	//! Block data (whole lines)
+	const char* begin;
+	//! End of the block data
+	const char* end;
+
+	//! Separator
+	char separator;
+	//! Max column index
+	int maxPartIndex;
+	//! Column index --> value slot (or -1 if the column is ignored)
+	const std::vector<int>* columnSlots;
+	//! Whether the values of each column are integers (see QString::toInt)
+	const std::vector<bool>* integerColumns;
+	//! Number of value slots (per point)
+	unsigned slotCount;
+
+	//! Number of lines
+	unsigned lineCount;
+	//! Number of points
+	unsigned pointCount;
+	//! Points values (slotCount values per point)
+	std::vector<double> values;
+	//! Lines that couldn't be loaded
+	std::vector<asciiBadLine> badLines;
+	//! Whether we ran out of memory
+	bool notEnoughMemory;
+};
+
+//! Parses a block of lines (same rules as the QTextStream based loader)
+static void ParseAsciiFileBlock(asciiFileBlock& block)
+{
+	block.lineCount = 0;
+	block.pointCount = 0;
+	block.values.clear();
+	block.badLines.clear();
+	block.notEnoughMemory = false;
+
+	const std::vector<int>& columnSlots = *block.columnSlots;
+	const std::vector<bool>& integerColumns = *block.integerColumns;
+	std::vector<double> pointValues(block.slotCount,0);
+
+	try
+	{
+		//we guess the number of lines from the first one
+		const char* firstLineEnd = static_cast<const char*>(memchr(block.begin,'\n',block.end-block.begin));
+		if (firstLineEnd)
+			block.values.reserve(block.slotCount * static_cast<size_t>((block.end-block.begin)/(firstLineEnd-block.begin+1) + 1));
+
+		const char* lineStart = block.begin;
+		while (lineStart < block.end)
+		{
+			const char* lineEnd = static_cast<const char*>(memchr(lineStart,'\n',block.end-lineStart));
+			const char* next = (lineEnd ? lineEnd+1 : block.end);
+			if (!lineEnd)
+				lineEnd = block.end;
+			//"\r\n" line endings
+			if (lineEnd != lineStart && lineEnd[-1] == '\r')
+				--lineEnd;
+
+			++block.lineCount;
+
+			//comment
+			if (lineEnd-lineStart >= 2 && lineStart[0] == '/' && lineStart[1] == '/')
+			{
+				lineStart = next;
+				continue;
+			}
+
+			if (lineEnd == lineStart)
+			{
+				asciiBadLine badLine = { block.lineCount, -1 };
+				block.badLines.push_back(badLine);
+				lineStart = next;
+				continue;
+			}
+
+			//we split the line (empty parts are skipped)
+			int partCount = 0;
+			const char* partStart = lineStart;
+			while (partStart < lineEnd)
+			{
+				const char* partEnd = partStart;
+				while (partEnd != lineEnd && *partEnd != block.separator)
+					++partEnd;
+
+				if (partEnd != partStart)
+				{
+					if (partCount <= block.maxPartIndex)
+					{
+						int slot = columnSlots[partCount];
+						if (slot >= 0)
+							pointValues[slot] = integerColumns[partCount] ? static_cast<double>(ParseInt(partStart,partEnd)) : ParseDouble(partStart,partEnd);
+					}
+					++partCount;
+				}
+				partStart = partEnd+1;
+			}
+
+			if (partCount > block.maxPartIndex)
+			{
+				block.values.insert(block.values.end(),pointValues.begin(),pointValues.end());
+				++block.pointCount;
+			}
+			else
+			{
+				asciiBadLine badLine = { block.lineCount, partCount };
+				block.badLines.push_back(badLine);
+			}
+
+			lineStart = next;
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		block.notEnoughMemory = true;
+	}
+}
+
+//! Size of the blocks parsed by each thread (in bytes)
+static const size_t ASCII_FILE_BLOCK_SIZE = (8 << 20);
+
+//! Adds the scalar fields to the cloud display and stores it in the container
+static void StoreCloud(cloudAttributesDescriptor& cloudDesc, ccHObject& container)
+{
+	//the scalar fields (filled with setValue) must be resized to the actual number of points in any case
+	cloudDesc.cloud->resize(cloudDesc.cloud->size());
+
+	if (!cloudDesc.scalarFields.empty())
+	{
+		for (size_t j=0; j<cloudDesc.scalarFields.size(); ++j)
+			cloudDesc.scalarFields[j]->computeMinAndMax();
+		cloudDesc.cloud->setCurrentDisplayedScalarField(0);
+		cloudDesc.cloud->showSF(true);
+	}
+
+	container.addChild(cloudDesc.cloud);
+	cloudDesc.reset();
+}
+
+CC_FILE_ERROR AsciiFilter::loadCloudFromMappedAsciiFile(const char* data,
+														size_t dataSize,
+														const char* filename,
+														ccHObject& container,
+														const AsciiOpenDlg::Sequence& openSequence,
+														char separator,
+														unsigned approximateNumberOfLines,
+														unsigned maxCloudSize,
+														unsigned skipLines,
+														bool alwaysDisplayLoadDialog,
+														bool* coordinatesShiftEnabled,
+														CCVector3d* coordinatesShift)
+{
+	assert(data);
+
+	//we may have to "slice" clouds when opening them if they are too big!
+	maxCloudSize = std::max<unsigned>(1,std::min(maxCloudSize,CC_MAX_NUMBER_OF_POINTS_PER_CLOUD));
+	unsigned chunkRank = 1;
+
+	//we initialize the loading accelerator structure and point cloud
+	int maxPartIndex = -1;
+	cloudAttributesDescriptor cloudDesc = prepareCloud(openSequence, std::min(maxCloudSize,approximateNumberOfLines), maxPartIndex, chunkRank);
+	if (!cloudDesc.cloud)
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+
+	//value slots: X, Y, Z, then the other columns (in the file order)
+	std::vector<int> columnSlots;
+	std::vector<bool> integerColumns;
+	int xSlot = -1, ySlot = -1, zSlot = -1;
+	int nxSlot = -1, nySlot = -1, nzSlot = -1;
+	int rSlot = -1, gSlot = -1, bSlot = -1, iRgbaSlot = -1, fRgbaSlot = -1, greySlot = -1;
+	std::vector<int> sfSlots;
+	unsigned slotCount = 0;
+	try
+	{
+		columnSlots.resize(static_cast<size_t>(maxPartIndex+1),-1);
+		integerColumns.resize(static_cast<size_t>(maxPartIndex+1),false);
+
+		int* slots[cloudAttributesDescriptor::c_attribCount] = {	&xSlot, &ySlot, &zSlot,
+																	&nxSlot, &nySlot, &nzSlot,
+																	&rSlot, &gSlot, &bSlot,
+																	&iRgbaSlot, &fRgbaSlot, &greySlot };
+		for (unsigned i=0; i<cloudAttributesDescriptor::c_attribCount; ++i)
+		{
+			int column = cloudDesc.indexes[i];
+			if (column >= 0)
+			{
+				*slots[i] = static_cast<int>(slotCount);
+				columnSlots[column] = static_cast<int>(slotCount++);
+			}
+		}
+		//(see QString::toInt in the QTextStream based loader)
+		if (cloudDesc.iRgbaIndex >= 0)
+			integerColumns[cloudDesc.iRgbaIndex] = true;
+		if (cloudDesc.greyIndex >= 0)
+			integerColumns[cloudDesc.greyIndex] = true;
+
+		for (size_t j=0; j<cloudDesc.scalarIndexes.size(); ++j)
+		{
+			sfSlots.push_back(static_cast<int>(slotCount));
+			columnSlots[cloudDesc.scalarIndexes[j]] = static_cast<int>(slotCount++);
+		}
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		clearStructure(cloudDesc);
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+
+	//we skip lines as defined on input
+	const char* dataEnd = data + dataSize;
+	const char* current = data;
+	for (unsigned i=0; i<skipLines && current < dataEnd; ++i)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(current,'\n',dataEnd-current));
+		current = (lineEnd ? lineEnd+1 : dataEnd);
+	}
+
+	//one block per thread at each iteration
+	size_t threadCount = static_cast<size_t>(std::max(1,QThreadPool::globalInstance()->maxThreadCount()));
+	std::vector<asciiFileBlock> blocks;
+
+	//progress indicator
+	ccProgressDialog pdlg(true);
+	unsigned blockCount = static_cast<unsigned>((dataEnd-current) / ASCII_FILE_BLOCK_SIZE + 1);
+	CCLib::NormalizedProgress nprogress(&pdlg,blockCount);
+	pdlg.setMethodTitle(qPrintable(QString("Open ASCII file [%1]").arg(filename)));
+	pdlg.setInfo(qPrintable(QString("Approximate number of points: %1").arg(approximateNumberOfLines)));
+	pdlg.start();
+
+	//buffers
+	double P[3] = {0,0,0};
+	CCVector3d Pshift(0,0,0);
+	CCVector3 N(0,0,0);
+	colorType col[3] = {0,0,0};
+
+	//other useful variables
+	unsigned linesRead = 0;
+	unsigned pointsRead = 0;
+
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+
+	while (current < dataEnd && result == CC_FERR_NO_ERROR)
+	{
+		//we cut the next blocks (at the end of a line)
+		blocks.clear();
+		while (blocks.size() < threadCount && current < dataEnd)
+		{
+			asciiFileBlock block;
+			block.begin = current;
+			if (static_cast<size_t>(dataEnd-current) <= ASCII_FILE_BLOCK_SIZE)
+			{
+				block.end = dataEnd;
+			}
+			else
+			{
+				const char* lineEnd = static_cast<const char*>(memchr(current+ASCII_FILE_BLOCK_SIZE,'\n',dataEnd-(current+ASCII_FILE_BLOCK_SIZE)));
+				block.end = (lineEnd ? lineEnd+1 : dataEnd);
+			}
+			block.separator = separator;
+			block.maxPartIndex = maxPartIndex;
+			block.columnSlots = &columnSlots;
+			block.integerColumns = &integerColumns;
+			block.slotCount = slotCount;
+			block.lineCount = block.pointCount = 0;
+			block.notEnoughMemory = false;
+			blocks.push_back(block);
+			current = block.end;
+		}
+
+		//we parse them in parallel
+		if (blocks.size() > 1)
+			QtConcurrent::blockingMap(blocks, ParseAsciiFileBlock);
+		else
+			ParseAsciiFileBlock(blocks[0]);
+
+		//then we add the points to the cloud(s) in the file order
+		for (size_t b=0; b<blocks.size() && result == CC_FERR_NO_ERROR; ++b)
+		{
+			asciiFileBlock& block = blocks[b];
+			if (block.notEnoughMemory)
+			{
+				ccLog::Error("Not enough memory! Process stopped ...");
+				result = CC_FERR_NOT_ENOUGH_MEMORY;
+				break;
+			}
+
+			for (size_t k=0; k<block.badLines.size(); ++k)
+			{
+				const asciiBadLine& badLine = block.badLines[k];
+				if (badLine.partCount < 0)
+					ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (empty)!",linesRead+badLine.lineNumber);
+				else
+					ccLog::Warning("[AsciiFilter::Load] Line %i is corrupted (found %i part(s) on %i expected)!",linesRead+badLine.lineNumber,badLine.partCount,maxPartIndex+1);
+			}
+			linesRead += block.lineCount;
+
+			const double* values = block.values.empty() ? 0 : &(block.values[0]);
+			unsigned pointIndex = 0;
+			while (pointIndex < block.pointCount)
+			{
+				//if we have reached the max. number of points per cloud
+				if (cloudDesc.cloud->size() == maxCloudSize)
+				{
+					ccLog::PrintDebug("[ASCII] Point %i -> end of chunk (%i points)",pointsRead,maxCloudSize);
+					StoreCloud(cloudDesc,container);
+					cloudDesc = prepareCloud(openSequence, std::min(maxCloudSize,block.pointCount-pointIndex), maxPartIndex, ++chunkRank);
+					if (!cloudDesc.cloud)
+					{
+						ccLog::Error("Not enough memory! Process stopped ...");
+						result = CC_FERR_NOT_ENOUGH_MEMORY;
+						break;
+					}
+					cloudDesc.cloud->setGlobalShift(Pshift);
+				}
+
+				//we enlarge the current cloud
+				unsigned cloudSize = cloudDesc.cloud->size();
+				unsigned count = std::min(block.pointCount-pointIndex,maxCloudSize-cloudSize);
+				if (cloudDesc.cloud->capacity() < cloudSize+count)
+				{
+					//(we reserve some more room to avoid reallocating memory at each block)
+					unsigned newCapacity = std::min(maxCloudSize,std::max(cloudSize+count,cloudSize+cloudSize/2));
+					if (!cloudDesc.cloud->reserve(newCapacity))
+					{
+						ccLog::Error("Not enough memory! Process stopped ...");
+						result = CC_FERR_NOT_ENOUGH_MEMORY;
+						break;
+					}
+				}
+
+				for (unsigned i=0; i<count; ++i, ++pointIndex, values+=slotCount)
+				{
+					//(X,Y,Z)
+					if (xSlot >= 0)
+						P[0] = values[xSlot];
+					if (ySlot >= 0)
+						P[1] = values[ySlot];
+					if (zSlot >= 0)
+						P[2] = values[zSlot];
+
+					//first point: check for 'big' coordinates
+					if (pointsRead == 0)
+					{
+						bool shiftAlreadyEnabled = (coordinatesShiftEnabled && *coordinatesShiftEnabled && coordinatesShift);
+						if (shiftAlreadyEnabled)
+							Pshift = *coordinatesShift;
+						bool applyAll=false;
+						if (	sizeof(PointCoordinateType) < 8
+							&&	ccCoordinatesShiftManager::Handle(P,0,alwaysDisplayLoadDialog,shiftAlreadyEnabled,Pshift,0,applyAll) )
+						{
+							cloudDesc.cloud->setGlobalShift(Pshift);
+							ccLog::Warning("[ASCIIFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",Pshift.x,Pshift.y,Pshift.z);
+
+							//we save coordinates shift information
+							if (applyAll && coordinatesShiftEnabled && coordinatesShift)
+							{
+								*coordinatesShiftEnabled = true;
+								*coordinatesShift = Pshift;
+							}
+						}
+					}
+
+					//add point
+					cloudDesc.cloud->addPoint(CCVector3(static_cast<PointCoordinateType>(P[0] + Pshift.x),
+														static_cast<PointCoordinateType>(P[1] + Pshift.y),
+														static_cast<PointCoordinateType>(P[2] + Pshift.z)) );
+
+					//Normal vector
+					if (cloudDesc.hasNorms)
+					{
+						if (nxSlot >= 0)
+							N.x = static_cast<PointCoordinateType>(values[nxSlot]);
+						if (nySlot >= 0)
+							N.y = static_cast<PointCoordinateType>(values[nySlot]);
+						if (nzSlot >= 0)
+							N.z = static_cast<PointCoordinateType>(values[nzSlot]);
+						cloudDesc.cloud->addNorm(N);
+					}
+
+					//Colors
+					if (cloudDesc.hasRGBColors)
+					{
+						if (iRgbaSlot >= 0)
+						{
+							const uint32_t rgb = static_cast<uint32_t>(static_cast<int>(values[iRgbaSlot]));
+							col[0] = ((rgb >> 16)	& 0x0000ff);
+							col[1] = ((rgb >> 8)	& 0x0000ff);
+							col[2] = ((rgb)			& 0x0000ff);
+						}
+						else if (fRgbaSlot >= 0)
+						{
+							const float rgbf = static_cast<float>(values[fRgbaSlot]);
+							const uint32_t rgb = (uint32_t)(*((uint32_t*)&rgbf));
+							col[0] = ((rgb >> 16)	& 0x0000ff);
+							col[1] = ((rgb >> 8)	& 0x0000ff);
+							col[2] = ((rgb)			& 0x0000ff);
+						}
+						else
+						{
+							if (rSlot >= 0)
+								col[0] = static_cast<colorType>(static_cast<float>(values[rSlot]));
+							if (gSlot >= 0)
+								col[1] = static_cast<colorType>(static_cast<float>(values[gSlot]));
+							if (bSlot >= 0)
+								col[2] = static_cast<colorType>(static_cast<float>(values[bSlot]));
+						}
+						cloudDesc.cloud->addRGBColor(col);
+					}
+					else if (greySlot >= 0)
+					{
+						col[0] = col[1] = col[2] = static_cast<colorType>(static_cast<int>(values[greySlot]));
+						cloudDesc.cloud->addRGBColor(col);
+					}
+
+					//Scalar fields
+					for (size_t j=0; j<sfSlots.size(); ++j)
+						cloudDesc.scalarFields[j]->setValue(cloudSize+i,static_cast<ScalarType>(values[sfSlots[j]]));
+
+					++pointsRead;
+				}
+			}
+
+			if (!nprogress.oneStep())
+			{
+				//cancel requested
+				result = CC_FERR_CANCELED_BY_USER;
+				break;
+			}
+		}
+
+		pdlg.setInfo(qPrintable(QString("Points: %1").arg(pointsRead)));
+	}
+
+	if (cloudDesc.cloud)
+		StoreCloud(cloudDesc,container);
+
+	return result;
+}
+
 CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const char* filename,
 															ccHObject& container,
 															const AsciiOpenDlg::Sequence& openSequence,
@@ -571,6 +1156,27 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const char* filename,
 															bool* coordinatesShiftEnabled/*=0*/,
 															CCVector3d* coordinatesShift/*=0*/)
 {
+	//fast path: we parse the memory-mapped file in parallel
+	{
+		InputMemoryFile mappedFile(filename);
+		if (mappedFile.data())
+		{
+			return loadCloudFromMappedAsciiFile(mappedFile.data(),
+												mappedFile.size(),
+												filename,
+												container,
+												openSequence,
+												separator,
+												approximateNumberOfLines,
+												maxCloudSize,
+												skipLines,
+												alwaysDisplayLoadDialog,
+												coordinatesShiftEnabled,
+												coordinatesShift);
+		}
+		//otherwise (the file can't be mapped in memory) we read it line by line
+	}
+
 	//we may have to "slice" clouds when opening them if they are too big!
 	maxCloudSize = std::min(maxCloudSize,CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
 	unsigned cloudChunkSize = std::min(maxCloudSize,approximateNumberOfLines);
@@ -833,8 +1439,8 @@ CC_FILE_ERROR AsciiFilter::loadCloudFromFormatedAsciiFile(	const char* filename,
 
 	if (cloudDesc.cloud)
 	{
-		if (cloudDesc.cloud->size() < cloudDesc.cloud->capacity())
-			cloudDesc.cloud->resize(cloudDesc.cloud->size());
+		//the scalar fields (filled with setValue) must be resized to the actual number of points in any case
+		cloudDesc.cloud->resize(cloudDesc.cloud->size());
 
 		//add cloud to output
 		if (!cloudDesc.scalarFields.empty())
@@ -56,6 +56,24 @@ protected:
 	//! Internal use only
 	CC_FILE_ERROR saveFile(ccHObject* entity, FILE *theFile);
 
+	//! Loads a (memory-mapped) ASCII file by parsing blocks of lines in parallel
+	/** Same parameters and behavior as loadCloudFromFormatedAsciiFile.
+		\param data file data
+		\param dataSize file size (in bytes)
+	**/
+	CC_FILE_ERROR loadCloudFromMappedAsciiFile(	const char* data,
+												size_t dataSize,
+												const char* filename,
+												ccHObject& container,
+												const AsciiOpenDlg::Sequence& openSequence,
+												char separator,
+												unsigned approximateNumberOfLines,
+												unsigned maxCloudSize,
+												unsigned skipLines,
+												bool alwaysDisplayLoadDialog,
+												bool* coordinatesShiftEnabled,
+												CCVector3d* coordinatesShift);
+
 	//! Associated (export) dialog
 	static QSharedPointer<AsciiSaveDlg> s_saveDialog;
 
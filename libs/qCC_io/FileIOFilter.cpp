@@ -111,11 +111,11 @@ CC_FILE_TYPES FileIOFilter::GuessFileFormatFromExtension(const char* ext)
 	else if (strcmp(ext,"WRL") == 0)
 		fType = X3D;
 #endif
-#ifdef CC_LAS_SUPPORT
 	else if (strcmp(ext,"LAS") == 0)
 		fType = LAS;
+#ifdef CC_LAS_SUPPORT
 	else if (strcmp(ext,"LAZ") == 0)
-		fType = LAS; //DGM: LAZ extension is handled by LASFilter
+		fType = LAS; //LAZ extension is handled by LASFilter (with liblas)
 #endif
 #ifdef CC_E57_SUPPORT
 	else if (strcmp(ext,"E57") == 0)
@@ -187,10 +187,8 @@ FileIOFilter* FileIOFilter::CreateFilter(CC_FILE_TYPES fType)
 	case X3D:
 		return new X3DFilter();
 #endif
-#ifdef CC_LAS_SUPPORT
 	case LAS:
 		return new LASFilter();
-#endif
 #ifdef CC_E57_SUPPORT
 	case E57:
 		return new E57Filter();
@@ -50,9 +50,7 @@ enum CC_FILE_TYPES {UNKNOWN_FILE = 0	,		/**< unknown type */
 #ifdef CC_X3D_SUPPORT
 					X3D					,		/**< X3D mesh file */
 #endif
-#ifdef CC_LAS_SUPPORT
 					LAS					,		/**< LAS lidar point cloud (binary) */
-#endif
 #ifdef CC_E57_SUPPORT
 					E57					,		/**< ASTM E2807-11 E57 file */
 #endif
@@ -78,9 +76,7 @@ const CC_FILE_TYPES CC_FILE_TYPES_ENUMS[] = {UNKNOWN_FILE, SOI, ASCII, BIN,
 #ifdef CC_X3D_SUPPORT
 												,X3D
 #endif
-#ifdef CC_LAS_SUPPORT
 												,LAS
-#endif
 #ifdef CC_E57_SUPPORT
 												,E57
 #endif
@@ -122,6 +118,8 @@ const char CC_FILE_TYPE_FILTERS[][64] = {
 #endif
 #ifdef CC_LAS_SUPPORT
 			, "LAS lidar point cloud (*.las *.laz)"
+#else
+			, "LAS lidar point cloud (*.las)" //LAZ files require liblas
 #endif
 #ifdef CC_E57_SUPPORT
 			, "E57 ASTM E2807-11 files (*.e57)"
@@ -162,9 +160,7 @@ const char CC_FILE_TYPE_DEFAULT_EXTENSION[][8] = {
 #ifdef CC_X3D_SUPPORT
 				, "x3d"
 #endif
-#ifdef CC_LAS_SUPPORT
 				, "las"
-#endif
 #ifdef CC_E57_SUPPORT
 				, "e57"
 #endif
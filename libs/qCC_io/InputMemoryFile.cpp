@@ -53,12 +53,19 @@ InputMemoryFile::InputMemoryFile(const char *pathname)
 	file_handle_ = ::CreateFile(pathname, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0);
 	if (file_handle_ == INVALID_HANDLE_VALUE)
 		return;
+	//64 bits file size (GetFileSize only returns the lower 32 bits)
+	LARGE_INTEGER fileSize;
+	if (!::GetFileSizeEx(file_handle_, &fileSize) || static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<unsigned long long>(static_cast<size_t>(-1)))
+		return; //too big to be mapped as a whole (32 bits version)
 	file_mapping_handle_ = ::CreateFileMapping(file_handle_, 0, PAGE_READONLY, 0, 0, 0);
-	if (file_mapping_handle_ == INVALID_HANDLE_VALUE)
+	if (!file_mapping_handle_) //CreateFileMapping returns NULL on failure
+	{
+		file_mapping_handle_ = INVALID_HANDLE_VALUE;
 		return;
+	}
 	data_ = static_cast<char*>(::MapViewOfFile(file_mapping_handle_, FILE_MAP_READ, 0, 0, 0));
 	if (data_)
-		size_ = ::GetFileSize(file_handle_, 0);
+		size_ = static_cast<size_t>(fileSize.QuadPart);
 #endif
 }
 
@@ -15,13 +15,13 @@
 //#                                                                        #
 //##########################################################################
 
-#ifdef CC_LAS_SUPPORT
-
 #include "LASFilter.h"
 
 //qCC
 #include "ccCoordinatesShiftManager.h"
 #include "LASOpenDlg.h"
+#include "LASNativeReader.h"
+#include "InputMemoryFile.h"
 
 //qCC_db
 #include <ccLog.h>
@@ -30,11 +30,13 @@
 #include <ccScalarField.h>
 #include "ccColorScalesManager.h"
 
+#ifdef CC_LAS_SUPPORT
 //Liblas
 #include <liblas/point.hpp>
 #include <liblas/reader.hpp>
 #include <liblas/writer.hpp>
 #include <liblas/factory.hpp>	// liblas::ReaderFactory
+#endif
 
 //Qt
 #include <QFileInfo>
@@ -45,6 +47,8 @@
 #include <fstream>				// std::ifstream
 #include <iostream>				// std::cout
 
+#ifdef CC_LAS_SUPPORT
+
 //LAS field descriptor
 struct LasField
 {
@@ -338,10 +342,102 @@ CC_FILE_ERROR LASFilter::saveToFile(ccHObject* entity, const char* filename)
 	return CC_FERR_NO_ERROR;
 }
 
+#else
+
+CC_FILE_ERROR LASFilter::saveToFile(ccHObject* entity, const char* filename)
+{
+	ccLog::Error("[LAS] Writing LAS files requires liblas support!");
+	return CC_FERR_WRONG_FILE_TYPE;
+}
+
+#endif //CC_LAS_SUPPORT
+
 QSharedPointer<LASOpenDlg> s_lasOpenDlg(0);
 
+//! LAS fields that can be loaded as scalar fields
+static const LAS_FIELDS LAS_SCALAR_FIELDS[] = {	LAS_CLASSIFICATION,
+												LAS_CLASSIF_VALUE,
+												LAS_CLASSIF_SYNTHETIC,
+												LAS_CLASSIF_KEYPOINT,
+												LAS_CLASSIF_WITHHELD,
+												LAS_INTENSITY,
+												LAS_TIME,
+												LAS_RETURN_NUMBER,
+												LAS_NUMBER_OF_RETURNS,
+												LAS_SCAN_DIRECTION,
+												LAS_FLIGHT_LINE_EDGE,
+												LAS_SCAN_ANGLE_RANK,
+												LAS_USER_DATA,
+												LAS_POINT_SOURCE_ID };
+
 CC_FILE_ERROR LASFilter::loadFile(const char* filename, ccHObject& container, bool alwaysDisplayLoadDialog/*=true*/, bool* coordinatesShiftEnabled/*=0*/, CCVector3d* coordinatesShift/*=0*/)
 {
+	//uncompressed files are directly decoded (see LASNativeReader)
+	{
+		InputMemoryFile mappedFile(filename);
+		LASNativeReader::Header header;
+		if (	mappedFile.data()
+			&&	LASNativeReader::ReadHeader(mappedFile.data(),mappedFile.size(),header) == CC_FERR_NO_ERROR
+			&&	!header.compressed )
+		{
+			ccLog::Print(QString("[LAS] %1 - version %2.%3 - point format %4").arg(filename).arg(header.versionMajor).arg(header.versionMinor).arg(header.pointFormat));
+			if (header.pointCount == 0)
+			{
+				//strange file ;)
+				return CC_FERR_NO_LOAD;
+			}
+
+			//dialog to choose the fields to load
+			std::vector<std::string> dimensions;
+			LASNativeReader::GetDimensions(header.pointFormat,dimensions);
+			if (!s_lasOpenDlg)
+				s_lasOpenDlg = QSharedPointer<LASOpenDlg>(new LASOpenDlg());
+			s_lasOpenDlg->setDimensions(dimensions);
+			if (alwaysDisplayLoadDialog && !s_lasOpenDlg->autoSkipMode() && !s_lasOpenDlg->exec())
+				return CC_FERR_CANCELED_BY_USER;
+
+			LASNativeReader::LoadParameters params;
+			params.loadColor[0] = s_lasOpenDlg->doLoad(LAS_RED);
+			params.loadColor[1] = s_lasOpenDlg->doLoad(LAS_GREEN);
+			params.loadColor[2] = s_lasOpenDlg->doLoad(LAS_BLUE);
+			params.forced8bitRgbMode = s_lasOpenDlg->forced8bitRgbMode();
+			params.ignoreDefaultFields = s_lasOpenDlg->ignoreDefaultFieldsCheckBox->isChecked();
+			for (size_t i=0; i<sizeof(LAS_SCALAR_FIELDS)/sizeof(LAS_FIELDS); ++i)
+				if (s_lasOpenDlg->doLoad(LAS_SCALAR_FIELDS[i]))
+					params.fields.push_back(LAS_SCALAR_FIELDS[i]);
+
+			//optional filter
+			if (s_lasOpenDlg->boxFilterGroupBox->isChecked())
+			{
+				params.filter.useBox = true;
+				params.filter.boxMin[0] = s_lasOpenDlg->xMinDoubleSpinBox->value();
+				params.filter.boxMin[1] = s_lasOpenDlg->yMinDoubleSpinBox->value();
+				params.filter.boxMin[2] = s_lasOpenDlg->zMinDoubleSpinBox->value();
+				params.filter.boxMax[0] = s_lasOpenDlg->xMaxDoubleSpinBox->value();
+				params.filter.boxMax[1] = s_lasOpenDlg->yMaxDoubleSpinBox->value();
+				params.filter.boxMax[2] = s_lasOpenDlg->zMaxDoubleSpinBox->value();
+			}
+			if (!s_lasOpenDlg->getClasses(params.filter.classes))
+			{
+				ccLog::Error(QString("[LAS] Invalid classes list: '%1'").arg(s_lasOpenDlg->classesLineEdit->text()));
+				return CC_FERR_BAD_ARGUMENT;
+			}
+			params.alwaysDisplayLoadDialog = alwaysDisplayLoadDialog;
+			params.coordinatesShiftEnabled = coordinatesShiftEnabled;
+			params.coordinatesShift = coordinatesShift;
+
+			return LASNativeReader::Load(mappedFile.data(),mappedFile.size(),header,container,params);
+		}
+		//otherwise (compressed files, etc.) we rely on liblas
+	}
+
+#ifndef CC_LAS_SUPPORT
+
+	ccLog::Error("[LAS] Reading compressed (LAZ) files requires liblas support!");
+	return CC_FERR_WRONG_FILE_TYPE;
+
+#else
+
 	//opening file
 	std::ifstream ifs;
 	ifs.open(filename, std::ios::in | std::ios::binary);
@@ -765,6 +861,6 @@ CC_FILE_ERROR LASFilter::loadFile(const char* filename, ccHObject& container, bo
 	ifs.close();
 
 	return CC_FERR_NO_ERROR;
-}
 
-#endif
+#endif //CC_LAS_SUPPORT
+}
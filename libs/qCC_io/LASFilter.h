@@ -20,9 +20,10 @@
 
 #include "FileIOFilter.h"
 
-#ifdef CC_LAS_SUPPORT
-
 //! ASPRS LAS point cloud file I/O filter
+/** Uncompressed files are read natively (see LASNativeReader). Compressed
+	(LAZ) files and writing require liblas (CC_LAS_SUPPORT).
+**/
 class LASFilter : public FileIOFilter
 {
 public:
@@ -33,6 +34,4 @@ public:
 
 };
 
-#endif //CC_LAS_SUPPORT
-
 #endif
@@ -0,0 +1,698 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "LASNativeReader.h"
+#include "ccCoordinatesShiftManager.h"
+
+//qCC_db
+#include <ccLog.h>
+#include <ccPointCloud.h>
+#include <ccProgressDialog.h>
+#include <ccScalarField.h>
+#include <ccColorScalesManager.h>
+
+//Qt
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+//System
+#include <string.h>
+#include <assert.h>
+#include <algorithm>
+
+//! Reads a (little endian) value
+template<typename T> static inline T ReadLE(const unsigned char* ptr)
+{
+	T value;
+	memcpy(&value,ptr,sizeof(T));
+	return value;
+}
+
+//! Minimal point data record length for each format (0 to 10)
+static const unsigned short LAS_POINT_RECORD_LENGTHS[11] = { 20, 28, 26, 34, 57, 63, 30, 36, 38, 59, 67 };
+
+//! Offset of the GPS time for each format (or 0 if there's no time)
+static const unsigned short LAS_TIME_OFFSETS[11] = { 0, 20, 0, 20, 20, 20, 22, 22, 22, 22, 22 };
+
+//! Offset of the RGB components for each format (or 0 if there's no color)
+static const unsigned short LAS_RGB_OFFSETS[11] = { 0, 0, 20, 28, 0, 28, 0, 30, 30, 0, 30 };
+
+CC_FILE_ERROR LASNativeReader::ReadHeader(const char* data, size_t dataSize, Header& header)
+{
+	const unsigned char* h = reinterpret_cast<const unsigned char*>(data);
+	if (!h || dataSize < 227 || memcmp(h,"LASF",4) != 0)
+		return CC_FERR_WRONG_FILE_TYPE;
+
+	header.versionMajor = h[24];
+	header.versionMinor = h[25];
+	header.headerSize = ReadLE<uint16_t>(h+94);
+	header.pointDataOffset = ReadLE<uint32_t>(h+96);
+	//the 2 most significant bits of the point format are used to flag compressed files (LAZ)
+	header.pointFormat = (h[104] & 63);
+	header.compressed = ((h[104] & 192) != 0);
+	header.pointRecordLength = ReadLE<uint16_t>(h+105);
+	header.pointCount = ReadLE<uint32_t>(h+107);
+	for (unsigned d=0; d<3; ++d)
+	{
+		header.scale[d]		= ReadLE<double>(h+131+8*d);
+		header.offset[d]	= ReadLE<double>(h+155+8*d);
+		header.bbMax[d]		= ReadLE<double>(h+179+16*d);
+		header.bbMin[d]		= ReadLE<double>(h+187+16*d);
+	}
+
+	//LAS 1.4: 64 bits point count
+	if (	header.versionMajor == 1 && header.versionMinor >= 4
+		&&	header.headerSize >= 375 && dataSize >= 375)
+	{
+		uint64_t pointCount = ReadLE<uint64_t>(h+247);
+		if (pointCount != 0)
+			header.pointCount = pointCount;
+	}
+
+	if (	header.headerSize < 227
+		||	header.pointDataOffset < header.headerSize
+		||	header.pointFormat > 10
+		||	header.pointRecordLength < LAS_POINT_RECORD_LENGTHS[header.pointFormat]
+		||	header.scale[0] == 0 || header.scale[1] == 0 || header.scale[2] == 0)
+	{
+		return CC_FERR_MALFORMED_FILE;
+	}
+
+	//truncated file?
+	uint64_t maxPointCount = (header.pointDataOffset < dataSize ? (dataSize - header.pointDataOffset) / header.pointRecordLength : 0);
+	if (header.pointCount > maxPointCount)
+	{
+		ccLog::Warning(QString("[LAS] File is truncated: only %1 points out of %2 can be read").arg(maxPointCount).arg(header.pointCount));
+		header.pointCount = maxPointCount;
+	}
+
+	return CC_FERR_NO_ERROR;
+}
+
+void LASNativeReader::GetDimensions(unsigned char pointFormat, std::vector<std::string>& dimensions)
+{
+	dimensions.clear();
+	if (pointFormat > 10)
+		return;
+
+	const LAS_FIELDS standardFields[] = {	LAS_X, LAS_Y, LAS_Z, LAS_INTENSITY,
+											LAS_RETURN_NUMBER, LAS_NUMBER_OF_RETURNS, LAS_SCAN_DIRECTION, LAS_FLIGHT_LINE_EDGE,
+											LAS_CLASSIFICATION, LAS_SCAN_ANGLE_RANK, LAS_USER_DATA, LAS_POINT_SOURCE_ID };
+	for (size_t i=0; i<sizeof(standardFields)/sizeof(LAS_FIELDS); ++i)
+		dimensions.push_back(LAS_FIELD_NAMES[standardFields[i]]);
+
+	if (LAS_TIME_OFFSETS[pointFormat] != 0)
+		dimensions.push_back(LAS_FIELD_NAMES[LAS_TIME]);
+
+	if (LAS_RGB_OFFSETS[pointFormat] != 0)
+	{
+		dimensions.push_back(LAS_FIELD_NAMES[LAS_RED]);
+		dimensions.push_back(LAS_FIELD_NAMES[LAS_GREEN]);
+		dimensions.push_back(LAS_FIELD_NAMES[LAS_BLUE]);
+	}
+}
+
+//! Point data record decoder
+struct LASRecordDecoder
+{
+	//! Point format
+	unsigned char pointFormat;
+	//! Whether the point format is one of the LAS 1.4 'extended' formats (6 to 10)
+	bool extended;
+	//! Coordinates scale
+	double scale[3];
+	//! Coordinates offset
+	double offset[3];
+
+	//! Returns the coordinates of a point (file coordinates)
+	inline void getPoint(const unsigned char* record, double P[]) const
+	{
+		P[0] = ReadLE<int32_t>(record  ) * scale[0] + offset[0];
+		P[1] = ReadLE<int32_t>(record+4) * scale[1] + offset[1];
+		P[2] = ReadLE<int32_t>(record+8) * scale[2] + offset[2];
+	}
+
+	//! Returns the class of a point
+	inline unsigned char getClass(const unsigned char* record) const
+	{
+		return extended ? record[16] : (record[15] & 31);
+	}
+
+	//! Returns the (16 bits) color of a point
+	inline void getColor(const unsigned char* record, uint16_t rgb[]) const
+	{
+		const unsigned char* c = record + LAS_RGB_OFFSETS[pointFormat];
+		rgb[0] = ReadLE<uint16_t>(c  );
+		rgb[1] = ReadLE<uint16_t>(c+2);
+		rgb[2] = ReadLE<uint16_t>(c+4);
+	}
+
+	//! Returns the value of a given field
+	inline double getValue(const unsigned char* record, LAS_FIELDS field) const
+	{
+		switch (field)
+		{
+		case LAS_INTENSITY:
+			return ReadLE<uint16_t>(record+12);
+		case LAS_RETURN_NUMBER:
+			return extended ? (record[14] & 15) : (record[14] & 7);
+		case LAS_NUMBER_OF_RETURNS:
+			return extended ? ((record[14] >> 4) & 15) : ((record[14] >> 3) & 7);
+		case LAS_SCAN_DIRECTION:
+			return extended ? ((record[15] >> 6) & 1) : ((record[14] >> 6) & 1);
+		case LAS_FLIGHT_LINE_EDGE:
+			return extended ? ((record[15] >> 7) & 1) : ((record[14] >> 7) & 1);
+		case LAS_CLASSIFICATION:
+		case LAS_CLASSIF_VALUE:
+			return getClass(record);
+		case LAS_CLASSIF_SYNTHETIC:
+			return extended ? (record[15] & 1) : ((record[15] >> 5) & 1);
+		case LAS_CLASSIF_KEYPOINT:
+			return extended ? ((record[15] >> 1) & 1) : ((record[15] >> 6) & 1);
+		case LAS_CLASSIF_WITHHELD:
+			return extended ? ((record[15] >> 2) & 1) : ((record[15] >> 7) & 1);
+		case LAS_SCAN_ANGLE_RANK:
+			//LAS 1.4: scan angle in 0.006 degree increments
+			return extended ? ReadLE<int16_t>(record+18) * 0.006 : static_cast<signed char>(record[16]);
+		case LAS_USER_DATA:
+			return record[17];
+		case LAS_POINT_SOURCE_ID:
+			return ReadLE<uint16_t>(record + (extended ? 20 : 18));
+		case LAS_TIME:
+			return (LAS_TIME_OFFSETS[pointFormat] != 0 ? ReadLE<double>(record + LAS_TIME_OFFSETS[pointFormat]) : 0.0);
+		default:
+			assert(false);
+			break;
+		}
+		return 0.0;
+	}
+};
+
+//! Shared parameters of all the decoding jobs
+struct LASDecodingContext
+{
+	//! First point record
+	const unsigned char* records;
+	//! Point record length
+	unsigned short recordLength;
+	//! Record decoder
+	LASRecordDecoder decoder;
+	//! Points filter
+	const LASNativeReader::Filter* filter;
+	//! Fields to load
+	const std::vector<LAS_FIELDS>* fields;
+	//! Color components mask
+	uint16_t colorMask[3];
+	//! Whether colors should be loaded
+	bool loadColors;
+	//! Progress notification (first pass)
+	CCLib::ParallelProgressRelay* progress;
+
+	//decoding (second pass)
+
+	//! Coordinates shift
+	CCVector3d Pshift;
+	//! Output clouds (CC_MAX_NUMBER_OF_POINTS_PER_CLOUD points max each)
+	std::vector<ccPointCloud*> clouds;
+	//! Output scalar fields (per cloud, per field - or 0 if the field is ignored)
+	std::vector< std::vector<ccScalarField*> > scalarFields;
+	//! Colors bit shift (8 for standard 16 bits colors, 0 otherwise)
+	unsigned char colorBitShift;
+	//! Whether colors are actually stored
+	bool storeColors;
+
+	//! Returns whether a point passes the filter
+	inline bool accept(const unsigned char* record) const
+	{
+		if (!filter)
+			return true;
+
+		if (!filter->classes.empty() && !filter->classes[decoder.getClass(record)])
+			return false;
+
+		if (filter->useBox)
+		{
+			double P[3];
+			decoder.getPoint(record,P);
+			if (	P[0] < filter->boxMin[0] || P[0] > filter->boxMax[0]
+				||	P[1] < filter->boxMin[1] || P[1] > filter->boxMax[1]
+				||	P[2] < filter->boxMin[2] || P[2] > filter->boxMax[2])
+				return false;
+		}
+
+		return true;
+	}
+};
+
+//! Decoding job (a chunk of consecutive point records)
+struct lasChunk
+{
+	//! Shared parameters
+	LASDecodingContext* context;
+	//! First record index
+	uint64_t firstRecord;
+	//! Number of records
+	unsigned recordCount;
+
+	//first pass
+
+	//! Number of accepted points
+	unsigned acceptedCount;
+	//! First accepted record (if any)
+	uint64_t firstAcceptedRecord;
+	//! Whether a non black color has been met
+	bool hasColors;
+	//! Whether a color component larger than 255 has been met
+	bool has16bitColors;
+	//! Min value of each field
+	std::vector<double> minValues;
+	//! Max value of each field
+	std::vector<double> maxValues;
+
+	//second pass
+
+	//! Output index of the first accepted point (all clouds together)
+	uint64_t firstOutputIndex;
+};
+
+//! First pass: counts the accepted points and gathers the fields statistics
+static void AnalyzeLASChunk(lasChunk& chunk)
+{
+	const LASDecodingContext& context = *chunk.context;
+	const std::vector<LAS_FIELDS>& fields = *context.fields;
+
+	chunk.acceptedCount = 0;
+	chunk.hasColors = false;
+	chunk.has16bitColors = false;
+	chunk.minValues.resize(fields.size(),0);
+	chunk.maxValues.resize(fields.size(),0);
+
+	//process canceled?
+	if (context.progress->isCanceled())
+		return;
+
+	const unsigned char* record = context.records + chunk.firstRecord * context.recordLength;
+	for (unsigned i=0; i<chunk.recordCount; ++i, record+=context.recordLength)
+	{
+		if (!context.accept(record))
+			continue;
+
+		if (chunk.acceptedCount == 0)
+			chunk.firstAcceptedRecord = chunk.firstRecord + i;
+
+		if (context.loadColors)
+		{
+			uint16_t rgb[3];
+			context.decoder.getColor(record,rgb);
+			rgb[0] &= context.colorMask[0];
+			rgb[1] &= context.colorMask[1];
+			rgb[2] &= context.colorMask[2];
+			if (rgb[0] || rgb[1] || rgb[2])
+			{
+				chunk.hasColors = true;
+				if ((rgb[0] | rgb[1] | rgb[2]) & 0xFF00)
+					chunk.has16bitColors = true;
+			}
+		}
+
+		for (size_t j=0; j<fields.size(); ++j)
+		{
+			double value = context.decoder.getValue(record,fields[j]);
+			if (chunk.acceptedCount == 0)
+			{
+				chunk.minValues[j] = chunk.maxValues[j] = value;
+			}
+			else if (value < chunk.minValues[j])
+			{
+				chunk.minValues[j] = value;
+			}
+			else if (value > chunk.maxValues[j])
+			{
+				chunk.maxValues[j] = value;
+			}
+		}
+
+		++chunk.acceptedCount;
+	}
+
+	context.progress->steps(1);
+}
+
+//! Second pass: decodes the accepted points
+static void DecodeLASChunk(lasChunk& chunk)
+{
+	const LASDecodingContext& context = *chunk.context;
+	const std::vector<LAS_FIELDS>& fields = *context.fields;
+
+	uint64_t outputIndex = chunk.firstOutputIndex;
+	const unsigned char* record = context.records + chunk.firstRecord * context.recordLength;
+	for (unsigned i=0; i<chunk.recordCount; ++i, record+=context.recordLength)
+	{
+		if (!context.accept(record))
+			continue;
+
+		size_t cloudIndex = static_cast<size_t>(outputIndex / CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
+		unsigned pointIndex = static_cast<unsigned>(outputIndex % CC_MAX_NUMBER_OF_POINTS_PER_CLOUD);
+		ccPointCloud* cloud = context.clouds[cloudIndex];
+
+		double P[3];
+		context.decoder.getPoint(record,P);
+		*const_cast<CCVector3*>(cloud->getPoint(pointIndex)) = CCVector3(	static_cast<PointCoordinateType>(P[0] + context.Pshift.x),
+																			static_cast<PointCoordinateType>(P[1] + context.Pshift.y),
+																			static_cast<PointCoordinateType>(P[2] + context.Pshift.z));
+
+		if (context.storeColors)
+		{
+			uint16_t rgb[3];
+			context.decoder.getColor(record,rgb);
+			colorType col[3] = {	static_cast<colorType>((rgb[0] & context.colorMask[0]) >> context.colorBitShift),
+									static_cast<colorType>((rgb[1] & context.colorMask[1]) >> context.colorBitShift),
+									static_cast<colorType>((rgb[2] & context.colorMask[2]) >> context.colorBitShift) };
+			//(we don't use ccPointCloud::setPointColor as it is not thread-safe)
+			cloud->rgbColors()->setValue(pointIndex,col);
+		}
+
+		const std::vector<ccScalarField*>& sfs = context.scalarFields[cloudIndex];
+		for (size_t j=0; j<fields.size(); ++j)
+			if (sfs[j])
+				sfs[j]->setValue(pointIndex,static_cast<ScalarType>(context.decoder.getValue(record,fields[j])));
+
+		++outputIndex;
+	}
+}
+
+//! Number of point records per decoding job
+static const unsigned LAS_CHUNK_SIZE = (1 << 16);
+
+CC_FILE_ERROR LASNativeReader::Load(const char* data,
+									size_t dataSize,
+									const Header& header,
+									ccHObject& container,
+									const LoadParameters& params)
+{
+	if (header.compressed)
+		return CC_FERR_WRONG_FILE_TYPE;
+	if (header.pointCount == 0)
+		return CC_FERR_NO_LOAD;
+	assert(header.pointDataOffset + header.pointCount * header.pointRecordLength <= dataSize);
+
+	LASDecodingContext context;
+	context.records = reinterpret_cast<const unsigned char*>(data) + header.pointDataOffset;
+	context.recordLength = header.pointRecordLength;
+	context.decoder.pointFormat = header.pointFormat;
+	context.decoder.extended = (header.pointFormat >= 6);
+	for (unsigned d=0; d<3; ++d)
+	{
+		context.decoder.scale[d] = header.scale[d];
+		context.decoder.offset[d] = header.offset[d];
+	}
+	context.filter = (params.filter.useBox || !params.filter.classes.empty() ? &params.filter : 0);
+	if (context.filter && !params.filter.classes.empty() && params.filter.classes.size() < 256)
+	{
+		ccLog::Warning("[LAS] Invalid classes filter (256 flags expected)");
+		return CC_FERR_BAD_ARGUMENT;
+	}
+	context.colorMask[0] = (params.loadColor[0] ? 0xFFFF : 0);
+	context.colorMask[1] = (params.loadColor[1] ? 0xFFFF : 0);
+	context.colorMask[2] = (params.loadColor[2] ? 0xFFFF : 0);
+	context.loadColors = (LAS_RGB_OFFSETS[header.pointFormat] != 0 && (params.loadColor[0] || params.loadColor[1] || params.loadColor[2]));
+	context.colorBitShift = 0;
+	context.storeColors = false;
+
+	//fields (only the ones available in this point format)
+	std::vector<LAS_FIELDS> fields;
+	{
+		for (size_t j=0; j<params.fields.size(); ++j)
+		{
+			LAS_FIELDS field = params.fields[j];
+			if (field == LAS_X || field == LAS_Y || field == LAS_Z || field == LAS_RED || field == LAS_GREEN || field == LAS_BLUE || field == LAS_INVALID)
+				continue;
+			if (field == LAS_TIME && LAS_TIME_OFFSETS[header.pointFormat] == 0)
+				continue;
+			fields.push_back(field);
+		}
+	}
+	context.fields = &fields;
+
+	//decoding jobs
+	std::vector<lasChunk> chunks;
+	try
+	{
+		chunks.resize(static_cast<size_t>((header.pointCount + LAS_CHUNK_SIZE - 1) / LAS_CHUNK_SIZE));
+	}
+	catch (.../*const std::bad_alloc&*/) //out of memory
+	{
+		return CC_FERR_NOT_ENOUGH_MEMORY;
+	}
+	for (size_t i=0; i<chunks.size(); ++i)
+	{
+		lasChunk& chunk = chunks[i];
+		chunk.context = &context;
+		chunk.firstRecord = static_cast<uint64_t>(i) * LAS_CHUNK_SIZE;
+		chunk.recordCount = static_cast<unsigned>(std::min<uint64_t>(LAS_CHUNK_SIZE, header.pointCount - chunk.firstRecord));
+		chunk.acceptedCount = 0;
+		chunk.firstAcceptedRecord = 0;
+		chunk.firstOutputIndex = 0;
+	}
+
+	//progress dialog (each chunk is processed twice)
+	ccProgressDialog pdlg(true); //cancel available
+	CCLib::NormalizedProgress nprogress(&pdlg,static_cast<unsigned>(chunks.size()) * 2);
+	pdlg.setMethodTitle("Open LAS file");
+	pdlg.setInfo(qPrintable(QString("Points: %1").arg(header.pointCount)));
+	pdlg.start();
+
+	//first pass: number of (accepted) points and fields statistics
+	//(the workers only count their chunks: the progress dialog is updated by this thread)
+	CCLib::ParallelProgressRelay progressRelay(&nprogress);
+	context.progress = &progressRelay;
+	QtConcurrent::blockingMap(chunks, AnalyzeLASChunk);
+	progressRelay.flush();
+	if (progressRelay.isCanceled())
+		return CC_FERR_CANCELED_BY_USER;
+
+	uint64_t acceptedCount = 0;
+	const unsigned char* firstAcceptedRecord = 0;
+	bool hasColors = false;
+	bool has16bitColors = false;
+	std::vector<double> minValues(fields.size(),0), maxValues(fields.size(),0);
+	for (size_t i=0; i<chunks.size(); ++i)
+	{
+		lasChunk& chunk = chunks[i];
+		chunk.firstOutputIndex = acceptedCount;
+		if (chunk.acceptedCount == 0)
+			continue;
+
+		if (!firstAcceptedRecord)
+		{
+			firstAcceptedRecord = context.records + chunk.firstAcceptedRecord * context.recordLength;
+			minValues = chunk.minValues;
+			maxValues = chunk.maxValues;
+		}
+		else
+		{
+			for (size_t j=0; j<fields.size(); ++j)
+			{
+				minValues[j] = std::min(minValues[j],chunk.minValues[j]);
+				maxValues[j] = std::max(maxValues[j],chunk.maxValues[j]);
+			}
+		}
+		hasColors |= chunk.hasColors;
+		has16bitColors |= chunk.has16bitColors;
+		acceptedCount += chunk.acceptedCount;
+	}
+
+	if (acceptedCount == 0)
+	{
+		ccLog::Warning("[LAS] No point passed the filter");
+		return CC_FERR_NO_LOAD;
+	}
+
+	if (context.loadColors)
+	{
+		if (!hasColors)
+		{
+			ccLog::Warning("[LAS FILE] Color field was all black! We ignored it...");
+		}
+		else
+		{
+			context.storeColors = true;
+			//we test if the color components are on 16 bits (standard) or only on 8 bits (it happens ;)
+			if (has16bitColors && !params.forced8bitRgbMode)
+			{
+				ccLog::Print("[LAS FILE] Color components are coded on 16 bits");
+				context.colorBitShift = 8;
+			}
+		}
+	}
+
+	//DGM: we only load the fields with non default values
+	std::vector<bool> fieldIsLoaded(fields.size(),true);
+	for (size_t j=0; j<fields.size(); ++j)
+	{
+		double defaultValue = (fields[j] == LAS_RETURN_NUMBER || fields[j] == LAS_NUMBER_OF_RETURNS ? 1.0 : 0.0);
+		if (params.ignoreDefaultFields && minValues[j] == maxValues[j] && minValues[j] == defaultValue)
+		{
+			ccLog::Warning(QString("[LAS FILE] All '%1' values were the same (%2)! We ignored them...").arg(LAS_FIELD_NAMES[fields[j]]).arg(minValues[j]));
+			fieldIsLoaded[j] = false;
+		}
+	}
+
+	//first point: check for 'big' coordinates
+	{
+		double P[3];
+		context.decoder.getPoint(firstAcceptedRecord,P);
+		bool shiftAlreadyEnabled = (params.coordinatesShiftEnabled && *params.coordinatesShiftEnabled && params.coordinatesShift);
+		if (shiftAlreadyEnabled)
+			context.Pshift = *params.coordinatesShift;
+		else
+			context.Pshift = CCVector3d(0,0,0);
+		bool applyAll = false;
+		if (	sizeof(PointCoordinateType) < 8
+			&&	ccCoordinatesShiftManager::Handle(P,0,params.alwaysDisplayLoadDialog,shiftAlreadyEnabled,context.Pshift,0,applyAll))
+		{
+			ccLog::Warning("[LASFilter::loadFile] Cloud has been recentered! Translation: (%.2f,%.2f,%.2f)",context.Pshift.x,context.Pshift.y,context.Pshift.z);
+
+			//we save coordinates shift information
+			if (applyAll && params.coordinatesShiftEnabled && params.coordinatesShift)
+			{
+				*params.coordinatesShiftEnabled = true;
+				*params.coordinatesShift = context.Pshift;
+			}
+		}
+	}
+
+	//output clouds (we may have to "slice" the cloud if it is too big!)
+	CC_FILE_ERROR result = CC_FERR_NO_ERROR;
+	for (uint64_t firstIndex=0; firstIndex<acceptedCount; firstIndex+=CC_MAX_NUMBER_OF_POINTS_PER_CLOUD)
+	{
+		unsigned cloudSize = static_cast<unsigned>(std::min<uint64_t>(acceptedCount-firstIndex,CC_MAX_NUMBER_OF_POINTS_PER_CLOUD));
+
+		ccPointCloud* cloud = new ccPointCloud();
+		context.clouds.push_back(cloud);
+		context.scalarFields.push_back(std::vector<ccScalarField*>(fields.size(),static_cast<ccScalarField*>(0)));
+		if (!cloud->resize(cloudSize) || (context.storeColors && !cloud->resizeTheRGBTable()))
+		{
+			result = CC_FERR_NOT_ENOUGH_MEMORY;
+			break;
+		}
+		cloud->setGlobalShift(context.Pshift);
+
+		for (size_t j=0; j<fields.size(); ++j)
+		{
+			if (!fieldIsLoaded[j])
+				continue;
+
+			ccScalarField* sf = new ccScalarField(LAS_FIELD_NAMES[fields[j]]);
+			if (!sf->resize(cloudSize))
+			{
+				ccLog::Warning(QString("[LAS FILE] Not enough memory: '%1' field will be ignored!").arg(LAS_FIELD_NAMES[fields[j]]));
+				sf->release();
+				continue;
+			}
+			sf->link();
+			cloud->addScalarField(sf);
+			sf->release();
+			context.scalarFields.back()[j] = sf;
+		}
+	}
+
+	//second pass: decoding (by groups of chunks, so as to update the progress bar)
+	uint64_t decodedCount = acceptedCount;
+	if (result == CC_FERR_NO_ERROR)
+	{
+		size_t groupSize = static_cast<size_t>(std::max(1,QThreadPool::globalInstance()->maxThreadCount())) * 4;
+		for (size_t first=0; first<chunks.size(); first+=groupSize)
+		{
+			size_t last = std::min(first+groupSize,chunks.size());
+			std::vector<lasChunk> group(chunks.begin()+first,chunks.begin()+last);
+			QtConcurrent::blockingMap(group, DecodeLASChunk);
+
+			if (!nprogress.steps(static_cast<unsigned>(last-first)))
+			{
+				//cancel requested: we keep the points decoded so far
+				if (last < chunks.size())
+					decodedCount = chunks[last].firstOutputIndex;
+				result = CC_FERR_CANCELED_BY_USER;
+				break;
+			}
+		}
+	}
+
+	if (result != CC_FERR_NO_ERROR && result != CC_FERR_CANCELED_BY_USER)
+	{
+		for (size_t i=0; i<context.clouds.size(); ++i)
+			delete context.clouds[i];
+		return result;
+	}
+
+	//finalization
+	for (size_t i=0; i<context.clouds.size(); ++i)
+	{
+		ccPointCloud* cloud = context.clouds[i];
+
+		//process canceled?
+		uint64_t firstIndex = static_cast<uint64_t>(i) * CC_MAX_NUMBER_OF_POINTS_PER_CLOUD;
+		if (firstIndex >= decodedCount)
+		{
+			delete cloud;
+			continue;
+		}
+		if (firstIndex + cloud->size() > decodedCount)
+			cloud->resize(static_cast<unsigned>(decodedCount - firstIndex));
+
+		bool thisChunkHasColors = cloud->hasColors();
+		cloud->showColors(thisChunkHasColors);
+
+		for (size_t j=0; j<fields.size(); ++j)
+		{
+			ccScalarField* sf = context.scalarFields[i][j];
+			if (!sf)
+				continue;
+
+			sf->computeMinAndMax();
+
+			if (	fields[j] == LAS_CLASSIFICATION
+				||	fields[j] == LAS_RETURN_NUMBER
+				||	fields[j] == LAS_NUMBER_OF_RETURNS)
+			{
+				int cMin = static_cast<int>(sf->getMin());
+				int cMax = static_cast<int>(sf->getMax());
+				sf->setColorRampSteps(std::min<int>(cMax-cMin+1,256));
+			}
+			else if (fields[j] == LAS_INTENSITY)
+			{
+				sf->setColorScale(ccColorScalesManager::GetDefaultScale(ccColorScalesManager::GREY));
+			}
+
+			if (!cloud->hasDisplayedScalarField())
+			{
+				cloud->setCurrentDisplayedScalarField(cloud->getScalarFieldIndexByName(sf->getName()));
+				cloud->showSF(!thisChunkHasColors);
+			}
+		}
+
+		QString chunkName("unnamed - Cloud");
+		if (context.clouds.size() > 1)
+			chunkName += QString(" #%1").arg(static_cast<unsigned>(i+1));
+		cloud->setName(chunkName);
+
+		container.addChild(cloud);
+	}
+
+	return result;
+}
@@ -0,0 +1,149 @@
+//##########################################################################
+//#                                                                        #
+//#                            CLOUDCOMPARE                                #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU General Public License as published by  #
+//#  the Free Software Foundation; version 2 of the License.               #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef CC_LAS_NATIVE_READER_HEADER
+#define CC_LAS_NATIVE_READER_HEADER
+
+#include "FileIOFilter.h"
+#include "LASOpenDlg.h" //for LAS_FIELDS
+
+//system
+#include <vector>
+#include <string>
+#include <stdint.h>
+
+class ccHObject;
+
+//! Native ASPRS LAS (1.0 to 1.4) point reader
+/** Decodes the point data records (formats 0 to 10) of uncompressed
+	LAS files directly from a memory-mapped file, by chunks of points
+	processed in parallel (no third party library involved).
+	Compressed (LAZ) files are not supported.
+**/
+class LASNativeReader
+{
+public:
+
+	//! LAS public header block (useful fields only)
+	struct Header
+	{
+		//! Version (major)
+		unsigned char versionMajor;
+		//! Version (minor)
+		unsigned char versionMinor;
+		//! Point data record format (0 to 10)
+		unsigned char pointFormat;
+		//! Whether the point data is compressed (LAZ)
+		bool compressed;
+		//! Header size (in bytes)
+		unsigned short headerSize;
+		//! Offset to point data (in bytes)
+		uint32_t pointDataOffset;
+		//! Point data record length (in bytes)
+		unsigned short pointRecordLength;
+		//! Number of point records
+		uint64_t pointCount;
+		//! Coordinates scale
+		double scale[3];
+		//! Coordinates offset
+		double offset[3];
+		//! Bounding-box (min corner)
+		double bbMin[3];
+		//! Bounding-box (max corner)
+		double bbMax[3];
+	};
+
+	//! Reads the header of a LAS file
+	/** \param data file data
+		\param dataSize file size
+		\param[out] header file header
+		\return CC_FERR_NO_ERROR if the header is valid
+	**/
+	static CC_FILE_ERROR ReadHeader(const char* data, size_t dataSize, Header& header);
+
+	//! Returns the dimensions of a point data record format (see LAS_FIELD_NAMES)
+	static void GetDimensions(unsigned char pointFormat, std::vector<std::string>& dimensions);
+
+	//! Points filter (applied while the points are decoded)
+	struct Filter
+	{
+		//! Whether to keep only the points inside a box
+		bool useBox;
+		//! Box min corner (file coordinates, i.e. before any shift)
+		double boxMin[3];
+		//! Box max corner (file coordinates, i.e. before any shift)
+		double boxMax[3];
+		//! Accepted classes (all classes are accepted if empty, otherwise 256 flags)
+		std::vector<bool> classes;
+
+		//! Default constructor (no filtering)
+		Filter() : useBox(false)
+		{
+			boxMin[0] = boxMin[1] = boxMin[2] = 0;
+			boxMax[0] = boxMax[1] = boxMax[2] = 0;
+		}
+	};
+
+	//! Loading parameters
+	struct LoadParameters
+	{
+		//! Fields to load as scalar fields
+		std::vector<LAS_FIELDS> fields;
+		//! Color components to load (red, green and blue)
+		bool loadColor[3];
+		//! Whether colors are always coded on 8 bits
+		bool forced8bitRgbMode;
+		//! Whether to ignore fields with default values only
+		bool ignoreDefaultFields;
+		//! Points filter
+		Filter filter;
+		//! Whether the coordinates shift dialog can be displayed
+		bool alwaysDisplayLoadDialog;
+		//! Coordinates shift (input/output, see FileIOFilter::loadFile)
+		bool* coordinatesShiftEnabled;
+		//! Coordinates shift (input/output, see FileIOFilter::loadFile)
+		CCVector3d* coordinatesShift;
+
+		//! Default constructor
+		LoadParameters()
+			: forced8bitRgbMode(false)
+			, ignoreDefaultFields(true)
+			, alwaysDisplayLoadDialog(true)
+			, coordinatesShiftEnabled(0)
+			, coordinatesShift(0)
+		{
+			loadColor[0] = loadColor[1] = loadColor[2] = true;
+		}
+	};
+
+	//! Loads the points of a LAS file
+	/** Clouds are split if they contain more than CC_MAX_NUMBER_OF_POINTS_PER_CLOUD points.
+		\param data file data (see InputMemoryFile)
+		\param dataSize file size
+		\param header file header (see ReadHeader)
+		\param container output container
+		\param params loading parameters
+		\return error code
+	**/
+	static CC_FILE_ERROR Load(	const char* data,
+								size_t dataSize,
+								const Header& header,
+								ccHObject& container,
+								const LoadParameters& params);
+};
+
+#endif //CC_LAS_NATIVE_READER_HEADER
@@ -19,6 +19,7 @@
 
 //Qt
 #include <QMessageBox>
+#include <QStringList>
 
 //System
 #include <string.h>
@@ -128,3 +129,34 @@ bool LASOpenDlg::forced8bitRgbMode() const
 {
 	return force8bitRgbCheckBox->isChecked();
 }
+
+bool LASOpenDlg::getClasses(std::vector<bool>& classes) const
+{
+	classes.clear();
+
+	//e.g. "2,6,9-12"
+	QStringList tokens = classesLineEdit->text().split(",",QString::SkipEmptyParts);
+	if (tokens.empty())
+		return true;
+
+	classes.resize(256,false);
+	for (int i=0; i<tokens.size(); ++i)
+	{
+		QStringList bounds = tokens[i].split("-");
+		if (bounds.size() > 2)
+			return false;
+
+		bool ok = false;
+		int first = bounds.front().trimmed().toInt(&ok);
+		if (!ok)
+			return false;
+		int last = bounds.back().trimmed().toInt(&ok);
+		if (!ok || first < 0 || last > 255 || first > last)
+			return false;
+
+		for (int c=first; c<=last; ++c)
+			classes[c] = true;
+	}
+
+	return true;
+}
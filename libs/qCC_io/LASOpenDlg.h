@@ -93,6 +93,12 @@ public:
 	//! Whether 8-bit RGB mode is forced or not
 	bool forced8bitRgbMode() const;
 
+	//! Returns the classes to load (see LASNativeReader::Filter)
+	/** \param[out] classes 256 flags (or an empty vector if all classes should be loaded)
+		\return false if the classes list is malformed
+	**/
+	bool getClasses(std::vector<bool>& classes) const;
+
 };
 
 #endif //CC_LAS_OPEN_DIALOG
@@ -17,6 +17,7 @@
 
 #include "PCV.h"
 #include "PCVContext.h"
+#include "PCVSoftwareContext.h"
 
 //Qt
 #include <QString>
@@ -190,7 +191,8 @@ int PCV::Launch(unsigned numberOfRays,
 				bool mode360/*=true*/,
 				unsigned width/*=1024*/,
 				unsigned height/*=1024*/,
-				CCLib::GenericProgressCallback* progressCb/*=0*/)
+				CCLib::GenericProgressCallback* progressCb/*=0*/,
+				bool softwareRendering/*=false*/)
 {
 	//generates light directions
 	unsigned rayCount = numberOfRays * (mode360 ? 1 : 2);
@@ -215,7 +217,7 @@ int PCV::Launch(unsigned numberOfRays,
 		rays.resize(rayCount);
 	}
 
-	if (!Launch(rays, vertices, mesh, meshIsClosed, width, height, progressCb))
+	if (!Launch(rays, vertices, mesh, meshIsClosed, width, height, progressCb, softwareRendering))
 		return -1;
 
 	return static_cast<int>(rayCount);
@@ -227,7 +229,8 @@ bool PCV::Launch(std::vector<CCVector3>& rays,
 				 bool meshIsClosed/*=false*/,
 				 unsigned width/*=1024*/,
 				 unsigned height/*=1024*/,
-				 CCLib::GenericProgressCallback* progressCb/*=0*/)
+				 CCLib::GenericProgressCallback* progressCb/*=0*/,
+				 bool softwareRendering/*=false*/)
 {
 	if (rays.empty())
 		return false;
@@ -271,38 +274,48 @@ bool PCV::Launch(std::vector<CCVector3>& rays,
 
 	bool success = true;
 
-	//must be done after progress dialog display!
-	PCVContext win;
-	if (win.init(width,height,vertices,mesh,meshIsClosed))
+	if (softwareRendering)
 	{
-		for (unsigned i=0; i<numberOfRays; ++i)
+		//several directions are rendered concurrently on the CPU
+		PCVSoftwareContext context;
+		success = context.init(width,height,vertices,mesh,meshIsClosed)
+				&& context.accumPixels(rays,visibilityCount,nProgress);
+	}
+	else
+	{
+		//must be done after progress dialog display!
+		PCVContext win;
+		if (win.init(width,height,vertices,mesh,meshIsClosed))
 		{
-			//set current 'light' direction
-			win.setViewDirection(rays[i]);
+			for (unsigned i=0; i<numberOfRays; ++i)
+			{
+				//set current 'light' direction
+				win.setViewDirection(rays[i]);
 
-			//flag viewed vertices
-			win.GLAccumPixel(visibilityCount);
+				//flag viewed vertices
+				win.GLAccumPixel(visibilityCount);
 
-			if (nProgress && !nProgress->oneStep())
-			{
-				success = false;
-				break;
+				if (nProgress && !nProgress->oneStep())
+				{
+					success = false;
+					break;
+				}
 			}
 		}
-
-		if (success)
+		else
 		{
-			//we convert per-vertex accumulators to an 'intensity' scalar field
-			for (unsigned j=0; j<numberOfPoints; ++j)
-			{
-				ScalarType visValue = static_cast<ScalarType>(visibilityCount[j]) / static_cast<ScalarType>(numberOfRays);
-				vertices->setPointScalarValue(j,visValue);
-			}
+			success = false;
 		}
 	}
-	else
+
+	if (success)
 	{
-		success = false;
+		//we convert per-vertex accumulators to an 'intensity' scalar field
+		for (unsigned j=0; j<numberOfPoints; ++j)
+		{
+			ScalarType visValue = static_cast<ScalarType>(visibilityCount[j]) / static_cast<ScalarType>(numberOfRays);
+			vertices->setPointScalarValue(j,visValue);
+		}
 	}
 
 	if (nProgress)
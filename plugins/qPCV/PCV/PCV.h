@@ -42,6 +42,7 @@ public:
 		\param width width  of the OpenGL context used to simulate illumination
 		\param height height of the OpenGL context used to simulate illumination
 		\param progressCb optional progress bar
+		\param softwareRendering whether to use the CPU rasterizer (no OpenGL context required) instead of OpenGL
 		\return number of 'light' directions actually used (or a value <0 if an error occurred)
 	**/
 	static int Launch(unsigned numberOfRays,
@@ -51,7 +52,8 @@ public:
 							bool mode360=true,
 							unsigned width=1024,
 							unsigned height=1024,
-							CCLib::GenericProgressCallback* progressCb=0);
+							CCLib::GenericProgressCallback* progressCb=0,
+							bool softwareRendering=false);
 
 	//! Simulates global illumination on a cloud (or a mesh) with OpenGL
 	/** Computes per-vertex illumination intensity as a scalar field.
@@ -62,6 +64,7 @@ public:
 		\param width width  of the OpenGL context used to simulate illumination
 		\param height height of the OpenGL context used to simulate illumination
 		\param progressCb optional progress bar
+		\param softwareRendering whether to use the CPU rasterizer (no OpenGL context required) instead of OpenGL
 		\return success
 	**/
 	static bool Launch(std::vector<CCVector3>& rays,
@@ -70,7 +73,8 @@ public:
 							bool meshIsClosed=false,
 							unsigned width=1024,
 							unsigned height=1024,
-							CCLib::GenericProgressCallback* progressCb=0);
+							CCLib::GenericProgressCallback* progressCb=0,
+							bool softwareRendering=false);
 };
 
 #endif
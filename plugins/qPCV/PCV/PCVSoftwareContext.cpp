@@ -0,0 +1,384 @@
+//##########################################################################
+//#                                                                        #
+//#                                PCV                                     #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#include "PCVSoftwareContext.h"
+
+//CCLib
+#include <CCConst.h>
+#include <GenericTriangle.h>
+
+//Qt
+#include <QThreadPool>
+#include <QtConcurrentMap>
+
+//system
+#include <assert.h>
+#include <math.h>
+#include <algorithm>
+
+using namespace CCLib;
+
+//same depth offset as PCVContext
+#ifndef ZTWIST
+#define ZTWIST 1e-3f
+#endif
+
+PCVSoftwareContext::PCVSoftwareContext()
+	: m_zoom(1)
+	, m_width(0)
+	, m_height(0)
+	, m_meshIsClosed(false)
+{
+}
+
+bool PCVSoftwareContext::init(	unsigned W,
+								unsigned H,
+								CCLib::GenericCloud* cloud,
+								CCLib::GenericMesh* mesh/*=0*/,
+								bool closedMesh/*=true*/)
+{
+	assert(cloud);
+	if (!cloud || W == 0 || H == 0)
+		return false;
+
+	//we copy the vertices and the triangles, so that they can be
+	//accessed by several threads at the same time
+	try
+	{
+		unsigned nPts = cloud->size();
+		m_vertices.resize(nPts);
+		cloud->placeIteratorAtBegining();
+		for (unsigned i=0; i<nPts; ++i)
+			m_vertices[i] = *cloud->getNextPoint();
+
+		m_triangles.clear();
+		if (mesh)
+		{
+			unsigned nTri = mesh->size();
+			m_triangles.resize(3*static_cast<size_t>(nTri));
+			mesh->placeIteratorAtBegining();
+			for (unsigned i=0; i<nTri; ++i)
+			{
+				const GenericTriangle* t = mesh->_getNextTriangle();
+				m_triangles[3*i  ] = *t->_getA();
+				m_triangles[3*i+1] = *t->_getB();
+				m_triangles[3*i+2] = *t->_getC();
+			}
+		}
+	}
+	catch(std::bad_alloc)
+	{
+		//not enough memory
+		m_vertices.clear();
+		m_triangles.clear();
+		return false;
+	}
+
+	m_meshIsClosed = (closedMesh || !mesh);
+	m_width = W;
+	m_height = H;
+
+	//we get cloud bounding box
+	CCVector3 bbMin,bbMax;
+	cloud->getBoundingBox(bbMin.u,bbMax.u);
+
+	//we compute bbox diagonal
+	PointCoordinateType maxD = (bbMax-bbMin).norm();
+
+	//we deduce default zoom
+	m_zoom = (maxD > ZERO_TOLERANCE ? static_cast<PointCoordinateType>(std::min(m_width,m_height)) / maxD : static_cast<PointCoordinateType>(1.0));
+
+	//as well as display center
+	m_viewCenter = (bbMax+bbMin)/2;
+
+	return true;
+}
+
+void PCVSoftwareContext::getProjection(const CCVector3& V, Projection& proj) const
+{
+	//equivalent to gluLookAt(-V,0,U) + glScale(zoom) + glTranslate(-center) (see PCVContext)
+	CCVector3 U(0,0,1);
+	if (1-fabs(V.dot(U)) < 1.0e-4)
+	{
+		U.y = 1;
+		U.z = 0;
+	}
+
+	PointCoordinateType normV = V.norm();
+	CCVector3 f = (normV > ZERO_TOLERANCE ? V / normV : CCVector3(0,0,1));
+	CCVector3 s = f.cross(U);
+	s.normalize();
+	CCVector3 u = s.cross(f);
+
+	//followed by glOrtho(-w/2,w/2,-h/2,h/2,-maxD,maxD) and the viewport transformation
+	PointCoordinateType w2 = static_cast<PointCoordinateType>(m_width) / 2;
+	PointCoordinateType h2 = static_cast<PointCoordinateType>(m_height) / 2;
+	PointCoordinateType maxD = static_cast<PointCoordinateType>(std::max(m_width,m_height));
+
+	proj.X = s * m_zoom;
+	proj.tx = w2 - proj.X.dot(m_viewCenter);
+	proj.Y = u * m_zoom;
+	proj.ty = h2 - proj.Y.dot(m_viewCenter);
+	proj.Z = f * (m_zoom / (2*maxD));
+	proj.tz = static_cast<PointCoordinateType>(0.5) + normV / (2*maxD) - proj.Z.dot(m_viewCenter);
+}
+
+//! Rasterizes a triangle in a depth buffer (window coordinates)
+static void RasterizeTriangle(	const PointCoordinateType* A,
+								const PointCoordinateType* B,
+								const PointCoordinateType* C,
+								bool cullBackFaces,
+								float* depthBuffer,
+								int W,
+								int H)
+{
+	double area = (static_cast<double>(B[0])-A[0])*(static_cast<double>(C[1])-A[1]) - (static_cast<double>(B[1])-A[1])*(static_cast<double>(C[0])-A[0]);
+	if (area == 0)
+		return;
+	if (area < 0)
+	{
+		//front faces are counter-clockwise (OpenGL default)
+		if (cullBackFaces)
+			return;
+		std::swap(B,C);
+		area = -area;
+	}
+
+	//bounding box (pixels whose center lies inside)
+	int xMin = std::max(0,		static_cast<int>(ceil (std::min(A[0],std::min(B[0],C[0])) - 0.5)));
+	int xMax = std::min(W-1,	static_cast<int>(floor(std::max(A[0],std::max(B[0],C[0])) - 0.5)));
+	int yMin = std::max(0,		static_cast<int>(ceil (std::min(A[1],std::min(B[1],C[1])) - 0.5)));
+	int yMax = std::min(H-1,	static_cast<int>(floor(std::max(A[1],std::max(B[1],C[1])) - 0.5)));
+	if (xMin > xMax || yMin > yMax)
+		return;
+
+	//edge functions (= barycentric coordinates x area)
+	const double invArea = 1.0 / area;
+	const double dxA = (static_cast<double>(C[1])-B[1]), dyA = (static_cast<double>(B[0])-C[0]); //edge BC
+	const double dxB = (static_cast<double>(A[1])-C[1]), dyB = (static_cast<double>(C[0])-A[0]); //edge CA
+	const double dxC = (static_cast<double>(B[1])-A[1]), dyC = (static_cast<double>(A[0])-B[0]); //edge AB
+
+	for (int y=yMin; y<=yMax; ++y)
+	{
+		double py = y + 0.5;
+		double px = xMin + 0.5;
+		double wA = (px-B[0])*dxA + (py-B[1])*dyA;
+		double wB = (px-C[0])*dxB + (py-C[1])*dyB;
+		double wC = (px-A[0])*dxC + (py-A[1])*dyC;
+		//the edge functions above are negated (so that they are positive inside)
+		wA = -wA; wB = -wB; wC = -wC;
+
+		float* depth = depthBuffer + (static_cast<size_t>(y)*W + xMin);
+		for (int x=xMin; x<=xMax; ++x, ++depth)
+		{
+			if (wA >= 0 && wB >= 0 && wC >= 0)
+			{
+				float z = static_cast<float>((wA*A[2] + wB*B[2] + wC*C[2]) * invArea);
+				if (z < *depth)
+					*depth = z;
+			}
+			wA -= dxA;
+			wB -= dxB;
+			wC -= dxC;
+		}
+	}
+}
+
+void PCVSoftwareContext::renderAndFlag(	const CCVector3& V,
+										std::vector<float>& depthBuffer,
+										std::vector<bool>& visible) const
+{
+	const int W = static_cast<int>(m_width);
+	const int H = static_cast<int>(m_height);
+
+	//clear buffers
+	depthBuffer.assign(static_cast<size_t>(W)*H,1.0f);
+	visible.assign(m_vertices.size(),false);
+
+	Projection proj;
+	getProjection(V,proj);
+
+	//render the entity (with the same depth range as PCVContext)
+	const PointCoordinateType renderDepthMin = 2*ZTWIST;
+	const PointCoordinateType renderDepthScale = 1 - 2*ZTWIST;
+	if (!m_triangles.empty())
+	{
+		size_t nTri = m_triangles.size() / 3;
+		for (size_t i=0; i<nTri; ++i)
+		{
+			PointCoordinateType P[3][3];
+			for (unsigned j=0; j<3; ++j)
+			{
+				proj.project(m_triangles[3*i+j],P[j][0],P[j][1],P[j][2]);
+				P[j][2] = renderDepthMin + renderDepthScale * P[j][2];
+			}
+			//back faces are only displayed for meshes that are not closed
+			RasterizeTriangle(P[0],P[1],P[2],m_meshIsClosed,&(depthBuffer[0]),W,H);
+		}
+	}
+	else
+	{
+		for (size_t i=0; i<m_vertices.size(); ++i)
+		{
+			PointCoordinateType x,y,z;
+			proj.project(m_vertices[i],x,y,z);
+			int xi = static_cast<int>(floor(x));
+			int yi = static_cast<int>(floor(y));
+			if (xi >= 0 && xi < W && yi >= 0 && yi < H)
+			{
+				float& depth = depthBuffer[static_cast<size_t>(yi)*W + xi];
+				float zr = static_cast<float>(renderDepthMin + renderDepthScale * z);
+				if (zr < depth)
+					depth = zr;
+			}
+		}
+	}
+
+	//flag the visible vertices (see PCVContext::GLAccumPixel)
+	for (size_t i=0; i<m_vertices.size(); ++i)
+	{
+		PointCoordinateType x,y,z;
+		proj.project(m_vertices[i],x,y,z);
+		int xi = static_cast<int>(floor(x));
+		int yi = static_cast<int>(floor(y));
+		if (xi < 0 || xi >= W || yi < 0 || yi >= H)
+			continue;
+
+		const float* depth = &(depthBuffer[static_cast<size_t>(yi)*W + xi]);
+
+		if (!m_meshIsClosed)
+		{
+			//the vertex must be next to a rendered pixel
+			int dx = (xi+1 < W ? 1 : 0);
+			int dy = (yi+1 < H ? W : 0);
+			if (depth[0] >= 1.0f && depth[dx] >= 1.0f && depth[dy] >= 1.0f && depth[dx+dy] >= 1.0f)
+				continue;
+		}
+
+		if (renderDepthScale * z < *depth)
+			visible[i] = true;
+	}
+}
+
+//! Rendering job (one view direction)
+struct pcvRenderJob
+{
+	//! Rendering context
+	const PCVSoftwareContext* context;
+	//! View direction
+	CCVector3 V;
+	//! Depth buffer
+	std::vector<float> depthBuffer;
+	//! Per-vertex visibility
+	std::vector<bool> visible;
+};
+
+static void RenderJob(pcvRenderJob& job)
+{
+	job.context->renderAndFlag(job.V,job.depthBuffer,job.visible);
+}
+
+//! Accumulation job (a range of vertices)
+struct pcvAccumChunk
+{
+	//! Rendering jobs
+	const pcvRenderJob* jobs;
+	//! Number of rendering jobs
+	size_t jobCount;
+	//! Per-vertex visibility count
+	int* visibilityCount;
+	//! First vertex
+	size_t begin;
+	//! Last vertex (excluded)
+	size_t end;
+};
+
+static void AccumChunk(pcvAccumChunk& chunk)
+{
+	for (size_t j=0; j<chunk.jobCount; ++j)
+	{
+		const std::vector<bool>& visible = chunk.jobs[j].visible;
+		for (size_t i=chunk.begin; i<chunk.end; ++i)
+			if (visible[i])
+				++chunk.visibilityCount[i];
+	}
+}
+
+bool PCVSoftwareContext::accumPixels(	const std::vector<CCVector3>& rays,
+										std::vector<int>& visibilityCount,
+										CCLib::NormalizedProgress* nProgress/*=0*/)
+{
+	if (m_vertices.size() != visibilityCount.size() || m_width == 0 || m_height == 0)
+		return false;
+	if (m_vertices.empty())
+		return true;
+
+	//several directions are rendered at the same time (one per thread)
+	size_t threadCount = static_cast<size_t>(std::max(1,QThreadPool::globalInstance()->maxThreadCount()));
+	std::vector<pcvRenderJob> jobs;
+	std::vector<pcvAccumChunk> chunks;
+	try
+	{
+		jobs.resize(std::min(threadCount,rays.size()));
+		for (size_t j=0; j<jobs.size(); ++j)
+		{
+			jobs[j].context = this;
+			jobs[j].depthBuffer.resize(static_cast<size_t>(m_width)*m_height);
+			jobs[j].visible.resize(m_vertices.size());
+		}
+
+		//then the visibility counts are updated in parallel (by ranges of vertices)
+		size_t chunkCount = std::min(threadCount,m_vertices.size());
+		size_t chunkSize = (m_vertices.size() + chunkCount - 1) / chunkCount;
+		chunks.resize(chunkCount);
+		for (size_t k=0; k<chunkCount; ++k)
+		{
+			chunks[k].jobs = &(jobs[0]);
+			chunks[k].jobCount = 0;
+			chunks[k].visibilityCount = &(visibilityCount[0]);
+			chunks[k].begin = std::min(m_vertices.size(),k*chunkSize);
+			chunks[k].end = std::min(m_vertices.size(),chunks[k].begin+chunkSize);
+		}
+	}
+	catch(std::bad_alloc)
+	{
+		//not enough memory
+		return false;
+	}
+
+	for (size_t first=0; first<rays.size(); first+=jobs.size())
+	{
+		size_t count = std::min(jobs.size(),rays.size()-first);
+		for (size_t j=0; j<count; ++j)
+			jobs[j].V = rays[first+j];
+
+		QtConcurrent::blockingMap(jobs.begin(), jobs.begin()+count, RenderJob);
+
+		for (size_t k=0; k<chunks.size(); ++k)
+			chunks[k].jobCount = count;
+		QtConcurrent::blockingMap(chunks, AccumChunk);
+
+		if (nProgress)
+		{
+			for (size_t j=0; j<count; ++j)
+				if (!nProgress->oneStep())
+					return false;
+		}
+	}
+
+	return true;
+}
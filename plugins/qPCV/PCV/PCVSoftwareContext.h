@@ -0,0 +1,117 @@
+//##########################################################################
+//#                                                                        #
+//#                                PCV                                     #
+//#                                                                        #
+//#  This program is free software; you can redistribute it and/or modify  #
+//#  it under the terms of the GNU Library General Public License as       #
+//#  published by the Free Software Foundation; version 2 of the License.  #
+//#                                                                        #
+//#  This program is distributed in the hope that it will be useful,       #
+//#  but WITHOUT ANY WARRANTY; without even the implied warranty of        #
+//#  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the         #
+//#  GNU General Public License for more details.                          #
+//#                                                                        #
+//#          COPYRIGHT: EDF R&D / TELECOM ParisTech (ENST-TSI)             #
+//#                                                                        #
+//##########################################################################
+
+#ifndef PCV_SOFTWARE_CONTEXT_HEADER
+#define PCV_SOFTWARE_CONTEXT_HEADER
+
+//CCLib
+#include <GenericCloud.h>
+#include <GenericMesh.h>
+#include <GenericProgressCallback.h>
+
+//system
+#include <vector>
+
+//! PCV (Portion de Ciel Visible / Ambiant Illumination) software rendering context
+/** CPU counterpart of PCVContext (no OpenGL context required): the entity is
+	rasterized (points or triangles) in a depth buffer with the same orthographic
+	projection and depth offsets. Several view directions are rendered concurrently
+	(one depth buffer per thread).
+**/
+class PCVSoftwareContext
+{
+	public:
+
+		//! Default constructor
+		PCVSoftwareContext();
+
+		//! Initialization
+		/** \param W render buffer width (pixels)
+			\param H render buffer height (pixels)
+			\param cloud associated cloud (or mesh vertices)
+			\param mesh associated mesh (if any)
+			\param closedMesh whether mesh is closed (faster) or not
+			\return initialization success
+		**/
+		bool init(	unsigned W,
+					unsigned H,
+					CCLib::GenericCloud* cloud,
+					CCLib::GenericMesh* mesh = 0,
+					bool closedMesh = true);
+
+		//! Increments the visibility counter for points viewed from each direction
+		/** \param rays view directions
+			\param visibilityCount per-vertex visibility count (same size as the number of vertices)
+			\param nProgress optional progress notification (one step per direction)
+			\return success (false if the process has been canceled or if there's not enough memory)
+		**/
+		bool accumPixels(	const std::vector<CCVector3>& rays,
+							std::vector<int>& visibilityCount,
+							CCLib::NormalizedProgress* nProgress = 0);
+
+		//! Renders the entity along a given direction and flags the visible vertices
+		/** Thread-safe (as long as each thread uses its own buffers).
+			\param V view direction
+			\param depthBuffer depth buffer (resized if necessary)
+			\param visible per-vertex visibility flags (output)
+		**/
+		void renderAndFlag(	const CCVector3& V,
+							std::vector<float>& depthBuffer,
+							std::vector<bool>& visible) const;
+
+	protected:
+
+		//! Orthographic projection (window coordinates) for a given view direction
+		struct Projection
+		{
+			//! Rows of the projection matrix
+			CCVector3 X, Y, Z;
+			//! Translation
+			PointCoordinateType tx, ty, tz;
+
+			//! Projects a point (x and y in pixels, normalized depth in [0,1])
+			inline void project(const CCVector3& P, PointCoordinateType& x, PointCoordinateType& y, PointCoordinateType& z) const
+			{
+				x = X.dot(P) + tx;
+				y = Y.dot(P) + ty;
+				z = Z.dot(P) + tz;
+			}
+		};
+
+		//! Computes the projection for a given view direction
+		void getProjection(const CCVector3& V, Projection& proj) const;
+
+		//! Vertices
+		std::vector<CCVector3> m_vertices;
+		//! Triangles (3 vertices per triangle - empty for clouds)
+		std::vector<CCVector3> m_triangles;
+
+		//! Current zoom
+		PointCoordinateType m_zoom;
+		//! Displayed entity center
+		CCVector3 m_viewCenter;
+
+		//! Render buffer width (pixels)
+		unsigned m_width;
+		//! Render buffer height (pixels)
+		unsigned m_height;
+
+		//! Whether displayed mesh is closed or not
+		bool m_meshIsClosed;
+};
+
+#endif
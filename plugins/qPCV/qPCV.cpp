@@ -72,6 +72,7 @@ static int s_raysSpinBoxValue			= 256;
 static int s_resSpinBoxValue			= 1024;
 static bool s_mode180CheckBoxState		= true;
 static bool s_closedMeshCheckBoxState	= false;
+static bool s_softwareRenderingState	= false;
 
 void qPCV::doAction()
 {
@@ -122,6 +123,7 @@ void qPCV::doAction()
 		dlg.mode180CheckBox->setChecked(s_mode180CheckBoxState);
 		dlg.resSpinBox->setValue(s_resSpinBoxValue);
 		dlg.closedMeshCheckBox->setChecked(s_closedMeshCheckBoxState);
+		dlg.softwareRenderingCheckBox->setChecked(s_softwareRenderingState);
 	}
 
 	//for meshes only
@@ -163,6 +165,7 @@ void qPCV::doAction()
 		s_mode180CheckBoxState		= dlg.mode180CheckBox->isChecked();
 		s_resSpinBoxValue			= dlg.resSpinBox->value();
 		s_closedMeshCheckBoxState	= dlg.closedMeshCheckBox->isChecked();
+		s_softwareRenderingState	= dlg.softwareRenderingCheckBox->isChecked();
 	}
 
 	//we get the PCV field if it already exists
@@ -182,6 +185,7 @@ void qPCV::doAction()
 	unsigned res = dlg.resSpinBox->value();
 	bool meshIsClosed = (mesh ? dlg.closedMeshCheckBox->checkState()==Qt::Checked : false);
 	bool mode360 = !dlg.mode180CheckBox->isChecked();
+	bool softwareRendering = dlg.softwareRenderingCheckBox->isChecked();
 
 	//progress dialog
 	ccProgressDialog progressCb(true,m_app->getMainWindow());
@@ -199,12 +203,12 @@ void qPCV::doAction()
 		for (unsigned i=0; i<count; ++i)
 			rays[i] = CCVector3(pc->getPointNormal(i));
 
-		success = PCV::Launch(rays,cloud,mesh,meshIsClosed,res,res,&progressCb);
+		success = PCV::Launch(rays,cloud,mesh,meshIsClosed,res,res,&progressCb,softwareRendering);
 	}
 	else
 	{
 		//Version with rays sampled on a sphere
-		success = (PCV::Launch(raysNumber,cloud,mesh,meshIsClosed,mode360,res,res,&progressCb) > 0);
+		success = (PCV::Launch(raysNumber,cloud,mesh,meshIsClosed,mode360,res,res,&progressCb,softwareRendering) > 0);
 	}
 
 	if (!success)
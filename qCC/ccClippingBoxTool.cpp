@@ -29,12 +29,15 @@
 #include <ccClipBox.h>
 #include <ccGenericPointCloud.h>
 #include <ccPointCloud.h>
+#include <ccOctree.h>
 #include <ccProgressDialog.h>
 #include <ccPolyline.h>
 #include <ccProgressDialog.h>
 
 //CCLib
 #include <ReferenceCloud.h>
+#include <ManualSegmentationTools.h>
+#include <PointProjectionTools.h>
 #include <Neighbourhood.h>
 
 //Qt
@@ -155,6 +158,15 @@ bool ccClippingBoxTool::setAssociatedEntity(ccHObject* entity)
 	entity->setVisible(true);
 	entity->setEnabled(true);
 
+	//the clipping box updates (and the slices extraction) rely on the cloud octree
+	ccGenericPointCloud* cloud = static_cast<ccGenericPointCloud*>(entity);
+	if (!cloud->getOctree())
+	{
+		ccProgressDialog pDlg(true,this);
+		if (!cloud->computeOctree(&pDlg))
+			ccLog::Warning(QString("[Clipping box] Failed to compute the octree of cloud '%1'! The clipping box updates will be slower...").arg(entity->getName()));
+	}
+
 	m_clipBox->setAssociatedEntity(entity);
 	if (m_associatedWin)
 		m_associatedWin->redraw();
@@ -355,7 +367,7 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 		extractContours = repeatDlg.extractContoursGroupBox->isChecked();
 	}
 			
-	//compute the cloud bounding box in the local clipping box ref.
+	//transformation to the local clipping box ref.
 	ccGLMatrix localTrans;
 	{
 		if (m_clipBox->isGLTransEnabled())
@@ -364,54 +376,30 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 			localTrans.toIdentity();
 	}
 
-	//compute 'grid' extents in the local clipping box ref.
-	int indexMins[3] = { 0, 0, 0 };
-	int indexMaxs[3] = { 0, 0, 0 };
-	int gridDim[3] = { 1, 1, 1 };
-	unsigned cellCount = 1;
-	CCVector3 gridOrigin = m_clipBox->getBB().minCorner();
-	CCVector3 cellSize = m_clipBox->getBB().getDiagVec();
-	PointCoordinateType gap = (PointCoordinateType)repeatDlg.gapDoubleSpinBox->value();
+	//slices 'grid' in the local clipping box ref.
+	CCLib::ManualSegmentationTools::SlicesGrid grid;
+	grid.transMat = (m_clipBox->isGLTransEnabled() ? localTrans.data() : 0);
+	grid.origin = m_clipBox->getBB().minCorner();
+	grid.cellSize = m_clipBox->getBB().getDiagVec();
+	grid.gap = static_cast<PointCoordinateType>(repeatDlg.gapDoubleSpinBox->value());
 
 	//for mutli-dimensional mode only!
 	if (!singleContourMode)
 	{
-		ccBBox localBox;
-		for (unsigned i=0; i<cloud->size(); ++i)
-		{
-			CCVector3 P = *cloud->getPoint(i);
-			localTrans.apply(P);
-			localBox.add(P);
-		}
-
-		for (unsigned char d=0; d<3; ++d)
+		//compute 'grid' extents
+		if (!CCLib::ManualSegmentationTools::computeSlicesGridExtents(cloud,grid,processDim))
 		{
-			if (processDim[d])
-			{
-				if (cellSize.u[d] + gap < ZERO_TOLERANCE)
-				{
-					ccLog::Error("Box size (plus gap) is null! Can't apply repetitive process!");
-					return;
-				}
-
-				PointCoordinateType a = (localBox.minCorner().u[d] - gridOrigin.u[d])/(cellSize.u[d]+gap); //don't forget the user defined gap between 'cells'
-				PointCoordinateType b = (localBox.maxCorner().u[d] - gridOrigin.u[d])/(cellSize.u[d]+gap);
-
-				indexMins[d] = static_cast<int>(floor(a+static_cast<PointCoordinateType>(1.0e-6)));
-				indexMaxs[d] = static_cast<int>(ceil(b-static_cast<PointCoordinateType>(1.0e-6)))-1;
-				
-				assert(indexMaxs[d] >= indexMins[d]);
-				gridDim[d] = std::max(indexMaxs[d] - indexMins[d] + 1, 1);
-				cellCount *= static_cast<unsigned>(gridDim[d]);
-			}
+			ccLog::Error("Box size (plus gap) is null! Can't apply repetitive process!");
+			return;
 		}
 	}
+	const int* indexMins = grid.indexMins;
+	const int* indexMaxs = grid.indexMaxs;
+	unsigned cellCount = grid.sliceCount();
+	CCVector3 cellSizePlusGap = grid.cellSize + CCVector3(grid.gap,grid.gap,grid.gap);
 
 	//apply process
 	{
-		//backup original clipping box
-		//ccBBox originalBox = m_clipBox->getBox();
-
 		//group to store all the resulting slices
 		ccHObject* sliceGroup = 0;
 
@@ -427,6 +415,10 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 			return;
 		}
 
+		//points indexes sorted by slice (multi-dimensional mode only)
+		std::vector<unsigned> sliceStarts;
+		std::vector<unsigned> pointIndexes;
+
 		bool error = false;
 		bool warningsIssued = false;
 		unsigned subCloudsCount = 0;
@@ -446,75 +438,25 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 		}
 		else
 		{
-			//we'll potentially create up to one (ref.) cloud per cell
-			std::vector<CCLib::ReferenceCloud*> refClouds;
-			try
-			{
-				refClouds.resize(cellCount,0);
-			}
-			catch(std::bad_alloc)
-			{
-				ccLog::Error("Not enough memory!");
-				return;
-			}
-			CCVector3 cellSizePlusGap = cellSize + CCVector3(gap,gap,gap);
-
-			//project points into grid
+			//sort the points by slice (in a single pass)
 			{
-				unsigned pointCount = cloud->size(); 
-
-				ccProgressDialog pDlg(false,this);
-				pDlg.setInfo(qPrintable(QString("Points: %1").arg(pointCount)));
-				pDlg.start();
-				pDlg.show();
-				QApplication::processEvents();
-
-				CCLib::NormalizedProgress nProgress(&pDlg,pointCount);
-				for (unsigned i=0; i<pointCount; ++i)
+				ccProgressDialog pDlg(true,this);
+				if (!CCLib::ManualSegmentationTools::extractSlices(cloud,grid,sliceStarts,pointIndexes,cloud->getOctree(),&pDlg))
 				{
-					CCVector3 P = *cloud->getPoint(i);
-					localTrans.apply(P);
-
-					//relative coordinates (between 0 and 1)
-					P -= gridOrigin;
-					P.x /= cellSizePlusGap.x;
-					P.y /= cellSizePlusGap.y;
-					P.z /= cellSizePlusGap.z;
-
-					int xi = static_cast<int>(floor(P.x));
-					xi = std::min( std::max(xi, indexMins[0]), indexMaxs[0]);
-					int yi = static_cast<int>(floor(P.y));
-					yi = std::min( std::max(yi, indexMins[1]), indexMaxs[1]);
-					int zi = static_cast<int>(floor(P.z));
-					zi = std::min( std::max(zi, indexMins[2]), indexMaxs[2]);
-
-					if ( gap == 0 ||
-						(	(P.x-static_cast<PointCoordinateType>(xi))*cellSizePlusGap.x <= cellSize.x
-						&&	(P.y-static_cast<PointCoordinateType>(yi))*cellSizePlusGap.y <= cellSize.y
-						&&	(P.z-static_cast<PointCoordinateType>(zi))*cellSizePlusGap.z <= cellSize.z) )
-					{
-						int cloudIndex = ((zi-indexMins[2]) * static_cast<int>(gridDim[1]) + (yi-indexMins[1])) * static_cast<int>(gridDim[0]) + (xi-indexMins[0]);
-						assert(cloudIndex < refClouds.size());
-
-						if (!refClouds[cloudIndex])
-						{
-							refClouds[cloudIndex] = new CCLib::ReferenceCloud(cloud);
-							++subCloudsCount;
-						}
-
-						if (!refClouds[cloudIndex]->addPointIndex(i))
-						{
-							ccLog::Error("Not enough memory!");
-							error = true;
-							break;
-						}
-					}
+					if (pDlg.isCancelRequested())
+						ccLog::Warning(QString("[ccClippingBoxTool::exportMultCloud] Process canceled by user"));
+					else
+						ccLog::Error("Not enough memory!");
+					return;
 				}
+			}
 
-				nProgress.oneStep();
-			} //project points into grid
+			for (unsigned s=0; s<cellCount; ++s)
+				if (sliceStarts[s+1] != sliceStarts[s])
+					++subCloudsCount;
 
 			//now create the real clouds
+			//(sequentially, as the creation of entities is not thread-safe)
 			{
 				sliceGroup = new ccHObject(QString("%1.slices").arg(cloud->getName()));
 
@@ -522,81 +464,78 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 				pDlg.show();
 				QApplication::processEvents();
 
-				for (int i=indexMins[0]; i<=indexMaxs[0]; ++i)
+				unsigned currentCloudCount = 0;
+				int pos[3];
+				for (pos[0]=indexMins[0]; pos[0]<=indexMaxs[0] && !error; ++pos[0])
 				{
-					for (int j=indexMins[1]; j<=indexMaxs[1]; ++j)
+					for (pos[1]=indexMins[1]; pos[1]<=indexMaxs[1] && !error; ++pos[1])
 					{
-						for (int k=indexMins[2]; k<=indexMaxs[2]; ++k)
+						for (pos[2]=indexMins[2]; pos[2]<=indexMaxs[2] && !error; ++pos[2])
 						{
-							int cloudIndex = ((k-indexMins[2]) * static_cast<int>(gridDim[1]) + (j-indexMins[1])) * static_cast<int>(gridDim[0]) + (i-indexMins[0]);
-							assert(cloudIndex < refClouds.size());
+							unsigned cloudIndex = grid.sliceIndex(pos);
+							assert(cloudIndex < clouds.size());
 
-							if (refClouds[cloudIndex]) //some slices can be empty due to rounding issues!
+							unsigned sliceSize = sliceStarts[cloudIndex+1] - sliceStarts[cloudIndex];
+							if (sliceSize == 0) //some slices can be empty due to rounding issues!
+								continue;
+
+							CCLib::ReferenceCloud refCloud(cloud);
+							if (!refCloud.reserve(sliceSize))
 							{
-								//generate slice from previous selection
-								int warnings = 0;
-								ccPointCloud* sliceCloud = cloud->partialClone(refClouds[cloudIndex],&warnings);
-								warningsIssued |= (warnings != 0);
-							
-								if (sliceCloud)
+								ccLog::Error("Not enough memory!");
+								error = true;
+								break;
+							}
+							for (unsigned n=0; n<sliceSize; ++n)
+								refCloud.addPointIndex(pointIndexes[sliceStarts[cloudIndex]+n]);
+
+							//generate slice from previous selection
+							int warnings = 0;
+							ccPointCloud* sliceCloud = cloud->partialClone(&refCloud,&warnings);
+							warningsIssued |= (warnings != 0);
+
+							if (sliceCloud)
+							{
+								if (generateRandomColors && cloud->isA(CC_TYPES::POINT_CLOUD))
 								{
-									if (generateRandomColors && cloud->isA(CC_TYPES::POINT_CLOUD))
+									colorType col[3];
+									ccColor::Generator::Random(col);
+									if (!sliceCloud->setRGBColor(col))
 									{
-										colorType col[3];
-										ccColor::Generator::Random(col);
-										if (!sliceCloud->setRGBColor(col))
-										{
-											ccLog::Error("Not enough memory!");
-											error = true;
-											i = indexMaxs[0];
-											j = indexMaxs[1];
-											k = indexMaxs[2];
-										}
-										sliceCloud->showColors(true);
+										ccLog::Error("Not enough memory!");
+										error = true;
 									}
-
-									sliceCloud->setEnabled(true);
-									sliceCloud->setVisible(true);
-									sliceCloud->setDisplay(cloud->getDisplay());
-
-									CCVector3 cellOrigin(	gridOrigin.x + static_cast<PointCoordinateType>(i) * cellSizePlusGap.x,
-															gridOrigin.y + static_cast<PointCoordinateType>(j) * cellSizePlusGap.y,
-															gridOrigin.z + static_cast<PointCoordinateType>(k) * cellSizePlusGap.z);
-									QString slicePosStr = QString("(%1 ; %2 ; %3)").arg(cellOrigin.x).arg(cellOrigin.y).arg(cellOrigin.z);
-									sliceCloud->setName(QString("slice @ ")+slicePosStr);
-
-									//add slice to group
-									sliceGroup->addChild(sliceCloud);
-									//update 'real clouds' grid
-									clouds[cloudIndex] = sliceCloud;
-									++subCloudsCount;
+									sliceCloud->showColors(true);
 								}
 
-								if (pDlg.wasCanceled())
-								{
-									error = true;
-									ccLog::Warning(QString("[ccClippingBoxTool::exportMultCloud] Process canceled by user"));
-									//early stop
-									i = indexMaxs[0];
-									j = indexMaxs[1];
-									k = indexMaxs[2];
-									break;
-								}
-								pDlg.setValue(static_cast<int>(subCloudsCount));
+								sliceCloud->setEnabled(true);
+								sliceCloud->setVisible(true);
+								sliceCloud->setDisplay(cloud->getDisplay());
 
+								CCVector3 cellOrigin(	grid.origin.x + static_cast<PointCoordinateType>(pos[0]) * cellSizePlusGap.x,
+														grid.origin.y + static_cast<PointCoordinateType>(pos[1]) * cellSizePlusGap.y,
+														grid.origin.z + static_cast<PointCoordinateType>(pos[2]) * cellSizePlusGap.z);
+								QString slicePosStr = QString("(%1 ; %2 ; %3)").arg(cellOrigin.x).arg(cellOrigin.y).arg(cellOrigin.z);
+								sliceCloud->setName(QString("slice @ ")+slicePosStr);
+
+								//add slice to group
+								sliceGroup->addChild(sliceCloud);
+								//update 'real clouds' grid
+								clouds[cloudIndex] = sliceCloud;
+							}
+
+							++currentCloudCount;
+							if (pDlg.wasCanceled())
+							{
+								error = true;
+								ccLog::Warning(QString("[ccClippingBoxTool::exportMultCloud] Process canceled by user"));
+								break;
 							}
+							pDlg.setValue(static_cast<int>(currentCloudCount));
 						}
 					}
 				}
 			} //now create the real clouds
-
-			//release memory
-			{
-				for (size_t i=0; i<refClouds.size(); ++i)
-					if (refClouds[i])
-						delete refClouds[i];
-				refClouds.clear();
-			}
 		}
 
 		//extract contour polylines (optionaly)
@@ -609,11 +548,6 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 			{
 				splitContour = (QMessageBox::question(0,"Split contour","Do you want to split the contour(s) in multiple parts if necessary?",QMessageBox::Yes,QMessageBox::No) == QMessageBox::Yes);
 			}
-			ccHObject* contourGroup = new ccHObject(obj->getName() + QString(".contours"));
-
-			QProgressDialog pDlg(QString("Extract contour(s): %1").arg(subCloudsCount),"Cancel",0,static_cast<int>(subCloudsCount),this);
-			pDlg.show();
-			QApplication::processEvents();
 
 			//preferred dimension?
 			int preferredDim = -1;
@@ -626,66 +560,84 @@ void ccClippingBoxTool::extractSlicesAndContours(bool extractSlices, bool extrac
 			ccGLMatrix invLocalTrans = localTrans.inverse();
 			PointCoordinateType* preferredOrientation = (preferredDim != -1 ? invLocalTrans.getColumn(preferredDim) : 0);
 
-			unsigned currentCloudCount = 0;
-			for (int i=indexMins[0]; i<=indexMaxs[0]; ++i)
+			//extract the contours vertices (the slices are processed in parallel)
+			std::vector< std::vector<CCVector3> > contours;
+			if (singleContourMode)
 			{
-				for (int j=indexMins[1]; j<=indexMaxs[1]; ++j)
+				try
 				{
-					for (int k=indexMins[2]; k<=indexMaxs[2]; ++k)
-					{
-						int cloudIndex = ((k-indexMins[2]) * static_cast<int>(gridDim[1]) + (j-indexMins[1])) * static_cast<int>(gridDim[0]) + (i-indexMins[0]);
-						assert(cloudIndex < clouds.size());
+					contours.resize(1);
+				}
+				catch(std::bad_alloc)
+				{
+					ccLog::Error("Not enough memory!");
+					error = true;
+				}
 
-						if (clouds[cloudIndex]) //some slices can be empty due to rounding issues!
-						{
-							std::vector<ccPolyline*> polys;
-							if (ccPolyline::ExtractFlatContour(	clouds[cloudIndex],
-																static_cast<PointCoordinateType>(s_maxEdgeLength),
-																polys,
-																splitContour,
-																preferredOrientation))
-							{
-								if (!polys.empty())
-								{
-									for (size_t p=0; p<polys.size(); ++p)
-									{
-										ccPolyline* poly = polys[p];
-										poly->setColor(ccColor::green);
-										poly->showColors(true);
-										QString contourName = clouds[cloudIndex]->getName();
-										contourName.replace("slice","contour");
-										if (polys.size() != 1)
-											contourName += QString(" (part %1)").arg(p+1);
-										poly->setName(contourName);
-										contourGroup->addChild(poly);
-									}
-								}
-								else
-								{
-									ccLog::Warning(QString("%1: points are too far from each other! Increase the max edge length").arg(clouds[cloudIndex]->getName()));
-									warningsIssued = true;
-								}
-							}
-							else
-							{
-								ccLog::Warning(QString("%1: contour extraction failed!").arg(clouds[cloudIndex]->getName()));
-								warningsIssued = true;
-							}
-						}
-						
-						++currentCloudCount;
-						if (pDlg.wasCanceled())
+				if (!error && clouds[0]->size() >= 3)
+				{
+					if (!CCLib::PointProjectionTools::extractFlatContour(clouds[0],static_cast<PointCoordinateType>(s_maxEdgeLength),contours[0],preferredOrientation))
+						contours[0].clear();
+				}
+			}
+			else
+			{
+				ccProgressDialog pDlg(true,this);
+				if (!CCLib::ManualSegmentationTools::extractSlicesContours(	cloud,
+																			sliceStarts,
+																			pointIndexes,
+																			static_cast<PointCoordinateType>(s_maxEdgeLength),
+																			contours,
+																			preferredOrientation,
+																			&pDlg))
+				{
+					if (pDlg.isCancelRequested())
+						ccLog::Warning(QString("[ccClippingBoxTool::exportMultCloud] Process canceled by user"));
+					else
+						ccLog::Error("Not enough memory!");
+					error = true;
+				}
+			}
+
+			ccHObject* contourGroup = new ccHObject(obj->getName() + QString(".contours"));
+
+			//now create the polylines
+			for (size_t cloudIndex=0; cloudIndex<clouds.size() && !error; ++cloudIndex)
+			{
+				if (!clouds[cloudIndex]) //some slices can be empty due to rounding issues!
+					continue;
+
+				std::vector<ccPolyline*> polys;
+				if (!contours[cloudIndex].empty() && ccPolyline::CreateFlatContour(	contours[cloudIndex],
+																					static_cast<PointCoordinateType>(s_maxEdgeLength),
+																					polys,
+																					splitContour))
+				{
+					if (!polys.empty())
+					{
+						for (size_t p=0; p<polys.size(); ++p)
 						{
-							error = true;
-							ccLog::Warning(QString("[ccClippingBoxTool::exportMultCloud] Process canceled by user"));
-							//early stop
-							i = indexMaxs[0];
-							j = indexMaxs[1];
-							k = indexMaxs[2];
-							break;
+							ccPolyline* poly = polys[p];
+							poly->setColor(ccColor::green);
+							poly->showColors(true);
+							QString contourName = clouds[cloudIndex]->getName();
+							contourName.replace("slice","contour");
+							if (polys.size() != 1)
+								contourName += QString(" (part %1)").arg(p+1);
+							poly->setName(contourName);
+							contourGroup->addChild(poly);
 						}
-						pDlg.setValue(static_cast<int>(currentCloudCount));
 					}
+					else
+					{
+						ccLog::Warning(QString("%1: points are too far from each other! Increase the max edge length").arg(clouds[cloudIndex]->getName()));
+						warningsIssued = true;
+					}
+				}
+				else
+				{
+					ccLog::Warning(QString("%1: contour extraction failed!").arg(clouds[cloudIndex]->getName()));
+					warningsIssued = true;
 				}
 			}
 
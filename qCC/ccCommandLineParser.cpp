@@ -6,6 +6,10 @@
 #include <NormalDistribution.h>
 #include <StatisticalTestingTools.h>
 #include <Neighbourhood.h>
+#include <GeometricalAnalysisTools.h>
+#include <ManualSegmentationTools.h>
+#include <DistanceComputationTools.h>
+#include <MemoryMappedChunks.h>
 
 //qCC_db
 #include <ccProgressDialog.h>
@@ -26,6 +30,12 @@
 #include "mainwindow.h"
 #include "ccComparisonDlg.h"
 #include "ccRegistrationTools.h"
+#include "ccMinimumSpanningTreeForNormsDirection.h"
+
+#ifdef CC_PCV_SUPPORT
+//PCV (see qPCV plugin)
+#include <PCV.h>
+#endif
 
 //Qt
 #include <QMessageBox>
@@ -45,6 +55,8 @@ static const char COMMAND_DENSITY[]							= "DENSITY";		//+ sphere radius
 static const char COMMAND_APPROX_DENSITY[]					= "APPROX_DENSITY";
 static const char COMMAND_SF_GRADIENT[]						= "SF_GRAD";
 static const char COMMAND_ROUGHNESS[]						= "ROUGH";
+static const char COMMAND_GEOM_FEATURES[]					= "GEOM_FEATURES";	//+ features (NORMAL:MEAN_CURV:GAUSS_CURV:ROUGH:DENSITY:LINEARITY:PLANARITY:SPHERICITY:NB_COUNT) + radius (or radii, e.g. 0.5:1.0)
+static const char COMMAND_ORIENT_NORMALS_MST[]				= "ORIENT_NORMS_MST";	//+ number of neighbors
 static const char COMMAND_BUNDLER[]							= "BUNDLER_IMPORT"; //Import Bundler file + orthorectification
 static const char COMMAND_BUNDLER_ALT_KEYPOINTS[]			= "ALT_KEYPOINTS";
 static const char COMMAND_BUNDLER_SCALE_FACTOR[]			= "SCALE_FACTOR";
@@ -55,6 +67,7 @@ static const char COMMAND_C2M_DIST_FLIP_NORMALS[]			= "FLIP_NORMS";
 static const char COMMAND_C2C_DIST[]						= "C2C_DIST";
 static const char COMMAND_C2C_SPLIT_XYZ[]					= "SPLIT_XYZ";
 static const char COMMAND_C2C_LOCAL_MODEL[]					= "MODEL";
+static const char COMMAND_C2C_TILED[]						= "TILED";	//+ max number of points per tile (requires MAX_DIST)
 static const char COMMAND_MAX_DISTANCE[]					= "MAX_DIST";
 static const char COMMAND_OCTREE_LEVEL[]					= "OCTREE_LEVEL";
 static const char COMMAND_SAMPLE_MESH[]						= "SAMPLE_MESH";
@@ -81,12 +94,25 @@ static const char COMMAND_ASCII_EXPORT_SEPARATOR[]			= "SEP";
 static const char COMMAND_MESH_EXPORT_FORMAT[]				= "M_EXPORT_FMT";
 static const char COMMAND_EXPORT_EXTENSION[]				= "EXT";
 static const char COMMAND_NO_TIMESTAMP[]					= "NO_TIMESTAMP";
+static const char COMMAND_OUT_OF_CORE[]						= "OUT_OF_CORE";	//memory-mapped storage for the new clouds
+static const char COMMAND_OUT_OF_CORE_MAX_RESIDENT[]		= "MAX_RESIDENT";	//+ max physical memory used by the mapped data (in Mb)
+static const char COMMAND_OUT_OF_CORE_TEMP_DIR[]			= "TEMP_DIR";		//+ directory of the temporary files
 static const char COMMAND_CROP[]							= "CROP";
 static const char COMMAND_CROP_2D[]							= "CROP2D";
 static const char COMMAND_CROP_OUTSIDE[]					= "OUTSIDE";
+static const char COMMAND_SLICES[]							= "SLICES";			//+ box extents (Xmin:Ymin:Zmin:Xmax:Ymax:Zmax) + repeat dimension(s) (e.g. X, XY or Z)
+static const char COMMAND_SLICES_GAP[]						= "GAP";			//+ gap between slices
+static const char COMMAND_SLICES_CONTOURS[]					= "CONTOURS";		//+ max edge length
 static const char COMMAND_SAVE_CLOUDS[]						= "SAVE_CLOUDS";
 static const char COMMAND_SAVE_MESHES[]						= "SAVE_MESHES";
 static const char COMMAND_SET_ACTIVE_SF[]					= "SET_ACTIVE_SF";
+#ifdef CC_PCV_SUPPORT
+static const char COMMAND_PCV[]								= "PCV";			//Ambient occlusion (software rendering)
+static const char COMMAND_PCV_N_RAYS[]						= "N_RAYS";
+static const char COMMAND_PCV_IS_CLOSED[]					= "IS_CLOSED";
+static const char COMMAND_PCV_180[]							= "180";
+static const char COMMAND_PCV_RESOLUTION[]					= "RESOLUTION";
+#endif
 
 //Current cloud(s) export format (can be modified with the 'COMMAND_CLOUD_EXPORT_FORMAT' option)
 static CC_FILE_TYPES s_CloudExportFormat = BIN;
@@ -687,6 +713,211 @@ bool ccCommandLineParser::commandRoughness(QStringList& arguments, QDialog* pare
 	return true;
 }
 
+bool ccCommandLineParser::commandGeomFeatures(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[GEOMETRIC FEATURES]");
+
+	//features
+	if (arguments.empty())
+		return Error(QString("Missing parameter: features after \"-%1\" (e.g. NORMAL:ROUGH:PLANARITY)").arg(COMMAND_GEOM_FEATURES));
+
+	struct FeatureName
+	{
+		const char* keyword;
+		const char* sfName;
+		CCLib::GeometricalAnalysisTools::GeomFeature feature;
+	};
+	static const FeatureName s_featureNames[] = {	{ "NORMAL",		0,						CCLib::GeometricalAnalysisTools::GF_NORMAL				},
+													{ "MEAN_CURV",	"Mean curvature",		CCLib::GeometricalAnalysisTools::GF_MEAN_CURVATURE		},
+													{ "GAUSS_CURV",	"Gaussian curvature",	CCLib::GeometricalAnalysisTools::GF_GAUSSIAN_CURVATURE	},
+													{ "ROUGH",		"Roughness",			CCLib::GeometricalAnalysisTools::GF_ROUGHNESS			},
+													{ "DENSITY",	"Density",				CCLib::GeometricalAnalysisTools::GF_DENSITY				},
+													{ "LINEARITY",	"Linearity",			CCLib::GeometricalAnalysisTools::GF_LINEARITY			},
+													{ "PLANARITY",	"Planarity",			CCLib::GeometricalAnalysisTools::GF_PLANARITY			},
+													{ "SPHERICITY",	"Sphericity",			CCLib::GeometricalAnalysisTools::GF_SPHERICITY			},
+													{ "NB_COUNT",	"Neighbors count",		CCLib::GeometricalAnalysisTools::GF_NEIGHBOR_COUNT		} };
+	static const size_t s_featureCount = sizeof(s_featureNames)/sizeof(FeatureName);
+
+	std::vector<size_t> featureIndexes;
+	{
+		QStringList tokens = arguments.takeFirst().toUpper().split(':',QString::SkipEmptyParts);
+		for (int i=0; i<tokens.size(); ++i)
+		{
+			size_t j = 0;
+			while (j < s_featureCount && tokens[i] != s_featureNames[j].keyword)
+				++j;
+			if (j == s_featureCount)
+				return Error(QString("Invalid parameter: unknown feature '%1' after \"-%2\"").arg(tokens[i]).arg(COMMAND_GEOM_FEATURES));
+			featureIndexes.push_back(j);
+		}
+		if (featureIndexes.empty())
+			return Error(QString("Invalid parameter: no feature after \"-%1\"").arg(COMMAND_GEOM_FEATURES));
+	}
+
+	//radii
+	std::vector<PointCoordinateType> radii;
+	{
+		if (arguments.empty())
+			return Error(QString("Missing parameter: radius (or radii) after \"-%1\" {features} (e.g. 0.5:1.0)").arg(COMMAND_GEOM_FEATURES));
+		QStringList tokens = arguments.takeFirst().split(':',QString::SkipEmptyParts);
+		for (int i=0; i<tokens.size(); ++i)
+		{
+			bool conversionOk = false;
+			PointCoordinateType radius = static_cast<PointCoordinateType>(tokens[i].toDouble(&conversionOk));
+			if (!conversionOk || radius <= 0)
+				return Error(QString("Invalid parameter: radius after \"-%1\" {features}. Got '%2' instead.").arg(COMMAND_GEOM_FEATURES).arg(tokens[i]));
+			radii.push_back(radius);
+		}
+		if (radii.empty())
+			return Error(QString("Invalid parameter: no radius after \"-%1\" {features}").arg(COMMAND_GEOM_FEATURES));
+	}
+
+	if (m_clouds.empty())
+		return Error(QString("No point cloud on which to compute geometric features! (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN).arg(COMMAND_GEOM_FEATURES));
+
+	for (size_t i=0; i<m_clouds.size(); ++i)
+	{
+		ccPointCloud* pc = m_clouds[i].pc;
+		unsigned pointCount = pc->size();
+
+		//we create the output scalar fields (a cloud can only store one set of normals: they are computed with the first radius)
+		std::vector<CCLib::GeometricalAnalysisTools::GeomFeatureDesc> features;
+		CCLib::GeometricalAnalysisTools::NormalsContainer* normals = 0;
+		int lastSfIdx = -1;
+		for (size_t r=0; r<radii.size(); ++r)
+		{
+			for (size_t f=0; f<featureIndexes.size(); ++f)
+			{
+				const FeatureName& desc = s_featureNames[featureIndexes[f]];
+				CCLib::GeometricalAnalysisTools::GeomFeatureDesc feature(desc.feature,radii[r]);
+
+				if (desc.feature == CCLib::GeometricalAnalysisTools::GF_NORMAL)
+				{
+					if (r != 0 || normals)
+						continue;
+					normals = new CCLib::GeometricalAnalysisTools::NormalsContainer();
+					if (!normals->resize(pointCount))
+					{
+						normals->release();
+						return Error("Not enough memory!");
+					}
+					feature.normals = normals;
+				}
+				else
+				{
+					QString sfName = QString("%1 (%2)").arg(desc.sfName).arg(radii[r]);
+					int sfIdx = pc->getScalarFieldIndexByName(qPrintable(sfName));
+					if (sfIdx >= 0)
+						pc->deleteScalarField(sfIdx);
+					sfIdx = pc->addScalarField(qPrintable(sfName));
+					if (sfIdx < 0)
+					{
+						if (normals)
+							normals->release();
+						return Error("Not enough memory!");
+					}
+					feature.sf = pc->getScalarField(sfIdx);
+					lastSfIdx = sfIdx;
+				}
+
+				features.push_back(feature);
+			}
+		}
+
+		//compute octree if necessary
+		ccOctree* theOctree = pc->getOctree();
+		if (!theOctree)
+			theOctree = pc->computeOctree(pDlg);
+
+		int result = -3;
+		if (theOctree)
+			result = CCLib::GeometricalAnalysisTools::computeGeomFeatures(pc,features,pDlg,theOctree);
+
+		if (result == 0)
+		{
+			for (size_t f=0; f<features.size(); ++f)
+				if (features[f].sf)
+					static_cast<ccScalarField*>(features[f].sf)->computeMinAndMax();
+			if (lastSfIdx >= 0)
+			{
+				pc->setCurrentDisplayedScalarField(lastSfIdx);
+				pc->showSF(true);
+			}
+
+			if (normals)
+			{
+				if (pc->resizeTheNormsTable())
+				{
+					for (unsigned j=0; j<pointCount; ++j)
+						pc->setPointNormalIndex(j,ccNormalVectors::GetNormIndex(normals->getValue(j)));
+					pc->showNormals(true);
+				}
+				else
+				{
+					ccConsole::Warning(QString("Not enough memory to store the normals of cloud '%1'").arg(pc->getName()));
+				}
+			}
+		}
+
+		if (normals)
+		{
+			normals->release();
+			normals = 0;
+		}
+
+		if (result != 0)
+			return Error(QString("Failed to compute the geometric features of cloud '%1' (error code: %2)").arg(pc->getName()).arg(result));
+
+		//save output
+		QString errorStr = Export(m_clouds[i],"GEOM_FEATURES");
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+	}
+
+	return true;
+}
+
+bool ccCommandLineParser::commandOrientNormalsMST(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[ORIENT NORMALS (MST)]");
+
+	if (arguments.empty())
+		return Error(QString("Missing parameter: number of neighbors after \"-%1\"").arg(COMMAND_ORIENT_NORMALS_MST));
+
+	bool paramOk = false;
+	QString knnStr = arguments.takeFirst();
+	int knn = knnStr.toInt(&paramOk);
+	if (!paramOk || knn <= 0)
+		return Error(QString("Invalid parameter: number of neighbors (after \"-%1\"). Got '%2' instead.").arg(COMMAND_ORIENT_NORMALS_MST).arg(knnStr));
+	Print(QString("\tNumber of neighbors: %1").arg(knn));
+
+	if (m_clouds.empty())
+		return Error(QString("No point cloud on which to orient normals! (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN).arg(COMMAND_ORIENT_NORMALS_MST));
+
+	for (size_t i=0; i<m_clouds.size(); ++i)
+	{
+		ccPointCloud* cloud = m_clouds[i].pc;
+		assert(cloud);
+
+		if (!cloud->hasNormals())
+		{
+			ccConsole::Warning(QString("Cloud '%1' has no normals!").arg(cloud->getName()));
+			continue;
+		}
+
+		//use Minimum Spanning Tree to resolve normals direction
+		if (!ccMinimumSpanningTreeForNormsDirection::Process(cloud,static_cast<unsigned>(knn),pDlg,cloud->getOctree()))
+			return Error(QString("Failed to orient the normals of cloud '%1'!").arg(cloud->getName()));
+
+		//save output
+		QString errorStr = Export(m_clouds[i],QString("NORMS_MST_KNN_%1").arg(knn));
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+	}
+
+	return true;
+}
+
 //special SF values that can be used instead of explicit ones
 enum USE_SPECIAL_SF_VALUE { USE_NONE,
 							USE_MIN,
@@ -1112,6 +1343,131 @@ bool ccCommandLineParser::commandSampleMesh(QStringList& arguments, ccProgressDi
 	return true;
 }
 
+#ifdef CC_PCV_SUPPORT
+//! Computes the PCV scalar field of a cloud (or of the vertices of a mesh)
+static bool ComputePCV(	ccPointCloud* pc,
+						ccGenericMesh* mesh,
+						unsigned rayCount,
+						bool meshIsClosed,
+						bool mode360,
+						unsigned resolution,
+						ccProgressDialog* pDlg)
+{
+	static const char PCV_SF_NAME[] = "Illuminance (PCV)";
+
+	int sfIdx = pc->getScalarFieldIndexByName(PCV_SF_NAME);
+	if (sfIdx < 0)
+		sfIdx = pc->addScalarField(PCV_SF_NAME);
+	if (sfIdx < 0)
+		return false;
+	pc->setCurrentScalarField(sfIdx);
+
+	//no OpenGL context is available on the command line: we use the software renderer
+	if (PCV::Launch(rayCount,pc,mesh,meshIsClosed,mode360,resolution,resolution,pDlg,true) <= 0)
+	{
+		pc->deleteScalarField(sfIdx);
+		return false;
+	}
+
+	pc->getScalarField(sfIdx)->computeMinAndMax();
+	pc->setCurrentDisplayedScalarField(sfIdx);
+	return true;
+}
+
+bool ccCommandLineParser::commandPCV(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[PCV]");
+
+	//look for local options
+	unsigned rayCount = 256;
+	bool meshIsClosed = false;
+	bool mode360 = true;
+	unsigned resolution = 1024;
+
+	while (!arguments.empty())
+	{
+		QString argument = arguments.front();
+		if (IsCommand(argument,COMMAND_PCV_N_RAYS))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: number of rays after \"-%1\"").arg(COMMAND_PCV_N_RAYS));
+			bool conversionOk = false;
+			rayCount = arguments.takeFirst().toUInt(&conversionOk);
+			if (!conversionOk || rayCount == 0)
+				return Error(QString("Invalid parameter: number of rays after \"-%1\"").arg(COMMAND_PCV_N_RAYS));
+		}
+		else if (IsCommand(argument,COMMAND_PCV_IS_CLOSED))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			meshIsClosed = true;
+		}
+		else if (IsCommand(argument,COMMAND_PCV_180))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			mode360 = false;
+		}
+		else if (IsCommand(argument,COMMAND_PCV_RESOLUTION))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: resolution after \"-%1\"").arg(COMMAND_PCV_RESOLUTION));
+			bool conversionOk = false;
+			resolution = arguments.takeFirst().toUInt(&conversionOk);
+			if (!conversionOk || resolution == 0)
+				return Error(QString("Invalid parameter: resolution after \"-%1\"").arg(COMMAND_PCV_RESOLUTION));
+		}
+		else
+		{
+			break; //as soon as we encounter an unrecognized argument, we break the local loop to go back on the main one!
+		}
+	}
+
+	if (m_clouds.empty() && m_meshes.empty())
+		return Error(QString("No point cloud or mesh available. Be sure to open one first!"));
+
+	for (size_t i=0; i<m_clouds.size(); ++i)
+	{
+		if (!ComputePCV(m_clouds[i].pc,0,rayCount,false,mode360,resolution,pDlg))
+			return Error(QString("Failed to compute the PCV field on cloud '%1'").arg(m_clouds[i].pc->getName()));
+
+		//save output
+		QString errorStr = Export(m_clouds[i],"PCV");
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+	}
+
+	for (size_t i=0; i<m_meshes.size(); ++i)
+	{
+		ccGenericMesh* mesh = m_meshes[i].mesh;
+		ccGenericPointCloud* vertices = mesh->getAssociatedCloud();
+		if (!vertices || !vertices->isA(CC_TYPES::POINT_CLOUD))
+		{
+			ccConsole::Warning(QString("Mesh '%1' has no real vertices: PCV field can't be computed").arg(mesh->getName()));
+			continue;
+		}
+
+		if (!ComputePCV(static_cast<ccPointCloud*>(vertices),mesh,rayCount,meshIsClosed,mode360,resolution,pDlg))
+			return Error(QString("Failed to compute the PCV field on mesh '%1'").arg(mesh->getName()));
+
+		//save output
+		QString errorStr = Export(m_meshes[i],"PCV");
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+	}
+
+	return true;
+}
+#endif
+
 bool ccCommandLineParser::commandCrop(QStringList& arguments)
 {
 	Print("[CROP]");
@@ -1199,6 +1555,226 @@ bool ccCommandLineParser::commandCrop(QStringList& arguments)
 	return true;
 }
 
+bool ccCommandLineParser::commandSlices(QStringList& arguments, ccProgressDialog* pDlg/*=0*/)
+{
+	Print("[SLICES]");
+
+	if (arguments.empty())
+		return Error(QString("Missing parameter: box extents after \"-%1\" (Xmin:Ymin:Zmin:Xmax:Ymax:Zmax)").arg(COMMAND_SLICES));
+
+	//decode box extents
+	CCVector3 boxMin,boxMax;
+	{
+		QString boxBlock = arguments.takeFirst();
+		QStringList tokens = boxBlock.split(':');
+		if (tokens.size() != 6)
+			return Error(QString("Invalid parameter: box extents (expected format is 'Xmin:Ymin:Zmin:Xmax:Ymax:Zmax')"));
+
+		for (int i=0; i<6; ++i)
+		{
+			CCVector3* vec = (i<3 ? &boxMin : &boxMax);
+			bool ok = true;
+			vec->u[i%3] = static_cast<PointCoordinateType>(tokens[i].toDouble(&ok));
+			if (!ok)
+			{
+				return Error(QString("Invalid parameter: box extents (component #%1 is not a valid number)").arg(i+1));
+			}
+		}
+	}
+
+	//repeat dimension(s)
+	bool repeatDim[3] = { false, false, false };
+	unsigned repeatDimCount = 0;
+	{
+		if (arguments.empty())
+			return Error(QString("Missing parameter: repeat dimension(s) after \"-%1\" {box extents} (e.g. X, XY or Z)").arg(COMMAND_SLICES));
+		QString dimStr = arguments.takeFirst().toUpper();
+		for (int i=0; i<dimStr.length(); ++i)
+		{
+			int d = QString("XYZ").indexOf(dimStr[i]);
+			if (d < 0 || repeatDim[d])
+				return Error(QString("Invalid parameter: repeat dimension(s) after \"-%1\" {box extents}. Got '%2' instead (e.g. X, XY or Z).").arg(COMMAND_SLICES).arg(dimStr));
+			repeatDim[d] = true;
+			++repeatDimCount;
+		}
+		if (repeatDimCount == 0)
+			return Error(QString("Invalid parameter: no repeat dimension after \"-%1\" {box extents}").arg(COMMAND_SLICES));
+	}
+
+	//optional parameters
+	PointCoordinateType gap = 0;
+	bool extractContours = false;
+	PointCoordinateType maxEdgeLength = 0;
+	while (!arguments.empty())
+	{
+		QString argument = arguments.front();
+		if (IsCommand(argument,COMMAND_SLICES_GAP))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: value after \"-%1\"").arg(COMMAND_SLICES_GAP));
+			bool conversionOk = false;
+			gap = static_cast<PointCoordinateType>(arguments.takeFirst().toDouble(&conversionOk));
+			if (!conversionOk || gap < 0)
+				return Error(QString("Invalid value for \"-%1\"!").arg(COMMAND_SLICES_GAP));
+		}
+		else if (IsCommand(argument,COMMAND_SLICES_CONTOURS))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: max edge length after \"-%1\"").arg(COMMAND_SLICES_CONTOURS));
+			bool conversionOk = false;
+			maxEdgeLength = static_cast<PointCoordinateType>(arguments.takeFirst().toDouble(&conversionOk));
+			if (!conversionOk || maxEdgeLength < 0)
+				return Error(QString("Invalid value for \"-%1\"!").arg(COMMAND_SLICES_CONTOURS));
+			extractContours = true;
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	if (m_clouds.empty())
+		return Error(QString("No point cloud to slice! (be sure to open one with \"-%1 [cloud filename]\" before \"-%2\")").arg(COMMAND_OPEN).arg(COMMAND_SLICES));
+
+	//preferred (normal) direction for the contours
+	PointCoordinateType preferredDim[3] = { 0, 0, 0 };
+	if (repeatDimCount == 1)
+	{
+		for (unsigned char d=0; d<3; ++d)
+			if (repeatDim[d])
+				preferredDim[d] = 1;
+	}
+
+	for (size_t i=0; i<m_clouds.size(); ++i)
+	{
+		ccPointCloud* pc = m_clouds[i].pc;
+
+		CCLib::ManualSegmentationTools::SlicesGrid grid;
+		grid.origin = boxMin;
+		grid.cellSize = boxMax - boxMin;
+		grid.gap = gap;
+		if (!CCLib::ManualSegmentationTools::computeSlicesGridExtents(pc,grid,repeatDim))
+			return Error(QString("Box size (plus gap) is null! Can't slice cloud '%1'").arg(pc->getName()));
+
+		//compute octree if necessary
+		ccOctree* theOctree = pc->getOctree();
+		if (!theOctree)
+			theOctree = pc->computeOctree(pDlg);
+
+		std::vector<unsigned> sliceStarts;
+		std::vector<unsigned> pointIndexes;
+		if (!CCLib::ManualSegmentationTools::extractSlices(pc,grid,sliceStarts,pointIndexes,theOctree,pDlg))
+			return Error(QString("Failed to slice cloud '%1' (not enough memory?)").arg(pc->getName()));
+
+		//export the slices
+		unsigned sliceCount = 0;
+		std::vector<QString> sliceNames(grid.sliceCount());
+		int pos[3];
+		for (pos[0]=grid.indexMins[0]; pos[0]<=grid.indexMaxs[0]; ++pos[0])
+		{
+			for (pos[1]=grid.indexMins[1]; pos[1]<=grid.indexMaxs[1]; ++pos[1])
+			{
+				for (pos[2]=grid.indexMins[2]; pos[2]<=grid.indexMaxs[2]; ++pos[2])
+				{
+					unsigned sliceIndex = grid.sliceIndex(pos);
+					unsigned sliceSize = sliceStarts[sliceIndex+1] - sliceStarts[sliceIndex];
+					if (sliceSize == 0)
+						continue;
+
+					CCLib::ReferenceCloud refCloud(pc);
+					if (!refCloud.reserve(sliceSize))
+						return Error("Not enough memory!");
+					for (unsigned n=0; n<sliceSize; ++n)
+						refCloud.addPointIndex(pointIndexes[sliceStarts[sliceIndex]+n]);
+
+					ccPointCloud* sliceCloud = pc->partialClone(&refCloud);
+					if (!sliceCloud)
+						return Error(QString("Not enough memory to create the slices of cloud '%1'!").arg(pc->getName()));
+
+					sliceNames[sliceIndex] = QString("SLICE_%1_%2_%3").arg(pos[0]).arg(pos[1]).arg(pos[2]);
+					sliceCloud->setName(pc->getName());
+
+					CloudDesc sliceDesc(sliceCloud,m_clouds[i].basename,m_clouds[i].path,m_clouds[i].indexInFile);
+					QString errorStr = Export(sliceDesc,sliceNames[sliceIndex]);
+					delete sliceCloud;
+					sliceCloud = 0;
+
+					if (!errorStr.isEmpty())
+						return Error(errorStr);
+					++sliceCount;
+				}
+			}
+		}
+		Print(QString("%1 slice(s) extracted from cloud '%2'").arg(sliceCount).arg(pc->getName()));
+
+		//extract the contours (optional)
+		if (extractContours)
+		{
+			std::vector< std::vector<CCVector3> > contours;
+			if (!CCLib::ManualSegmentationTools::extractSlicesContours(	pc,
+																		sliceStarts,
+																		pointIndexes,
+																		maxEdgeLength,
+																		contours,
+																		repeatDimCount == 1 ? preferredDim : 0,
+																		pDlg))
+			{
+				return Error(QString("Failed to extract the contours of the slices of cloud '%1' (not enough memory?)").arg(pc->getName()));
+			}
+
+			ccHObject contourGroup(pc->getName() + QString(".contours"));
+			for (size_t s=0; s<contours.size(); ++s)
+			{
+				if (contours[s].empty())
+					continue;
+
+				std::vector<ccPolyline*> polys;
+				if (!ccPolyline::CreateFlatContour(contours[s],maxEdgeLength,polys,maxEdgeLength > 0))
+				{
+					ccConsole::Warning(QString("%1: contour extraction failed!").arg(sliceNames[s]));
+					continue;
+				}
+				for (size_t p=0; p<polys.size(); ++p)
+				{
+					QString contourName = sliceNames[s];
+					contourName.replace("SLICE","CONTOUR");
+					if (polys.size() != 1)
+						contourName += QString("_PART_%1").arg(p+1);
+					polys[p]->setName(contourName);
+					contourGroup.addChild(polys[p]);
+				}
+			}
+
+			if (contourGroup.getChildrenNumber() == 0)
+			{
+				ccConsole::Warning(QString("No contour could be extracted from the slices of cloud '%1'").arg(pc->getName()));
+			}
+			else
+			{
+				//save contours as a BIN file
+				QString contourFilename = QString("%1/%2").arg(m_clouds[i].path).arg(m_clouds[i].basename);
+				if (m_clouds[i].indexInFile >= 0)
+					contourFilename += QString("_%1").arg(m_clouds[i].indexInFile);
+				contourFilename += QString("_CONTOURS");
+				if (s_addTimestamp)
+					contourFilename += QString("_%1").arg(QDateTime::currentDateTime().toString("yyyy-MM-dd_hh'h'mm"));
+				contourFilename += QString(".bin");
+
+				if (FileIOFilter::SaveToFile(&contourGroup,qPrintable(contourFilename),BIN) != CC_FERR_NO_ERROR)
+					return Error(QString("Failed to save contours in file '%1'").arg(contourFilename));
+			}
+		}
+	}
+
+	return true;
+}
+
 bool ccCommandLineParser::commandCrop2D(QStringList& arguments)
 {
 	Print("[CROP 2D]");
@@ -1405,7 +1981,7 @@ bool ccCommandLineParser::commandBundler(QStringList& arguments)
 	return true;
 }
 
-bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDist, QDialog* parent/*=0*/)
+bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDist, ccProgressDialog* pDlg/*=0*/, QDialog* parent/*=0*/)
 {
 	Print("[DISTANCE COMPUTATION]");
 
@@ -1444,6 +2020,7 @@ bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDis
 	int modelIndex = 0;
 	bool useKNN = true;
 	double nSize = 0;
+	unsigned maxPointsPerTile = 0;
 
 	while (!arguments.empty())
 	{
@@ -1545,12 +2122,69 @@ bool ccCommandLineParser::commandDist(QStringList& arguments, bool cloud2meshDis
 				return Error(QString("Missing parameter: expected neighborhood size after neighborhood type (neighbor count/sphere radius)"));
 			}
 		}
+		else if (IsCommand(argument,COMMAND_C2C_TILED))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: max number of points per tile after \"-%1\"").arg(COMMAND_C2C_TILED));
+			bool conversionOk = false;
+			maxPointsPerTile = arguments.takeFirst().toUInt(&conversionOk);
+			if (!conversionOk || maxPointsPerTile == 0)
+				return Error(QString("Invalid parameter: max number of points per tile after \"-%1\"").arg(COMMAND_C2C_TILED));
+
+			if (cloud2meshDist)
+				ccConsole::Warning(QString("Parameter \"-%1\" ignored: only for C2C distance!").arg(COMMAND_C2C_TILED));
+		}
 		else
 		{
 			break; //as soon as we encounter an unrecognized argument, we break the local loop to go back on the main one!
 		}
 	}
 
+	//tiled C2C distance (for very large clouds: no global octree is built)
+	if (maxPointsPerTile != 0 && !cloud2meshDist)
+	{
+		if (maxDist <= 0)
+			return Error(QString("Parameter \"-%1\" requires a max distance (\"-%2\")").arg(COMMAND_C2C_TILED).arg(COMMAND_MAX_DISTANCE));
+		if (splitXYZ || modelIndex != 0)
+			ccConsole::Warning(QString("Parameters \"-%1\" and \"-%2\" are ignored in tiled mode!").arg(COMMAND_C2C_SPLIT_XYZ).arg(COMMAND_C2C_LOCAL_MODEL));
+
+		ccPointCloud* pc = compCloud.pc;
+		int sfIdx = pc->getScalarFieldIndexByName(CC_CLOUD2CLOUD_DISTANCES_DEFAULT_SF_NAME);
+		if (sfIdx >= 0)
+			pc->deleteScalarField(sfIdx);
+		sfIdx = pc->addScalarField(CC_CLOUD2CLOUD_DISTANCES_DEFAULT_SF_NAME);
+		if (sfIdx < 0)
+			return Error("Not enough memory!");
+		pc->setCurrentScalarField(sfIdx);
+
+		CCLib::DistanceComputationTools::Cloud2CloudDistanceComputationParams params;
+		params.maxSearchDist = static_cast<ScalarType>(maxDist);
+		params.octreeLevel = static_cast<uchar>(octreeLevel < static_cast<unsigned>(CCLib::DgmOctree::MAX_OCTREE_LEVEL) ? octreeLevel : CCLib::DgmOctree::MAX_OCTREE_LEVEL); //0 = automatic (for each tile)
+
+		int result = CCLib::DistanceComputationTools::computeTiledHausdorffDistance(pc,m_clouds[1].pc,params,maxPointsPerTile,0,pDlg);
+		if (result < 0)
+		{
+			pc->deleteScalarField(sfIdx);
+			return Error(QString("An error occured during distances computation! (error code: %1)").arg(result));
+		}
+
+		ccScalarField* sf = static_cast<ccScalarField*>(pc->getScalarField(sfIdx));
+		sf->computeMinAndMax();
+		pc->setCurrentDisplayedScalarField(sfIdx);
+		pc->showSF(true);
+
+		compCloud.basename += QString("_C2C_DIST_MAX_DIST_%1").arg(maxDist);
+
+		QString errorStr = Export(compCloud);
+		if (!errorStr.isEmpty())
+			return Error(errorStr);
+
+		return true;
+	}
+
 	//spawn dialog (virtually) so as to prepare the comparison process
 	ccComparisonDlg compDlg(compCloud.pc,
 							refEntity,
@@ -2067,6 +2701,52 @@ bool ccCommandLineParser::commandChangeCloudOutputFormat(QStringList& arguments)
 	return true;
 }
 
+bool ccCommandLineParser::commandOutOfCore(QStringList& arguments)
+{
+	Print("[OUT-OF-CORE STORAGE]");
+
+	//optional parameters
+	while (!arguments.empty())
+	{
+		QString argument = arguments.front();
+		if (IsCommand(argument,COMMAND_OUT_OF_CORE_MAX_RESIDENT))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: memory size (in Mb) after \"-%1\"").arg(COMMAND_OUT_OF_CORE_MAX_RESIDENT));
+			bool conversionOk = false;
+			double maxResidentMb = arguments.takeFirst().toDouble(&conversionOk);
+			if (!conversionOk || maxResidentMb < 0)
+				return Error(QString("Invalid value for \"-%1\"!").arg(COMMAND_OUT_OF_CORE_MAX_RESIDENT));
+
+			MemoryMappedChunks::SetResidencyLimit(static_cast<size_t>(maxResidentMb * 1048576.0));
+			Print(QString("Max resident memory: %1 Mb").arg(maxResidentMb));
+		}
+		else if (IsCommand(argument,COMMAND_OUT_OF_CORE_TEMP_DIR))
+		{
+			//local option confirmed, we can move on
+			arguments.pop_front();
+
+			if (arguments.empty())
+				return Error(QString("Missing parameter: directory after \"-%1\"").arg(COMMAND_OUT_OF_CORE_TEMP_DIR));
+			QString tempDir = arguments.takeFirst();
+			MemoryMappedChunks::SetTempDirectory(qPrintable(tempDir));
+			Print(QString("Temporary files directory: %1").arg(tempDir));
+		}
+		else
+		{
+			break; //as soon as we encounter an unrecognized argument, we break the local loop to go back on the main one!
+		}
+	}
+
+	//the clouds loaded (or created) from now on will be stored in memory-mapped files
+	MemoryMappedChunks::SetEnabled(true);
+
+	return true;
+}
+
 bool ccCommandLineParser::commandChangeMeshOutputFormat(QStringList& arguments)
 {
 	CC_FILE_TYPES type = getFileFormat(arguments);
@@ -2143,6 +2823,16 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			success = commandRoughness(arguments,parent);
 		}
+		// "GEOM_FEATURES" GEOMETRIC FEATURES (SINGLE PASS)
+		else if (IsCommand(argument,COMMAND_GEOM_FEATURES))
+		{
+			success = commandGeomFeatures(arguments,&progressDlg);
+		}
+		// "ORIENT_NORMS_MST" NORMALS ORIENTATION
+		else if (IsCommand(argument,COMMAND_ORIENT_NORMALS_MST))
+		{
+			success = commandOrientNormalsMST(arguments,&progressDlg);
+		}
 		//Import Bundler file + orthorectification
 		else if (IsCommand(argument,COMMAND_BUNDLER))
 		{
@@ -2151,12 +2841,12 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		//Cloud-Mesh distance
 		else if (IsCommand(argument,COMMAND_C2M_DIST))
 		{
-			success = commandDist(arguments,true,parent);
+			success = commandDist(arguments,true,&progressDlg,parent);
 		}
 		//Cloud-Cloud distance
 		else if (IsCommand(argument,COMMAND_C2C_DIST))
 		{
-			success = commandDist(arguments,false,parent);
+			success = commandDist(arguments,false,&progressDlg,parent);
 		}
 		//Mesh sampling
 		else if (IsCommand(argument,COMMAND_SAMPLE_MESH))
@@ -2203,6 +2893,11 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			success = commandCrop2D(arguments);
 		}
+		//Slices
+		else if (IsCommand(argument,COMMAND_SLICES))
+		{
+			success = commandSlices(arguments,&progressDlg);
+		}
 		//Change default cloud output format
 		else if (IsCommand(argument,COMMAND_CLOUD_EXPORT_FORMAT))
 		{
@@ -2217,6 +2912,13 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			success = setActiveSF(arguments);
 		}
+#ifdef CC_PCV_SUPPORT
+		//ambient occlusion
+		else if (IsCommand(argument,COMMAND_PCV))
+		{
+			success = commandPCV(arguments,&progressDlg);
+		}
+#endif
 		//save all loaded clouds
 		else if (IsCommand(argument,COMMAND_SAVE_CLOUDS))
 		{
@@ -2248,6 +2950,11 @@ int ccCommandLineParser::parse(QStringList& arguments, QDialog* parent/*=0*/)
 		{
 			s_addTimestamp = false;
 		}
+		//out-of-core storage
+		else if (IsCommand(argument,COMMAND_OUT_OF_CORE))
+		{
+			success = commandOutOfCore(arguments);
+		}
 		//silent mode (i.e. no console)
 		else if (IsCommand(argument,COMMAND_SILENT_MODE))
 		{
@@ -34,20 +34,27 @@ protected:
 	bool commandApproxDensity				(QStringList& arguments, QDialog* parent = 0);
 	bool commandSFGradient					(QStringList& arguments, QDialog* parent = 0);
 	bool commandRoughness					(QStringList& arguments, QDialog* parent = 0);
+	bool commandGeomFeatures				(QStringList& arguments, ccProgressDialog* pDlg = 0);
+	bool commandOrientNormalsMST			(QStringList& arguments, ccProgressDialog* pDlg = 0);
 	bool commandSampleMesh					(QStringList& arguments, ccProgressDialog* pDlg = 0);
 	bool commandBundler						(QStringList& arguments);
-	bool commandDist						(QStringList& arguments, bool cloud2meshDist, QDialog* parent = 0);
+	bool commandDist						(QStringList& arguments, bool cloud2meshDist, ccProgressDialog* pDlg = 0, QDialog* parent = 0);
 	bool commandFilterSFByValue				(QStringList& arguments);
 	bool commandMergeClouds					(QStringList& arguments);
 	bool commandStatTest					(QStringList& arguments, ccProgressDialog* pDlg = 0);
 	bool commandBestFitPlane				(QStringList& arguments);
 	bool commandCrop						(QStringList& arguments);
 	bool commandCrop2D						(QStringList& arguments);
+	bool commandSlices						(QStringList& arguments, ccProgressDialog* pDlg = 0);
 	bool matchBBCenters						(QStringList& arguments);
 	bool commandICP							(QStringList& arguments, QDialog* parent = 0);
 	bool commandChangeCloudOutputFormat		(QStringList& arguments);
 	bool commandChangeMeshOutputFormat		(QStringList& arguments);
+	bool commandOutOfCore					(QStringList& arguments);
 	bool setActiveSF						(QStringList& arguments);
+#ifdef CC_PCV_SUPPORT
+	bool commandPCV							(QStringList& arguments, ccProgressDialog* pDlg = 0);
+#endif
 
 protected:
 
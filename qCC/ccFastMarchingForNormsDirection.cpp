@@ -77,6 +77,13 @@ int ccFastMarchingForNormsDirection::init(	ccGenericPointCloud* cloud,
 	CCLib::DgmOctree::cellCodesContainer cellCodes;
 	theOctree->getCellCodes(level,cellCodes,true);
 
+	//the cells are stored contiguously
+	if (!instantiateCellsTpl(m_cells,cellCodes.size()))
+	{
+		//not enough memory
+		return -1;
+	}
+
 	CCLib::ReferenceCloud Yk(theOctree->associatedCloud());
 
 	while (!cellCodes.empty())
@@ -95,7 +102,7 @@ int ccFastMarchingForNormsDirection::init(	ccGenericPointCloud* cloud,
 		unsigned gridPos = FM_pos2index(cellPos);
 
 		//create corresponding cell
-		DirectionCell* aCell = new DirectionCell;
+		DirectionCell* aCell = &m_cells[cellCodes.size()-1];
 		{
 			//aCell->signConfidence = 1;
 			aCell->cellCode = cellCodes.back();
@@ -244,7 +251,7 @@ int ccFastMarchingForNormsDirection::step()
 					float t_new = computeT(nIndex);
 
 					if (t_new < t_old)
-						nCell->T = t_new;
+						decreaseTrialCellTime(nIndex,t_new);
 				}
 			}
 		}
@@ -350,10 +357,11 @@ void ccFastMarchingForNormsDirection::initTrialCells()
 			if (nCell/* && nCell->state == DirectionCell::FAR_CELL*/)
 			{
 				assert(nCell->state == DirectionCell::FAR_CELL);
-				addTrialCell(nIndex);
 
 				//compute its approximate arrival time
 				nCell->T = seedCell->T + m_neighboursDistance[i] * computeTCoefApprox(seedCell,nCell);
+
+				addTrialCell(nIndex);
 			}
 		}
 	}
@@ -89,9 +89,6 @@ protected:
 #endif
 		{}
 
-		///! Destructor
-		virtual ~DirectionCell() {}
-
 		//! The local cell normal
 		CCVector3 N;
 		//! The local cell center
@@ -110,7 +107,7 @@ protected:
 	virtual float computeTCoefApprox(CCLib::FastMarching::Cell* currentCell, CCLib::FastMarching::Cell* neighbourCell) const;
 	virtual int step();
 	virtual void initTrialCells();
-	virtual bool instantiateGrid(unsigned size) { return instantiateGridTpl<DirectionCell*>(size); }
+	virtual bool instantiateGrid(unsigned size) { return instantiateGridTpl<DirectionCell>(size); }
 
 	//! Computes relative 'confidence' between two cells (orientations)
 	/** \return confidence between 0 and 1
@@ -119,6 +116,9 @@ protected:
 
 	//! Resolves the direction of a given cell (once and for all)
 	void resolveCellOrientation(unsigned index);
+
+	//! Grid cells (non empty ones only)
+	std::vector<DirectionCell> m_cells;
 };
 
 #endif
@@ -31,6 +31,7 @@
 #include <ccPointCloud.h>
 #include <ccMesh.h>
 #include <ccHObjectCaster.h>
+#include <ccOctree.h>
 
 //Qt
 #include <QMenu>
@@ -580,6 +581,47 @@ void ccGraphicalSegmentationTool::segment(bool keepPointsInside)
 	int VP[4];
 	m_associatedWin->getViewportArray(VP);
 
+	//equivalent of 'gluProject' (minus the half screen size) as a single 4x4 matrix
+	double screenMat[16];
+	{
+		//projMat * viewMat
+		double clipMat[16];
+		for (unsigned c=0; c<4; ++c)
+			for (unsigned r=0; r<4; ++r)
+				clipMat[c*4+r] = MP[r]*MM[c*4] + MP[4+r]*MM[c*4+1] + MP[8+r]*MM[c*4+2] + MP[12+r]*MM[c*4+3];
+
+		//viewport transformation
+		const double sx = static_cast<double>(VP[2])/2;
+		const double sy = static_cast<double>(VP[3])/2;
+		const double tx = VP[0] + sx - half_w;
+		const double ty = VP[1] + sy - half_h;
+		for (unsigned c=0; c<4; ++c)
+		{
+			screenMat[c*4]   = sx * clipMat[c*4]   + tx * clipMat[c*4+3];
+			screenMat[c*4+1] = sy * clipMat[c*4+1] + ty * clipMat[c*4+3];
+			screenMat[c*4+2] = clipMat[c*4+2];
+			screenMat[c*4+3] = clipMat[c*4+3];
+		}
+	}
+
+	//segmentation polygon
+	std::vector<CCVector2> polyVertices;
+	try
+	{
+		polyVertices.resize(m_segmentationPoly->size());
+	}
+	catch(std::bad_alloc)
+	{
+		ccLog::Error("Not enough memory!");
+		return;
+	}
+	for (unsigned j=0; j<m_segmentationPoly->size(); ++j)
+	{
+		CCVector3 V;
+		m_segmentationPoly->getPoint(j,V);
+		polyVertices[j] = CCVector2(V.x,V.y);
+	}
+
 	//for each selected entity
 	for (std::set<ccHObject*>::iterator p = m_toSegment.begin(); p != m_toSegment.end(); ++p)
 	{
@@ -592,20 +634,19 @@ void ccGraphicalSegmentationTool::segment(bool keepPointsInside)
 		unsigned cloudSize = cloud->size();
 
 		//we project each point and we check if it falls inside the segmentation polyline
+		//(the octree - if any - is used to reject the cells that are outside)
+		std::vector<unsigned char> insideFlags;
+		if (!CCLib::ManualSegmentationTools::flagPointsInsidePoly(cloud,polyVertices,insideFlags,screenMat,cloud->getOctree()))
+		{
+			ccLog::Error("Not enough memory!");
+			break;
+		}
+
 		for (unsigned i=0; i<cloudSize; ++i)
 		{
 			if (visibilityArray->getValue(i) == POINT_VISIBLE)
 			{
-				CCVector3 P;
-				cloud->getPoint(i,P);
-
-				GLdouble xp,yp,zp;
-				gluProject(P.x,P.y,P.z,MM,MP,VP,&xp,&yp,&zp);
-
-				CCVector2 P2D(	static_cast<PointCoordinateType>(xp-half_w),
-								static_cast<PointCoordinateType>(yp-half_h) );
-				bool pointInside = CCLib::ManualSegmentationTools::isPointInsidePoly(P2D,m_segmentationPoly);
-
+				bool pointInside = (insideFlags[i] != 0);
 				visibilityArray->setValue(i, keepPointsInside != pointInside ? POINT_HIDDEN : POINT_VISIBLE );
 			}
 		}
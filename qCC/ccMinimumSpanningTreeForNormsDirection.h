@@ -26,14 +26,25 @@ class ccPointCloud;
 
 //! Minimum Spanning Tree for normals direction resolution
 /** See http://people.maths.ox.ac.uk/wendland/research/old/reconhtml/node3.html
+	Wrapper around CCLib::NormalsOrientationTools::orientNormalsWithMST.
 **/
 class ccMinimumSpanningTreeForNormsDirection
 {
 
 public:
 
+	//! Default number of neighbors used to build the graph
+	static const unsigned DEFAULT_NEIGHBOR_COUNT = 6;
+
 	//! Main entry point
+	/** \param cloud cloud (with normals)
+		\param kNN number of neighbors used to build the graph
+		\param progressCb progress callback
+		\param octree cloud octree (computed if not set)
+		\return success
+	**/
 	static bool Process(	ccPointCloud* cloud,
+							unsigned kNN = DEFAULT_NEIGHBOR_COUNT,
 							CCLib::GenericProgressCallback* progressCb = 0,
 							CCLib::DgmOctree* octree = 0);
 };
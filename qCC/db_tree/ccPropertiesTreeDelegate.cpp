@@ -823,7 +823,11 @@ template<int N, class ElementType> void ccPropertiesTreeDelegate::fillWithChunke
 	appendRow( ITEM("Capacity"), ITEM(QLocale(QLocale::English).toString(_obj->capacity()) ) );
 
 	//Memory
-	appendRow( ITEM("Memory"), ITEM(QString("%1 Mb").arg((double)_obj->memory()/1048576.0,0,'f',2)) );
+	size_t mappedBytes = 0;
+	size_t residentBytes = _obj->memory(mappedBytes);
+	appendRow( ITEM("Memory"), ITEM(QString("%1 Mb").arg((double)residentBytes/1048576.0,0,'f',2)) );
+	if (mappedBytes != 0)
+		appendRow( ITEM("Mapped (out-of-core)"), ITEM(QString("%1 Mb").arg((double)mappedBytes/1048576.0,0,'f',2)) );
 
 	//ccChunkedArray objects are 'shareable'
 	fillWithShareable(_obj);
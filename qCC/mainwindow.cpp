@@ -5576,6 +5576,12 @@ void MainWindow::doActionOrientNormalsMST()
 		return;
 	}
 
+	//ask for parameter
+	bool ok;
+	unsigned kNN = static_cast<unsigned>(QInputDialog::getInt(this,"Neighborhood size", "Neighbors", ccMinimumSpanningTreeForNormsDirection::DEFAULT_NEIGHBOR_COUNT, 1, 1000, 1, &ok));
+	if (!ok)
+		return;
+
 	ccProgressDialog pDlg(true,this);
 
 	bool success = false;
@@ -5592,7 +5598,7 @@ void MainWindow::doActionOrientNormalsMST()
 		}
 
 		//use Minimum Spanning Tree to resolve normals direction
-		if (ccMinimumSpanningTreeForNormsDirection::Process(cloud,&pDlg,cloud->getOctree()))
+		if (ccMinimumSpanningTreeForNormsDirection::Process(cloud,kNN,&pDlg,cloud->getOctree()))
 		{
 			cloud->prepareDisplayForRefresh();
 			success = true;
@@ -8669,9 +8675,7 @@ void MainWindow::loadFile()
 	filters.append(QString(CC_FILE_TYPE_FILTERS[X3D]) + ";;");
 #endif
 
-#ifdef CC_LAS_SUPPORT
 	filters.append(QString(CC_FILE_TYPE_FILTERS[LAS]) + ";;");
-#endif
 #ifdef CC_E57_SUPPORT
 	filters.append(QString(CC_FILE_TYPE_FILTERS[E57]) + ";;");
 #endif